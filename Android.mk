@@ -9,6 +9,7 @@ include $(LIBYAMICODEC_PATH)/vaapi/Android.mk
 include $(LIBYAMICODEC_PATH)/decoder/Android.mk
 include $(LIBYAMICODEC_PATH)/encoder/Android.mk
 include $(LIBYAMICODEC_PATH)/vpp/Android.mk
+include $(LIBYAMICODEC_PATH)/pipeline/Android.mk
 include $(LIBYAMICODEC_PATH)/v4l2/Android.mk
 
 include $(CLEAR_VARS)
@@ -25,6 +26,7 @@ LOCAL_WHOLE_STATIC_LIBRARIES := \
         libcodecparser \
         libyami_vaapi \
         libyami_vpp \
+        libyami_pipeline \
         libyami_decoder \
         libyami_encoder \
 
@@ -80,6 +80,46 @@ void decodeFlush(DecodeHandler p)
         ((IVideoDecoder*)p)->flush();
 }
 
+YamiStatus decodeSetDecodePolicy(DecodeHandler p, VideoDecodePolicy policy)
+{
+     if(p)
+        return ((IVideoDecoder*)p)->setDecodePolicy(policy);
+     else
+         return YAMI_FAIL;
+}
+
+YamiStatus decodeGetFirstDisplayTimeStamp(DecodeHandler p, int64_t* timeStamp)
+{
+     if(p)
+        return ((IVideoDecoder*)p)->getFirstDisplayTimeStamp(timeStamp);
+     else
+         return YAMI_FAIL;
+}
+
+int decodeGetEventFd(DecodeHandler p)
+{
+     if(p)
+        return ((IVideoDecoder*)p)->getEventFd();
+     else
+         return -1;
+}
+
+YamiStatus decodeSetSchedulePriority(DecodeHandler p, uint32_t priority)
+{
+     if(p)
+        return ((IVideoDecoder*)p)->setSchedulePriority(priority);
+     else
+         return YAMI_FAIL;
+}
+
+YamiStatus decodeGetScheduleStats(DecodeHandler p, VideoScheduleStats* stats)
+{
+     if(p)
+        return ((IVideoDecoder*)p)->getScheduleStats(stats);
+     else
+         return YAMI_FAIL;
+}
+
 YamiStatus decodeDecode(DecodeHandler p, VideoDecodeBuffer* buffer)
 {
      if(p)
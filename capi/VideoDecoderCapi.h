@@ -41,6 +41,17 @@ void decodeStop(DecodeHandler p);
 
 void decodeFlush(DecodeHandler p);
 
+YamiStatus decodeSetDecodePolicy(DecodeHandler p, VideoDecodePolicy policy);
+
+YamiStatus decodeGetFirstDisplayTimeStamp(DecodeHandler p, int64_t* timeStamp);
+
+/* readable when there is output or a surface was freed, -1 on failure */
+int decodeGetEventFd(DecodeHandler p);
+
+YamiStatus decodeSetSchedulePriority(DecodeHandler p, uint32_t priority);
+
+YamiStatus decodeGetScheduleStats(DecodeHandler p, VideoScheduleStats* stats);
+
 YamiStatus decodeDecode(DecodeHandler p, VideoDecodeBuffer* buffer);
 
 VideoFrame* decodeGetOutput(DecodeHandler p);
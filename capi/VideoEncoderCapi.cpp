@@ -20,6 +20,7 @@
 #include "VideoEncoderCapi.h"
 #include "interface/VideoEncoderInterface.h"
 #include "interface/VideoEncoderHost.h"
+#include <vector>
 
 using namespace YamiMediaCodec;
 
@@ -63,6 +64,18 @@ YamiStatus encodeEncode(EncodeHandler p, VideoFrame* frame)
     return ((IVideoEncoder*)p)->encode(f);
 }
 
+YamiStatus encodeEncodeBatch(EncodeHandler p, VideoFrame** frames, VideoEncOutputBuffer* outputs, uint32_t count)
+{
+    if (!frames)
+        return YAMI_INVALID_PARAM;
+    std::vector<SharedPtr<VideoFrame> > f(count);
+    for (uint32_t i = 0; i < count; i++)
+        f[i].reset(frames[i], freeFrame);
+    if (!p || !count)
+        return YAMI_INVALID_PARAM;
+    return ((IVideoEncoder*)p)->encodeBatch(&f[0], outputs, count);
+}
+
 YamiStatus encodeEncodeRawData(EncodeHandler p, VideoFrameRawData* inBuffer)
 {
     if(p)
@@ -103,6 +116,30 @@ YamiStatus encodeGetMaxOutSize(EncodeHandler p, uint32_t* maxSize)
         return YAMI_FAIL;
 }
 
+int encodeGetEventFd(EncodeHandler p)
+{
+    if(p)
+        return ((IVideoEncoder*)p)->getEventFd();
+    else
+        return -1;
+}
+
+YamiStatus encodeSetSchedulePriority(EncodeHandler p, uint32_t priority)
+{
+    if(p)
+        return ((IVideoEncoder*)p)->setSchedulePriority(priority);
+    else
+        return YAMI_FAIL;
+}
+
+YamiStatus encodeGetScheduleStats(EncodeHandler p, VideoScheduleStats* stats)
+{
+    if(p)
+        return ((IVideoEncoder*)p)->getScheduleStats(stats);
+    else
+        return YAMI_FAIL;
+}
+
 void releaseEncoder(EncodeHandler p)
 {
     if (p)
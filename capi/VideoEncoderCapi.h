@@ -41,12 +41,23 @@ YamiStatus encodeEncode(EncodeHandler p, VideoFrame* frame);
 
 YamiStatus encodeGetOutput(EncodeHandler p, VideoEncOutputBuffer* outBuffer, bool withWait);
 
+/* encodes count frames and waits for all of them, outputs[i] gets frames[i].
+   encoder will call frames[i]->free, no matter it return fail or not */
+YamiStatus encodeEncodeBatch(EncodeHandler p, VideoFrame** frames, VideoEncOutputBuffer* outputs, uint32_t count);
+
 YamiStatus encodeGetParameters(EncodeHandler p, VideoParamConfigType type, Yami_PTR videoEncParams);
 
 YamiStatus encodeSetParameters(EncodeHandler p, VideoParamConfigType type, Yami_PTR videoEncParams);
 
 YamiStatus encodeGetMaxOutSize(EncodeHandler p, uint32_t* maxSize);
 
+/* readable when there is output or encode is no longer busy, -1 on failure */
+int encodeGetEventFd(EncodeHandler p);
+
+YamiStatus encodeSetSchedulePriority(EncodeHandler p, uint32_t priority);
+
+YamiStatus encodeGetScheduleStats(EncodeHandler p, VideoScheduleStats* stats);
+
 void releaseEncoder(EncodeHandler p);
 
 /*deprecated*/
@@ -36,7 +36,7 @@ public:
     uint32_t read(uint32_t nbits);
 
     /*read the next nbits bits from the bitstream but not advance the bitstream pointer*/
-    uint32_t peek(uint32_t nbits) const;
+    virtual uint32_t peek(uint32_t nbits) const;
 
     /* You are allowed to skip less than BitReader::CACHEBYTES bytes
      * when call this function at a time. And if you need to skip more than
@@ -608,6 +608,45 @@ error:
     return false;
 }
 
+bool Parser::parseRecoveryPoint(RecoveryPoint& recovery, const NalUnit* nalu)
+{
+    if (nalu->nal_unit_type != NAL_SEI)
+        return false;
+
+    NalReader nr(nalu->m_data + nalu->m_nalUnitHeaderBytes,
+        nalu->m_size - nalu->m_nalUnitHeaderBytes);
+
+    //7.3.2.3.1, sei_message() until rbsp_trailing_bits()
+    while (nr.moreRbspData()) {
+        uint32_t payloadType = 0;
+        uint32_t payloadSize = 0;
+        uint32_t byte;
+        do {
+            if (!nr.read(byte, 8))
+                return false;
+            payloadType += byte;
+        } while (byte == 0xff);
+        do {
+            if (!nr.read(byte, 8))
+                return false;
+            payloadSize += byte;
+        } while (byte == 0xff);
+
+        if (payloadType == SEI_RECOVERY_POINT) {
+            recovery.recovery_frame_cnt = nr.readUe();
+            recovery.exact_match_flag = nr.read(1);
+            recovery.broken_link_flag = nr.read(1);
+            recovery.changing_slice_group_idc = nr.read(2);
+            return true;
+        }
+        if (payloadSize > (nr.getRemainingBitsCount() >> 3))
+            return false;
+        for (uint32_t i = 0; i < payloadSize; i++)
+            nr.skip(8);
+    }
+    return false;
+}
+
 inline SharedPtr<PPS>
 Parser::searchPps(uint8_t id) const
 {
@@ -364,6 +364,14 @@ struct DecRefPicMarking {
     uint8_t n_ref_pic_marking;
 };
 
+//D.1.7 recovery point SEI message
+struct RecoveryPoint {
+    uint32_t recovery_frame_cnt;
+    uint8_t exact_match_flag;
+    uint8_t broken_link_flag;
+    uint8_t changing_slice_group_idc;
+};
+
 class SliceHeader {
 public:
     SliceHeader() { memset(&pred_weight_table, 0, sizeof(pred_weight_table)); }
@@ -424,7 +432,8 @@ public:
     enum {
         MAX_CPB_CNT_MINUS1 = 31,
         MAX_CHROMA_FORMAT_IDC = 3,
-        SCALING_LIST_DEFAULT_VALUE = 16
+        SCALING_LIST_DEFAULT_VALUE = 16,
+        SEI_RECOVERY_POINT = 6
     };
 
     typedef std::map<uint8_t, SharedPtr<SPS> > SpsMap;
@@ -432,6 +441,8 @@ public:
 
     bool parseSps(SharedPtr<SPS>& sps, const NalUnit* nalu);
     bool parsePps(SharedPtr<PPS>& pps, const NalUnit* nalu);
+    //return true if the sei nal unit carries a recovery point message
+    bool parseRecoveryPoint(RecoveryPoint& recovery, const NalUnit* nalu);
 
     inline SharedPtr<PPS> searchPps(uint8_t id) const;
     inline SharedPtr<SPS> searchSps(uint8_t id) const;
@@ -213,5 +213,26 @@ namespace H264 {
         ASSERT_FALSE(HasFailure());
     }
 
+    H264_PARSER_TEST(Parse_RecoveryPoint)
+    {
+        //user data unregistered followed by a recovery point, recovery_frame_cnt = 2
+        const uint8_t sei[] = { 0x06, 0x05, 0x02, 0xaa, 0xbb, 0x06, 0x01, 0x71, 0x80 };
+        //user data unregistered only
+        const uint8_t noRecovery[] = { 0x06, 0x05, 0x02, 0xaa, 0xbb, 0x80 };
+        NalUnit nalu;
+        Parser parser;
+        RecoveryPoint recovery;
+
+        ASSERT_TRUE(nalu.parseNalUnit(sei, sizeof(sei)));
+        ASSERT_TRUE(parser.parseRecoveryPoint(recovery, &nalu));
+        EXPECT_EQ(2u, recovery.recovery_frame_cnt);
+        EXPECT_EQ(1, recovery.exact_match_flag);
+        EXPECT_EQ(0, recovery.broken_link_flag);
+        EXPECT_EQ(0, recovery.changing_slice_group_idc);
+
+        ASSERT_TRUE(nalu.parseNalUnit(noRecovery, sizeof(noRecovery)));
+        EXPECT_FALSE(parser.parseRecoveryPoint(recovery, &nalu));
+    }
+
 } // namespace H264
 } // namespace YamiParser
@@ -0,0 +1,619 @@
+/*
+ * Copyright 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----
+ *
+ * Parts of IJG's libjpeg library (jdhuff.c, jdphuff.c and jidctint.c) were
+ * used as a reference while implementing this decoder.  The progressive
+ * refinement logic and the accurate integer IDCT reproduce the ones found
+ * in those files, refactored to fit into the overall libyami framework.
+ * Therefore, this implementation is considered to be partially derived from
+ * IJG's libjpeg.
+ *
+ * The following license preamble, below, is reproduced from libjpeg's
+ * jidctint.c file.  The README.ijg is also provided with this file:
+ *
+ * Copyright (C) 1991-1998, Thomas G. Lane.
+ * The jidctint.c file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README.ijg file.
+ *
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// primary header
+#include "jpegCoefficientDecoder.h"
+
+// library headers
+#include "common/log.h"
+
+// system headers
+#include <algorithm>
+#include <cstring>
+
+namespace YamiParser {
+namespace JPEG {
+
+// codes up to this many bits long are decoded with a single table lookup
+#define HUFF_LOOKAHEAD 9
+
+// natural order position of each zigzag index, padded so that a corrupt
+// run can not step past the end of a block
+static const uint8_t naturalOrder[DCTSIZE2 + 16] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63,
+    63, 63, 63, 63, 63, 63, 63, 63,
+    63, 63, 63, 63, 63, 63, 63, 63
+};
+
+// a HuffTable expanded for decoding
+class DerivedTable {
+public:
+    bool init(const HuffTable& table)
+    {
+        uint32_t code = 0;
+        int32_t index = 0;
+
+        memset(lookLength, 0, sizeof(lookLength));
+        for (uint32_t length = 1; length <= 16; length++) {
+            const uint32_t count = table.codes[length - 1];
+            if (index + count > 256)
+                return false;
+            valOffset[length] = index - code;
+            for (uint32_t i = 0; i < count; i++, code++, index++) {
+                if (length > HUFF_LOOKAHEAD)
+                    continue;
+                const uint32_t shift = HUFF_LOOKAHEAD - length;
+                for (uint32_t j = 0; j < (1u << shift); j++) {
+                    lookLength[(code << shift) + j] = length;
+                    lookValue[(code << shift) + j] = table.values[index];
+                }
+            }
+            // a code of all one bits is not allowed
+            if (code >= (1u << length))
+                return false;
+            maxCode[length] = count ? code - 1 : -1;
+            code <<= 1;
+        }
+        memcpy(values, &table.values[0], sizeof(values));
+        return true;
+    }
+
+    uint8_t lookLength[1 << HUFF_LOOKAHEAD];
+    uint8_t lookValue[1 << HUFF_LOOKAHEAD];
+    int32_t maxCode[17];
+    int32_t valOffset[17];
+    uint8_t values[256];
+};
+
+// reads the bits of one restart interval, zero bytes stuffed after 0xFF
+// removed, and zeros once the data runs out
+class EntropyReader {
+public:
+    EntropyReader(const uint8_t* data, const uint8_t* end)
+        : m_data(data)
+        , m_end(end)
+        , m_bits(0)
+        , m_count(0)
+    {
+    }
+
+    uint32_t bits(uint32_t n)
+    {
+        if (!n)
+            return 0;
+        if (m_count < n)
+            fill();
+        uint32_t value = m_bits >> (64 - n);
+        m_bits <<= n;
+        m_count -= n;
+        return value;
+    }
+
+    // the bits of a magnitude category s, as a signed value
+    int32_t extend(uint32_t s)
+    {
+        int32_t value = bits(s);
+        if (s && value < (1 << (s - 1)))
+            value -= (1 << s) - 1;
+        return value;
+    }
+
+    uint32_t decode(const DerivedTable& table)
+    {
+        if (m_count < 16)
+            fill();
+        const uint32_t look = m_bits >> (64 - HUFF_LOOKAHEAD);
+        if (uint32_t length = table.lookLength[look]) {
+            m_bits <<= length;
+            m_count -= length;
+            return table.lookValue[look];
+        }
+        for (uint32_t length = HUFF_LOOKAHEAD + 1; length <= 16; length++) {
+            const int32_t code = m_bits >> (64 - length);
+            if (code <= table.maxCode[length]) {
+                m_bits <<= length;
+                m_count -= length;
+                return table.values[table.valOffset[length] + code];
+            }
+        }
+        // corrupt data, decode as a zero difference or end of block
+        return 0;
+    }
+
+private:
+    void fill()
+    {
+        while (m_count <= 56) {
+            uint32_t byte = 0;
+            if (m_data < m_end) {
+                byte = *m_data++;
+                if (byte == 0xFF) {
+                    if (m_data < m_end && !*m_data) {
+                        m_data++;
+                    } else {
+                        // fill bytes ahead of the next marker
+                        m_data = m_end;
+                        byte = 0;
+                    }
+                }
+            }
+            m_bits |= static_cast<uint64_t>(byte) << (56 - m_count);
+            m_count += 8;
+        }
+    }
+
+    const uint8_t* m_data;
+    const uint8_t* m_end;
+    uint64_t m_bits; // msb first
+    uint32_t m_count;
+};
+
+static void decodeSequential(EntropyReader& reader, const DerivedTable& dc,
+    const DerivedTable& ac, int32_t& pred, int16_t* block)
+{
+    pred += reader.extend(reader.decode(dc));
+    block[0] = pred;
+    for (uint32_t k = 1; k < DCTSIZE2; k++) {
+        const uint32_t rs = reader.decode(ac);
+        const uint32_t r = rs >> 4;
+        const uint32_t s = rs & 15;
+        if (s) {
+            k += r;
+            block[naturalOrder[k]] = reader.extend(s);
+        } else {
+            if (r != 15)
+                break;
+            k += 15;
+        }
+    }
+}
+
+static void decodeDCFirst(EntropyReader& reader, const DerivedTable& dc,
+    int32_t& pred, int al, int16_t* block)
+{
+    pred += reader.extend(reader.decode(dc));
+    block[0] = pred * (1 << al);
+}
+
+static void decodeDCRefine(EntropyReader& reader, int al, int16_t* block)
+{
+    if (reader.bits(1))
+        block[0] |= 1 << al;
+}
+
+static void decodeACFirst(EntropyReader& reader, const DerivedTable& ac,
+    uint32_t& eobrun, int ss, int se, int al, int16_t* block)
+{
+    if (eobrun) {
+        eobrun--;
+        return;
+    }
+    for (int k = ss; k <= se; k++) {
+        const uint32_t rs = reader.decode(ac);
+        const uint32_t r = rs >> 4;
+        const uint32_t s = rs & 15;
+        if (s) {
+            k += r;
+            block[naturalOrder[k]] = reader.extend(s) * (1 << al);
+        } else if (r == 15) {
+            k += 15;
+        } else {
+            // the rest of this band and of eobrun more are zero
+            eobrun = (1 << r) + reader.bits(r) - 1;
+            break;
+        }
+    }
+}
+
+static void decodeACRefine(EntropyReader& reader, const DerivedTable& ac,
+    uint32_t& eobrun, int ss, int se, int al, int16_t* block)
+{
+    const int p1 = 1 << al;
+    const int m1 = -1 * (1 << al);
+    int k = ss;
+
+    if (!eobrun) {
+        for (; k <= se; k++) {
+            const uint32_t rs = reader.decode(ac);
+            int r = rs >> 4;
+            int s = rs & 15;
+            if (s) {
+                // a newly nonzero coefficient always has magnitude 1
+                s = reader.bits(1) ? p1 : m1;
+            } else if (r != 15) {
+                eobrun = (1 << r) + reader.bits(r);
+                break;
+            }
+
+            // skip r zero coefficients, appending correction bits to the
+            // nonzero ones passed on the way
+            do {
+                int16_t& coef = block[naturalOrder[k]];
+                if (coef) {
+                    if (reader.bits(1) && !(coef & p1))
+                        coef += coef >= 0 ? p1 : m1;
+                } else if (--r < 0) {
+                    break;
+                }
+                k++;
+            } while (k <= se);
+
+            if (s)
+                block[naturalOrder[k]] = s;
+        }
+    }
+
+    if (eobrun) {
+        // only correction bits for the nonzero coefficients of this band
+        for (; k <= se; k++) {
+            int16_t& coef = block[naturalOrder[k]];
+            if (coef && reader.bits(1) && !(coef & p1))
+                coef += coef >= 0 ? p1 : m1;
+        }
+        eobrun--;
+    }
+}
+
+CoefficientDecoder::CoefficientDecoder()
+    : m_frame()
+    , m_planes()
+    , m_mcusWide(0)
+    , m_mcusHigh(0)
+{
+}
+
+bool CoefficientDecoder::start(const FrameHeader::Shared& frame)
+{
+    m_frame.reset();
+    m_planes.clear();
+
+    if (!frame)
+        return false;
+
+    if (frame->isArithmetic || frame->dataPrecision != 8) {
+        ERROR("Unsupported JPEG frame (arithmetic:%d precision:%d)",
+            frame->isArithmetic, frame->dataPrecision);
+        return false;
+    }
+
+    const uint32_t hMax = frame->maxHSampleFactor;
+    const uint32_t vMax = frame->maxVSampleFactor;
+    const size_t numComponents = frame->components.size();
+
+    for (size_t i(0); i < numComponents; ++i) {
+        const Component::Shared& component = frame->components[i];
+        if (component->hSampleFactor < 1 || component->hSampleFactor > 4
+            || component->vSampleFactor < 1 || component->vSampleFactor > 4) {
+            ERROR("Bad sampling factors for component %d", component->id);
+            return false;
+        }
+    }
+
+    m_mcusWide = (frame->imageWidth + hMax * DCTSIZE - 1) / (hMax * DCTSIZE);
+    m_mcusHigh = (frame->imageHeight + vMax * DCTSIZE - 1) / (vMax * DCTSIZE);
+
+    m_planes.resize(numComponents);
+    for (size_t i(0); i < numComponents; ++i) {
+        const Component::Shared& component = frame->components[i];
+        CoefficientPlane& plane = m_planes[i];
+        plane.width = (frame->imageWidth * component->hSampleFactor + hMax - 1) / hMax;
+        plane.height = (frame->imageHeight * component->vSampleFactor + vMax - 1) / vMax;
+        plane.blocksWide = m_mcusWide * component->hSampleFactor;
+        plane.blocksHigh = m_mcusHigh * component->vSampleFactor;
+        plane.coefficients.assign(plane.blocksWide * plane.blocksHigh * DCTSIZE2, 0);
+    }
+
+    m_frame = frame;
+
+    return true;
+}
+
+bool CoefficientDecoder::decodeScan(const ScanHeader::Shared& scan,
+    const HuffTables& dcTables, const HuffTables& acTables,
+    unsigned restartInterval, const uint8_t* data, const ScanIndex& index)
+{
+    if (!m_frame || !scan)
+        return false;
+
+    int ss = 0, se = DCTSIZE2 - 1, ah = 0, al = 0;
+    if (m_frame->isProgressive) {
+        ss = scan->ss;
+        se = scan->se;
+        ah = scan->ah;
+        al = scan->al;
+        if (ss > se || se >= (int)DCTSIZE2 || al > 13 || (!ss && se)
+            || (ss && scan->numComponents != 1)) {
+            ERROR("Invalid progressive scan (Ss:%d Se:%d Ah:%d Al:%d)",
+                ss, se, ah, al);
+            return false;
+        }
+    }
+
+    // a DC refinement scan is raw bits, every other scan needs its tables
+    const bool useDC = !ss && !ah;
+    const bool useAC = se > 0;
+    DerivedTable dc[MAX_COMPS_IN_SCAN];
+    DerivedTable ac[MAX_COMPS_IN_SCAN];
+
+    for (size_t i(0); i < scan->numComponents; ++i) {
+        const Component::Shared& component = scan->components[i];
+        if (useDC) {
+            const size_t n = component->dcTableNumber;
+            if (n >= NUM_HUFF_TBLS || !dcTables[n] || !dc[i].init(*dcTables[n])) {
+                ERROR("Bad DC table %u for component %d", (uint32_t)n, component->id);
+                return false;
+            }
+        }
+        if (useAC) {
+            const size_t n = component->acTableNumber;
+            if (n >= NUM_HUFF_TBLS || !acTables[n] || !ac[i].init(*acTables[n])) {
+                ERROR("Bad AC table %u for component %d", (uint32_t)n, component->id);
+                return false;
+            }
+        }
+    }
+
+    // an interleaved scan codes whole MCUs, otherwise one block is a unit
+    const bool interleaved = scan->numComponents > 1;
+    uint32_t unitsWide = m_mcusWide;
+    uint32_t unitsHigh = m_mcusHigh;
+    if (!interleaved) {
+        const CoefficientPlane& plane = m_planes[scan->components[0]->index];
+        unitsWide = (plane.width + DCTSIZE - 1) / DCTSIZE;
+        unitsHigh = (plane.height + DCTSIZE - 1) / DCTSIZE;
+    }
+    const uint32_t units = unitsWide * unitsHigh;
+    const uint32_t perInterval = restartInterval ? restartInterval : units;
+
+    uint32_t unit = 0;
+    for (size_t i(0); i < index.numIntervals() && unit < units; ++i) {
+        EntropyReader reader(data + index.intervalStart(i), data + index.intervalEnd(i));
+        int32_t pred[MAX_COMPS_IN_SCAN] = { 0 };
+        uint32_t eobrun = 0;
+
+        for (uint32_t n = 0; n < perInterval && unit < units; n++, unit++) {
+            const uint32_t x = unit % unitsWide;
+            const uint32_t y = unit / unitsWide;
+            for (size_t c(0); c < scan->numComponents; ++c) {
+                const Component::Shared& component = scan->components[c];
+                CoefficientPlane& plane = m_planes[component->index];
+                const uint32_t h = interleaved ? component->hSampleFactor : 1;
+                const uint32_t v = interleaved ? component->vSampleFactor : 1;
+                for (uint32_t by = 0; by < v; by++) {
+                    for (uint32_t bx = 0; bx < h; bx++) {
+                        int16_t* block = plane.block(x * h + bx, y * v + by);
+                        if (!m_frame->isProgressive)
+                            decodeSequential(reader, dc[c], ac[c], pred[c], block);
+                        else if (!ss && !ah)
+                            decodeDCFirst(reader, dc[c], pred[c], al, block);
+                        else if (!ss)
+                            decodeDCRefine(reader, al, block);
+                        else if (!ah)
+                            decodeACFirst(reader, ac[c], eobrun, ss, se, al, block);
+                        else
+                            decodeACRefine(reader, ac[c], eobrun, ss, se, al, block);
+                    }
+                }
+            }
+        }
+    }
+
+    if (unit < units) {
+        WARNING("Scan data ends after %u of %u units", unit, units);
+    }
+
+    return true;
+}
+
+#define CONST_BITS 13
+#define PASS1_BITS 2
+#define FIX_0_298631336 2446
+#define FIX_0_390180644 3196
+#define FIX_0_541196100 4433
+#define FIX_0_765366865 6270
+#define FIX_0_899976223 7373
+#define FIX_1_175875602 9633
+#define FIX_1_501321110 12299
+#define FIX_1_847759065 15137
+#define FIX_1_961570560 16069
+#define FIX_2_053119869 16819
+#define FIX_2_562915447 20995
+#define FIX_3_072711026 25172
+#define DESCALE(x, n) (((x) + (1 << ((n) - 1))) >> (n))
+
+static inline uint8_t clampSample(int32_t value)
+{
+    value += 128;
+    return value < 0 ? 0 : value > 255 ? 255 : value;
+}
+
+// the odd and even parts shared by both passes of idctBlock()
+#define IDCT_1D(in0, in1, in2, in3, in4, in5, in6, in7)          \
+    int32_t z1, z2, z3, z4, z5;                                   \
+    int32_t tmp0, tmp1, tmp2, tmp3;                               \
+    int32_t tmp10, tmp11, tmp12, tmp13;                           \
+                                                                  \
+    z2 = in2;                                                     \
+    z3 = in6;                                                     \
+    z1 = (z2 + z3) * FIX_0_541196100;                             \
+    tmp2 = z1 + z3 * -FIX_1_847759065;                            \
+    tmp3 = z1 + z2 * FIX_0_765366865;                             \
+    tmp0 = (in0 + in4) * (1 << CONST_BITS);                       \
+    tmp1 = (in0 - in4) * (1 << CONST_BITS);                       \
+    tmp10 = tmp0 + tmp3;                                          \
+    tmp13 = tmp0 - tmp3;                                          \
+    tmp11 = tmp1 + tmp2;                                          \
+    tmp12 = tmp1 - tmp2;                                          \
+                                                                  \
+    tmp0 = in7;                                                   \
+    tmp1 = in5;                                                   \
+    tmp2 = in3;                                                   \
+    tmp3 = in1;                                                   \
+    z1 = tmp0 + tmp3;                                             \
+    z2 = tmp1 + tmp2;                                             \
+    z3 = tmp0 + tmp2;                                             \
+    z4 = tmp1 + tmp3;                                             \
+    z5 = (z3 + z4) * FIX_1_175875602;                             \
+    tmp0 = tmp0 * FIX_0_298631336;                                \
+    tmp1 = tmp1 * FIX_2_053119869;                                \
+    tmp2 = tmp2 * FIX_3_072711026;                                \
+    tmp3 = tmp3 * FIX_1_501321110;                                \
+    z1 = z1 * -FIX_0_899976223;                                   \
+    z2 = z2 * -FIX_2_562915447;                                   \
+    z3 = z3 * -FIX_1_961570560 + z5;                              \
+    z4 = z4 * -FIX_0_390180644 + z5;                              \
+    tmp0 += z1 + z3;                                              \
+    tmp1 += z2 + z4;                                              \
+    tmp2 += z2 + z3;                                              \
+    tmp3 += z1 + z4;
+
+// the accurate integer IDCT of jidctint.c, with a shortcut for blocks
+// that only have a DC coefficient
+static void idctBlock(const int16_t* coef, const int32_t* quant,
+    uint8_t* out, uint32_t pitch)
+{
+    bool dcOnly = true;
+    for (uint32_t k = 1; k < DCTSIZE2 && dcOnly; k++)
+        dcOnly = !coef[k];
+    if (dcOnly) {
+        const int32_t dc = coef[0] * quant[0] * (1 << PASS1_BITS);
+        const uint8_t value = clampSample(DESCALE(dc, PASS1_BITS + 3));
+        for (uint32_t y = 0; y < DCTSIZE; y++)
+            memset(out + y * pitch, value, DCTSIZE);
+        return;
+    }
+
+    int32_t workspace[DCTSIZE2];
+
+    // columns from the input into the workspace
+    for (uint32_t x = 0; x < DCTSIZE; x++) {
+        const int16_t* in = coef + x;
+        const int32_t* q = quant + x;
+        int32_t* ws = workspace + x;
+        if (!in[DCTSIZE * 1] && !in[DCTSIZE * 2] && !in[DCTSIZE * 3]
+            && !in[DCTSIZE * 4] && !in[DCTSIZE * 5] && !in[DCTSIZE * 6]
+            && !in[DCTSIZE * 7]) {
+            const int32_t dc = in[0] * q[0] * (1 << PASS1_BITS);
+            for (uint32_t y = 0; y < DCTSIZE; y++)
+                ws[DCTSIZE * y] = dc;
+            continue;
+        }
+
+        IDCT_1D(in[DCTSIZE * 0] * q[DCTSIZE * 0], in[DCTSIZE * 1] * q[DCTSIZE * 1],
+            in[DCTSIZE * 2] * q[DCTSIZE * 2], in[DCTSIZE * 3] * q[DCTSIZE * 3],
+            in[DCTSIZE * 4] * q[DCTSIZE * 4], in[DCTSIZE * 5] * q[DCTSIZE * 5],
+            in[DCTSIZE * 6] * q[DCTSIZE * 6], in[DCTSIZE * 7] * q[DCTSIZE * 7])
+
+        ws[DCTSIZE * 0] = DESCALE(tmp10 + tmp3, CONST_BITS - PASS1_BITS);
+        ws[DCTSIZE * 7] = DESCALE(tmp10 - tmp3, CONST_BITS - PASS1_BITS);
+        ws[DCTSIZE * 1] = DESCALE(tmp11 + tmp2, CONST_BITS - PASS1_BITS);
+        ws[DCTSIZE * 6] = DESCALE(tmp11 - tmp2, CONST_BITS - PASS1_BITS);
+        ws[DCTSIZE * 2] = DESCALE(tmp12 + tmp1, CONST_BITS - PASS1_BITS);
+        ws[DCTSIZE * 5] = DESCALE(tmp12 - tmp1, CONST_BITS - PASS1_BITS);
+        ws[DCTSIZE * 3] = DESCALE(tmp13 + tmp0, CONST_BITS - PASS1_BITS);
+        ws[DCTSIZE * 4] = DESCALE(tmp13 - tmp0, CONST_BITS - PASS1_BITS);
+    }
+
+    // rows from the workspace into the output
+    for (uint32_t y = 0; y < DCTSIZE; y++) {
+        const int32_t* ws = workspace + y * DCTSIZE;
+        uint8_t* row = out + y * pitch;
+        if (!ws[1] && !ws[2] && !ws[3] && !ws[4] && !ws[5] && !ws[6] && !ws[7]) {
+            memset(row, clampSample(DESCALE(ws[0], PASS1_BITS + 3)), DCTSIZE);
+            continue;
+        }
+
+        IDCT_1D(ws[0], ws[1], ws[2], ws[3], ws[4], ws[5], ws[6], ws[7])
+
+        row[0] = clampSample(DESCALE(tmp10 + tmp3, CONST_BITS + PASS1_BITS + 3));
+        row[7] = clampSample(DESCALE(tmp10 - tmp3, CONST_BITS + PASS1_BITS + 3));
+        row[1] = clampSample(DESCALE(tmp11 + tmp2, CONST_BITS + PASS1_BITS + 3));
+        row[6] = clampSample(DESCALE(tmp11 - tmp2, CONST_BITS + PASS1_BITS + 3));
+        row[2] = clampSample(DESCALE(tmp12 + tmp1, CONST_BITS + PASS1_BITS + 3));
+        row[5] = clampSample(DESCALE(tmp12 - tmp1, CONST_BITS + PASS1_BITS + 3));
+        row[3] = clampSample(DESCALE(tmp13 + tmp0, CONST_BITS + PASS1_BITS + 3));
+        row[4] = clampSample(DESCALE(tmp13 - tmp0, CONST_BITS + PASS1_BITS + 3));
+    }
+}
+
+bool CoefficientDecoder::idct(size_t component, const QuantTables& quantTables,
+    uint8_t* samples, uint32_t pitch) const
+{
+    if (!m_frame || component >= m_planes.size())
+        return false;
+
+    const size_t n = m_frame->components[component]->quantTableNumber;
+    if (n >= NUM_QUANT_TBLS || !quantTables[n]) {
+        ERROR("Missing quant table %u", (uint32_t)n);
+        return false;
+    }
+
+    int32_t quant[DCTSIZE2];
+    for (size_t k(0); k < DCTSIZE2; ++k)
+        quant[naturalOrder[k]] = quantTables[n]->values[k];
+
+    const CoefficientPlane& plane = m_planes[component];
+    uint8_t edge[DCTSIZE2];
+    for (uint32_t y = 0; y < plane.height; y += DCTSIZE) {
+        for (uint32_t x = 0; x < plane.width; x += DCTSIZE) {
+            const int16_t* block = plane.block(x / DCTSIZE, y / DCTSIZE);
+            uint8_t* out = samples + y * pitch + x;
+            if (x + DCTSIZE <= plane.width && y + DCTSIZE <= plane.height) {
+                idctBlock(block, quant, out, pitch);
+                continue;
+            }
+            // a block hanging over the edge of the component
+            idctBlock(block, quant, edge, DCTSIZE);
+            const uint32_t w = std::min<uint32_t>(DCTSIZE, plane.width - x);
+            const uint32_t h = std::min<uint32_t>(DCTSIZE, plane.height - y);
+            for (uint32_t row = 0; row < h; row++)
+                memcpy(out + row * pitch, edge + row * DCTSIZE, w);
+        }
+    }
+
+    return true;
+}
+
+} // namespace JPEG
+} // namespace YamiParser
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * ----
+ *
+ * Parts of IJG's libjpeg library (jdhuff.c, jdphuff.c and jidctint.c) were
+ * used as a reference while implementing this decoder.  The progressive
+ * refinement logic and the accurate integer IDCT reproduce the ones found
+ * in those files, refactored to fit into the overall libyami framework.
+ * Therefore, this implementation is considered to be partially derived from
+ * IJG's libjpeg.
+ *
+ * The following license preamble, below, is reproduced from libjpeg's
+ * jidctint.c file.  The README.ijg is also provided with this file:
+ *
+ * Copyright (C) 1991-1998, Thomas G. Lane.
+ * The jidctint.c file is part of the Independent JPEG Group's software.
+ * For conditions of distribution and use, see the accompanying README.ijg file.
+ *
+ */
+
+#ifndef jpegCoefficientDecoder_h
+#define jpegCoefficientDecoder_h
+
+// library headers
+#include "jpegParser.h"
+
+// system headers
+#include <vector>
+
+namespace YamiParser {
+namespace JPEG {
+
+/**
+ * The quantized DCT coefficients of one component, DCTSIZE2 values in
+ * natural order for each 8x8 block.  The blocks are padded out to whole
+ * MCUs; width and height are the samples the component really has.
+ */
+struct CoefficientPlane {
+    CoefficientPlane()
+        : width(0), height(0), blocksWide(0), blocksHigh(0) { }
+
+    int16_t* block(uint32_t x, uint32_t y)
+    {
+        return &coefficients[(y * blocksWide + x) * DCTSIZE2];
+    }
+
+    const int16_t* block(uint32_t x, uint32_t y) const
+    {
+        return &coefficients[(y * blocksWide + x) * DCTSIZE2];
+    }
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t blocksWide;
+    uint32_t blocksHigh;
+    std::vector<int16_t> coefficients;
+};
+
+/**
+ * Decodes the Huffman coded scans of sequential and progressive frames on
+ * the CPU into coefficient planes, then dequantizes and inverse transforms
+ * them into 8 bit samples.  Arithmetic coding and 12 bit samples are not
+ * supported.
+ */
+class CoefficientDecoder {
+public:
+    CoefficientDecoder();
+
+    /**
+     * Sizes the coefficient planes for a new frame and clears them.
+     *
+     * @retval false if the frame can not be decoded
+     */
+    bool start(const FrameHeader::Shared& frame);
+
+    /**
+     * Entropy decodes a scan of the frame given to start().  The scan data
+     * is found in data at the positions in index, one restart interval at
+     * a time.
+     *
+     * @retval false if the scan parameters or tables are invalid
+     */
+    bool decodeScan(const ScanHeader::Shared& scan,
+        const HuffTables& dcTables, const HuffTables& acTables,
+        unsigned restartInterval, const uint8_t* data, const ScanIndex& index);
+
+    /**
+     * Dequantizes and inverse transforms a component, writing its width x
+     * height samples to samples, pitch bytes per row.
+     *
+     * @retval false if the quantization table of the component is missing
+     */
+    bool idct(size_t component, const QuantTables& quantTables,
+        uint8_t* samples, uint32_t pitch) const;
+
+    size_t numPlanes() const { return m_planes.size(); }
+    const CoefficientPlane& plane(size_t component) const
+    {
+        return m_planes[component];
+    }
+
+private:
+    FrameHeader::Shared m_frame;
+    std::vector<CoefficientPlane> m_planes;
+    uint32_t m_mcusWide;
+    uint32_t m_mcusHigh;
+};
+
+} // namespace JPEG
+} // namespace YamiParser
+
+#endif // jpegCoefficientDecoder_h
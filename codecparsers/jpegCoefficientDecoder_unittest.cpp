@@ -0,0 +1,348 @@
+/*
+ * Copyright 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// primary header
+#include "jpegCoefficientDecoder.h"
+
+// library headers
+#include "common/unittest.h"
+
+// system headers
+#include <cstdlib>
+#include <vector>
+
+namespace YamiParser {
+namespace JPEG {
+
+// A 40x24 4:2:0 picture with Y = 16 + 4x + 3y, Cb = 128 + x - y and
+// Cr = 128 - (x + y) / 2, encoded at quality 75 as a baseline frame, as a
+// progressive frame, and as a progressive frame with a restart interval of
+// two MCUs.  All three hold the same quantized coefficients.
+const static uint8_t g_SequentialJPEG[] = {
+    0xff, 0xd8, 0xff, 0xdb, 0x00, 0x43, 0x00, 0x08, 0x06, 0x06, 0x07, 0x06,
+    0x05, 0x08, 0x07, 0x07, 0x07, 0x09, 0x09, 0x08, 0x0a, 0x0c, 0x14, 0x0d,
+    0x0c, 0x0b, 0x0b, 0x0c, 0x19, 0x12, 0x13, 0x0f, 0x14, 0x1d, 0x1a, 0x1f,
+    0x1e, 0x1d, 0x1a, 0x1c, 0x1c, 0x20, 0x24, 0x2e, 0x27, 0x20, 0x22, 0x2c,
+    0x23, 0x1c, 0x1c, 0x28, 0x37, 0x29, 0x2c, 0x30, 0x31, 0x34, 0x34, 0x34,
+    0x1f, 0x27, 0x39, 0x3d, 0x38, 0x32, 0x3c, 0x2e, 0x33, 0x34, 0x32, 0xff,
+    0xdb, 0x00, 0x43, 0x01, 0x09, 0x09, 0x09, 0x0c, 0x0b, 0x0c, 0x18, 0x0d,
+    0x0d, 0x18, 0x32, 0x21, 0x1c, 0x21, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0xff, 0xc0, 0x00, 0x11,
+    0x08, 0x00, 0x18, 0x00, 0x28, 0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x01,
+    0x03, 0x11, 0x01, 0xff, 0xc4, 0x00, 0x18, 0x00, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x06, 0x04, 0x07, 0x05, 0xff, 0xc4, 0x00, 0x17, 0x10, 0x00, 0x03,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x04, 0x21, 0x31, 0xff, 0xc4, 0x00, 0x17, 0x01, 0x01,
+    0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x03, 0x04, 0x00, 0x06, 0xff, 0xc4, 0x00, 0x19, 0x11,
+    0x00, 0x03, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x02, 0x03, 0x11, 0x21, 0xff, 0xda,
+    0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x11, 0x03, 0x11, 0x00, 0x3f, 0x00,
+    0xe4, 0xe9, 0xad, 0x90, 0xa0, 0x4d, 0x6c, 0x86, 0x74, 0xd6, 0xc8, 0x50,
+    0x26, 0xb6, 0x43, 0x67, 0xa0, 0x35, 0x46, 0x84, 0xd6, 0xc8, 0x50, 0xa6,
+    0xb6, 0x43, 0x3a, 0x6b, 0x64, 0x28, 0x13, 0x5b, 0x21, 0x76, 0x7a, 0x01,
+    0x54, 0x68, 0x4d, 0x6c, 0x80, 0xf6, 0x13, 0x5b, 0x20, 0x2c, 0x9d, 0x3c,
+    0x01, 0xd1, 0xc5, 0x93, 0x5b, 0x21, 0x40, 0x9a, 0xd9, 0x00, 0x39, 0x9c,
+    0xe9, 0x94, 0x53, 0x28, 0x53, 0x5b, 0x21, 0x40, 0x9a, 0xd9, 0x00, 0x2e,
+    0xce, 0x98, 0x14, 0xca, 0x04, 0xd6, 0xc8, 0x00, 0x2c, 0x9a, 0x7c, 0x01,
+    0xb3, 0xff, 0xd9
+};
+
+const static uint8_t g_ProgressiveJPEG[] = {
+    0xff, 0xd8, 0xff, 0xdb, 0x00, 0x43, 0x00, 0x08, 0x06, 0x06, 0x07, 0x06,
+    0x05, 0x08, 0x07, 0x07, 0x07, 0x09, 0x09, 0x08, 0x0a, 0x0c, 0x14, 0x0d,
+    0x0c, 0x0b, 0x0b, 0x0c, 0x19, 0x12, 0x13, 0x0f, 0x14, 0x1d, 0x1a, 0x1f,
+    0x1e, 0x1d, 0x1a, 0x1c, 0x1c, 0x20, 0x24, 0x2e, 0x27, 0x20, 0x22, 0x2c,
+    0x23, 0x1c, 0x1c, 0x28, 0x37, 0x29, 0x2c, 0x30, 0x31, 0x34, 0x34, 0x34,
+    0x1f, 0x27, 0x39, 0x3d, 0x38, 0x32, 0x3c, 0x2e, 0x33, 0x34, 0x32, 0xff,
+    0xdb, 0x00, 0x43, 0x01, 0x09, 0x09, 0x09, 0x0c, 0x0b, 0x0c, 0x18, 0x0d,
+    0x0d, 0x18, 0x32, 0x21, 0x1c, 0x21, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0xff, 0xc2, 0x00, 0x11,
+    0x08, 0x00, 0x18, 0x00, 0x28, 0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x01,
+    0x03, 0x11, 0x01, 0xff, 0xc4, 0x00, 0x18, 0x00, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x05, 0x03, 0x06, 0x04, 0xff, 0xc4, 0x00, 0x17, 0x01, 0x01, 0x01,
+    0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x03, 0x02, 0x00, 0x05, 0xff, 0xda, 0x00, 0x0c, 0x03, 0x01,
+    0x00, 0x02, 0x10, 0x03, 0x10, 0x00, 0x00, 0x01, 0xe4, 0xe8, 0x67, 0x43,
+    0x46, 0x94, 0x33, 0xa0, 0xe7, 0xa3, 0xd8, 0x68, 0xe2, 0xe8, 0x1c, 0xc4,
+    0xa1, 0x40, 0x73, 0xa0, 0x1a, 0x3f, 0xff, 0xc4, 0x00, 0x15, 0x10, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x02, 0x00, 0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00,
+    0x01, 0x05, 0x02, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06,
+    0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0xff, 0xc4, 0x00, 0x17, 0x11, 0x01,
+    0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x01, 0x00, 0x10, 0x11, 0xff, 0xda, 0x00, 0x08, 0x01,
+    0x03, 0x01, 0x01, 0x3f, 0x01, 0x59, 0x6e, 0xcc, 0xe7, 0xff, 0xc4, 0x00,
+    0x16, 0x11, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x01, 0xff, 0xda, 0x00,
+    0x08, 0x01, 0x02, 0x01, 0x01, 0x3f, 0x01, 0x2a, 0x2a, 0xc5, 0x1d, 0x8e,
+    0xd9, 0xb7, 0xff, 0xc4, 0x00, 0x14, 0x10, 0x01, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30,
+    0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x06, 0x3f, 0x02, 0x7f, 0xff,
+    0xc4, 0x00, 0x14, 0x10, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30, 0xff, 0xda, 0x00,
+    0x08, 0x01, 0x01, 0x00, 0x01, 0x3f, 0x21, 0x70, 0x00, 0x00, 0x00, 0x3f,
+    0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x00, 0x03, 0x00, 0x00,
+    0x00, 0x10, 0x01, 0xdf, 0x00, 0xf7, 0xcf, 0xff, 0xc4, 0x00, 0x16, 0x11,
+    0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x10, 0xff, 0xda, 0x00, 0x08, 0x01,
+    0x03, 0x01, 0x01, 0x3f, 0x10, 0xc0, 0x62, 0x94, 0xb7, 0xff, 0xc4, 0x00,
+    0x18, 0x11, 0x01, 0x01, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x10, 0x11, 0x21, 0xff,
+    0xda, 0x00, 0x08, 0x01, 0x02, 0x01, 0x01, 0x3f, 0x10, 0xc0, 0x70, 0x51,
+    0x45, 0x34, 0xff, 0xc4, 0x00, 0x16, 0x10, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x21, 0x31, 0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x01, 0x3f, 0x10,
+    0x8a, 0x22, 0x88, 0xa2, 0x28, 0x8a, 0x22, 0x88, 0xa2, 0x28, 0x8a, 0x22,
+    0x88, 0xa2, 0x28, 0x8a, 0x22, 0x88, 0xa3, 0xff, 0xd9
+};
+
+const static uint8_t g_ProgressiveRestartJPEG[] = {
+    0xff, 0xd8, 0xff, 0xdb, 0x00, 0x43, 0x00, 0x08, 0x06, 0x06, 0x07, 0x06,
+    0x05, 0x08, 0x07, 0x07, 0x07, 0x09, 0x09, 0x08, 0x0a, 0x0c, 0x14, 0x0d,
+    0x0c, 0x0b, 0x0b, 0x0c, 0x19, 0x12, 0x13, 0x0f, 0x14, 0x1d, 0x1a, 0x1f,
+    0x1e, 0x1d, 0x1a, 0x1c, 0x1c, 0x20, 0x24, 0x2e, 0x27, 0x20, 0x22, 0x2c,
+    0x23, 0x1c, 0x1c, 0x28, 0x37, 0x29, 0x2c, 0x30, 0x31, 0x34, 0x34, 0x34,
+    0x1f, 0x27, 0x39, 0x3d, 0x38, 0x32, 0x3c, 0x2e, 0x33, 0x34, 0x32, 0xff,
+    0xdb, 0x00, 0x43, 0x01, 0x09, 0x09, 0x09, 0x0c, 0x0b, 0x0c, 0x18, 0x0d,
+    0x0d, 0x18, 0x32, 0x21, 0x1c, 0x21, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32,
+    0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0x32, 0xff, 0xc2, 0x00, 0x11,
+    0x08, 0x00, 0x18, 0x00, 0x28, 0x03, 0x01, 0x22, 0x00, 0x02, 0x11, 0x01,
+    0x03, 0x11, 0x01, 0xff, 0xc4, 0x00, 0x18, 0x00, 0x01, 0x01, 0x01, 0x01,
+    0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x05, 0x03, 0x04, 0x06, 0xff, 0xc4, 0x00, 0x19, 0x01, 0x00, 0x02,
+    0x03, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x03, 0x04, 0x00, 0x01, 0x02, 0x05, 0xff, 0xdd, 0x00, 0x04,
+    0x00, 0x02, 0xff, 0xda, 0x00, 0x0c, 0x03, 0x01, 0x00, 0x02, 0x10, 0x03,
+    0x10, 0x00, 0x00, 0x01, 0xf2, 0x74, 0x33, 0xa1, 0x31, 0xa5, 0x0c, 0xe8,
+    0x1c, 0x7f, 0xff, 0xd0, 0xa8, 0xec, 0x3a, 0xaf, 0x8b, 0xa0, 0x73, 0x09,
+    0xff, 0xd1, 0xec, 0xa0, 0x5a, 0xb4, 0x01, 0xb1, 0xff, 0xc4, 0x00, 0x15,
+    0x10, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0xff, 0xda, 0x00, 0x08, 0x01,
+    0x01, 0x00, 0x01, 0x05, 0x02, 0x06, 0x06, 0xff, 0xd0, 0x06, 0x06, 0xff,
+    0xd1, 0x06, 0x06, 0xff, 0xd2, 0x06, 0x06, 0xff, 0xd3, 0x06, 0x06, 0xff,
+    0xd4, 0x06, 0x06, 0xff, 0xd5, 0x06, 0x06, 0xff, 0xd6, 0x06, 0xff, 0xc4,
+    0x00, 0x17, 0x11, 0x01, 0x01, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x10, 0x11, 0xff,
+    0xda, 0x00, 0x08, 0x01, 0x03, 0x01, 0x01, 0x3f, 0x01, 0x59, 0x6f, 0xff,
+    0xd0, 0xec, 0xdf, 0xff, 0xd1, 0x73, 0xff, 0xc4, 0x00, 0x16, 0x11, 0x01,
+    0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x02, 0x00, 0x01, 0xff, 0xda, 0x00, 0x08, 0x01, 0x02,
+    0x01, 0x01, 0x3f, 0x01, 0x2a, 0x2a, 0xff, 0xd0, 0xc5, 0x1d, 0xbf, 0xff,
+    0xd1, 0x3b, 0x66, 0xdf, 0xff, 0xc4, 0x00, 0x15, 0x10, 0x01, 0x01, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x10, 0x00, 0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x06, 0x3f,
+    0x02, 0x3f, 0xff, 0xd0, 0x3f, 0xff, 0xd1, 0x3f, 0xff, 0xd2, 0x3f, 0xff,
+    0xd3, 0x3f, 0xff, 0xd4, 0x3f, 0xff, 0xd5, 0x3f, 0xff, 0xd6, 0xbf, 0xff,
+    0xc4, 0x00, 0x15, 0x10, 0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0xff, 0xda,
+    0x00, 0x08, 0x01, 0x01, 0x00, 0x01, 0x3f, 0x21, 0x03, 0xff, 0xd0, 0x03,
+    0xff, 0xd1, 0x03, 0xff, 0xd2, 0x03, 0xff, 0xd3, 0x03, 0xff, 0xd4, 0x03,
+    0xff, 0xd5, 0x03, 0xff, 0xd6, 0x8f, 0xff, 0xda, 0x00, 0x0c, 0x03, 0x01,
+    0x00, 0x02, 0x00, 0x03, 0x00, 0x00, 0x00, 0x10, 0x01, 0xdf, 0xff, 0xd0,
+    0xf0, 0x0f, 0xff, 0xd1, 0xf7, 0xcf, 0xff, 0xc4, 0x00, 0x16, 0x11, 0x01,
+    0x01, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x01, 0x00, 0x10, 0xff, 0xda, 0x00, 0x08, 0x01, 0x03,
+    0x01, 0x01, 0x3f, 0x10, 0xc0, 0xff, 0xd0, 0x62, 0xbf, 0xff, 0xd1, 0x52,
+    0xdf, 0xff, 0xc4, 0x00, 0x18, 0x11, 0x01, 0x01, 0x00, 0x03, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01,
+    0x10, 0x11, 0x21, 0xff, 0xda, 0x00, 0x08, 0x01, 0x02, 0x01, 0x01, 0x3f,
+    0x10, 0xc0, 0x7f, 0xff, 0xd0, 0xe0, 0xa3, 0xff, 0xd1, 0xa2, 0x9a, 0x7f,
+    0xff, 0xc4, 0x00, 0x16, 0x10, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x21, 0x31,
+    0xff, 0xda, 0x00, 0x08, 0x01, 0x01, 0x00, 0x01, 0x3f, 0x10, 0x8a, 0x22,
+    0x8f, 0xff, 0xd0, 0x8a, 0x22, 0x8f, 0xff, 0xd1, 0x8a, 0x22, 0x8f, 0xff,
+    0xd2, 0x8a, 0x22, 0x8f, 0xff, 0xd3, 0x8a, 0x22, 0x8f, 0xff, 0xd4, 0x8a,
+    0x22, 0x8f, 0xff, 0xd5, 0x8a, 0x22, 0x8f, 0xff, 0xd6, 0x8a, 0x3f, 0xff,
+    0xd9
+};
+
+// entropy decodes each scan as the parser reaches it
+class ScanCallback {
+public:
+    ScanCallback(const Parser& parser, CoefficientDecoder& decoder,
+        const uint8_t* data, bool& ok)
+        : m_parser(parser), m_decoder(decoder), m_data(data), m_ok(ok) { }
+
+    Parser::CallbackResult operator()() const
+    {
+        if (!m_decoder.numPlanes())
+            m_ok = m_decoder.start(m_parser.frameHeader());
+        m_ok = m_ok && m_decoder.decodeScan(m_parser.scanHeader(),
+            m_parser.dcHuffTables(), m_parser.acHuffTables(),
+            m_parser.restartInterval(), m_data, m_parser.scanIndex());
+        return Parser::ParseContinue;
+    }
+
+private:
+    const Parser& m_parser;
+    CoefficientDecoder& m_decoder;
+    const uint8_t* m_data;
+    bool& m_ok;
+};
+
+class JPEGCoefficientDecoderTest : public ::testing::Test {
+protected:
+    static void decode(const uint8_t* data, uint32_t size,
+        CoefficientDecoder& decoder, QuantTables& quantTables)
+    {
+        Parser parser(data, size);
+        bool ok = true;
+        parser.registerCallback(M_SOS, ScanCallback(parser, decoder, data, ok));
+        ASSERT_TRUE(parser.parse());
+        ASSERT_TRUE(ok);
+        ASSERT_EQ(3u, decoder.numPlanes());
+        quantTables = parser.quantTables();
+    }
+
+    static int luma(int x, int y) { return 16 + 4 * x + 3 * y; }
+    static int cb(int x, int y) { return 128 + x - y; }
+    static int cr(int x, int y) { return 128 - (x + y) / 2; }
+
+    // compares a component with its source, sampled at the center of each
+    // chroma sample for the subsampled ones
+    static void checkSamples(const CoefficientDecoder& decoder,
+        const QuantTables& quantTables, size_t component, int (*source)(int, int))
+    {
+        const CoefficientPlane& plane = decoder.plane(component);
+        const int scale = component ? 2 : 1;
+        std::vector<uint8_t> samples(plane.width * plane.height);
+        ASSERT_TRUE(decoder.idct(component, quantTables, &samples[0], plane.width));
+        for (uint32_t y = 0; y < plane.height; y++) {
+            for (uint32_t x = 0; x < plane.width; x++) {
+                int expected = 0;
+                for (int i = 0; i < scale * scale; i++)
+                    expected += source(x * scale + i % scale, y * scale + i / scale);
+                expected /= scale * scale;
+                EXPECT_GE(3, std::abs(samples[y * plane.width + x] - expected))
+                    << "component " << component << " at " << x << "," << y;
+            }
+        }
+    }
+};
+
+#define JPEG_COEFFICIENT_DECODER_TEST(name) \
+    TEST_F(JPEGCoefficientDecoderTest, name)
+
+JPEG_COEFFICIENT_DECODER_TEST(Start_Unsupported)
+{
+    CoefficientDecoder decoder;
+    FrameHeader::Shared frame(new FrameHeader);
+    frame->isBaseline = false;
+    frame->isProgressive = false;
+    frame->isArithmetic = false;
+    frame->dataPrecision = 12;
+    frame->imageWidth = 16;
+    frame->imageHeight = 16;
+    frame->maxHSampleFactor = 1;
+    frame->maxVSampleFactor = 1;
+    frame->components.push_back(Component::Shared(new Component()));
+    frame->components[0]->hSampleFactor = 1;
+    frame->components[0]->vSampleFactor = 1;
+
+    EXPECT_FALSE(decoder.start(frame));
+
+    frame->dataPrecision = 8;
+    frame->isArithmetic = true;
+    EXPECT_FALSE(decoder.start(frame));
+
+    frame->isArithmetic = false;
+    frame->components[0]->vSampleFactor = 0;
+    EXPECT_FALSE(decoder.start(frame));
+
+    frame->components[0]->vSampleFactor = 1;
+    EXPECT_TRUE(decoder.start(frame));
+    EXPECT_EQ(1u, decoder.numPlanes());
+    EXPECT_EQ(2u * 2u * DCTSIZE2, decoder.plane(0).coefficients.size());
+}
+
+JPEG_COEFFICIENT_DECODER_TEST(Decode_Sequential)
+{
+    CoefficientDecoder decoder;
+    QuantTables quantTables;
+    decode(g_SequentialJPEG, sizeof(g_SequentialJPEG), decoder, quantTables);
+
+    EXPECT_EQ(40u, decoder.plane(0).width);
+    EXPECT_EQ(24u, decoder.plane(0).height);
+    EXPECT_EQ(20u, decoder.plane(1).width);
+    EXPECT_EQ(12u, decoder.plane(1).height);
+    // padded to whole 16x16 MCUs
+    EXPECT_EQ(6u, decoder.plane(0).blocksWide);
+    EXPECT_EQ(4u, decoder.plane(0).blocksHigh);
+    EXPECT_EQ(3u, decoder.plane(2).blocksWide);
+    EXPECT_EQ(2u, decoder.plane(2).blocksHigh);
+
+    checkSamples(decoder, quantTables, 0, luma);
+    checkSamples(decoder, quantTables, 1, cb);
+    checkSamples(decoder, quantTables, 2, cr);
+}
+
+JPEG_COEFFICIENT_DECODER_TEST(Decode_Progressive)
+{
+    CoefficientDecoder sequential, progressive, restart;
+    QuantTables quantTables;
+    decode(g_SequentialJPEG, sizeof(g_SequentialJPEG), sequential, quantTables);
+    decode(g_ProgressiveJPEG, sizeof(g_ProgressiveJPEG), progressive, quantTables);
+    decode(g_ProgressiveRestartJPEG, sizeof(g_ProgressiveRestartJPEG),
+        restart, quantTables);
+
+    for (size_t i(0); i < sequential.numPlanes(); ++i) {
+        EXPECT_TRUE(sequential.plane(i).coefficients == progressive.plane(i).coefficients)
+            << "component " << i;
+        EXPECT_TRUE(sequential.plane(i).coefficients == restart.plane(i).coefficients)
+            << "component " << i;
+    }
+
+    checkSamples(restart, quantTables, 0, luma);
+    checkSamples(restart, quantTables, 1, cb);
+    checkSamples(restart, quantTables, 2, cr);
+}
+
+JPEG_COEFFICIENT_DECODER_TEST(DecodeScan_NotStarted)
+{
+    CoefficientDecoder decoder;
+    Parser parser(g_SequentialJPEG, sizeof(g_SequentialJPEG));
+    ASSERT_TRUE(parser.parse());
+
+    EXPECT_FALSE(decoder.decodeScan(parser.scanHeader(), parser.dcHuffTables(),
+        parser.acHuffTables(), parser.restartInterval(), g_SequentialJPEG,
+        parser.scanIndex()));
+
+    // a scan referring to a missing table
+    ASSERT_TRUE(decoder.start(parser.frameHeader()));
+    HuffTables none;
+    EXPECT_FALSE(decoder.decodeScan(parser.scanHeader(), none,
+        parser.acHuffTables(), parser.restartInterval(), g_SequentialJPEG,
+        parser.scanIndex()));
+}
+
+} // namespace JPEG
+} // namespace YamiParser
@@ -223,11 +223,13 @@ Defaults::Defaults()
 
 Parser::Parser(const uint8_t* data, const uint32_t size)
     : m_input(data, size)
+    , m_inputOffset(0)
     , m_data(data)
     , m_size(size)
     , m_current()
     , m_frameHeader()
     , m_scanHeader()
+    , m_scanIndex()
     , m_quantTables()
     , m_dcHuffTables()
     , m_acHuffTables()
@@ -250,13 +252,16 @@ bool Parser::skipBytes(const uint32_t nBytes)
         return false;
     }
 
-    // BitReader only supports skipping a max of CACHEBYTES at a time
-    // for each call to skip.
-    const uint32_t nSkips = nBytes / BitReader::CACHEBYTES;
-    const uint32_t rem = nBytes % BitReader::CACHEBYTES;
-    for (uint32_t i(0); i < nSkips; ++i)
-        m_input.skip(BitReader::CACHEBYTES << 3);
-    m_input.skip(rem << 3);
+    if (!nBytes)
+        return true;
+
+    // Restart the reader at the destination rather than stepping through
+    // the bytes CACHEBYTES at a time.  It starts one byte early since a
+    // BitReader can not be empty.
+    const uint32_t position = currentBytePosition() + nBytes - 1;
+    m_input = BitReader(m_data + position, m_size - position);
+    m_inputOffset = position;
+    m_input.skip(8);
 
     return true;
 }
@@ -307,6 +312,15 @@ bool Parser::firstMarker()
     return true;
 }
 
+//position of the next 0xFF at or after p, end if there is none
+static const uint8_t* nextFF(const uint8_t* p, const uint8_t* end)
+{
+    if (p >= end)
+        return end;
+    const void* match = std::memchr(p, 0xFF, end - p);
+    return match ? static_cast<const uint8_t*>(match) : end;
+}
+
 bool Parser::nextMarker()
 {
     const uint8_t* const end = m_data + m_size - 1;
@@ -315,7 +329,7 @@ bool Parser::nextMarker()
     const uint8_t* match;
 
     do {
-        match = std::find(current, end, 0xFF);
+        match = nextFF(current, end);
         if (match == end)
             return false;
         if (*(match + 1) < 0xFF && *(match + 1) >= M_SOF0)
@@ -380,7 +394,7 @@ bool Parser::parse()
             parseSegment = parseDRI();
             break;
         case M_SOS:
-            parseSegment = parseSOS();
+            parseSegment = parseSOS() && indexScan();
             break;
         case M_EOI:
             parseSegment = parseEOI();
@@ -613,6 +627,38 @@ bool Parser::parseSOS()
     return true;
 }
 
+bool Parser::indexScan()
+{
+    const uint8_t* const end = m_data + m_size - 1;
+    const uint8_t* current = m_data + currentBytePosition();
+
+    m_scanIndex.start = currentBytePosition();
+    m_scanIndex.restarts.clear();
+
+    while (true) {
+        const uint8_t* match = nextFF(current, end);
+        if (match == end) {
+            ERROR("No marker after the entropy-coded data");
+            return false;
+        }
+
+        const uint8_t next = *(match + 1);
+        if (next >= M_RST0 && next <= M_RST7) {
+            m_scanIndex.restarts.push_back(match - m_data);
+            current = match + 2;
+        } else if (next < M_SOF0 || next == 0xFF) {
+            // stuffed zero byte or fill byte
+            current = match + 1;
+        } else {
+            m_scanIndex.end = match - m_data;
+            break;
+        }
+    }
+
+    // leave the input on the marker so nextMarker() finds it at once
+    return skipBytes(m_scanIndex.end - currentBytePosition());
+}
+
 bool Parser::parseEOI()
 {
     if (m_sawEOI) {
@@ -115,6 +115,23 @@ struct Segment {
     uint32_t length;
 };
 
+/**
+ * Byte positions of the entropy-coded data of a scan.  The RSTn markers
+ * split it into restart intervals; each position in restarts and end is
+ * that of the 0xFF byte of the marker closing an interval.
+ */
+struct ScanIndex {
+    ScanIndex() : start(0), end(0) { }
+
+    size_t numIntervals() const { return restarts.size() + 1; }
+    uint32_t intervalStart(size_t i) const { return i ? restarts[i - 1] + 2 : start; }
+    uint32_t intervalEnd(size_t i) const { return i < restarts.size() ? restarts[i] : end; }
+
+    uint32_t start;
+    std::vector<uint32_t> restarts;
+    uint32_t end;
+};
+
 struct FrameHeader {
     typedef std::tr1::shared_ptr<FrameHeader> Shared;
 
@@ -211,6 +228,13 @@ public:
     const Segment& current() const { return m_current; }
     const FrameHeader::Shared& frameHeader() const { return m_frameHeader; }
     const ScanHeader::Shared& scanHeader() const { return m_scanHeader; }
+
+    /**
+     * @return the index of the entropy-coded data following the most
+     * recent SOS.  It is complete by the time the SOS callbacks run, and
+     * RSTn markers are recorded here rather than reported to callbacks.
+     */
+    const ScanIndex& scanIndex() const { return m_scanIndex; }
     const QuantTables& quantTables() const { return m_quantTables; }
     const HuffTables& dcHuffTables() const { return m_dcHuffTables; }
     const HuffTables& acHuffTables() const { return m_acHuffTables; }
@@ -222,13 +246,17 @@ private:
     bool firstMarker();
     bool nextMarker();
     bool skipBytes(const uint32_t);
-    uint32_t currentBytePosition() const { return m_input.getPos() >> 3; }
+    uint32_t currentBytePosition() const
+    {
+        return m_inputOffset + (m_input.getPos() >> 3);
+    }
     CallbackResult notifyCallbacks() const;
 
     bool parseSOI();
     bool parseAPP();
     bool parseSOF(bool, bool, bool);
     bool parseSOS();
+    bool indexScan();
     bool parseEOI();
     bool parseDAC();
     bool parseDQT();
@@ -236,6 +264,7 @@ private:
     bool parseDRI();
 
     BitReader m_input;
+    uint32_t m_inputOffset; // byte position m_input starts at
 
     const uint8_t* m_data;
     uint32_t m_size;
@@ -243,6 +272,7 @@ private:
     Segment m_current;
     FrameHeader::Shared m_frameHeader;
     ScanHeader::Shared m_scanHeader;
+    ScanIndex m_scanIndex;
 
     QuantTables m_quantTables;
     HuffTables m_dcHuffTables;
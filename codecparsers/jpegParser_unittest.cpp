@@ -23,9 +23,11 @@
 
 // library headers
 #include "common/unittest.h"
+#include "common/utils.h"
 
 // system headers
 #include <limits>
+#include <vector>
 
 namespace YamiParser {
 namespace JPEG {
@@ -526,5 +528,88 @@ JPEG_PARSER_TEST(Parse_SimpleTruncated)
     }
 }
 
+//g_SimpleJPEG with a DRI and its entropy-coded data replaced by intervals
+//restart intervals of size bytes each, with every 0xFF in them stuffed
+static std::vector<uint8_t> restartJPEG(size_t intervals, size_t size)
+{
+    const size_t sos = 609; // 0xFF of the SOS marker
+    const size_t scan = 623; // first byte of the entropy-coded data
+    const uint8_t dri[] = { 0xff, M_DRI, 0x00, 0x04, 0x00, 0x01 };
+
+    std::vector<uint8_t> data(g_SimpleJPEG.begin(), g_SimpleJPEG.begin() + sos);
+    data.insert(data.end(), dri, dri + sizeof(dri));
+    data.insert(data.end(), g_SimpleJPEG.begin() + sos, g_SimpleJPEG.begin() + scan);
+    for (size_t i(0); i < intervals; ++i) {
+        if (i) {
+            data.push_back(0xff);
+            data.push_back(M_RST0 + (i - 1) % 8);
+        }
+        for (size_t j(0); j < size; ++j) {
+            const uint8_t byte = (i + j) & 0xff;
+            data.push_back(byte);
+            if (byte == 0xff)
+                data.push_back(0x00);
+        }
+    }
+    // a fill byte ahead of the EOI
+    data.push_back(0xff);
+    data.push_back(0xff);
+    data.push_back(M_EOI);
+    return data;
+}
+
+JPEG_PARSER_TEST(Parse_RestartIndex)
+{
+    const std::vector<uint8_t> data(restartJPEG(4, 300));
+    Parser parser(&data[0], data.size());
+
+    EXPECT_TRUE(parser.parse());
+    EXPECT_EQ(M_EOI, parser.current().marker);
+    EXPECT_EQ(1u, parser.restartInterval());
+
+    const ScanIndex& index = parser.scanIndex();
+    EXPECT_EQ(629u, index.start);
+    EXPECT_EQ(data.size() - 2, index.end);
+    ASSERT_EQ(4u, index.numIntervals());
+
+    uint32_t stuffed = 0;
+    for (size_t i(0); i < index.numIntervals(); ++i) {
+        const uint32_t start = index.intervalStart(i);
+        const uint32_t end = index.intervalEnd(i);
+        ASSERT_LT(start, end);
+        if (i < index.restarts.size()) {
+            EXPECT_EQ(0xff, data[end]);
+            EXPECT_EQ(M_RST0 + i, data[end + 1]);
+        }
+        for (uint32_t j(start); j < end; ++j) {
+            if (data[j] == 0xff && data[j + 1] == 0x00)
+                ++stuffed;
+        }
+    }
+    // every interval crosses one stuffed 0xFF
+    EXPECT_EQ(4u, stuffed);
+}
+
+//bytes per second parsing an MJPEG capture of large restart coded frames
+JPEG_PARSER_TEST(Parse_MJPEGThroughput)
+{
+    const size_t frames = 64;
+    const std::vector<uint8_t> frame(restartJPEG(2048, 256));
+    std::vector<uint8_t> capture;
+    for (size_t i(0); i < frames; ++i)
+        capture.insert(capture.end(), frame.begin(), frame.end());
+
+    uint64_t begin = YamiMediaCodec::getMonotonicTimeUs();
+    for (size_t i(0); i < frames; ++i) {
+        Parser parser(&capture[i * frame.size()], frame.size());
+        ASSERT_TRUE(parser.parse());
+        ASSERT_EQ(2048u, parser.scanIndex().numIntervals());
+    }
+    uint64_t us = YamiMediaCodec::getMonotonicTimeUs() - begin;
+    RecordProperty("Bytes", (int)capture.size());
+    RecordProperty("Us", (int)us);
+    RecordProperty("MegabytesPerSecond", (int)(us ? capture.size() / us : 0));
+}
+
 } // namespace JPEG
 } // namespace YamiParser
@@ -63,6 +63,13 @@ void NalReader::loadDataToCache(uint32_t nbytes)
     m_epb += epb;
 }
 
+uint32_t NalReader::peek(uint32_t nbits) const
+{
+    NalReader tmp(*this);
+
+    return tmp.read(nbits);
+}
+
 /*according to 9.1 of h264 spec*/
 bool NalReader::readUe(uint32_t& v)
 {
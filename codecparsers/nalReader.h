@@ -33,6 +33,9 @@ public:
     bool readSe(int32_t& v);
     int32_t readSe();
 
+    /*peek through emulation prevention bytes as read() does*/
+    uint32_t peek(uint32_t nbits) const;
+
     bool moreRbspData() const;
     void rbspTrailingBits();
     uint32_t getEpbCnt() { return m_epb; }
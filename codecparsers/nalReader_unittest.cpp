@@ -55,4 +55,19 @@ NALREADER_TEST(ReadBeyondBoundary)
     EXPECT_EQ(0, reader.readSe());
 }
 
+NALREADER_TEST(PeekSkipsEmulationBytes)
+{
+    const uint8_t data[] = {
+        0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x00, 0x00,
+        0x03, 0x01, 0x80
+    };
+    NalReader reader(data, sizeof(data));
+    EXPECT_EQ(0x112233u, reader.read(24));
+    EXPECT_EQ(0x44556600u, reader.read(32));
+    EXPECT_EQ(0x0001u, reader.peek(16));
+    EXPECT_EQ(0x0001u, reader.read(16));
+    EXPECT_EQ(1u, reader.getEpbCnt());
+    EXPECT_EQ(0x80u, reader.read(8));
+}
+
 } // namespace YamiParser
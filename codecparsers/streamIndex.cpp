@@ -0,0 +1,519 @@
+/*
+ * Copyright 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "streamIndex.h"
+
+#include "bitReader.h"
+#include "nalReader.h"
+#include "common/log.h"
+#include "interface/VideoCommonDefs.h"
+
+#include <algorithm>
+#include <pthread.h>
+#include <string.h>
+
+namespace YamiParser {
+
+namespace {
+
+enum Codec {
+    CODEC_H264,
+    CODEC_H265,
+    CODEC_MPEG2,
+    CODEC_VP8,
+    CODEC_VP9,
+    CODEC_UNKNOWN
+};
+
+//how a nal unit (or MPEG-2 start code) relates to access units
+enum NalClass {
+    //parameter sets, SEI, delimiters in front of a picture
+    NAL_PREFIX,
+    //first slice of a picture or MPEG-2 picture header
+    NAL_PICTURE,
+    //any other slice
+    NAL_SLICE,
+    //everything else, leaves the current access unit alone
+    NAL_OTHER
+};
+
+//not a random access point
+const int NO_ENTRY = -1;
+
+//Annex B streams smaller than this are not worth a thread
+const uint64_t MIN_CHUNK_SIZE = 1024 * 1024;
+
+const uint32_t INDEX_MAGIC = 0x58444959; //"YIDX"
+const uint32_t INDEX_VERSION = 1;
+const size_t ENTRY_BYTES = 8 + 4 + 8 + 8 + 1;
+const size_t HEADER_BYTES = 4 + 4 + 8 + 4;
+
+struct Picture {
+    uint64_t offset;
+    int type;
+};
+
+//one part of an Annex B stream, scanned by one thread
+struct Chunk {
+    Codec codec;
+    const uint8_t* data;
+    uint64_t size;
+    //start codes in [begin, end) belong to this chunk
+    uint64_t begin;
+    uint64_t end;
+
+    std::vector<Picture> pictures;
+    //no slice came before the first picture, its prefix may start in the
+    //chunk before
+    bool firstOpen;
+    bool sawSlice;
+    //start of the prefix run at the end of the chunk, -1 if none
+    int64_t tailPrefix;
+    //that run has a recovery point SEI
+    bool tailRecovery;
+};
+
+Codec getCodec(const char* mimeType)
+{
+    if (!mimeType)
+        return CODEC_UNKNOWN;
+    if (!strcmp(mimeType, YAMI_MIME_H264) || !strcmp(mimeType, YAMI_MIME_AVC))
+        return CODEC_H264;
+    if (!strcmp(mimeType, YAMI_MIME_H265) || !strcmp(mimeType, YAMI_MIME_HEVC))
+        return CODEC_H265;
+    if (!strcmp(mimeType, YAMI_MIME_MPEG2))
+        return CODEC_MPEG2;
+    if (!strcmp(mimeType, YAMI_MIME_VP8))
+        return CODEC_VP8;
+    if (!strcmp(mimeType, YAMI_MIME_VP9))
+        return CODEC_VP9;
+    return CODEC_UNKNOWN;
+}
+
+//position of the next 00 00 01 at or after p, end if there is none
+const uint8_t* nextStartCode(const uint8_t* p, const uint8_t* end)
+{
+    while (end - p >= 3) {
+        const uint8_t* one = static_cast<const uint8_t*>(memchr(p + 2, 1, end - p - 2));
+        if (!one)
+            break;
+        if (!one[-1] && !one[-2])
+            return one - 2;
+        p = one - 1;
+    }
+    return end;
+}
+
+bool hasRecoveryPoint(const uint8_t* nal, uint32_t size)
+{
+    const uint32_t SEI_RECOVERY_POINT = 6;
+    NalReader nr(nal + 1, size - 1);
+    while (nr.moreRbspData()) {
+        uint32_t payloadType = 0;
+        uint32_t payloadSize = 0;
+        uint32_t byte;
+        do {
+            if (!nr.read(byte, 8))
+                return false;
+            payloadType += byte;
+        } while (byte == 0xff);
+        do {
+            if (!nr.read(byte, 8))
+                return false;
+            payloadSize += byte;
+        } while (byte == 0xff);
+        if (payloadType == SEI_RECOVERY_POINT)
+            return true;
+        if (payloadSize > (nr.getRemainingBitsCount() >> 3))
+            return false;
+        for (uint32_t i = 0; i < payloadSize; i++)
+            nr.skip(8);
+    }
+    return false;
+}
+
+//slice_type is the second syntax element, no need for the parameter sets
+bool isIntraSlice(const uint8_t* nal, uint32_t size)
+{
+    NalReader nr(nal + 1, std::min(size - 1, 16u));
+    uint32_t firstMb, sliceType;
+    if (!nr.readUe(firstMb) || !nr.readUe(sliceType))
+        return false;
+    //I or SI
+    return sliceType % 5 == 2 || sliceType % 5 == 4;
+}
+
+NalClass classifyH264(const uint8_t* nal, uint32_t size, int& type, bool& recovery)
+{
+    if (size < 2 || (nal[0] & 0x80))
+        return NAL_OTHER;
+    switch (nal[0] & 0x1f) {
+    case 1: //non IDR slice
+    case 2: //slice data partition A
+        if (!(nal[1] & 0x80))
+            return NAL_SLICE;
+        if (recovery)
+            type = StreamIndex::ENTRY_RECOVERY_POINT;
+        else if (isIntraSlice(nal, size))
+            type = StreamIndex::ENTRY_INTRA;
+        else
+            type = NO_ENTRY;
+        return NAL_PICTURE;
+    case 5: //IDR slice
+        if (!(nal[1] & 0x80))
+            return NAL_SLICE;
+        type = StreamIndex::ENTRY_IDR;
+        return NAL_PICTURE;
+    case 3:
+    case 4:
+        return NAL_SLICE;
+    case 6:
+        if (hasRecoveryPoint(nal, size))
+            recovery = true;
+        return NAL_PREFIX;
+    case 7: //SPS
+    case 8: //PPS
+    case 9: //access unit delimiter
+    case 13: //SPS extension
+    case 14: //prefix nal
+    case 15: //subset SPS
+        return NAL_PREFIX;
+    default:
+        return NAL_OTHER;
+    }
+}
+
+NalClass classifyH265(const uint8_t* nal, uint32_t size, int& type)
+{
+    if (size < 3 || (nal[0] & 0x80))
+        return NAL_OTHER;
+    //only the base layer
+    if (((nal[0] & 1) << 5) | (nal[1] >> 3))
+        return NAL_OTHER;
+    uint8_t nalType = (nal[0] >> 1) & 0x3f;
+    if (nalType <= 31) {
+        if (!(nal[2] & 0x80))
+            return NAL_SLICE;
+        if (nalType == 19 || nalType == 20)
+            type = StreamIndex::ENTRY_IDR;
+        else if (nalType >= 16 && nalType <= 21)
+            type = StreamIndex::ENTRY_IRAP;
+        else
+            type = NO_ENTRY;
+        return NAL_PICTURE;
+    }
+    //VPS, SPS, PPS, AUD, prefix SEI and reserved prefix types
+    if (nalType <= 35 || nalType == 39 || (nalType >= 41 && nalType <= 44)
+        || (nalType >= 48 && nalType <= 55))
+        return NAL_PREFIX;
+    return NAL_OTHER;
+}
+
+NalClass classifyMpeg2(const uint8_t* code, uint32_t size, int& type)
+{
+    if (size < 1)
+        return NAL_OTHER;
+    switch (code[0]) {
+    case 0xb3: //sequence header
+    case 0xb8: //group of pictures
+        return NAL_PREFIX;
+    case 0x00:
+        if (size < 3)
+            return NAL_OTHER;
+        //picture_coding_type follows the 10 bits temporal_reference
+        type = ((code[2] >> 3) & 7) == 1 ? StreamIndex::ENTRY_INTRA : NO_ENTRY;
+        return NAL_PICTURE;
+    default:
+        if (code[0] >= 0x01 && code[0] <= 0xaf)
+            return NAL_SLICE;
+        return NAL_OTHER;
+    }
+}
+
+void scanChunk(Chunk& c)
+{
+    const uint8_t* base = c.data;
+    const uint8_t* end = base + c.size;
+    const uint8_t* p = nextStartCode(base + c.begin, end);
+    int64_t prefix = -1;
+    bool recovery = false;
+
+    c.firstOpen = false;
+    c.sawSlice = false;
+    while (p < base + c.end) {
+        const uint8_t* nal = p + 3;
+        const uint8_t* next = nextStartCode(nal, end);
+        uint32_t size = next - nal;
+        //the zero_byte of a 4 bytes start code starts the access unit
+        int64_t start = p - base;
+        if (start && !p[-1])
+            start--;
+        int type = NO_ENTRY;
+        NalClass nalClass;
+        if (c.codec == CODEC_H264)
+            nalClass = classifyH264(nal, size, type, recovery);
+        else if (c.codec == CODEC_H265)
+            nalClass = classifyH265(nal, size, type);
+        else
+            nalClass = classifyMpeg2(nal, size, type);
+
+        switch (nalClass) {
+        case NAL_PREFIX:
+            if (prefix < 0)
+                prefix = start;
+            break;
+        case NAL_PICTURE: {
+            Picture picture;
+            picture.offset = prefix < 0 ? start : prefix;
+            picture.type = type;
+            if (c.pictures.empty() && !c.sawSlice)
+                c.firstOpen = true;
+            c.pictures.push_back(picture);
+            c.sawSlice = true;
+            prefix = -1;
+            recovery = false;
+            break;
+        }
+        case NAL_SLICE:
+            c.sawSlice = true;
+            prefix = -1;
+            recovery = false;
+            break;
+        default:
+            break;
+        }
+        p = next;
+    }
+    c.tailPrefix = prefix;
+    c.tailRecovery = recovery;
+}
+
+void* scanThread(void* arg)
+{
+    scanChunk(*static_cast<Chunk*>(arg));
+    return NULL;
+}
+
+uint32_t readLe(const uint8_t* p, uint32_t bytes)
+{
+    uint32_t v = 0;
+    for (uint32_t i = 0; i < bytes; i++)
+        v |= (uint32_t)p[i] << (i * 8);
+    return v;
+}
+
+uint64_t readLe64(const uint8_t* p)
+{
+    return readLe(p, 4) | ((uint64_t)readLe(p + 4, 4) << 32);
+}
+
+void writeLe(std::vector<uint8_t>& out, uint64_t v, uint32_t bytes)
+{
+    for (uint32_t i = 0; i < bytes; i++)
+        out.push_back((v >> (i * 8)) & 0xff);
+}
+
+bool isVp9KeyFrame(const uint8_t* data, uint32_t size)
+{
+    BitReader br(data, size);
+    if (br.read(2) != 2) //frame_marker
+        return false;
+    uint32_t profile = br.read(1);
+    profile |= br.read(1) << 1;
+    if (profile == 3)
+        br.skip(1);
+    if (br.read(1)) //show_existing_frame
+        return false;
+    return !br.read(1);
+}
+
+} //namespace
+
+StreamIndex::StreamIndex()
+    : m_frameCount(0)
+{
+}
+
+bool StreamIndex::build(const char* mimeType, const uint8_t* data, uint64_t size, uint32_t threads)
+{
+    m_entries.clear();
+    m_frameCount = 0;
+
+    Codec codec = getCodec(mimeType);
+    if (codec == CODEC_UNKNOWN || !data) {
+        ERROR("can't index %s", mimeType ? mimeType : "(null)");
+        return false;
+    }
+
+    if (codec == CODEC_VP8 || codec == CODEC_VP9) {
+        //IVF, frame sizes chain the frames, nothing to split
+        const uint32_t IVF_FILE_HEADER = 32;
+        const uint32_t IVF_FRAME_HEADER = 12;
+        if (size < IVF_FILE_HEADER || memcmp(data, "DKIF", 4)) {
+            ERROR("not an ivf file");
+            return false;
+        }
+        uint64_t pos = readLe(data + 6, 2);
+        while (pos + IVF_FRAME_HEADER <= size) {
+            uint32_t frameSize = readLe(data + pos, 4);
+            int64_t timeStamp = readLe64(data + pos + 4);
+            pos += IVF_FRAME_HEADER;
+            if (!frameSize || pos + frameSize > size)
+                break;
+            const uint8_t* frame = data + pos;
+            bool key = codec == CODEC_VP8 ? !(frame[0] & 1) : isVp9KeyFrame(frame, frameSize);
+            if (key) {
+                Entry entry;
+                entry.offset = pos;
+                entry.size = frameSize;
+                entry.frame = m_frameCount;
+                entry.timeStamp = timeStamp;
+                entry.type = ENTRY_KEY_FRAME;
+                m_entries.push_back(entry);
+            }
+            m_frameCount++;
+            pos += frameSize;
+        }
+        return true;
+    }
+
+    uint64_t chunks = std::max(1u, threads);
+    chunks = std::min(chunks, std::max((uint64_t)1, size / MIN_CHUNK_SIZE));
+    std::vector<Chunk> parts(chunks);
+    std::vector<pthread_t> ids(chunks);
+    std::vector<bool> started(chunks, false);
+    for (uint64_t i = 0; i < chunks; i++) {
+        Chunk& c = parts[i];
+        c.codec = codec;
+        c.data = data;
+        c.size = size;
+        c.begin = size / chunks * i;
+        c.end = i + 1 == chunks ? size : size / chunks * (i + 1);
+        if (i)
+            started[i] = !pthread_create(&ids[i], NULL, scanThread, &c);
+    }
+    scanChunk(parts[0]);
+    for (uint64_t i = 1; i < chunks; i++) {
+        if (started[i])
+            pthread_join(ids[i], NULL);
+        else
+            scanChunk(parts[i]);
+    }
+
+    //stitch the parts, a prefix run or recovery point may cross a boundary
+    std::vector<Picture> pictures;
+    int64_t carryPrefix = -1;
+    bool carryRecovery = false;
+    for (uint64_t i = 0; i < chunks; i++) {
+        Chunk& c = parts[i];
+        if (!c.pictures.empty() && c.firstOpen) {
+            Picture& first = c.pictures[0];
+            if (carryPrefix >= 0)
+                first.offset = carryPrefix;
+            if (carryRecovery && first.type != ENTRY_IDR)
+                first.type = ENTRY_RECOVERY_POINT;
+        }
+        pictures.insert(pictures.end(), c.pictures.begin(), c.pictures.end());
+        if (c.sawSlice) {
+            carryPrefix = c.tailPrefix;
+            carryRecovery = c.tailRecovery;
+        } else {
+            if (carryPrefix < 0)
+                carryPrefix = c.tailPrefix;
+            carryRecovery = carryRecovery || c.tailRecovery;
+        }
+    }
+
+    m_frameCount = pictures.size();
+    for (size_t i = 0; i < pictures.size(); i++) {
+        if (pictures[i].type == NO_ENTRY)
+            continue;
+        uint64_t next = i + 1 < pictures.size() ? pictures[i + 1].offset : size;
+        Entry entry;
+        entry.offset = pictures[i].offset;
+        entry.size = next - entry.offset;
+        entry.frame = i;
+        entry.timeStamp = -1;
+        entry.type = pictures[i].type;
+        m_entries.push_back(entry);
+    }
+    return true;
+}
+
+static bool frameLess(uint64_t frame, const StreamIndex::Entry& entry)
+{
+    return frame < entry.frame;
+}
+
+const StreamIndex::Entry* StreamIndex::find(uint64_t frame) const
+{
+    std::vector<Entry>::const_iterator it
+        = std::upper_bound(m_entries.begin(), m_entries.end(), frame, frameLess);
+    if (it == m_entries.begin())
+        return NULL;
+    return &*(it - 1);
+}
+
+void StreamIndex::serialize(std::vector<uint8_t>& out) const
+{
+    out.clear();
+    out.reserve(HEADER_BYTES + m_entries.size() * ENTRY_BYTES);
+    writeLe(out, INDEX_MAGIC, 4);
+    writeLe(out, INDEX_VERSION, 4);
+    writeLe(out, m_frameCount, 8);
+    writeLe(out, m_entries.size(), 4);
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        const Entry& e = m_entries[i];
+        writeLe(out, e.offset, 8);
+        writeLe(out, e.size, 4);
+        writeLe(out, e.frame, 8);
+        writeLe(out, e.timeStamp, 8);
+        writeLe(out, e.type, 1);
+    }
+}
+
+bool StreamIndex::deserialize(const uint8_t* data, size_t size)
+{
+    m_entries.clear();
+    m_frameCount = 0;
+    if (!data || size < HEADER_BYTES
+        || readLe(data, 4) != INDEX_MAGIC
+        || readLe(data + 4, 4) != INDEX_VERSION)
+        return false;
+    uint32_t count = readLe(data + 16, 4);
+    if ((size - HEADER_BYTES) / ENTRY_BYTES < count)
+        return false;
+
+    const uint8_t* p = data + HEADER_BYTES;
+    m_entries.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        Entry& e = m_entries[i];
+        e.offset = readLe64(p);
+        e.size = readLe(p + 8, 4);
+        e.frame = readLe64(p + 12);
+        e.timeStamp = readLe64(p + 20);
+        e.type = p[28];
+        p += ENTRY_BYTES;
+    }
+    m_frameCount = readLe64(data + 8);
+    return true;
+}
+
+} /*namespace YamiParser*/
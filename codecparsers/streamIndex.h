@@ -0,0 +1,84 @@
+/*
+ * Copyright 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef streamIndex_h
+#define streamIndex_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace YamiParser {
+
+/*
+ * Random access index of an elementary stream held in memory (usually a
+ * mapped file). H.264, HEVC and MPEG-2 Annex B streams are scanned for start
+ * codes, only nal headers and the first bits of a picture are looked at, so
+ * the scan runs close to memory bandwidth and can be split over threads.
+ * VP8 and VP9 are read from IVF, the frame headers give offsets directly.
+ */
+class StreamIndex {
+public:
+    enum EntryType {
+        //H.264/HEVC IDR
+        ENTRY_IDR,
+        //HEVC CRA and BLA, decoding starts here dropping RASL pictures
+        ENTRY_IRAP,
+        //H.264 picture with a recovery point SEI
+        ENTRY_RECOVERY_POINT,
+        //H.264 I picture or MPEG-2 I frame, leading pictures may be broken
+        ENTRY_INTRA,
+        //VP8/VP9 key frame
+        ENTRY_KEY_FRAME
+    };
+
+    struct Entry {
+        //first byte of the access unit, parameter sets and SEI in front of
+        //the picture included. for IVF the first byte of the frame data
+        uint64_t offset;
+        //bytes up to the next access unit
+        uint32_t size;
+        //number of pictures before this one in decode order
+        uint64_t frame;
+        //IVF time stamp, -1 for elementary streams
+        int64_t timeStamp;
+        uint8_t type;
+    };
+
+    StreamIndex();
+
+    /// scan @data for random access points of @mimeType,
+    /// Annex B streams are split into @threads parts scanned in parallel
+    bool build(const char* mimeType, const uint8_t* data, uint64_t size, uint32_t threads = 1);
+
+    const std::vector<Entry>& entries() const { return m_entries; }
+    uint64_t frameCount() const { return m_frameCount; }
+
+    /// the last random access point at or before @frame, NULL if there is none
+    const Entry* find(uint64_t frame) const;
+
+    /// little endian, independent of the host
+    void serialize(std::vector<uint8_t>& out) const;
+    bool deserialize(const uint8_t* data, size_t size);
+
+private:
+    std::vector<Entry> m_entries;
+    uint64_t m_frameCount;
+};
+
+} /*namespace YamiParser*/
+
+#endif
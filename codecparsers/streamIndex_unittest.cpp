@@ -0,0 +1,238 @@
+/*
+ * Copyright 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// primary header
+#include "streamIndex.h"
+
+// library headers
+#include "common/unittest.h"
+#include "interface/VideoCommonDefs.h"
+
+// system libraries
+#include <vector>
+
+namespace YamiParser {
+
+namespace {
+
+const uint8_t h264Sps[] = { 0x67, 0x42, 0xc0, 0x0d, 0xab };
+const uint8_t h264Pps[] = { 0x68, 0xce, 0x3c, 0x80 };
+//recovery point, recovery_frame_cnt 0, exact_match_flag 1
+const uint8_t h264Sei[] = { 0x06, 0x06, 0x01, 0xc4, 0x80 };
+//first_mb_in_slice 0, slice_type 7
+const uint8_t h264Idr[] = { 0x65, 0x88, 0x84 };
+const uint8_t h264I[] = { 0x41, 0x88, 0x84 };
+//first_mb_in_slice 0, slice_type 5
+const uint8_t h264P[] = { 0x41, 0x9a, 0x02 };
+//first_mb_in_slice 1
+const uint8_t h264SecondSlice[] = { 0x41, 0x40, 0x02 };
+
+const uint8_t hevcVps[] = { 0x40, 0x01, 0x0c };
+const uint8_t hevcSps[] = { 0x42, 0x01, 0x01 };
+const uint8_t hevcPps[] = { 0x44, 0x01, 0xc1 };
+const uint8_t hevcIdr[] = { 0x26, 0x01, 0xaf };
+const uint8_t hevcCra[] = { 0x2a, 0x01, 0xaf };
+const uint8_t hevcTrail[] = { 0x02, 0x01, 0xd0 };
+const uint8_t hevcRasl[] = { 0x10, 0x01, 0xd0 };
+
+template <size_t N>
+void addNal(std::vector<uint8_t>& stream, const uint8_t (&nal)[N], size_t padding = 0)
+{
+    static const uint8_t startCode[] = { 0, 0, 0, 1 };
+    stream.insert(stream.end(), startCode, startCode + sizeof(startCode));
+    stream.insert(stream.end(), nal, nal + N);
+    stream.insert(stream.end(), padding, 0xaa);
+}
+
+void addIvfFrame(std::vector<uint8_t>& stream, uint8_t first, uint32_t size, uint64_t pts)
+{
+    for (int i = 0; i < 4; i++)
+        stream.push_back((size >> (i * 8)) & 0xff);
+    for (int i = 0; i < 8; i++)
+        stream.push_back((pts >> (i * 8)) & 0xff);
+    stream.push_back(first);
+    stream.insert(stream.end(), size - 1, 0x55);
+}
+
+} //namespace
+
+class StreamIndexTest
+    : public ::testing::Test {
+};
+
+#define STREAMINDEX_TEST(name) \
+    TEST_F(StreamIndexTest, name)
+
+STREAMINDEX_TEST(H264)
+{
+    std::vector<uint8_t> stream;
+    addNal(stream, h264Sps);
+    addNal(stream, h264Pps);
+    addNal(stream, h264Idr, 10);
+    addNal(stream, h264P, 10);
+    size_t recovery = stream.size();
+    addNal(stream, h264Sei);
+    addNal(stream, h264P, 10);
+    size_t intra = stream.size();
+    addNal(stream, h264I, 10);
+    addNal(stream, h264SecondSlice, 10);
+    addNal(stream, h264P, 10);
+
+    StreamIndex index;
+    ASSERT_TRUE(index.build(YAMI_MIME_H264, &stream[0], stream.size()));
+    EXPECT_EQ(5u, index.frameCount());
+
+    const std::vector<StreamIndex::Entry>& entries = index.entries();
+    ASSERT_EQ(3u, entries.size());
+    EXPECT_EQ(StreamIndex::ENTRY_IDR, entries[0].type);
+    EXPECT_EQ(0u, entries[0].offset);
+    EXPECT_EQ(0u, entries[0].frame);
+
+    EXPECT_EQ(StreamIndex::ENTRY_RECOVERY_POINT, entries[1].type);
+    EXPECT_EQ(recovery, entries[1].offset);
+    EXPECT_EQ(2u, entries[1].frame);
+
+    EXPECT_EQ(StreamIndex::ENTRY_INTRA, entries[2].type);
+    EXPECT_EQ(intra, entries[2].offset);
+    EXPECT_EQ(3u, entries[2].frame);
+    EXPECT_EQ(intra - recovery, entries[1].size);
+
+    EXPECT_EQ(&entries[0], index.find(1));
+    EXPECT_EQ(&entries[1], index.find(2));
+    EXPECT_EQ(&entries[2], index.find(4));
+}
+
+STREAMINDEX_TEST(H265)
+{
+    std::vector<uint8_t> stream;
+    addNal(stream, hevcVps);
+    addNal(stream, hevcSps);
+    addNal(stream, hevcPps);
+    addNal(stream, hevcIdr, 10);
+    addNal(stream, hevcTrail, 10);
+    size_t cra = stream.size();
+    addNal(stream, hevcPps);
+    addNal(stream, hevcCra, 10);
+    addNal(stream, hevcRasl, 10);
+
+    StreamIndex index;
+    ASSERT_TRUE(index.build(YAMI_MIME_H265, &stream[0], stream.size()));
+    EXPECT_EQ(4u, index.frameCount());
+
+    const std::vector<StreamIndex::Entry>& entries = index.entries();
+    ASSERT_EQ(2u, entries.size());
+    EXPECT_EQ(StreamIndex::ENTRY_IDR, entries[0].type);
+    EXPECT_EQ(StreamIndex::ENTRY_IRAP, entries[1].type);
+    EXPECT_EQ(cra, entries[1].offset);
+    EXPECT_EQ(2u, entries[1].frame);
+}
+
+STREAMINDEX_TEST(ThreadsMatchSingleThread)
+{
+    std::vector<uint8_t> stream;
+    for (size_t gop = 0; stream.size() < 6 * 1024 * 1024; gop++) {
+        addNal(stream, h264Sps);
+        addNal(stream, h264Pps);
+        if (gop % 3)
+            addNal(stream, h264Sei);
+        addNal(stream, gop % 2 ? h264I : h264Idr, 1000 + gop % 7);
+        for (size_t i = 0; i < 10; i++) {
+            addNal(stream, h264P, 3000 + i * 13);
+            addNal(stream, h264SecondSlice, gop % 11);
+        }
+    }
+
+    StreamIndex single;
+    StreamIndex threaded;
+    ASSERT_TRUE(single.build(YAMI_MIME_H264, &stream[0], stream.size()));
+    ASSERT_TRUE(threaded.build(YAMI_MIME_H264, &stream[0], stream.size(), 4));
+    EXPECT_EQ(single.frameCount(), threaded.frameCount());
+
+    const std::vector<StreamIndex::Entry>& a = single.entries();
+    const std::vector<StreamIndex::Entry>& b = threaded.entries();
+    ASSERT_EQ(a.size(), b.size());
+    for (size_t i = 0; i < a.size(); i++) {
+        EXPECT_EQ(a[i].offset, b[i].offset);
+        EXPECT_EQ(a[i].size, b[i].size);
+        EXPECT_EQ(a[i].frame, b[i].frame);
+        EXPECT_EQ(a[i].type, b[i].type);
+    }
+}
+
+STREAMINDEX_TEST(Vp8Ivf)
+{
+    std::vector<uint8_t> stream(32);
+    memcpy(&stream[0], "DKIF", 4);
+    stream[6] = 32;
+    memcpy(&stream[8], "VP80", 4);
+    addIvfFrame(stream, 0x10, 100, 0);
+    addIvfFrame(stream, 0x11, 20, 1);
+    size_t key = stream.size() + 12;
+    addIvfFrame(stream, 0x10, 90, 2);
+    addIvfFrame(stream, 0x11, 30, 3);
+
+    StreamIndex index;
+    ASSERT_TRUE(index.build(YAMI_MIME_VP8, &stream[0], stream.size()));
+    EXPECT_EQ(4u, index.frameCount());
+
+    const std::vector<StreamIndex::Entry>& entries = index.entries();
+    ASSERT_EQ(2u, entries.size());
+    EXPECT_EQ(StreamIndex::ENTRY_KEY_FRAME, entries[1].type);
+    EXPECT_EQ(key, entries[1].offset);
+    EXPECT_EQ(90u, entries[1].size);
+    EXPECT_EQ(2u, entries[1].frame);
+    EXPECT_EQ(2, entries[1].timeStamp);
+}
+
+STREAMINDEX_TEST(Serialize)
+{
+    std::vector<uint8_t> stream;
+    addNal(stream, h264Sps);
+    addNal(stream, h264Pps);
+    addNal(stream, h264Idr, 10);
+    addNal(stream, h264P, 10);
+    addNal(stream, h264I, 10);
+
+    StreamIndex index;
+    ASSERT_TRUE(index.build(YAMI_MIME_H264, &stream[0], stream.size()));
+
+    std::vector<uint8_t> data;
+    index.serialize(data);
+
+    StreamIndex loaded;
+    ASSERT_TRUE(loaded.deserialize(&data[0], data.size()));
+    EXPECT_EQ(index.frameCount(), loaded.frameCount());
+    ASSERT_EQ(index.entries().size(), loaded.entries().size());
+    for (size_t i = 0; i < index.entries().size(); i++) {
+        const StreamIndex::Entry& a = index.entries()[i];
+        const StreamIndex::Entry& b = loaded.entries()[i];
+        EXPECT_EQ(a.offset, b.offset);
+        EXPECT_EQ(a.size, b.size);
+        EXPECT_EQ(a.frame, b.frame);
+        EXPECT_EQ(a.timeStamp, b.timeStamp);
+        EXPECT_EQ(a.type, b.type);
+    }
+
+    EXPECT_FALSE(loaded.deserialize(&data[0], data.size() - 1));
+    data[0] = 0;
+    EXPECT_FALSE(loaded.deserialize(&data[0], data.size()));
+}
+
+} // namespace YamiParser
@@ -19,6 +19,7 @@
 #endif
 
 #include "vc1Parser.h"
+#include "common/common_def.h"
 #include <cstring>
 #include <cassert>
 
@@ -116,6 +117,80 @@ namespace VC1 {
         },
     };
 
+    /* Table 80: Norm-2/Diff-2 Code Table, indexed by the next 3 bits.
+       bit 1 of bits is the first macroblock of the pair, bit 0 the second */
+    static const struct {
+        uint8_t bits;
+        uint8_t length;
+    } Norm2LookupTable[8] = {
+        { 0, 1 }, { 0, 1 }, { 0, 1 }, { 0, 1 },
+        { 2, 3 }, { 1, 3 }, { 3, 2 }, { 3, 2 }
+    };
+
+    /* direct lookup of a vlc table, indexed by the next maxBits bits.
+       every entry holds the symbol in the high bits and the code length
+       in the low 4 bits, 0 length means an invalid code */
+    class VLCLookup {
+    public:
+        VLCLookup(const VLCTable* table, uint32_t tableLen, uint32_t maxBits)
+            : m_maxBits(maxBits)
+            , m_entries(1 << maxBits, 0)
+        {
+            uint32_t i, j, shift;
+            for (i = 0; i < tableLen; i++) {
+                shift = maxBits - table[i].codeLength;
+                for (j = table[i].codeWord << shift;
+                     j < (uint32_t)(table[i].codeWord + 1) << shift; j++) {
+                    if (!m_entries[j])
+                        m_entries[j] = (i << 4) | table[i].codeLength;
+                }
+            }
+        }
+
+        bool decode(BitReader* br, uint16_t* out) const
+        {
+            uint16_t entry;
+            /* a short peek returns 0, which is a valid code of the norm6
+               table. the remaining count still holds the emulation
+               prevention bytes, at most a third of it, so twice the
+               code length keeps the peek inside the data */
+            if (br->getRemainingBitsCount() < 2 * m_maxBits)
+                return decodeBits(br, out);
+            entry = m_entries[br->peek(m_maxBits)];
+            if (!(entry & 0xf))
+                return false;
+            br->skip(entry & 0xf);
+            *out = entry >> 4;
+            return true;
+        }
+
+    private:
+        /* near the end of the data, read the code a bit at a time
+           until it matches an entry of the same length */
+        bool decodeBits(BitReader* br, uint16_t* out) const
+        {
+            uint32_t len, bit, code = 0;
+            uint16_t entry;
+            for (len = 1; len <= m_maxBits; len++) {
+                if (!br->read(bit, 1))
+                    return false;
+                code = (code << 1) | bit;
+                entry = m_entries[code << (m_maxBits - len)];
+                if ((entry & 0xf) == len) {
+                    *out = entry >> 4;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uint32_t m_maxBits;
+        std::vector<uint16_t> m_entries;
+    };
+
+    static const VLCLookup ImodeLookup(ImodeVLCTable, N_ELEMENTS(ImodeVLCTable), 4);
+    static const VLCLookup Norm6Lookup(Norm6VLCTable, N_ELEMENTS(Norm6VLCTable), 13);
+
     Parser::Parser()
     {
         memset(&m_seqHdr, 0, sizeof(m_seqHdr));
@@ -159,19 +234,22 @@ namespace VC1 {
         bool ret = false;
         m_mbWidth = (m_seqHdr.coded_width + 15) >> 4;
         m_mbHeight = (m_seqHdr.coded_height + 15) >> 4;
-        mallocBitPlanes();
+        resetBitPlanes();
         memset(&m_frameHdr, 0, sizeof(m_frameHdr));
-        if (!convertToRbdu(data, size))
+        if (!searchFrameBdu(data, size))
             return false;
-        BitReader bitReader(&m_rbdu[0], m_rbdu.size());
+        /* the frame is unescaped lazily, only the header bits are touched
+           and the ebdu stays in the caller's buffer for the slice data */
+        NalReader nalReader(data, size);
         if (m_seqHdr.profile != PROFILE_ADVANCED) {
-            ret = parseFrameHeaderSimpleMain(&bitReader);
+            ret = parseFrameHeaderSimpleMain(&nalReader);
         }
         else {
             /* support advanced profile */
-            ret = parseFrameHeaderAdvanced(&bitReader);
+            ret = parseFrameHeaderAdvanced(&nalReader);
         }
-        m_frameHdr.macroblock_offset = bitReader.getPos();
+        /* macroblock_offset is counted in rbdu bits */
+        m_frameHdr.macroblock_offset = nalReader.getPos() - (nalReader.getEpbCnt() << 3);
         return ret;
     }
 
@@ -183,11 +261,9 @@ namespace VC1 {
         return (pos == data + size) ? (-1) : (pos - data);
     }
 
-    bool Parser::convertToRbdu(uint8_t*& data, uint32_t& size)
+    bool Parser::searchFrameBdu(uint8_t*& data, uint32_t& size)
     {
-        uint8_t* pos;
-        int32_t offset, i = 0;
-        const uint8_t startCode[] = { 0x00, 0x00, 0x03 };
+        int32_t offset;
 
         if (m_seqHdr.profile == PROFILE_ADVANCED) {
             while (1) {
@@ -206,22 +282,6 @@ namespace VC1 {
                 return false;
             }
         }
-        m_rbdu.clear();
-        /*extraction of rbdu from ebdu*/
-        while (1) {
-            pos = std::search(data + i, data + size, startCode, startCode + 3);
-            if (pos == data + size) {
-                m_rbdu.insert(m_rbdu.end(), data + i, pos);
-                break;
-            }
-            if (pos[3] <= 0x03) {
-                m_rbdu.insert(m_rbdu.end(), data + i, pos + 2);
-            }
-            else {
-                m_rbdu.insert(m_rbdu.end(), data + i, pos + 3);
-            }
-            i = pos - data + 3;
-        }
         return (size > 0);
     }
 
@@ -362,213 +422,195 @@ namespace VC1 {
         return true;
     }
 
-    void Parser::mallocBitPlanes()
+    void Parser::resetBitPlanes()
     {
-        uint32_t size = m_mbHeight * m_mbWidth;
-        m_bitPlanes.acpred.resize(size);
-        m_bitPlanes.fieldtx.resize(size);
-        m_bitPlanes.overflags.resize(size);
-        m_bitPlanes.mvtypemb.resize(size);
-        m_bitPlanes.skipmb.resize(size);
-        m_bitPlanes.directmb.resize(size);
-        m_bitPlanes.forwardmb.resize(size);
+        m_bitPlanes.assign((m_mbWidth * m_mbHeight + 1) >> 1, 0);
     }
 
-    bool Parser::decodeVLCTable(BitReader* br, uint16_t* out,
-        const VLCTable* table, uint32_t tableLen)
+    inline uint8_t Parser::getBitPlane(uint32_t idx, uint32_t bit) const
     {
-        uint32_t i = 0;
-        uint16_t numberOfBits = 0;
-        uint16_t codeWord = 0;
-        while (i < tableLen) {
-            if (numberOfBits != table[i].codeLength) {
-                numberOfBits = table[i].codeLength;
-                codeWord = br->peek(numberOfBits);
-            }
-            if (codeWord == table[i].codeWord) {
-                *out = i;
-                br->skip(numberOfBits);
-                break;
-            }
-            i++;
-        }
-        return (i < tableLen) ? true : false;
+        return (m_bitPlanes[idx >> 1] >> (bit + ((idx & 1) ? 0 : 4))) & 1;
+    }
+
+    inline void Parser::flipBitPlane(uint32_t idx, uint32_t bit)
+    {
+        m_bitPlanes[idx >> 1] ^= 1 << (bit + ((idx & 1) ? 0 : 4));
     }
 
     /* 8.7.3.6 Row-skip mode*/
-    void Parser::decodeRowskipMode(BitReader* br, uint8_t* data, uint32_t width, uint32_t height)
+    void Parser::decodeRowskipMode(BitReader* br, uint32_t bit,
+        uint32_t x, uint32_t y, uint32_t width, uint32_t height)
     {
-        uint32_t i, j;
-        for (j = 0; j < height; j++) {
-            if (br->read(1)) {
-                for (i = 0; i < width; i++)
-                    data[i] = br->read(1);
-            }
-            else {
-                memset(data, 0, width);
+        uint32_t i, j, k, n, bits, idx;
+        for (j = y; j < y + height; j++) {
+            if (!br->read(1))
+                continue;
+            idx = j * m_mbWidth + x;
+            for (i = 0; i < width; i += n) {
+                n = std::min(width - i, 24u);
+                bits = br->read(n);
+                for (k = 0; bits; k++, bits >>= 1) {
+                    if (bits & 1)
+                        flipBitPlane(idx + i + n - 1 - k, bit);
+                }
             }
-            data += m_mbWidth;
         }
     }
 
     /* 8.7.3.7 Column-skip mode*/
-    void Parser::decodeColskipMode(BitReader* br, uint8_t* data, uint32_t width, uint32_t height)
+    void Parser::decodeColskipMode(BitReader* br, uint32_t bit,
+        uint32_t x, uint32_t y, uint32_t width, uint32_t height)
     {
-        uint32_t i, j;
-        for (i = 0; i < width; i++) {
-            if (br->read(1)) {
-                for (j = 0; j < height; j++)
-                    data[j * m_mbWidth] = br->read(1);
-            }
-            else {
-                for (j = 0; j < height; j++)
-                    data[j * m_mbWidth] = 0;
+        uint32_t i, j, k, n, bits;
+        for (i = x; i < x + width; i++) {
+            if (!br->read(1))
+                continue;
+            for (j = 0; j < height; j += n) {
+                n = std::min(height - j, 24u);
+                bits = br->read(n);
+                for (k = 0; bits; k++, bits >>= 1) {
+                    if (bits & 1)
+                        flipBitPlane((y + j + n - 1 - k) * m_mbWidth + i, bit);
+                }
             }
-            data++;
         }
     }
 
     /* Table 80: Norm-2/Diff-2 Code Table */
-    bool Parser::decodeNorm2Mode(BitReader* br, uint8_t* data, uint32_t width, uint32_t height)
+    bool Parser::decodeNorm2Mode(BitReader* br, uint32_t bit)
     {
-        uint32_t i;
-        uint16_t temp;
-        uint8_t* out = data;
-        if ((height * width) & 1)
-            *out++ = br->read(1);
-        for (i = (height * width) & 1; i < height * width; i += 2) {
-            temp = br->read(1);
-            if (temp == 0) {
-                *out++ = 0;
-                *out++ = 0;
-            }
-            else {
-                temp = br->read(1);
-                if (temp == 1) {
-                    *out++ = 1;
-                    *out++ = 1;
-                }
-                else {
-                    temp = br->read(1);
-                    if (temp == 0) {
-                        *out++ = 1;
-                        *out++ = 0;
-                    }
-                    else {
-                        *out++ = 0;
-                        *out++ = 1;
-                    }
-                }
-            }
+        uint32_t i, code;
+        uint32_t count = m_mbWidth * m_mbHeight;
+        i = 0;
+        if (count & 1) {
+            if (br->read(1))
+                flipBitPlane(0, bit);
+            i = 1;
+        }
+        for (; i < count; i += 2) {
+            code = br->peek(3);
+            br->skip(Norm2LookupTable[code].length);
+            if (Norm2LookupTable[code].bits & 2)
+                flipBitPlane(i, bit);
+            if (Norm2LookupTable[code].bits & 1)
+                flipBitPlane(i + 1, bit);
         }
         return true;
     }
 
-    bool Parser::decodeNorm6Mode(BitReader* br, uint8_t* data, uint32_t width, uint32_t height)
+    /* Table 81: Code table for 3x2 and 2x3 tiles */
+    bool Parser::decodeNorm6Mode(BitReader* br, uint32_t bit)
     {
-        uint32_t i = 0, j = 0;
+        uint32_t i, j, k, v;
         uint16_t temp;
-        uint8_t* out = data;
+        uint32_t width = m_mbWidth;
+        uint32_t height = m_mbHeight;
         bool is2x3Tiled = (((width % 3) != 0) && ((height % 3) == 0));
-        if (is2x3Tiled) {
-            for (j = 0; j < height; j += 3) {
-                for (i = width & 1; i < width; i += 2) {
-                    if (!decodeVLCTable(br, &temp, Norm6VLCTable, 64))
-                        return false;
-                    out[i] = temp & 1;
-                    out[i + 1] = (temp & 2) >> 1;
-                    out[i + width] = (temp & 4) >> 2;
-                    out[i + width + 1] = (temp & 8) >> 3;
-                    out[i + width * 2] = (temp & 16) >> 4;
-                    out[i + width * 2 + 1] = (temp & 32) >> 5;
-                }
-                out += 3 * width;
-            }
-            if (width & 1)
-                decodeColskipMode(br, data, width & 1, height);
-        }
-        else {
-            out += (height & 1) * width;
-            for (j = height & 1; j < height; j += 2) {
-                for (i = width % 3; i < width; i += 3) {
-                    if (!decodeVLCTable(br, &temp, Norm6VLCTable, 64))
-                        return false;
-                    out[i] = temp & 1;
-                    out[i + 1] = (temp & 2) >> 1;
-                    out[i + 2] = (temp & 4) >> 2;
-                    out[i + width] = (temp & 8) >> 3;
-                    out[i + width + 1] = (temp & 16) >> 4;
-                    out[i + width + 2] = (temp & 32) >> 5;
+        /* macroblock offset of each symbol bit inside a tile */
+        const uint32_t tile2x3[6] = { 0, 1, width, width + 1, width * 2, width * 2 + 1 };
+        const uint32_t tile3x2[6] = { 0, 1, 2, width, width + 1, width + 2 };
+        const uint32_t* tile = is2x3Tiled ? tile2x3 : tile3x2;
+        uint32_t tileWidth = is2x3Tiled ? 2 : 3;
+        uint32_t tileHeight = is2x3Tiled ? 3 : 2;
+        /* macroblocks not covered by tiles are on the left and the top */
+        uint32_t x = width % tileWidth;
+        uint32_t y = is2x3Tiled ? 0 : (height & 1);
+
+        for (j = y; j < height; j += tileHeight) {
+            for (i = x; i < width; i += tileWidth) {
+                if (!Norm6Lookup.decode(br, &temp))
+                    return false;
+                for (k = 0, v = temp; v; k++, v >>= 1) {
+                    if (v & 1)
+                        flipBitPlane(j * width + i + tile[k], bit);
                 }
-                out += 2 * width;
             }
-            if (width % 3)
-                decodeColskipMode(br, data, width % 3, height);
-            if (height & 1)
-                decodeRowskipMode(br, data + (width % 3), width - (width % 3), height & 1);
         }
+        if (x)
+            decodeColskipMode(br, bit, 0, 0, x, height);
+        if (y)
+            decodeRowskipMode(br, bit, x, 0, width - x, y);
         return true;
     }
 
+    /* 8.7.1 INVERT, flip the plane bit of all nibbles a word at a time */
+    void Parser::invertBitPlane(uint32_t bit)
+    {
+        uint32_t i = 0;
+        uint64_t word;
+        const uint64_t mask = 0x1111111111111111ULL << bit;
+        uint32_t size = m_bitPlanes.size();
+        uint8_t* data = &m_bitPlanes[0];
+        for (; i + sizeof(word) <= size; i += sizeof(word)) {
+            memcpy(&word, data + i, sizeof(word));
+            word ^= mask;
+            memcpy(data + i, &word, sizeof(word));
+        }
+        for (; i < size; i++)
+            data[i] ^= static_cast<uint8_t>(mask);
+        /* keep the padding nibble of an odd macroblock count clean */
+        if ((m_mbWidth * m_mbHeight) & 1)
+            data[size - 1] &= ~(1 << bit);
+    }
+
     /* 8.7.3.8 Diff: Inverse differential decoding */
-    void Parser::inverseDiff(uint8_t* data, uint32_t width, uint32_t height, uint32_t invert)
+    void Parser::inverseDiff(uint32_t bit, uint32_t invert)
     {
-        uint32_t i, j;
-        for (j = 0; j < height; j++)
-            for (i = 0; i < width; i++) {
-                if ((i == 0) && (j == 0)) {
-                    data[j * width + i] ^= invert;
-                }
-                else if (i == 0) {
-                    data[j * width + i] ^= data[(j - 1) * width];
-                }
-                else if ((j > 0) && (data[(j - 1) * width + i] != data[j * width + i - 1])) {
-                    data[j * width + i] ^= invert;
-                }
-                else {
-                    data[j * width + i] ^= data[j * width + i - 1];
-                }
+        uint32_t i, j, idx = 0;
+        uint8_t pred, cur, left = 0;
+        for (j = 0; j < m_mbHeight; j++) {
+            for (i = 0; i < m_mbWidth; i++, idx++) {
+                cur = getBitPlane(idx, bit);
+                if (i == 0)
+                    pred = j ? getBitPlane(idx - m_mbWidth, bit) : invert;
+                else if (j && (getBitPlane(idx - m_mbWidth, bit) != left))
+                    pred = invert;
+                else
+                    pred = left;
+                if (pred)
+                    flipBitPlane(idx, bit);
+                left = cur ^ pred;
             }
+        }
     }
 
-    bool Parser::decodeBitPlane(BitReader* br, uint8_t* data, bool* isRaw)
+    bool Parser::decodeBitPlane(BitReader* br, uint32_t bit, bool* isRaw)
     {
-        uint32_t i, invert;
+        uint32_t invert;
         uint16_t mode;
+        bool ret = true;
         *isRaw = false;
         invert = br->read(1);
-        if (!decodeVLCTable(br, &mode, ImodeVLCTable, 7))
+        if (!ImodeLookup.decode(br, &mode))
             return false;
         if (mode == IMODE_RAW) {
             *isRaw = true;
             return true;
         }
         else if (mode == IMODE_NORM2) {
-            decodeNorm2Mode(br, data, m_mbWidth, m_mbHeight);
+            ret = decodeNorm2Mode(br, bit);
         }
         else if (mode == IMODE_NORM6) {
-            decodeNorm6Mode(br, data, m_mbWidth, m_mbHeight);
+            ret = decodeNorm6Mode(br, bit);
         }
         else if (mode == IMODE_DIFF2) {
-            decodeNorm2Mode(br, data, m_mbWidth, m_mbHeight);
-            inverseDiff(data, m_mbWidth, m_mbHeight, invert);
+            ret = decodeNorm2Mode(br, bit);
+            inverseDiff(bit, invert);
         }
         else if (mode == IMODE_DIFF6) {
-            decodeNorm6Mode(br, data, m_mbWidth, m_mbHeight);
-            inverseDiff(data, m_mbWidth, m_mbHeight, invert);
+            ret = decodeNorm6Mode(br, bit);
+            inverseDiff(bit, invert);
         }
         else if (mode == IMODE_ROWSKIP) {
-            decodeRowskipMode(br, data, m_mbWidth, m_mbHeight);
+            decodeRowskipMode(br, bit, 0, 0, m_mbWidth, m_mbHeight);
         }
         else if (mode == IMODE_COLSKIP) {
-            decodeColskipMode(br, data, m_mbWidth, m_mbHeight);
+            decodeColskipMode(br, bit, 0, 0, m_mbWidth, m_mbHeight);
         }
         /*8.7.1 INVERT*/
-        if ((mode != IMODE_DIFF2) && (mode != IMODE_DIFF6) && invert) {
-            for (i = 0; i < m_mbWidth * m_mbHeight; i++)
-                data[i] = !data[i];
-        }
-        return true;
+        if ((mode != IMODE_DIFF2) && (mode != IMODE_DIFF6) && invert)
+            invertBitPlane(bit);
+        return ret;
     }
 
     /*Table 24: VOPDQUANT in picture header(Refer to 7.1.1.31)*/
@@ -743,10 +785,10 @@ namespace VC1 {
             if (m_frameHdr.mv_mode == MVMODE_MIXED_MV
                 || (m_frameHdr.mv_mode == MVMODE_INTENSITY_COMPENSATION
                        && m_frameHdr.mv_mode2 == MVMODE_MIXED_MV)) {
-                if (!decodeBitPlane(br, &m_bitPlanes.mvtypemb[0], &m_frameHdr.mv_type_mb))
+                if (!decodeBitPlane(br, BITPLANE_MVTYPEMB, &m_frameHdr.mv_type_mb))
                     return false;
             }
-            if (!decodeBitPlane(br, &m_bitPlanes.skipmb[0], &m_frameHdr.skip_mb))
+            if (!decodeBitPlane(br, BITPLANE_SKIPMB, &m_frameHdr.skip_mb))
                 return false;
 
             m_frameHdr.mv_table = br->read(2);
@@ -764,9 +806,9 @@ namespace VC1 {
         }
         else if (m_frameHdr.picture_type == FRAME_B) {
             m_frameHdr.mv_mode = br->read(1);
-            if (!decodeBitPlane(br, &m_bitPlanes.directmb[0], &m_frameHdr.direct_mb))
+            if (!decodeBitPlane(br, BITPLANE_DIRECTMB, &m_frameHdr.direct_mb))
                 return false;
-            if (!decodeBitPlane(br, &m_bitPlanes.skipmb[0], &m_frameHdr.skip_mb))
+            if (!decodeBitPlane(br, BITPLANE_SKIPMB, &m_frameHdr.skip_mb))
                 return false;
             m_frameHdr.mv_table = br->read(2);
             m_frameHdr.cbp_table = br->read(2);
@@ -878,16 +920,16 @@ namespace VC1 {
         if ((m_frameHdr.picture_type == FRAME_I)
             || (m_frameHdr.picture_type == FRAME_BI)) {
             if (m_frameHdr.fcm == FRAME_INTERLACE) {
-                if (!decodeBitPlane(br, &m_bitPlanes.fieldtx[0], &m_frameHdr.fieldtx))
+                if (!decodeBitPlane(br, BITPLANE_FIELDTX, &m_frameHdr.fieldtx))
                     return false;
             }
-            if (!decodeBitPlane(br, &m_bitPlanes.acpred[0], &m_frameHdr.ac_pred))
+            if (!decodeBitPlane(br, BITPLANE_ACPRED, &m_frameHdr.ac_pred))
                 return false;
 
             if ((m_entryPointHdr.overlap == 1) && m_frameHdr.pquant <= 8) {
                 m_frameHdr.condover = getFirst01Bit(br, 0, 2);
                 if (m_frameHdr.condover == 2) {
-                    if (!decodeBitPlane(br, &m_bitPlanes.overflags[0], &m_frameHdr.overflags))
+                    if (!decodeBitPlane(br, BITPLANE_OVERFLAGS, &m_frameHdr.overflags))
                         return false;
                 }
             }
@@ -939,14 +981,14 @@ namespace VC1 {
                     if (m_frameHdr.mv_mode == MVMODE_MIXED_MV
                         || (m_frameHdr.mv_mode == MVMODE_INTENSITY_COMPENSATION
                                && m_frameHdr.mv_mode2 == MVMODE_MIXED_MV)) {
-                        if (!decodeBitPlane(br, &m_bitPlanes.mvtypemb[0], &m_frameHdr.mv_type_mb))
+                        if (!decodeBitPlane(br, BITPLANE_MVTYPEMB, &m_frameHdr.mv_type_mb))
                             return false;
                     }
                 }
             }
 
             if (m_frameHdr.fcm != FIELD_INTERLACE) {
-                if (!decodeBitPlane(br, &m_bitPlanes.skipmb[0], &m_frameHdr.skip_mb))
+                if (!decodeBitPlane(br, BITPLANE_SKIPMB, &m_frameHdr.skip_mb))
                     return false;
             }
 
@@ -992,13 +1034,13 @@ namespace VC1 {
                 m_frameHdr.mv_mode = br->read(1);
             }
             if (m_frameHdr.fcm == FIELD_INTERLACE) {
-                if (!decodeBitPlane(br, &m_bitPlanes.forwardmb[0], &m_frameHdr.forwardmb))
+                if (!decodeBitPlane(br, BITPLANE_FORWARDMB, &m_frameHdr.forwardmb))
                     return false;
             }
             else {
-                if (!decodeBitPlane(br, &m_bitPlanes.directmb[0], &m_frameHdr.direct_mb))
+                if (!decodeBitPlane(br, BITPLANE_DIRECTMB, &m_frameHdr.direct_mb))
                     return false;
-                if (!decodeBitPlane(br, &m_bitPlanes.skipmb[0], &m_frameHdr.skip_mb))
+                if (!decodeBitPlane(br, BITPLANE_SKIPMB, &m_frameHdr.skip_mb))
                     return false;
             }
             if (m_frameHdr.fcm != PROGRESSIVE) {
@@ -19,7 +19,7 @@
 
 #include <stdint.h>
 #include <stdlib.h>
-#include "bitReader.h"
+#include "nalReader.h"
 #include <vector>
 
 namespace YamiParser {
@@ -145,14 +145,16 @@ namespace VC1 {
         HrdParam hrd_param;
     };
 
-    struct BitPlanes {
-        std::vector<uint8_t> acpred;
-        std::vector<uint8_t> fieldtx;
-        std::vector<uint8_t> overflags;
-        std::vector<uint8_t> mvtypemb;
-        std::vector<uint8_t> skipmb;
-        std::vector<uint8_t> directmb;
-        std::vector<uint8_t> forwardmb;
+    /* bit of the packed bitplane nibble each bitplane is decoded to,
+       the layout of the va bitplane buffer for each picture type */
+    enum BitPlaneBit {
+        BITPLANE_FIELDTX = 0,
+        BITPLANE_ACPRED = 1,
+        BITPLANE_OVERFLAGS = 2,
+        BITPLANE_DIRECTMB = 0,
+        BITPLANE_SKIPMB = 1,
+        BITPLANE_MVTYPEMB = 2,
+        BITPLANE_FORWARDMB = 2
     };
 
     struct FrameHdr {
@@ -238,30 +240,35 @@ namespace VC1 {
         SeqHdr m_seqHdr;
         FrameHdr m_frameHdr;
         EntryPointHdr m_entryPointHdr;
-        BitPlanes m_bitPlanes;
+        /* one nibble per macroblock, the first macroblock of
+           each pair in the high nibble */
+        std::vector<uint8_t> m_bitPlanes;
         uint32_t m_mbWidth;
         uint32_t m_mbHeight;
 
     private:
-        void mallocBitPlanes();
+        void resetBitPlanes();
+        inline uint8_t getBitPlane(uint32_t, uint32_t) const;
+        inline void flipBitPlane(uint32_t, uint32_t);
         uint8_t getRefDist(BitReader*);
         int32_t getFirst01Bit(BitReader*, bool, uint32_t);
         uint8_t getMVMode(BitReader*, uint8_t, bool);
         int32_t searchStartCode(uint8_t*, uint32_t);
-        bool convertToRbdu(uint8_t*&, uint32_t&);
-        bool decodeVLCTable(BitReader*, uint16_t*, const VLCTable*, uint32_t);
-        void decodeRowskipMode(BitReader*, uint8_t*, uint32_t, uint32_t);
-        void decodeColskipMode(BitReader*, uint8_t*, uint32_t, uint32_t);
-        bool decodeNorm2Mode(BitReader*, uint8_t*, uint32_t, uint32_t);
-        bool decodeNorm6Mode(BitReader*, uint8_t*, uint32_t, uint32_t);
-        bool decodeBitPlane(BitReader*, uint8_t*, bool*);
-        void inverseDiff(uint8_t*, uint32_t, uint32_t, uint32_t);
+        bool searchFrameBdu(uint8_t*&, uint32_t&);
+        void decodeRowskipMode(BitReader*, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+        void decodeColskipMode(BitReader*, uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+        bool decodeNorm2Mode(BitReader*, uint32_t);
+        bool decodeNorm6Mode(BitReader*, uint32_t);
+        bool decodeBitPlane(BitReader*, uint32_t, bool*);
+        void invertBitPlane(uint32_t);
+        void inverseDiff(uint32_t, uint32_t);
         bool parseVopdquant(BitReader*, uint8_t);
         bool parseSequenceHeader(const uint8_t*, uint32_t);
         bool parseEntryPointHeader(const uint8_t*, uint32_t);
         bool parseFrameHeaderSimpleMain(BitReader*);
         bool parseFrameHeaderAdvanced(BitReader*);
-        std::vector<uint8_t> m_rbdu;
+
+        friend class VC1ParserTest;
     };
 }
 }
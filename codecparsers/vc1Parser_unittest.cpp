@@ -21,6 +21,7 @@
 #include "vc1Parser.h"
 
 // library headers
+#include "bitWriter.h"
 #include "common/unittest.h"
 
 // system headers
@@ -633,8 +634,40 @@ namespace VC1 {
             EXPECT_EQ(0x0, parser.m_frameHdr.intcompfield);
             EXPECT_EQ(0x14u, parser.m_frameHdr.macroblock_offset);
         }
+
+        /* decodes the bitplane written to bw for a width x height
+           macroblock picture into m_plane, one entry per macroblock */
+        bool decodeBitPlane(uint32_t width, uint32_t height, BitWriter& bw)
+        {
+            Parser parser;
+            bool isRaw;
+            parser.m_mbWidth = width;
+            parser.m_mbHeight = height;
+            parser.resetBitPlanes();
+            bw.writeToBytesAligned();
+            BitReader br(bw.getBitWriterData(), bw.getCodedBitsCount() >> 3);
+            bool ret = parser.decodeBitPlane(&br, BITPLANE_SKIPMB, &isRaw);
+            /* one nibble per macroblock, the first of each pair high */
+            m_plane.clear();
+            for (uint32_t i = 0; i < width * height; i++) {
+                uint8_t nibble = parser.m_bitPlanes[i >> 1] >> ((i & 1) ? 0 : 4);
+                m_plane.push_back((nibble >> BITPLANE_SKIPMB) & 1);
+                /* the other planes of the nibble are untouched */
+                EXPECT_EQ(0, nibble & ~(1 << BITPLANE_SKIPMB) & 0xf);
+            }
+            return ret;
+        }
+
+        template <size_t N>
+        void checkPlane(const uint8_t (&expected)[N])
+        {
+            EXPECT_EQ(std::vector<uint8_t>(expected, expected + N), m_plane);
+        }
+
+        std::vector<uint8_t> m_plane;
     };
 
+
 #define VC1_PARSER_TEST(name) TEST_F(VC1ParserTest, name)
 
     VC1_PARSER_TEST(ParseSequenceHeader)
@@ -665,5 +698,219 @@ namespace VC1 {
         checkParamsFrameHeader(parser);
     }
 
+    VC1_PARSER_TEST(DecodeBitPlaneNorm2)
+    {
+        /* odd macroblock count, the first one is coded on its own */
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x2, 2); /* IMODE NORM2 */
+        bw.writeBits(1, 1);
+        bw.writeBits(0x5, 3); /* 0 1 */
+        bw.writeBits(0x3, 2); /* 1 1 */
+        bw.writeBits(0, 1); /* 0 0 */
+        ASSERT_TRUE(decodeBitPlane(7, 1, bw));
+        const uint8_t plane[] = { 1, 0, 1, 1, 1, 0, 0 };
+        checkPlane(plane);
+
+        BitWriter inverted;
+        inverted.writeBits(1, 1); /* INVERT */
+        inverted.writeBits(0x2, 2); /* IMODE NORM2 */
+        inverted.writeBits(0x4, 3); /* 1 0 */
+        inverted.writeBits(0, 1); /* 0 0 */
+        ASSERT_TRUE(decodeBitPlane(2, 2, inverted));
+        const uint8_t invertedPlane[] = { 0, 1, 1, 1 };
+        checkPlane(invertedPlane);
+    }
+
+    VC1_PARSER_TEST(DecodeBitPlaneNorm6)
+    {
+        /* two 3x2 tiles */
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x3, 2); /* IMODE NORM6 */
+        bw.writeBits((2 << 5) | 7, 10); /* symbol 7, top row */
+        bw.writeBits((2 << 5) | 24, 10); /* symbol 56, bottom row */
+        ASSERT_TRUE(decodeBitPlane(6, 2, bw));
+        const uint8_t plane[] = {
+            1, 1, 1, 0, 0, 0,
+            0, 0, 0, 1, 1, 1
+        };
+        checkPlane(plane);
+    }
+
+    VC1_PARSER_TEST(DecodeBitPlaneNorm6Tiled2x3)
+    {
+        /* width is not a multiple of 3 but height is, 2x3 tiles */
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x3, 2); /* IMODE NORM6 */
+        bw.writeBits(2, 4); /* symbol 1 */
+        bw.writeBits(0x7, 6); /* symbol 63 */
+        ASSERT_TRUE(decodeBitPlane(4, 3, bw));
+        const uint8_t plane[] = {
+            1, 0, 1, 1,
+            0, 0, 1, 1,
+            0, 0, 1, 1
+        };
+        checkPlane(plane);
+    }
+
+    VC1_PARSER_TEST(DecodeBitPlaneNorm6Leftover)
+    {
+        /* 3x2 tiles, the column left of them is column-skip coded
+           and the row above them row-skip coded */
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x3, 2); /* IMODE NORM6 */
+        bw.writeBits(0x7, 6); /* symbol 63 */
+        bw.writeBits(1, 1); /* symbol 0 */
+        bw.writeBits(1, 1); /* column 0 coded */
+        bw.writeBits(0x9, 5);
+        bw.writeBits(1, 1); /* row 0 coded */
+        bw.writeBits(0x6, 3);
+        ASSERT_TRUE(decodeBitPlane(4, 5, bw));
+        const uint8_t plane[] = {
+            0, 1, 1, 0,
+            1, 1, 1, 1,
+            0, 1, 1, 1,
+            0, 0, 0, 0,
+            1, 0, 0, 0
+        };
+        checkPlane(plane);
+    }
+
+    VC1_PARSER_TEST(DecodeBitPlaneNorm6Invalid)
+    {
+        /* 00010 00000 is not in Table 81 */
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x3, 2); /* IMODE NORM6 */
+        bw.writeBits(2 << 5, 10);
+        bw.writeBits(0, 16);
+        EXPECT_FALSE(decodeBitPlane(3, 2, bw));
+    }
+
+    VC1_PARSER_TEST(DecodeBitPlaneNorm6Truncated)
+    {
+        /* the data ends inside the first code, the zeros read past
+           the end must not decode as symbol 3 */
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x3, 2); /* IMODE NORM6 */
+        bw.writeBits(0, 5);
+        EXPECT_FALSE(decodeBitPlane(3, 2, bw));
+
+        /* a code close to the end of the data still decodes */
+        BitWriter last;
+        last.writeBits(0, 1); /* INVERT */
+        last.writeBits(0x3, 2); /* IMODE NORM6 */
+        last.writeBits(0x7, 6); /* symbol 63 */
+        ASSERT_TRUE(decodeBitPlane(3, 2, last));
+        const uint8_t plane[] = {
+            1, 1, 1,
+            1, 1, 1
+        };
+        checkPlane(plane);
+    }
+
+    VC1_PARSER_TEST(DecodeBitPlaneDiff2)
+    {
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x1, 3); /* IMODE DIFF2 */
+        bw.writeBits(0x4, 3); /* 1 0 */
+        bw.writeBits(0x5, 3); /* 0 1 */
+        ASSERT_TRUE(decodeBitPlane(2, 2, bw));
+        const uint8_t plane[] = { 1, 1, 1, 0 };
+        checkPlane(plane);
+
+        /* INVERT is the prediction of the first macroblock and of
+           the ones with differing neighbours, the plane is not inverted */
+        BitWriter inverted;
+        inverted.writeBits(1, 1); /* INVERT */
+        inverted.writeBits(0x1, 3); /* IMODE DIFF2 */
+        inverted.writeBits(0x4, 3); /* 1 0 */
+        inverted.writeBits(0x5, 3); /* 0 1 */
+        ASSERT_TRUE(decodeBitPlane(2, 2, inverted));
+        const uint8_t invertedPlane[] = { 0, 0, 0, 1 };
+        checkPlane(invertedPlane);
+    }
+
+    VC1_PARSER_TEST(DecodeBitPlaneDiff6)
+    {
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x1, 4); /* IMODE DIFF6 */
+        bw.writeBits((2 << 5) | 7, 10); /* symbol 7, top row */
+        ASSERT_TRUE(decodeBitPlane(3, 2, bw));
+        const uint8_t plane[] = {
+            1, 0, 1,
+            1, 0, 0
+        };
+        checkPlane(plane);
+    }
+
+    VC1_PARSER_TEST(DecodeBitPlaneRowskip)
+    {
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x2, 3); /* IMODE ROWSKIP */
+        bw.writeBits(0, 1); /* row 0 skipped */
+        bw.writeBits(1, 1); /* row 1 coded */
+        bw.writeBits(0x5, 3);
+        ASSERT_TRUE(decodeBitPlane(3, 2, bw));
+        const uint8_t plane[] = {
+            0, 0, 0,
+            1, 0, 1
+        };
+        checkPlane(plane);
+
+        BitWriter inverted;
+        inverted.writeBits(1, 1); /* INVERT */
+        inverted.writeBits(0x2, 3); /* IMODE ROWSKIP */
+        inverted.writeBits(0, 1); /* row 0 skipped */
+        inverted.writeBits(1, 1); /* row 1 coded */
+        inverted.writeBits(0x5, 3);
+        ASSERT_TRUE(decodeBitPlane(3, 2, inverted));
+        const uint8_t invertedPlane[] = {
+            1, 1, 1,
+            0, 1, 0
+        };
+        checkPlane(invertedPlane);
+    }
+
+    VC1_PARSER_TEST(DecodeBitPlaneRowskipWide)
+    {
+        /* rows wider than 24 macroblocks are read in pieces */
+        const uint32_t width = 30;
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x2, 3); /* IMODE ROWSKIP */
+        bw.writeBits(1, 1); /* row 0 coded */
+        bw.writeBits(0x800001, 24);
+        bw.writeBits(0x21, 6);
+        ASSERT_TRUE(decodeBitPlane(width, 1, bw));
+        std::vector<uint8_t> plane(width, 0);
+        plane[0] = plane[23] = plane[24] = plane[29] = 1;
+        EXPECT_EQ(plane, m_plane);
+    }
+
+    VC1_PARSER_TEST(DecodeBitPlaneColskip)
+    {
+        BitWriter bw;
+        bw.writeBits(0, 1); /* INVERT */
+        bw.writeBits(0x3, 3); /* IMODE COLSKIP */
+        bw.writeBits(1, 1); /* column 0 coded */
+        bw.writeBits(0x6, 3);
+        bw.writeBits(0, 1); /* column 1 skipped */
+        ASSERT_TRUE(decodeBitPlane(2, 3, bw));
+        const uint8_t plane[] = {
+            1, 0,
+            1, 0,
+            0, 0
+        };
+        checkPlane(plane);
+    }
+
 } // namespace VC1
 } // namespace YamiParser
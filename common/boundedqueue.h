@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef boundedqueue_h
+#define boundedqueue_h
+
+#include "common/condition.h"
+#include "common/lock.h"
+#include <deque>
+
+namespace YamiMediaCodec{
+
+/**
+ * fifo between two threads, push() blocks while it is full and pop() while
+ * it is empty. close() releases both sides, pop() still drains what is left.
+ */
+template <class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity)
+        : m_capacity(capacity ? capacity : 1)
+        , m_maxSize(0)
+        , m_closed(false)
+        , m_cond(m_lock)
+    {
+    }
+
+    bool push(const T& item)
+    {
+        AutoLock l(m_lock);
+        while (!m_closed && m_items.size() >= m_capacity)
+            m_cond.wait();
+        if (m_closed)
+            return false;
+        m_items.push_back(item);
+        if (m_items.size() > m_maxSize)
+            m_maxSize = m_items.size();
+        m_cond.broadcast();
+        return true;
+    }
+
+    bool pop(T& item)
+    {
+        AutoLock l(m_lock);
+        while (!m_closed && m_items.empty())
+            m_cond.wait();
+        if (m_items.empty())
+            return false;
+        item = m_items.front();
+        m_items.pop_front();
+        m_cond.broadcast();
+        return true;
+    }
+
+    void close()
+    {
+        AutoLock l(m_lock);
+        m_closed = true;
+        m_cond.broadcast();
+    }
+
+    void clear()
+    {
+        AutoLock l(m_lock);
+        m_items.clear();
+        m_cond.broadcast();
+    }
+
+    size_t size()
+    {
+        AutoLock l(m_lock);
+        return m_items.size();
+    }
+
+    size_t maxSize()
+    {
+        AutoLock l(m_lock);
+        return m_maxSize;
+    }
+
+    size_t capacity() const { return m_capacity; }
+
+private:
+    const size_t m_capacity;
+    size_t m_maxSize;
+    bool m_closed;
+    std::deque<T> m_items;
+    Lock m_lock;
+    Condition m_cond;
+    DISALLOW_COPY_AND_ASSIGN(BoundedQueue);
+};
+
+} //namespace YamiMediaCodec
+
+#endif //boundedqueue_h
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// primary header
+#include "boundedqueue.h"
+
+// library headers
+#include "common/unittest.h"
+
+// system headers
+#include <pthread.h>
+
+#define BOUNDEDQUEUE_TEST(name) \
+    TEST(BoundedQueueTest, name)
+
+using namespace YamiMediaCodec;
+
+static void* pushFrom(void* arg)
+{
+    BoundedQueue<int>* queue = static_cast<BoundedQueue<int>*>(arg);
+    for (int i = 0; i < 100; i++) {
+        if (!queue->push(i))
+            break;
+    }
+    queue->close();
+    return NULL;
+}
+
+BOUNDEDQUEUE_TEST(Fifo) {
+    BoundedQueue<int> queue(3);
+    EXPECT_EQ(3u, queue.capacity());
+    EXPECT_TRUE(queue.push(1));
+    EXPECT_TRUE(queue.push(2));
+    EXPECT_EQ(2u, queue.size());
+
+    int item;
+    EXPECT_TRUE(queue.pop(item));
+    EXPECT_EQ(1, item);
+    EXPECT_TRUE(queue.pop(item));
+    EXPECT_EQ(2, item);
+    EXPECT_EQ(0u, queue.size());
+    EXPECT_EQ(2u, queue.maxSize());
+}
+
+BOUNDEDQUEUE_TEST(Close) {
+    BoundedQueue<int> queue(2);
+    EXPECT_TRUE(queue.push(1));
+    queue.close();
+    EXPECT_FALSE(queue.push(2));
+
+    //what was queued before close is still handed out
+    int item;
+    EXPECT_TRUE(queue.pop(item));
+    EXPECT_EQ(1, item);
+    EXPECT_FALSE(queue.pop(item));
+}
+
+BOUNDEDQUEUE_TEST(Backpressure) {
+    BoundedQueue<int> queue(2);
+    pthread_t thread;
+    ASSERT_EQ(0, pthread_create(&thread, NULL, pushFrom, &queue));
+
+    int item;
+    int expected = 0;
+    while (queue.pop(item)) {
+        EXPECT_EQ(expected, item);
+        expected++;
+    }
+    pthread_join(thread, NULL);
+    EXPECT_EQ(100, expected);
+    EXPECT_GE(2u, queue.maxSize());
+}
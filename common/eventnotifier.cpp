@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "eventnotifier.h"
+
+#include "common/log.h"
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace YamiMediaCodec{
+
+EventNotifier::EventNotifier()
+    : m_fd(-1)
+{
+}
+
+EventNotifier::~EventNotifier()
+{
+    if (m_fd >= 0)
+        ::close(m_fd);
+}
+
+int EventNotifier::fd()
+{
+    AutoLock lock(m_lock);
+    if (m_fd < 0) {
+        m_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_fd < 0)
+            ERROR("create eventfd failed");
+    }
+    return m_fd;
+}
+
+void EventNotifier::notify()
+{
+    AutoLock lock(m_lock);
+    if (m_fd < 0)
+        return;
+    uint64_t one = 1;
+    //only fails when the counter would overflow, it is readable anyway
+    if (write(m_fd, &one, sizeof(one)) != sizeof(one)) {
+        DEBUG("eventfd write failed");
+    }
+}
+
+};
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef eventnotifier_h
+#define eventnotifier_h
+
+#include "common/lock.h"
+
+namespace YamiMediaCodec{
+
+/*
+ * An eventfd that becomes readable when something happened, for clients
+ * running an epoll loop instead of polling. The fd is created by the first
+ * fd() call, notify() costs nothing before that. The client reads the fd
+ * to clear it and then drains whatever it waits for until that is empty.
+ */
+class EventNotifier
+{
+public:
+    EventNotifier();
+    ~EventNotifier();
+
+    /// -1 if eventfd is not supported
+    int fd();
+    void notify();
+
+private:
+    Lock m_lock;
+    int m_fd;
+    DISALLOW_COPY_AND_ASSIGN(EventNotifier);
+};
+
+};
+
+#endif
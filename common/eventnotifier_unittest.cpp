@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// primary header
+#include "eventnotifier.h"
+
+// library headers
+#include "common/unittest.h"
+
+// system headers
+#include <poll.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#define EVENTNOTIFIER_TEST(name) \
+    TEST(EventNotifierTest, name)
+
+using namespace YamiMediaCodec;
+
+static bool readable(int fd)
+{
+    struct pollfd p;
+    p.fd = fd;
+    p.events = POLLIN;
+    p.revents = 0;
+    return poll(&p, 1, 0) == 1 && (p.revents & POLLIN);
+}
+
+EVENTNOTIFIER_TEST(NotifyAndClear)
+{
+    EventNotifier notifier;
+    //nothing to do before anyone asked for the fd
+    notifier.notify();
+
+    int fd = notifier.fd();
+    ASSERT_LE(0, fd);
+    EXPECT_EQ(fd, notifier.fd());
+    EXPECT_FALSE(readable(fd));
+
+    notifier.notify();
+    notifier.notify();
+    EXPECT_TRUE(readable(fd));
+
+    uint64_t count = 0;
+    EXPECT_EQ((ssize_t)sizeof(count), read(fd, &count, sizeof(count)));
+    EXPECT_EQ(2u, count);
+    EXPECT_FALSE(readable(fd));
+}
@@ -29,6 +29,7 @@
 #include <ctype.h>
 #include <string.h>
 #include <sys/time.h>
+#include <time.h>
 #include <va/va.h>
 
 namespace YamiMediaCodec{
@@ -178,6 +179,24 @@ uint64_t getSystemTime()
     return tv.tv_usec/1000+tv.tv_sec*1000;
 }
 
+/// return a monotonic clock in us, for measuring intervals
+uint64_t getMonotonicTimeUs()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_MONOTONIC, &ts))
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/// return the cpu time of the process in us
+uint64_t getProcessTimeUs()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts))
+        return 0;
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 double  getFps(uint64_t current, uint64_t start, int frames)
 {
     uint64_t sysTime = current - start;
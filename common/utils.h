@@ -35,6 +35,15 @@ bool getPlaneResolution(uint32_t fourcc, uint32_t pixelWidth, uint32_t pixelHeig
 
 bool fillFrameRawData(VideoFrameRawData* frame, uint32_t fourcc, uint32_t width, uint32_t height, uint8_t* data);
 
+/// return system clock in ms
+uint64_t getSystemTime();
+
+/// return a monotonic clock in us, for measuring intervals
+uint64_t getMonotonicTimeUs();
+
+/// return the cpu time of the process in us
+uint64_t getProcessTimeUs();
+
 class CalcFps
 {
   public:
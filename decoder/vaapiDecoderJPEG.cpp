@@ -22,16 +22,23 @@
 #include "vaapiDecoderJPEG.h"
 
 // library headers
+#include "codecparsers/jpegCoefficientDecoder.h"
 #include "codecparsers/jpegParser.h"
 #include "common/common_def.h"
+#include "vaapi/VaapiUtils.h"
+#include "vaapi/vaapidisplay.h"
 #include "vaapidecoder_factory.h"
 
 // system headers
+#include <algorithm>
 #include <cassert>
 #include <tr1/array>
 #include <tr1/functional>
 #include <tr1/memory>
+#include <vector>
 
+using ::YamiParser::JPEG::CoefficientDecoder;
+using ::YamiParser::JPEG::CoefficientPlane;
 using ::YamiParser::JPEG::Component;
 using ::YamiParser::JPEG::FrameHeader;
 using ::YamiParser::JPEG::HuffTable;
@@ -40,6 +47,8 @@ using ::YamiParser::JPEG::Parser;
 using ::YamiParser::JPEG::QuantTable;
 using ::YamiParser::JPEG::QuantTables;
 using ::YamiParser::JPEG::ScanHeader;
+using ::YamiParser::JPEG::ScanIndex;
+using ::YamiParser::JPEG::Segment;
 using ::YamiParser::JPEG::Defaults;
 using ::std::tr1::function;
 using ::std::tr1::bind;
@@ -47,13 +56,12 @@ using ::std::tr1::ref;
 
 namespace YamiMediaCodec {
 
-struct Slice {
-    Slice() : data(NULL), start(0) , length(0) { }
+//restart intervals are grouped into at most this many slices per scan
+#define JPEG_MAX_SLICES 64
 
-    const uint8_t* data;
-    uint32_t start;
-    uint32_t length;
-};
+//64 bit FNV-1a, used to spot headers that repeat from frame to frame
+#define JPEG_HASH_BASIS 0xcbf29ce484222325ULL
+#define JPEG_HASH_PRIME 0x100000001b3ULL
 
 class VaapiDecoderJPEG::Impl
 {
@@ -67,7 +75,15 @@ public:
         , m_dcHuffmanTables(Defaults::instance().dcHuffTables())
         , m_acHuffmanTables(Defaults::instance().acHuffTables())
         , m_quantizationTables(Defaults::instance().quantTables())
-        , m_slice()
+        , m_data(NULL)
+        , m_coefficients()
+        , m_software(false)
+        , m_started(false)
+        , m_frameHash(JPEG_HASH_BASIS)
+        , m_quantHash(JPEG_HASH_BASIS)
+        , m_huffHash(JPEG_HASH_BASIS)
+        , m_newQuant(true)
+        , m_newHuff(true)
         , m_decodeStatus(YAMI_SUCCESS)
     {
     }
@@ -85,7 +101,7 @@ public:
          * we are continuing after previously suspending due to an SOF
          * YAMI_DECODE_FORMAT_CHANGE.
          */
-        if (m_slice.data != data)
+        if (m_data != data)
             m_parser.reset();
 
         if (!m_parser) { /* First call or new data */
@@ -93,7 +109,7 @@ public:
                 bind(&Impl::onMarker, ref(*this));
             Parser::Callback sofCallback =
                 bind(&Impl::onStartOfFrame, ref(*this));
-            m_slice.data = data;
+            m_data = data;
             m_parser.reset(new Parser(data, size));
             m_parser->registerCallback(M_SOI, defaultCallback);
             m_parser->registerCallback(M_EOI, defaultCallback);
@@ -127,9 +143,62 @@ public:
     const HuffTables& dcHuffmanTables() const { return m_dcHuffmanTables; }
     const HuffTables& acHuffmanTables() const { return m_acHuffmanTables; }
     const QuantTables& quantTables() const { return m_quantizationTables; }
-    const Slice& slice() const { return m_slice; }
+    const ScanIndex& scanIndex() const { return m_parser->scanIndex(); }
+    const uint8_t* data() const { return m_data; }
+
+    /**
+     * @return true if the scans of the current frame were entropy decoded
+     * into coefficients() rather than left for the hardware
+     */
+    bool software() const { return m_software; }
+    const CoefficientDecoder& coefficients() const { return m_coefficients; }
+
+    /**
+     * Hashes of the SOF segment of the current frame and of the DQT and
+     * DHT segments the current tables were parsed from.  A frame without
+     * DQT or DHT keeps the tables, and so the hash, of the one before.
+     */
+    uint64_t frameHash() const { return m_frameHash; }
+    uint64_t quantHash() const { return m_quantHash; }
+    uint64_t huffHash() const { return m_huffHash; }
 
 private:
+    /*
+     * The VA-API JPEG profile is baseline only and takes the picture as a
+     * single scan.  Everything else (progressive and extended frames and
+     * frames split into several scans) is entropy decoded here, one scan at
+     * a time, as the parser reaches it.
+     */
+    bool decodeScan()
+    {
+        const FrameHeader::Shared& frame = m_parser->frameHeader();
+        const ScanHeader::Shared& scan = m_parser->scanHeader();
+
+        if (!m_software) {
+            if (frame->isBaseline
+                && scan->numComponents == frame->components.size())
+                return true;
+            m_software = true;
+            if (!m_coefficients.start(frame))
+                return false;
+        }
+
+        return m_coefficients.decodeScan(scan, m_dcHuffmanTables,
+            m_acHuffmanTables, m_parser->restartInterval(), m_data,
+            m_parser->scanIndex());
+    }
+
+    uint64_t hashSegment(uint64_t hash) const
+    {
+        const Segment& segment = m_parser->current();
+        const uint8_t* p = m_data + segment.position;
+        const uint8_t* end = p + 1 + segment.length;
+
+        for (; p < end; ++p)
+            hash = (hash ^ *p) * JPEG_HASH_PRIME;
+        return hash;
+    }
+
     Parser::CallbackResult onMarker()
     {
         using namespace ::YamiParser::JPEG;
@@ -138,23 +207,27 @@ private:
 
         switch(m_parser->current().marker) {
         case M_SOI:
-            m_slice.start = 0;
-            m_slice.length = 0;
+            m_software = false;
+            m_newQuant = true;
+            m_newHuff = true;
             break;
         case M_SOS:
-            m_slice.start = m_parser->current().position + 1
-                + m_parser->current().length;
+            if (!decodeScan())
+                m_decodeStatus = YAMI_FAIL;
             break;
         case M_EOI:
-            m_slice.length = m_parser->current().position - m_slice.start;
             m_decodeStatus = m_finishHandler();
             break;
         case M_DQT:
             m_quantizationTables = m_parser->quantTables();
+            m_quantHash = hashSegment(m_newQuant ? JPEG_HASH_BASIS : m_quantHash);
+            m_newQuant = false;
             break;
         case M_DHT:
             m_dcHuffmanTables = m_parser->dcHuffTables();
             m_acHuffmanTables = m_parser->acHuffTables();
+            m_huffHash = hashSegment(m_newHuff ? JPEG_HASH_BASIS : m_huffHash);
+            m_newHuff = false;
             break;
         default:
             m_decodeStatus = YAMI_FAIL;
@@ -167,7 +240,20 @@ private:
 
     Parser::CallbackResult onStartOfFrame()
     {
+        /*
+         * MJPEG streams repeat the same SOF on every frame, only a frame
+         * header that really changed needs to go through start().
+         */
+        const uint64_t hash = hashSegment(JPEG_HASH_BASIS);
+        if (m_started && hash == m_frameHash) {
+            m_decodeStatus = YAMI_SUCCESS;
+            return Parser::ParseContinue;
+        }
+
         m_decodeStatus = m_startHandler();
+        m_started = m_decodeStatus == YAMI_SUCCESS
+            || m_decodeStatus == YAMI_DECODE_FORMAT_CHANGE;
+        m_frameHash = hash;
         if (m_decodeStatus != YAMI_SUCCESS)
             return Parser::ParseSuspend;
         return Parser::ParseContinue;
@@ -181,7 +267,17 @@ private:
     HuffTables m_acHuffmanTables;
     QuantTables m_quantizationTables;
 
-    Slice m_slice;
+    const uint8_t* m_data;
+
+    CoefficientDecoder m_coefficients;
+    bool m_software;
+
+    bool m_started; // start() accepted the frame header hashed in m_frameHash
+    uint64_t m_frameHash;
+    uint64_t m_quantHash;
+    uint64_t m_huffHash;
+    bool m_newQuant; // no DQT parsed yet in the current frame
+    bool m_newHuff; // no DHT parsed yet in the current frame
 
     YamiStatus m_decodeStatus;
 };
@@ -190,6 +286,9 @@ VaapiDecoderJPEG::VaapiDecoderJPEG()
     : VaapiDecoderBase::VaapiDecoderBase()
     , m_impl()
     , m_picture()
+    , m_pictureHash(0)
+    , m_iqMatrixHash(0)
+    , m_hufTableHash(0)
 {
     return;
 }
@@ -197,6 +296,10 @@ VaapiDecoderJPEG::VaapiDecoderJPEG()
 YamiStatus VaapiDecoderJPEG::fillPictureParam()
 {
     const FrameHeader::Shared frame = m_impl->frameHeader();
+    const uint64_t hash = m_impl->frameHash();
+
+    if (m_pictureParam && m_pictureHash == hash)
+        return m_picture->setPicture(m_pictureParam) ? YAMI_SUCCESS : YAMI_FAIL;
 
     const size_t numComponents = frame->components.size();
 
@@ -221,6 +324,9 @@ YamiStatus VaapiDecoderJPEG::fillPictureParam()
     vaPicParam->picture_height = frame->imageHeight;
     vaPicParam->num_components = frame->components.size();
 
+    m_pictureParam = m_picture->getPicture();
+    m_pictureHash = hash;
+
     return YAMI_SUCCESS;
 }
 
@@ -228,25 +334,8 @@ YamiStatus VaapiDecoderJPEG::fillSliceParam()
 {
     const ScanHeader::Shared scan = m_impl->scanHeader();
     const FrameHeader::Shared frame = m_impl->frameHeader();
-    const Slice& slice = m_impl->slice();
-    VASliceParameterBufferJPEGBaseline *sliceParam(NULL);
-
-    if (!m_picture->newSlice(sliceParam, slice.data + slice.start, slice.length))
-        return YAMI_FAIL;
-
-    for (size_t i(0); i < scan->numComponents; ++i) {
-        sliceParam->components[i].component_selector =
-            scan->components[i]->id;
-        sliceParam->components[i].dc_table_selector =
-            scan->components[i]->dcTableNumber;
-        sliceParam->components[i].ac_table_selector =
-            scan->components[i]->acTableNumber;
-    }
-
-    sliceParam->restart_interval = m_impl->restartInterval();
-    sliceParam->num_components = scan->numComponents;
-    sliceParam->slice_horizontal_position = 0;
-    sliceParam->slice_vertical_position = 0;
+    const ScanIndex& index = m_impl->scanIndex();
+    const unsigned restartInterval = m_impl->restartInterval();
 
     int width = frame->imageWidth;
     int height = frame->imageHeight;
@@ -270,7 +359,51 @@ YamiStatus VaapiDecoderJPEG::fillSliceParam()
         codedHeight = (height + maxVSample - 1) / maxVSample;
     }
 
-    sliceParam->num_mcus = codedWidth * codedHeight;
+    const uint32_t numMcus = codedWidth * codedHeight;
+    const size_t numIntervals = index.numIntervals();
+
+    /*
+     * Split the scan at its restart markers when they agree with the DRI,
+     * otherwise hand it over whole and let the driver resynchronize.
+     */
+    size_t perSlice = numIntervals;
+    if (numIntervals > 1) {
+        if (restartInterval
+            && numIntervals == (numMcus + restartInterval - 1) / restartInterval) {
+            perSlice = (numIntervals + JPEG_MAX_SLICES - 1) / JPEG_MAX_SLICES;
+        } else {
+            WARNING("%u restart markers for %u mcus with interval %u",
+                (uint32_t)index.restarts.size(), numMcus, restartInterval);
+        }
+    }
+
+    for (size_t first(0); first < numIntervals; first += perSlice) {
+        const size_t last = std::min(first + perSlice, numIntervals) - 1;
+        const uint32_t start = index.intervalStart(first);
+        const uint32_t end = index.intervalEnd(last);
+        const uint32_t firstMcu = first * restartInterval;
+        const uint32_t endMcu = last + 1 == numIntervals
+            ? numMcus : (last + 1) * restartInterval;
+        VASliceParameterBufferJPEGBaseline *sliceParam(NULL);
+
+        if (!m_picture->newSlice(sliceParam, m_impl->data() + start, end - start))
+            return YAMI_FAIL;
+
+        for (size_t i(0); i < scan->numComponents; ++i) {
+            sliceParam->components[i].component_selector =
+                scan->components[i]->id;
+            sliceParam->components[i].dc_table_selector =
+                scan->components[i]->dcTableNumber;
+            sliceParam->components[i].ac_table_selector =
+                scan->components[i]->acTableNumber;
+        }
+
+        sliceParam->restart_interval = restartInterval;
+        sliceParam->num_components = scan->numComponents;
+        sliceParam->slice_horizontal_position = first ? firstMcu % codedWidth : 0;
+        sliceParam->slice_vertical_position = first ? firstMcu / codedWidth : 0;
+        sliceParam->num_mcus = endMcu - firstMcu;
+    }
 
     return YAMI_SUCCESS;
 }
@@ -279,6 +412,11 @@ YamiStatus VaapiDecoderJPEG::loadQuantizationTables()
 {
     using namespace ::YamiParser::JPEG;
 
+    const uint64_t hash = m_impl->quantHash();
+
+    if (m_iqMatrix && m_iqMatrixHash == hash)
+        return m_picture->setIqMatrix(m_iqMatrix) ? YAMI_SUCCESS : YAMI_FAIL;
+
     VAIQMatrixBufferJPEGBaseline* vaIqMatrix(NULL);
 
     if (!m_picture->editIqMatrix(vaIqMatrix))
@@ -297,6 +435,9 @@ YamiStatus VaapiDecoderJPEG::loadQuantizationTables()
             vaIqMatrix->quantiser_table[i][j] = quantTable->values[j];
     }
 
+    m_iqMatrix = m_picture->getIqMatrix();
+    m_iqMatrixHash = hash;
+
     return YAMI_SUCCESS;
 }
 
@@ -304,6 +445,11 @@ YamiStatus VaapiDecoderJPEG::loadHuffmanTables()
 {
     using namespace ::YamiParser::JPEG;
 
+    const uint64_t hash = m_impl->huffHash();
+
+    if (m_hufTable && m_hufTableHash == hash)
+        return m_picture->setHufTable(m_hufTable) ? YAMI_SUCCESS : YAMI_FAIL;
+
     VAHuffmanTableBufferJPEGBaseline* vaHuffmanTable(NULL);
 
     if (!m_picture->editHufTable(vaHuffmanTable))
@@ -340,6 +486,9 @@ YamiStatus VaapiDecoderJPEG::loadHuffmanTables()
                 0, sizeof(vaHuffmanTable->huffman_table[i].pad));
     }
 
+    m_hufTable = m_picture->getHufTable();
+    m_hufTableHash = hash;
+
     return YAMI_SUCCESS;
 }
 
@@ -349,6 +498,7 @@ YamiStatus VaapiDecoderJPEG::decode(VideoDecodeBuffer* buffer)
         return YAMI_FAIL;
 
     m_currentPTS = buffer->timeStamp;
+    m_currentDecodeOnly = buffer->flag & WANT_DECODE_ONLY;
 
     if (!m_impl.get())
         m_impl.reset(new VaapiDecoderJPEG::Impl(
@@ -363,7 +513,7 @@ YamiStatus VaapiDecoderJPEG::start(VideoConfigBuffer* buffer)
     DEBUG("%s", __func__);
 
     m_configBuffer = *buffer;
-    m_configBuffer.surfaceNumber = 2;
+    m_configBuffer.surfaceNumber = JPEG_SURFACE_NUMBER;
     m_configBuffer.profile = VAProfileJPEGBaseline;
 
     /* We can't start until decoding has started */
@@ -381,11 +531,24 @@ YamiStatus VaapiDecoderJPEG::start(VideoConfigBuffer* buffer)
     if (!frame)
         return YAMI_FAIL;
 
-    if (!frame->isBaseline) {
-        ERROR("Unsupported JPEG profile. Only JPEG Baseline is supported.");
+    if (frame->isArithmetic || frame->dataPrecision != 8) {
+        ERROR("Unsupported JPEG profile. Only 8 bit Huffman coding is supported.");
         return YAMI_FAIL;
     }
 
+    /* a new frame header of the same size keeps the context and surfaces */
+    if (m_VAStarted) {
+        if (m_videoFormatInfo.width == frame->imageWidth
+            && m_videoFormatInfo.height == frame->imageHeight)
+            return YAMI_SUCCESS;
+        INFO("frame size changed from %d x %d to %d x %d",
+            m_videoFormatInfo.width, m_videoFormatInfo.height,
+            frame->imageWidth, frame->imageHeight);
+        dropBuffers();
+        if (VaapiDecoderBase::terminateVA() != YAMI_SUCCESS)
+            return YAMI_FAIL;
+    }
+
     m_configBuffer.width = frame->imageWidth;
     m_configBuffer.height = frame->imageHeight;
     m_configBuffer.surfaceWidth = frame->imageWidth;
@@ -418,6 +581,9 @@ YamiStatus VaapiDecoderJPEG::finish()
 
     m_picture->m_timeStamp = m_currentPTS;
 
+    if (m_impl->software())
+        return finishSoftware();
+
     YamiStatus status;
 
     status = fillSliceParam();
@@ -455,6 +621,96 @@ YamiStatus VaapiDecoderJPEG::finish()
     return YAMI_SUCCESS;
 }
 
+YamiStatus VaapiDecoderJPEG::finishSoftware()
+{
+    const FrameHeader::Shared frame = m_impl->frameHeader();
+    const CoefficientDecoder& coefficients = m_impl->coefficients();
+    const size_t numComponents = coefficients.numPlanes();
+
+    if (numComponents != 1 && numComponents != 3) {
+        ERROR("Unsupported number of JPEG components: %u", (uint32_t)numComponents);
+        return YAMI_FAIL;
+    }
+
+    const Component::Shared& luma = frame->components[0];
+    if (luma->hSampleFactor != frame->maxHSampleFactor
+        || luma->vSampleFactor != frame->maxVSampleFactor) {
+        ERROR("Unsupported JPEG sampling, the first component is subsampled");
+        return YAMI_FAIL;
+    }
+
+    /* inverse transform the chroma first, to resample it into the surface */
+    std::vector<uint8_t> chroma[2];
+    for (size_t i(1); i < numComponents; ++i) {
+        const CoefficientPlane& plane = coefficients.plane(i);
+        chroma[i - 1].resize(plane.width * plane.height);
+        if (!coefficients.idct(i, m_impl->quantTables(), &chroma[i - 1][0], plane.width))
+            return YAMI_FAIL;
+    }
+
+    VAImage image;
+    VADisplay display = m_display->getID();
+    uint8_t* dest = mapSurfaceToImage(display, m_picture->getSurfaceID(), image);
+    if (!dest) {
+        ERROR("map image failed");
+        return YAMI_FAIL;
+    }
+    if (image.format.fourcc != VA_FOURCC_NV12
+        || image.width < frame->imageWidth || image.height < frame->imageHeight) {
+        ERROR("software JPEG decoding needs a NV12 surface of the picture size");
+        unmapImage(display, image);
+        return YAMI_FAIL;
+    }
+
+    if (!coefficients.idct(0, m_impl->quantTables(),
+            dest + image.offsets[0], image.pitches[0])) {
+        unmapImage(display, image);
+        return YAMI_FAIL;
+    }
+
+    /* box filter the chroma, each NV12 sample averages the component
+       samples under its 2x2 luma samples */
+    const uint32_t width = (frame->imageWidth + 1) / 2;
+    const uint32_t height = (frame->imageHeight + 1) / 2;
+    for (size_t i(1); i < 3; ++i) {
+        uint8_t* uv = dest + image.offsets[1] + i - 1;
+        if (numComponents == 1) {
+            for (uint32_t y = 0; y < height; y++) {
+                for (uint32_t x = 0; x < width; x++)
+                    uv[y * image.pitches[1] + x * 2] = 128;
+            }
+            continue;
+        }
+        const Component::Shared& component = frame->components[i];
+        const CoefficientPlane& plane = coefficients.plane(i);
+        const uint32_t h = component->hSampleFactor;
+        const uint32_t v = component->vSampleFactor;
+        const uint32_t maxH = frame->maxHSampleFactor;
+        const uint32_t maxV = frame->maxVSampleFactor;
+        for (uint32_t y = 0; y < height; y++) {
+            uint32_t y0 = std::min(y * 2 * v / maxV, plane.height - 1);
+            uint32_t y1 = std::min(std::max(y0 + 1, (y * 2 + 2) * v / maxV), plane.height);
+            uint8_t* row = uv + y * image.pitches[1];
+            for (uint32_t x = 0; x < width; x++) {
+                uint32_t x0 = std::min(x * 2 * h / maxH, plane.width - 1);
+                uint32_t x1 = std::min(std::max(x0 + 1, (x * 2 + 2) * h / maxH), plane.width);
+                uint32_t count = (x1 - x0) * (y1 - y0);
+                uint32_t sum = count / 2;
+                for (uint32_t sy = y0; sy < y1; sy++) {
+                    const uint8_t* src = &chroma[i - 1][sy * plane.width];
+                    for (uint32_t sx = x0; sx < x1; sx++)
+                        sum += src[sx];
+                }
+                row[x * 2] = sum / count;
+            }
+        }
+    }
+
+    unmapImage(display, image);
+
+    return outputPicture(m_picture);
+}
+
 YamiStatus VaapiDecoderJPEG::reset(VideoConfigBuffer* buffer)
 {
     DEBUG("%s", __func__);
@@ -463,9 +719,18 @@ YamiStatus VaapiDecoderJPEG::reset(VideoConfigBuffer* buffer)
 
     m_impl.reset();
 
+    dropBuffers();
+
     return VaapiDecoderBase::reset(buffer);
 }
 
+void VaapiDecoderJPEG::dropBuffers()
+{
+    m_pictureParam.reset();
+    m_iqMatrix.reset();
+    m_hufTable.reset();
+}
+
 const bool VaapiDecoderJPEG::s_registered =
     VaapiDecoderFactory::register_<VaapiDecoderJPEG>(YAMI_MIME_JPEG);
 }
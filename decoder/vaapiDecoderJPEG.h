@@ -26,6 +26,10 @@
 
 namespace YamiMediaCodec {
 
+enum {
+    JPEG_SURFACE_NUMBER = 6, // a few pictures in flight for MJPEG streams
+};
+
 class VaapiDecoderJPEG
     : public VaapiDecoderBase {
 public:
@@ -49,10 +53,24 @@ private:
     YamiStatus loadHuffmanTables();
 
     YamiStatus finish();
+    YamiStatus finishSoftware();
+
+    void dropBuffers();
 
     std::auto_ptr<VaapiDecoderJPEG::Impl> m_impl;
     PicturePtr m_picture;
 
+    /*
+     * Parameter buffers of the last hardware decoded picture, given to the
+     * next ones for as long as the headers they came from hash the same.
+     */
+    BufObjectPtr m_pictureParam;
+    BufObjectPtr m_iqMatrix;
+    BufObjectPtr m_hufTable;
+    uint64_t m_pictureHash;
+    uint64_t m_iqMatrixHash;
+    uint64_t m_hufTableHash;
+
     static const bool s_registered; // VaapiDecoderFactory registration result
 
     DISALLOW_COPY_AND_ASSIGN(VaapiDecoderJPEG);
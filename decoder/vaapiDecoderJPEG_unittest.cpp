@@ -201,11 +201,8 @@ VAAPIDECODER_JPEG_TEST(Decode_SimpleMulti)
     buffer.size = 844; // Length of second jpeg image data
     buffer.timeStamp = 1;
 
-    // Decode returns format change after it decodes the SOF segment.
-    ASSERT_EQ(YAMI_DECODE_FORMAT_CHANGE, decoder.decode(&buffer));
-
-    // Resume decoding.  The decoder will continue where it left off (after the
-    // SOF segment) when we pass the same buffer as previous call.
+    // The SOF segment is the same as before, so the whole image decodes
+    // without a format change.
     ASSERT_EQ(YAMI_SUCCESS, decoder.decode(&buffer));
 
     EXPECT_TRUE(decoder.getOutput());
@@ -215,16 +212,57 @@ VAAPIDECODER_JPEG_TEST(Decode_SimpleMulti)
     buffer.size = mjpeg.size();  // Length of entire mjpeg
     buffer.timeStamp = 3;
 
-    // Decode returns format change after it decodes the first SOF segment.
-    ASSERT_EQ(YAMI_DECODE_FORMAT_CHANGE, decoder.decode(&buffer));
-
-    // Resume decoding.  The decoder will continue where it left off (after the
-    // SOF segment) when we pass the same buffer as previous call.  In this
-    // case, the decode should fail since it encounters a second image in the
+    // The decode should fail since it encounters a second image in the
     // buffer.
     ASSERT_EQ(YAMI_FAIL, decoder.decode(&buffer));
 }
 
+VAAPIDECODER_JPEG_TEST(Decode_SizeChange)
+{
+    VaapiDecoderJPEG decoder;
+    VideoConfigBuffer config;
+    VideoDecodeBuffer buffer;
+    std::tr1::array<uint8_t, 844> larger(g_SimpleJPEG);
+
+    // 16x16 instead of 10x10, the same 2x2 MCUs of scan data
+    ASSERT_EQ(0xc0, larger[159]);
+    larger[164] = 0x10;
+    larger[166] = 0x10;
+
+    config.flag = 0;
+
+    buffer.data = const_cast<uint8_t*>(g_SimpleJPEG.data());
+    buffer.size = g_SimpleJPEG.size();
+    buffer.timeStamp = 0;
+
+    ASSERT_EQ(YAMI_SUCCESS, decoder.start(&config));
+    ASSERT_EQ(YAMI_DECODE_FORMAT_CHANGE, decoder.decode(&buffer));
+    ASSERT_EQ(YAMI_SUCCESS, decoder.decode(&buffer));
+    EXPECT_TRUE(decoder.getOutput());
+
+    buffer.data = larger.data();
+    buffer.size = larger.size();
+    buffer.timeStamp = 1;
+
+    ASSERT_EQ(YAMI_DECODE_FORMAT_CHANGE, decoder.decode(&buffer));
+    ASSERT_EQ(YAMI_SUCCESS, decoder.decode(&buffer));
+    EXPECT_TRUE(decoder.getOutput());
+
+    const VideoFormatInfo* format = decoder.getFormatInfo();
+    ASSERT_TRUE(format);
+    EXPECT_EQ(16u, format->width);
+    EXPECT_EQ(16u, format->height);
+
+    // and back, a real change again
+    buffer.data = const_cast<uint8_t*>(g_SimpleJPEG.data());
+    buffer.size = g_SimpleJPEG.size();
+    buffer.timeStamp = 2;
+
+    ASSERT_EQ(YAMI_DECODE_FORMAT_CHANGE, decoder.decode(&buffer));
+    ASSERT_EQ(YAMI_SUCCESS, decoder.decode(&buffer));
+    EXPECT_TRUE(decoder.getOutput());
+}
+
 VAAPIDECODER_JPEG_TEST(Decode_SimpleTruncated)
 {
     const size_t size(g_SimpleJPEG.size());
@@ -40,6 +40,12 @@ inline void unrefAllocator(SurfaceAllocator* allocator)
 VaapiDecoderBase::VaapiDecoderBase()
     : m_VAStarted(false)
     , m_currentPTS(INVALID_PTS)
+    , m_currentDecodeOnly(false)
+    , m_firstDisplayPTS(INVALID_PTS)
+    , m_decodePolicy(DECODE_POLICY_ALL)
+    , m_skipState(SKIP_NONE)
+    , m_notifier(new EventNotifier)
+    , m_schedulePriority(1)
 {
     INFO("base: construct()");
     m_externalDisplay.handle = 0,
@@ -65,6 +71,7 @@ PicturePtr VaapiDecoderBase::createPicture(int64_t timeStamp /* , VaapiPictureSt
     }
 
     picture.reset(new VaapiDecPicture(m_context, surface, timeStamp));
+    picture->m_decodeOnly = m_currentDecodeOnly;
     return picture;
 }
 
@@ -131,6 +138,8 @@ void VaapiDecoderBase::stop(void)
     terminateVA();
 
     m_currentPTS = INVALID_PTS;
+    m_currentDecodeOnly = false;
+    m_firstDisplayPTS = INVALID_PTS;
 
     m_videoFormatInfo.valid = false;
 }
@@ -144,6 +153,89 @@ void VaapiDecoderBase::flush(void)
     }
 
     m_currentPTS = INVALID_PTS;
+    m_currentDecodeOnly = false;
+    m_firstDisplayPTS = INVALID_PTS;
+
+    AutoLock lock(m_policyLock);
+    m_skipState = SKIP_NONE;
+}
+
+YamiStatus VaapiDecoderBase::setDecodePolicy(VideoDecodePolicy policy)
+{
+    if (policy != DECODE_POLICY_ALL
+        && policy != DECODE_POLICY_SKIP_NON_REFERENCE
+        && policy != DECODE_POLICY_KEY_FRAMES_ONLY)
+        return YAMI_INVALID_PARAM;
+    INFO("base: decode policy %d", policy);
+    AutoLock lock(m_policyLock);
+    m_decodePolicy = policy;
+    return YAMI_SUCCESS;
+}
+
+YamiStatus VaapiDecoderBase::getFirstDisplayTimeStamp(int64_t* timeStamp)
+{
+    if (!timeStamp)
+        return YAMI_INVALID_PARAM;
+    if (m_firstDisplayPTS == INVALID_PTS)
+        return YAMI_MORE_DATA;
+    *timeStamp = m_firstDisplayPTS;
+    return YAMI_SUCCESS;
+}
+
+int VaapiDecoderBase::getEventFd()
+{
+    return m_notifier->fd();
+}
+
+YamiStatus VaapiDecoderBase::setSchedulePriority(uint32_t priority)
+{
+    if (!priority)
+        return YAMI_INVALID_PARAM;
+    m_schedulePriority = priority;
+    if (m_session)
+        m_session->setPriority(priority);
+    return YAMI_SUCCESS;
+}
+
+YamiStatus VaapiDecoderBase::getScheduleStats(VideoScheduleStats* stats)
+{
+    if (!stats)
+        return YAMI_INVALID_PARAM;
+    if (!m_session)
+        return YAMI_UNSUPPORTED;
+    m_session->getStats(stats);
+    return YAMI_SUCCESS;
+}
+
+bool VaapiDecoderBase::skipPicture(bool isReference, bool isKey, bool* resync)
+{
+    AutoLock lock(m_policyLock);
+    if (resync)
+        *resync = false;
+    if (isKey) {
+        if (m_skipState == SKIP_TO_KEY) {
+            m_skipState = SKIP_TO_REFERENCE;
+            if (resync)
+                *resync = true;
+        }
+        return false;
+    }
+    if (m_skipState == SKIP_TO_KEY)
+        return true;
+    if (m_skipState == SKIP_TO_REFERENCE) {
+        if (!isReference)
+            return true;
+        m_skipState = SKIP_NONE;
+    }
+
+    bool skip = false;
+    if (m_decodePolicy == DECODE_POLICY_SKIP_NON_REFERENCE)
+        skip = !isReference;
+    else if (m_decodePolicy == DECODE_POLICY_KEY_FRAMES_ONLY)
+        skip = true;
+    if (skip && isReference)
+        m_skipState = SKIP_TO_KEY;
+    return skip;
 }
 
 struct BufferRecycler
@@ -229,7 +321,7 @@ VaapiDecoderBase::setupVA(uint32_t numSurface, VAProfile profile)
 
     if (!m_externalAllocator) {
         //use internal allocator
-        m_allocator.reset(new VaapiSurfaceAllocator(m_display->getID()), unrefAllocator);
+        m_allocator.reset(new VaapiCachedSurfaceAllocator(m_display), unrefAllocator);
     } else {
         m_allocator = m_externalAllocator;
     }
@@ -239,6 +331,7 @@ VaapiDecoderBase::setupVA(uint32_t numSurface, VAProfile profile)
     DEBUG("surface pool is created");
     if (!m_surfacePool)
         return YAMI_FAIL;
+    m_surfacePool->setNotifier(m_notifier);
     std::vector<VASurfaceID> surfaces;
     m_surfacePool->getSurfaceIDs(surfaces);
     if (surfaces.empty())
@@ -253,6 +346,8 @@ VaapiDecoderBase::setupVA(uint32_t numSurface, VAProfile profile)
         ERROR("create context failed");
         return YAMI_FAIL;
     }
+    VaapiScheduler::bindSession(m_session, m_display, m_schedulePriority);
+    m_context->setSession(m_session);
 
     m_videoFormatInfo.surfaceWidth = m_videoFormatInfo.width;
     m_videoFormatInfo.surfaceHeight = m_videoFormatInfo.height;
@@ -306,6 +401,16 @@ SurfacePtr VaapiDecoderBase::createSurface()
 
 YamiStatus VaapiDecoderBase::outputPicture(const PicturePtr& picture)
 {
+    //the surface goes back to the pool once the decoder drops the picture
+    if (picture->m_decodeOnly) {
+        DEBUG("decode only picture, timeStamp %ld", picture->m_timeStamp);
+        return YAMI_SUCCESS;
+    }
+    //rendering may still be queued on the scheduler
+    if (!picture->wait())
+        return YAMI_FAIL;
+    if (m_firstDisplayPTS == INVALID_PTS)
+        m_firstDisplayPTS = picture->m_timeStamp;
     //TODO: reorder poc
     return m_surfacePool->output(picture->getSurface(),
                picture->m_timeStamp)
@@ -20,8 +20,11 @@
 
 #include "common/log.h"
 #include "common/common_def.h"
+#include "common/eventnotifier.h"
+#include "common/lock.h"
 #include "interface/VideoDecoderInterface.h"
 #include "vaapi/vaapiptrs.h"
+#include "vaapi/vaapischeduler.h"
 #include "vaapidecpicture.h"
 #include <deque>
 #include <pthread.h>
@@ -56,6 +59,11 @@ class VaapiDecoderBase:public IVideoDecoder {
     virtual void flush(void);
     virtual const VideoFormatInfo *getFormatInfo(void);
     virtual SharedPtr<VideoFrame> getOutput();
+    virtual YamiStatus setDecodePolicy(VideoDecodePolicy policy);
+    virtual YamiStatus getFirstDisplayTimeStamp(int64_t* timeStamp);
+    virtual int getEventFd();
+    virtual YamiStatus setSchedulePriority(uint32_t priority);
+    virtual YamiStatus getScheduleStats(VideoScheduleStats* stats);
 
     /* native window related functions */
     void setNativeDisplay(NativeDisplay * nativeDisplay);
@@ -71,6 +79,11 @@ class VaapiDecoderBase:public IVideoDecoder {
       YamiStatus updateReference(void);
       YamiStatus outputPicture(const PicturePtr& picture);
     SurfacePtr createSurface();
+    /* asks the decode policy about a new picture, before it takes a surface.
+     * true means drop it; parsing state (poc, frame num, probabilities) still
+     * has to follow the dropped picture. @resync is set when @isKey ends a
+     * run of dropped references, the key frame then starts a new stream */
+    bool skipPicture(bool isReference, bool isKey, bool* resync = NULL);
 
     NativeDisplay   m_externalDisplay;
     DisplayPtr m_display;
@@ -91,8 +104,27 @@ class VaapiDecoderBase:public IVideoDecoder {
     bool m_VAStarted;
 
     uint64_t m_currentPTS;
+    //current input is flagged WANT_DECODE_ONLY, its pictures are never output
+    bool m_currentDecodeOnly;
+    uint64_t m_firstDisplayPTS;
 
   private:
+    enum SkipState {
+        SKIP_NONE,
+        //a reference was dropped, nothing decodes cleanly before the next key frame
+        SKIP_TO_KEY,
+        //key frame found, non reference pictures after it may still predict from before it
+        SKIP_TO_REFERENCE
+    };
+    Lock m_policyLock;
+    VideoDecodePolicy m_decodePolicy;
+    SkipState m_skipState;
+    //outlives the surface pools, the client keeps polling the same fd
+    SharedPtr<EventNotifier> m_notifier;
+    //kept over start/stop so the statistics add up
+    ScheduleSessionPtr m_session;
+    uint32_t m_schedulePriority;
+
 #ifdef __ENABLE_DEBUG__
     int renderPictureCount;
 #endif
@@ -1118,6 +1118,11 @@ VaapiDecoderH264::VaapiDecoderH264()
     , m_dpb(bind(&VaapiDecoderH264::outputPicture, this, _1))
     , m_nalLengthSize(0)
     , m_contextChanged(false)
+    , m_skipCurrent(false)
+    , m_recovery(RECOVERY_NONE)
+    , m_recoveryFrameCnt(-1)
+    , m_recoveryFrameNum(0)
+    , m_recoveryPoc(0)
 {
 }
 
@@ -1599,7 +1604,8 @@ YamiStatus VaapiDecoderH264::createPicture(const SliceHeader* const slice,
             new VaapiDecPictureH264(m_context, m_currSurface, m_currentPTS));
     }
 
-    m_currPic->m_picOutputFlag = true;
+    m_currPic->m_decodeOnly = m_currentDecodeOnly || m_recovery == RECOVERY_REFRESH;
+    m_currPic->m_picOutputFlag = !m_currPic->m_decodeOnly;
     m_currPic->m_idrFlag = nalu->m_idrPicFlag;
     m_currPic->m_frameNum = slice->frame_num;
     m_currPic->m_pocLsb = slice->pic_order_cnt_lsb;
@@ -1609,6 +1615,13 @@ YamiStatus VaapiDecoderH264::createPicture(const SliceHeader* const slice,
     if (isIdr(m_currPic)) {
         m_prevPic.reset(
             new VaapiDecPictureH264(m_context, m_currSurface, m_currentPTS));
+    } else if (!m_prevPic) {
+        // start at a recovery point, take the previous frame_num and
+        // pic_order_cnt_lsb as our own so no gaps or poc wrap are derived
+        m_prevPic.reset(
+            new VaapiDecPictureH264(m_context, m_currSurface, m_currentPTS));
+        m_prevPic->m_frameNum = slice->frame_num;
+        m_prevPic->m_pocLsb = slice->pic_order_cnt_lsb;
     }
 
     if (nalu->nal_ref_idc) {
@@ -1624,6 +1637,56 @@ YamiStatus VaapiDecoderH264::createPicture(const SliceHeader* const slice,
     return status;
 }
 
+// pictures before the recovery point can not be reconstructed, drop them
+// before a surface is taken, reference pictures still have to be decoded
+// during a gradual refresh
+bool VaapiDecoderH264::isUnrecoverable(const SliceHeader* const slice,
+    const NalUnit* const nalu)
+{
+    if (nalu->m_idrPicFlag) {
+        m_recovery = RECOVERY_NONE;
+        m_recoveryFrameCnt = -1;
+        return false;
+    }
+    if (!m_prevPic) {
+        //nothing decoded yet, wait for an idr, an I picture or a recovery point
+        if (m_recoveryFrameCnt < 0) {
+            if (!isISlice(slice->slice_type))
+                return true;
+            //an I picture without sei recovers at once
+            m_recoveryFrameCnt = 0;
+        }
+        const SharedPtr<SPS>& sps = slice->m_pps->m_sps;
+        uint32_t maxFrameNum = 1 << (sps->log2_max_frame_num_minus4 + 4);
+        m_recoveryFrameNum = (slice->frame_num + m_recoveryFrameCnt) % maxFrameNum;
+        m_recoveryFrameCnt = -1;
+        m_recovery = RECOVERY_REFRESH;
+    }
+    if (m_recovery == RECOVERY_REFRESH) {
+        if (slice->frame_num == m_recoveryFrameNum) {
+            m_recovery = RECOVERY_POINT;
+            return false;
+        }
+        return !nalu->nal_ref_idc;
+    }
+    return false;
+}
+
+// leading pictures follow the recovery point in decode order but precede
+// it in output order, they may predict from pictures we never had
+bool VaapiDecoderH264::isLeading(const PicturePtr& picture)
+{
+    if (m_recovery == RECOVERY_POINT) {
+        m_recoveryPoc = picture->m_poc;
+        m_recovery = RECOVERY_LEADING;
+    } else if (m_recovery == RECOVERY_LEADING) {
+        if (picture->m_poc < m_recoveryPoc)
+            return true;
+        m_recovery = RECOVERY_NONE;
+    }
+    return false;
+}
+
 YamiStatus VaapiDecoderH264::decodeSlice(NalUnit* nalu)
 {
     SharedPtr<SliceHeader> currSlice(new SliceHeader);
@@ -1645,6 +1708,19 @@ YamiStatus VaapiDecoderH264::decodeSlice(NalUnit* nalu)
         status = decodeCurrent();
         if (status != YAMI_SUCCESS)
             return status;
+        bool resync = false;
+        m_skipCurrent = isUnrecoverable(slice, nalu)
+            || skipPicture(nalu->nal_ref_idc != 0,
+                   nalu->m_idrPicFlag || isISlice(slice->slice_type), &resync);
+        if (resync && !nalu->m_idrPicFlag) {
+            /* skipped reference pictures left frame_num and poc of m_prevPic
+               stale, start over at this I picture as at a recovery point */
+            m_dpb.flush();
+            m_prevPic.reset();
+            m_skipCurrent = isUnrecoverable(slice, nalu);
+        }
+        if (m_skipCurrent)
+            return YAMI_SUCCESS;
         status = createPicture(slice, nalu);
         if (status != YAMI_SUCCESS)
             return status;
@@ -1652,10 +1728,18 @@ YamiStatus VaapiDecoderH264::decodeSlice(NalUnit* nalu)
             || !m_dpb.init(m_currPic, m_prevPic, slice, nalu, m_newStream,
                            m_contextChanged))
             return YAMI_DECODE_INVALID_DATA;
+        if (isLeading(m_currPic)) {
+            m_currPic.reset();
+            m_skipCurrent = true;
+            return YAMI_SUCCESS;
+        }
         if (!fillPicture(m_currPic, slice) || !fillIqMatrix(m_currPic, slice))
             return YAMI_FAIL;
     }
 
+    if (m_skipCurrent)
+        return YAMI_SUCCESS;
+
     /* should init reference for every slice */
     m_dpb.initReference(m_currPic, slice);
 
@@ -1698,6 +1782,13 @@ YamiStatus VaapiDecoderH264::decodeNalu(NalUnit* nalu)
         case NAL_SEQ_END:
             m_endOfSequence = true;
             break;
+        case NAL_SEI:
+            if (!m_prevPic) {
+                RecoveryPoint recovery;
+                if (m_parser.parseRecoveryPoint(recovery, nalu))
+                    m_recoveryFrameCnt = recovery.recovery_frame_cnt;
+            }
+            break;
         default:
             break;
         }
@@ -1711,12 +1802,17 @@ YamiStatus VaapiDecoderH264::decode(VideoDecodeBuffer* buffer)
     if (!buffer || !buffer->data) {
         decodeCurrent();
         m_dpb.flush();
+        //the next stream starts at an idr or a recovery point again
+        m_prevPic.reset();
+        m_recovery = RECOVERY_NONE;
+        m_recoveryFrameCnt = -1;
         m_newStream = true;
         m_endOfStream = false;
         m_endOfSequence = false;
         return YAMI_SUCCESS;
     }
     m_currentPTS = buffer->timeStamp;
+    m_currentDecodeOnly = buffer->flag & WANT_DECODE_ONLY;
 
     int32_t size;
     NalUnit nalu;
@@ -1733,6 +1829,22 @@ YamiStatus VaapiDecoderH264::decode(VideoDecodeBuffer* buffer)
     return YAMI_SUCCESS;
 }
 
+void VaapiDecoderH264::flush(void)
+{
+    DEBUG("H264: flush()");
+    //bumped pictures are dropped with the output queue by the base flush
+    m_currPic.reset();
+    m_dpb.flush();
+    m_prevPic.reset();
+    m_recovery = RECOVERY_NONE;
+    m_recoveryFrameCnt = -1;
+    m_newStream = true;
+    m_endOfStream = false;
+    m_endOfSequence = false;
+    m_skipCurrent = false;
+    VaapiDecoderBase::flush();
+}
+
 const bool VaapiDecoderH264::s_registered
     = VaapiDecoderFactory::register_<VaapiDecoderH264>(YAMI_MIME_AVC)
       && VaapiDecoderFactory::register_<VaapiDecoderH264>(YAMI_MIME_H264);
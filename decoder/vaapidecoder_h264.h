@@ -40,6 +40,7 @@ public:
     virtual ~VaapiDecoderH264();
     virtual YamiStatus start(VideoConfigBuffer*);
     virtual YamiStatus decode(VideoDecodeBuffer*);
+    virtual void flush(void);
 
 private:
     friend class FactoryTest<IVideoDecoder, VaapiDecoderH264>;
@@ -148,6 +149,8 @@ private:
 
     YamiStatus createPicture(const SliceHeader* const,
         const NalUnit* const nalu);
+    bool isUnrecoverable(const SliceHeader* const, const NalUnit* const);
+    bool isLeading(const PicturePtr&);
     YamiStatus decodeCurrent();
     YamiStatus outputPicture(const PicturePtr&);
 
@@ -161,6 +164,24 @@ private:
     uint32_t m_nalLengthSize;
     SurfacePtr m_currSurface;
     bool m_contextChanged;
+    //the remaining slices belong to a dropped picture
+    bool m_skipCurrent;
+
+    //random access at a recovery point sei instead of an idr
+    enum RecoveryState {
+        RECOVERY_NONE,
+        //gradual refresh, reference pictures are decoded but not output
+        RECOVERY_REFRESH,
+        //the next picture is the recovery point
+        RECOVERY_POINT,
+        //drop leading pictures, they predict from before the recovery point
+        RECOVERY_LEADING
+    };
+    RecoveryState m_recovery;
+    //recovery_frame_cnt of the last recovery point before the first picture, -1 if none
+    int32_t m_recoveryFrameCnt;
+    uint32_t m_recoveryFrameNum;
+    int32_t m_recoveryPoc;
     static const bool s_registered; // VaapiDecoderFactory registration result
 };
 };
@@ -428,8 +428,11 @@ VaapiDecoderH265::VaapiDecoderH265():
     m_prevPicOrderCntMsb(0),
     m_prevPicOrderCntLsb(0),
     m_nalLengthSize(0),
+    m_associatedIrapNoRaslOutputFlag(false),
     m_newStream(true),
     m_endOfSequence(false),
+    m_handleCraAsBla(false),
+    m_skipCurrent(false),
     m_dpb(bind(&VaapiDecoderH265::outputPicture, this, _1))
 {
     m_parser.reset(new Parser());
@@ -491,6 +494,7 @@ YamiStatus VaapiDecoderH265::decodeCurrent()
         return YAMI_DECODE_INVALID_DATA;
     m_current.reset();
     m_newStream = false;
+    m_endOfSequence = false;
     return status;
 }
 
@@ -937,9 +941,8 @@ YamiStatus VaapiDecoderH265::ensureContext(const SPS* const sps)
 }
 
 /* 8.3.1 */
-void VaapiDecoderH265::getPoc(const PicturePtr& picture,
-        const SliceHeader* const slice,
-        const NalUnit* const nalu)
+int32_t VaapiDecoderH265::getPoc(const SliceHeader* const slice,
+        const NalUnit* const nalu, bool noRaslOutputFlag)
 {
     const PPS* const pps = slice->pps.get();
     const SPS* const sps = pps->sps.get();
@@ -947,7 +950,7 @@ void VaapiDecoderH265::getPoc(const PicturePtr& picture,
     const uint16_t pocLsb = slice->slice_pic_order_cnt_lsb;
     const int32_t MaxPicOrderCntLsb = 1 << (sps->log2_max_pic_order_cnt_lsb_minus4 + 4);
     int32_t picOrderCntMsb;
-    if (isIrap(nalu) && picture->m_noRaslOutputFlag) {
+    if (isIrap(nalu) && noRaslOutputFlag) {
         picOrderCntMsb = 0;
     } else {
         if((pocLsb < m_prevPicOrderCntLsb)
@@ -960,15 +963,44 @@ void VaapiDecoderH265::getPoc(const PicturePtr& picture,
             picOrderCntMsb =  m_prevPicOrderCntMsb;
         }
     }
-    picture->m_poc = picOrderCntMsb + pocLsb;
-    picture->m_pocLsb = pocLsb;
-
     uint8_t temporalID = nalu->nuh_temporal_id_plus1 - 1;
     //fixme:sub-layer non-reference picture.
     if (!temporalID && !isRasl(nalu) &&  !isRadl(nalu) && !isSublayerNoRef(nalu)) {
         m_prevPicOrderCntMsb = picOrderCntMsb;
         m_prevPicOrderCntLsb = pocLsb;
     }
+    return picOrderCntMsb + pocLsb;
+}
+
+/* decoding starts at an irap, and rasl pictures associated with an irap
+   with NoRaslOutputFlag refer to pictures before it in decode order */
+bool VaapiDecoderH265::isUnrecoverable(const NalUnit* const nalu)
+{
+    if (isIrap(nalu))
+        return false;
+    if (m_newStream || m_endOfSequence)
+        return true;
+    return isRasl(nalu) && m_associatedIrapNoRaslOutputFlag;
+}
+
+/* only sub-layer non-reference pictures of the highest sub-layer are
+   unreferenced, others may be used by pictures of higher sub-layers */
+bool VaapiDecoderH265::skipPicture(const SliceHeader* const slice,
+        const NalUnit* const nalu)
+{
+    const SPS* const sps = slice->pps->sps.get();
+    uint8_t temporalID = nalu->nuh_temporal_id_plus1 - 1;
+    bool isReference = !isSublayerNoRef(nalu)
+        || temporalID < sps->sps_max_sub_layers_minus1;
+    bool resync;
+    if (!VaapiDecoderBase::skipPicture(isReference, isIrap(nalu), &resync)) {
+        if (resync && isCra(nalu))
+            m_handleCraAsBla = true;
+        return false;
+    }
+    //keep the poc of later pictures right, a skipped picture is never irap
+    getPoc(slice, nalu, false);
+    return true;
 }
 
 PicturePtr VaapiDecoderH265::createPicture(const SliceHeader* const slice,
@@ -981,14 +1013,21 @@ PicturePtr VaapiDecoderH265::createPicture(const SliceHeader* const slice,
     picture.reset(new VaapiDecPictureH265(m_context, surface, m_currentPTS));
 
     picture->m_noRaslOutputFlag = isIdr(nalu) || isBla(nalu) ||
-                                  m_newStream || m_endOfSequence;
-    m_noRaslOutputFlag = picture->m_noRaslOutputFlag;
-    if (isIrap(nalu))
+                                  m_newStream || m_endOfSequence ||
+                                  m_handleCraAsBla;
+    if (isIrap(nalu)) {
         m_associatedIrapNoRaslOutputFlag = picture->m_noRaslOutputFlag;
+        m_handleCraAsBla = false;
+    }
+    picture->m_decodeOnly = m_currentDecodeOnly;
     picture->m_picOutputFlag
         = (isRasl(nalu) && m_associatedIrapNoRaslOutputFlag) ? false : slice->pic_output_flag;
+    //not waiting for output, the dpb drops it once it is unreferenced
+    if (m_currentDecodeOnly)
+        picture->m_picOutputFlag = false;
 
-    getPoc(picture, slice, nalu);
+    picture->m_poc = getPoc(slice, nalu, picture->m_noRaslOutputFlag);
+    picture->m_pocLsb = slice->slice_pic_order_cnt_lsb;
 
     return picture;
 }
@@ -1010,14 +1049,17 @@ YamiStatus VaapiDecoderH265::decodeSlice(NalUnit* nalu)
         status = decodeCurrent();
         if (status != YAMI_SUCCESS)
             return status;
-        m_current = createPicture(slice, nalu);
-        if (m_noRaslOutputFlag && isRasl(nalu))
+        m_skipCurrent = isUnrecoverable(nalu) || skipPicture(slice, nalu);
+        if (m_skipCurrent)
             return YAMI_SUCCESS;
+        m_current = createPicture(slice, nalu);
         if (!m_current || !m_dpb.init(m_current, slice, nalu, m_newStream))
             return YAMI_DECODE_INVALID_DATA;
         if (!fillPicture(m_current, slice) || !fillIqMatrix(m_current, slice))
             return YAMI_FAIL;
     }
+    if (m_skipCurrent)
+        return YAMI_SUCCESS;
     if (!m_current)
         return YAMI_FAIL;
     if (!fillSlice(m_current, slice, nalu))
@@ -1080,6 +1122,7 @@ YamiStatus VaapiDecoderH265::decode(VideoDecodeBuffer* buffer)
         return YAMI_SUCCESS;
     }
     m_currentPTS = buffer->timeStamp;
+    m_currentDecodeOnly = buffer->flag & WANT_DECODE_ONLY;
 
     NalReader nr(buffer->data, buffer->size, m_nalLengthSize);
     const uint8_t* nal;
@@ -1148,6 +1191,21 @@ bool VaapiDecoderH265::decodeHevcRecordData(uint8_t* buf, int32_t bufSize)
     return true;
 }
 
+void VaapiDecoderH265::flush(void)
+{
+    DEBUG("H265: flush()");
+    //bumped pictures are dropped with the output queue by the base flush
+    m_current.reset();
+    m_dpb.flush();
+    m_prevPicOrderCntMsb = 0;
+    m_prevPicOrderCntLsb = 0;
+    m_newStream = true;
+    m_endOfSequence = false;
+    m_handleCraAsBla = false;
+    m_skipCurrent = false;
+    VaapiDecoderBase::flush();
+}
+
 const bool VaapiDecoderH265::s_registered =
     VaapiDecoderFactory::register_<VaapiDecoderH265>(YAMI_MIME_H265);
 
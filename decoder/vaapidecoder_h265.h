@@ -53,6 +53,7 @@ public:
     virtual ~VaapiDecoderH265();
     virtual YamiStatus start(VideoConfigBuffer*);
     virtual YamiStatus decode(VideoDecodeBuffer*);
+    virtual void flush(void);
 
 private:
     friend class FactoryTest<IVideoDecoder, VaapiDecoderH265>;
@@ -138,8 +139,10 @@ private:
     bool decodeHevcRecordData(uint8_t* buf, int32_t bufSize);
 
     PicturePtr createPicture(const SliceHeader* const, const NalUnit* const nalu);
-    void getPoc(const PicturePtr&, const SliceHeader* const,
-            const NalUnit* const);
+    int32_t getPoc(const SliceHeader* const, const NalUnit* const,
+            bool noRaslOutputFlag);
+    bool skipPicture(const SliceHeader* const, const NalUnit* const);
+    bool isUnrecoverable(const NalUnit* const);
     YamiStatus decodeCurrent();
     YamiStatus outputPicture(const PicturePtr&);
 
@@ -149,9 +152,12 @@ private:
     int32_t     m_prevPicOrderCntLsb;
     int32_t     m_nalLengthSize;
     bool        m_associatedIrapNoRaslOutputFlag;
-    bool        m_noRaslOutputFlag;
     bool        m_newStream;
     bool        m_endOfSequence;
+    //a cra ends skipping, its rasl pictures reference dropped pictures (HandleCraAsBlaFlag)
+    bool        m_handleCraAsBla;
+    //the remaining slices belong to a dropped picture
+    bool        m_skipCurrent;
     DPB         m_dpb;
     std::map<int32_t, uint8_t> m_pocToIndex;
     SharedPtr<SliceHeader> m_prevSlice;
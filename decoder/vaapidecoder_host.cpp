@@ -21,6 +21,11 @@
 #include "common/log.h"
 #include "interface/VideoDecoderHost.h"
 #include "vaapidecoder_factory.h"
+#include "vaapi/vaapicontext.h"
+#include "vaapi/vaapidisplay.h"
+#include "vaapi/vaapiresourcecache.h"
+#include "vaapi/vaapisurfaceallocator.h"
+#include <string.h>
 
 #if __BUILD_FAKE_DECODER__
 #include "vaapidecoder_fake.h"
@@ -63,4 +68,52 @@ std::vector<std::string> getVideoDecoderMimeTypes()
 {
     return VaapiDecoderFactory::keys();
 }
+
+void setVideoResourceCacheTtl(uint32_t ttlMs)
+{
+    VaapiResourceCache::getInstance()->setTtl(ttlMs);
+}
+
+static void unrefAllocator(SurfaceAllocator* allocator)
+{
+    allocator->unref(allocator);
+}
+
+YamiStatus prewarmVideoDecoder(const NativeDisplay* display, const VideoConfigBuffer* config)
+{
+    if (!display || !config)
+        return YAMI_INVALID_PARAM;
+    if (!VaapiResourceCache::getInstance()->enabled())
+        return YAMI_UNSUPPORTED;
+    if (config->surfaceWidth <= 0 || config->surfaceHeight <= 0 || config->surfaceNumber <= 0)
+        return YAMI_INVALID_PARAM;
+
+    DisplayPtr vaDisplay = VaapiDisplay::create(*display);
+    if (!vaDisplay) {
+        ERROR("failed to create display");
+        return YAMI_FAIL;
+    }
+    if (config->profile != VAProfileNone) {
+        VAConfigAttrib attrib;
+        attrib.type = VAConfigAttribRTFormat;
+        attrib.value = VA_RT_FORMAT_YUV420;
+        //released right away, so it waits in the cache
+        if (!VaapiConfig::create(vaDisplay, config->profile, VAEntrypointVLD, &attrib, 1)) {
+            ERROR("failed to create config");
+            return YAMI_UNSUPPORTED;
+        }
+    }
+
+    SharedPtr<SurfaceAllocator> allocator(new VaapiCachedSurfaceAllocator(vaDisplay), unrefAllocator);
+    SurfaceAllocParams params;
+    memset(&params, 0, sizeof(params));
+    params.width = config->surfaceWidth;
+    params.height = config->surfaceHeight;
+    params.fourcc = YAMI_FOURCC_NV12;
+    params.size = config->surfaceNumber;
+    YamiStatus status = allocator->alloc(allocator.get(), &params);
+    if (status != YAMI_SUCCESS)
+        return status;
+    return allocator->free(allocator.get(), &params);
+}
 } // extern "C"
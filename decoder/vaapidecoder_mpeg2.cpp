@@ -211,6 +211,9 @@ VaapiDecoderMPEG2::VaapiDecoderMPEG2()
     , m_VAStart(false)
     , m_isParsingSlices(false)
     , m_loadNewIQMatrix(false)
+    , m_canCreatePicture(false)
+    , m_skipCurrent(false)
+    , m_expectSecondField(false)
 {
     m_parser.reset(new Parser());
     m_stream.reset(new StreamHeader());
@@ -497,6 +500,14 @@ YamiStatus VaapiDecoderMPEG2::processDecodeBuffer()
         // process a SliceCode
         if (isSliceCode(next_code)) {
 
+            if (m_canCreatePicture && skipPicture()) {
+                // drop the remaining slices, nothing to decode at the
+                // next picture start code
+                m_canCreatePicture = false;
+                m_isParsingSlices = false;
+            }
+            if (m_skipCurrent)
+                break;
             if (m_canCreatePicture)
             {
                 // create a new picture with updated information a field
@@ -519,6 +530,23 @@ YamiStatus VaapiDecoderMPEG2::processDecodeBuffer()
     return status;
 }
 
+bool VaapiDecoderMPEG2::skipPicture()
+{
+    // both fields of a frame share one decision, the second field of an
+    // I frame is often coded as P
+    if (m_pictureCodingExtension->picture_structure == kFramePicture) {
+        m_expectSecondField = false;
+    } else {
+        m_expectSecondField = !m_expectSecondField;
+        if (!m_expectSecondField)
+            return m_skipCurrent;
+    }
+    uint32_t type = m_pictureHeader->picture_coding_type;
+    m_skipCurrent = VaapiDecoderBase::skipPicture(
+        type != YamiParser::MPEG2::kBFrame, type == YamiParser::MPEG2::kIFrame);
+    return m_skipCurrent;
+}
+
 YamiStatus VaapiDecoderMPEG2::fillConfigBuffer()
 {
 
@@ -650,6 +678,7 @@ YamiStatus VaapiDecoderMPEG2::assignSurface()
     } else {
         m_currentPicture.reset(
             new VaapiDecPictureMpeg2(m_context, surface, m_currentPTS));
+        m_currentPicture->m_decodeOnly = m_currentDecodeOnly;
         m_currentPicture->m_isFirstField_ = true;
     }
 
@@ -904,6 +933,7 @@ YamiStatus VaapiDecoderMPEG2::decode(VideoDecodeBuffer* buffer)
     m_stream->streamSize = buffer->size;
     m_stream->time_stamp = buffer->timeStamp;
     m_currentPTS = buffer->timeStamp;
+    m_currentDecodeOnly = buffer->flag & WANT_DECODE_ONLY;
 
     DEBUG("decode size %ld timeStamp %ld", m_stream->streamSize,
           m_stream->time_stamp);
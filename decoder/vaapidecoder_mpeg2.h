@@ -124,6 +124,7 @@ private:
     YamiStatus assignSurface();
     YamiStatus assignPicture();
     YamiStatus createPicture();
+    bool skipPicture();
     YamiStatus loadIQMatrix();
     void updateIQMatrix(const YamiParser::MPEG2::QuantMatrices* refIQMatrix,
                         bool reset = false);
@@ -147,6 +148,10 @@ private:
     bool m_isParsingSlices;
     bool m_loadNewIQMatrix;
     bool m_canCreatePicture;
+    //the remaining slices belong to a dropped picture
+    bool m_skipCurrent;
+    //the next field picture completes a field pair
+    bool m_expectSecondField;
     PicturePtr m_currentPicture;
     YamiParser::MPEG2::StartCodeType m_previousStartCode;
     YamiParser::MPEG2::StartCodeType m_nextStartCode;
@@ -75,50 +75,14 @@ YamiStatus VaapiDecoderVC1::ensureContext()
     return YAMI_SUCCESS;
 }
 
-bool VaapiDecoderVC1::makeBitPlanes(PicturePtr& picture, VAPictureParameterBufferVC1* param)
+bool VaapiDecoderVC1::makeBitPlanes(PicturePtr& picture)
 {
-    uint8_t val = 0;
-    uint32_t i = 0, j = 0, k = 0, t = 0, dstIdx = 0, srcIdx = 0;
-    uint8_t* bitPlanes[3] = { NULL, NULL, NULL };
+    /* the parser decodes the bitplanes in the packed layout of va */
+    const std::vector<uint8_t>& bitPlanes = m_parser.m_bitPlanes;
     uint8_t* bitPlanesPayLoad = NULL;
-    if ((m_parser.m_frameHdr.picture_type == FRAME_I)
-        || (m_parser.m_frameHdr.picture_type == FRAME_BI)) {
-        if (param->bitplane_present.flags.bp_ac_pred)
-            bitPlanes[1] = &m_parser.m_bitPlanes.acpred[0];
-        if (param->bitplane_present.flags.bp_overflags)
-            bitPlanes[2] = &m_parser.m_bitPlanes.overflags[0];
-    }
-    else if (m_parser.m_frameHdr.picture_type == FRAME_P) {
-        if (param->bitplane_present.flags.bp_direct_mb)
-            bitPlanes[0] = &m_parser.m_bitPlanes.directmb[0];
-        if (param->bitplane_present.flags.bp_skip_mb)
-            bitPlanes[1] = &m_parser.m_bitPlanes.skipmb[0];
-        if (param->bitplane_present.flags.bp_mv_type_mb)
-            bitPlanes[2] = &m_parser.m_bitPlanes.mvtypemb[0];
-    }
-    else if (m_parser.m_frameHdr.picture_type == FRAME_B) {
-        if (param->bitplane_present.flags.bp_direct_mb)
-            bitPlanes[0] = &m_parser.m_bitPlanes.directmb[0];
-        if (param->bitplane_present.flags.bp_skip_mb)
-            bitPlanes[1] = &m_parser.m_bitPlanes.skipmb[0];
-    }
-    picture->editBitPlane(bitPlanesPayLoad, (m_parser.m_mbWidth * m_parser.m_mbHeight + 1) >> 1);
-    if (!bitPlanesPayLoad)
+    if (!picture->editBitPlane(bitPlanesPayLoad, bitPlanes.size()))
         return false;
-    for (i = 0; i < m_parser.m_mbHeight; i++) {
-        for (j = 0; j < m_parser.m_mbWidth; j++) {
-            dstIdx = t++ >> 1;
-            srcIdx = i * m_parser.m_mbWidth + j;
-            val = 0;
-            for (k = 0; k < 3; k++) {
-                if (bitPlanes[k])
-                    val |= bitPlanes[k][srcIdx] << k;
-            }
-            bitPlanesPayLoad[dstIdx] = (bitPlanesPayLoad[dstIdx] << 4) | val;
-        }
-    }
-    if (t & 1)
-        bitPlanesPayLoad[(t >> 1)] <<= 4;
+    memcpy(bitPlanesPayLoad, &bitPlanes[0], bitPlanes.size());
     return true;
 }
 
@@ -225,6 +189,8 @@ bool VaapiDecoderVC1::ensurePicture(PicturePtr& picture)
 
         FILL_RAWCODING(frameHdr, ac_pred);
         FILL_RAWCODING(frameHdr, overflags);
+        param->raw_coding.flags.field_tx = frameHdr->fieldtx;
+        param->raw_coding.flags.forward_mb = frameHdr->forwardmb;
         FILL_REFERENCE(entryPointHdr, reference_distance_flag);
 
         param->mv_fields.bits.extended_mv_flag = entryPointHdr->extended_mv;
@@ -245,6 +211,17 @@ bool VaapiDecoderVC1::ensurePicture(PicturePtr& picture)
                    || frameHdr->picture_type == FRAME_BI))
             param->bitplane_present.flags.bp_ac_pred = 1;
 
+        if ((!(frameHdr->fieldtx))
+            && (frameHdr->picture_type == FRAME_I
+                   || frameHdr->picture_type == FRAME_BI)
+            && frameHdr->fcm == FRAME_INTERLACE)
+            param->bitplane_present.flags.bp_field_tx = 1;
+
+        if ((!(frameHdr->forwardmb))
+            && frameHdr->picture_type == FRAME_B
+            && frameHdr->fcm == FIELD_INTERLACE)
+            param->bitplane_present.flags.bp_forward_mb = 1;
+
         if ((!(frameHdr->overflags))
             && ((frameHdr->picture_type == FRAME_I
                     || frameHdr->picture_type == FRAME_BI)
@@ -281,7 +258,7 @@ bool VaapiDecoderVC1::ensurePicture(PicturePtr& picture)
         param->forward_reference_picture = m_forwardPicture->getSurfaceID();
 
     if (param->bitplane_present.value)
-        return makeBitPlanes(picture, param);
+        return makeBitPlanes(picture);
 
 #undef FILL
 #undef FILL_MV
@@ -313,6 +290,11 @@ YamiStatus VaapiDecoderVC1::decode(uint8_t* data, uint32_t size, uint64_t pts)
     if (ret != YAMI_SUCCESS)
         return ret;
 
+    uint32_t type = m_parser.m_frameHdr.picture_type;
+    bool isReference = type == FRAME_I || type == FRAME_P || type == FRAME_SKIPPED;
+    if (skipPicture(isReference, type == FRAME_I))
+        return YAMI_SUCCESS;
+
     PicturePtr picture = createPicture(pts);
     if (!picture) {
         return YAMI_OUT_MEMORY;
@@ -328,9 +310,7 @@ YamiStatus VaapiDecoderVC1::decode(uint8_t* data, uint32_t size, uint64_t pts)
         return YAMI_FAIL;
     }
 
-    if ((m_parser.m_frameHdr.picture_type == FRAME_I)
-        || (m_parser.m_frameHdr.picture_type == FRAME_P)
-        || (m_parser.m_frameHdr.picture_type == FRAME_SKIPPED)) {
+    if (isReference) {
         m_forwardPicture = picture;
     }
     return outputPicture(picture);
@@ -346,6 +326,7 @@ YamiStatus VaapiDecoderVC1::decode(VideoDecodeBuffer* buffer)
     }
     size = buffer->size;
     data = buffer->data;
+    m_currentDecodeOnly = buffer->flag & WANT_DECODE_ONLY;
     if (!m_parser.parseFrameHeader(data, size))
         return DECODE_FAIL;
     return decode(data, size, buffer->timeStamp);
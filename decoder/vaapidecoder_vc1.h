@@ -39,7 +39,7 @@ private:
     YamiStatus decode(uint8_t*, uint32_t, uint64_t);
     bool ensureSlice(PicturePtr&, void*, int);
     bool ensurePicture(PicturePtr&);
-    bool makeBitPlanes(PicturePtr&, VAPictureParameterBufferVC1*);
+    bool makeBitPlanes(PicturePtr&);
     YamiParser::VC1::Parser m_parser;
     PicturePtr m_forwardPicture;
     static const bool s_registered;
@@ -520,6 +520,7 @@ YamiStatus VaapiDecoderVP8::decode(VideoDecodeBuffer* buffer)
     Vp8ParserResult result;
 
     m_currentPTS = buffer->timeStamp;
+    m_currentDecodeOnly = buffer->flag & WANT_DECODE_ONLY;
 
     m_buffer = buffer->data;
     m_frameSize = buffer->size;
@@ -545,6 +546,16 @@ YamiStatus VaapiDecoderVP8::decode(VideoDecodeBuffer* buffer)
             if (status != YAMI_SUCCESS)
                 return status;
         }
+
+        // the parser keeps the probability and segmentation state, a
+        // frame which refreshes no reference buffer can simply be dropped
+        if (skipPicture(m_frameHdr.IsKeyframe() || m_frameHdr.refresh_last
+                            || m_frameHdr.refresh_golden_frame
+                            || m_frameHdr.refresh_alternate_frame
+                            || m_frameHdr.copy_buffer_to_golden
+                            || m_frameHdr.copy_buffer_to_alternate,
+                m_frameHdr.IsKeyframe()))
+            break;
 #if __PSB_CACHE_DRAIN_FOR_FIRST_FRAME__
         int ii = 0;
         int decodeCount = 1;
@@ -250,6 +250,15 @@ YamiStatus VaapiDecoderVP9::decode(const Vp9FrameHdr* hdr, const uint8_t* data,
     if (ret != YAMI_SUCCESS)
         return ret;
 
+    // the frame contexts live in the driver, so a frame refreshing them has
+    // to be decoded even if it updates no reference slot
+    bool isKey = hdr->frame_type == VP9_KEY_FRAME;
+    bool isReference = isKey || hdr->show_existing_frame
+        || hdr->refresh_frame_flags
+        || (hdr->refresh_frame_context && !hdr->error_resilient_mode);
+    if (skipPicture(isReference, isKey))
+        return YAMI_SUCCESS;
+
     PicturePtr picture = createPicture(timeStamp);
     if (!picture)
         return YAMI_OUT_MEMORY;
@@ -315,6 +324,7 @@ YamiStatus VaapiDecoderVP9::decode(VideoDecodeBuffer* buffer)
     YamiStatus status;
     if (!buffer)
         return YAMI_DECODE_INVALID_DATA;
+    m_currentDecodeOnly = buffer->flag & WANT_DECODE_ONLY;
     uint8_t* data = buffer->data;
     size_t  size = buffer->size;
     uint8_t* end = data + size;
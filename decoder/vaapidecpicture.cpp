@@ -26,10 +26,12 @@ namespace YamiMediaCodec{
 VaapiDecPicture::VaapiDecPicture(const ContextPtr& context,
                                  const SurfacePtr& surface, int64_t timeStamp)
     :VaapiPicture(context, surface, timeStamp)
+    , m_decodeOnly(false)
 {
 }
 
 VaapiDecPicture::VaapiDecPicture()
+    : m_decodeOnly(false)
 {
 }
 
@@ -38,6 +40,30 @@ bool VaapiDecPicture::decode()
     return render();
 }
 
+static bool shareObject(BufObjectPtr& object, const BufObjectPtr& shared)
+{
+    /* same one time offer as the edit functions */
+    if (object || !shared)
+        return false;
+    object = shared;
+    return true;
+}
+
+bool VaapiDecPicture::setPicture(const BufObjectPtr& picParam)
+{
+    return shareObject(m_picture, picParam);
+}
+
+bool VaapiDecPicture::setIqMatrix(const BufObjectPtr& matrix)
+{
+    return shareObject(m_iqMatrix, matrix);
+}
+
+bool VaapiDecPicture::setHufTable(const BufObjectPtr& hufTable)
+{
+    return shareObject(m_hufTable, hufTable);
+}
+
 bool VaapiDecPicture::doRender()
 {
     RENDER_OBJECT(m_picture);
@@ -23,7 +23,8 @@ class VaapiDecPicture : public VaapiPicture
 {
 public:
     VaapiDecPicture(const ContextPtr&, const SurfacePtr&, int64_t timeStamp);
-    virtual ~VaapiDecPicture() {};
+    //the render job may still read our buffers
+    virtual ~VaapiDecPicture() { wait(); };
 
 
     template <class T>
@@ -44,8 +45,22 @@ public:
     template <class T>
     bool newSlice(T*& sliceParam, const void* sliceData, uint32_t sliceSize);
 
+    //share a buffer filled for an earlier picture, e.g. for tables that
+    //repeat from frame to frame
+    bool setPicture(const BufObjectPtr& picParam);
+    bool setIqMatrix(const BufObjectPtr& matrix);
+    bool setHufTable(const BufObjectPtr& hufTable);
+
+    //the buffers to share, valid until the picture is decoded
+    const BufObjectPtr& getPicture() const { return m_picture; }
+    const BufObjectPtr& getIqMatrix() const { return m_iqMatrix; }
+    const BufObjectPtr& getHufTable() const { return m_hufTable; }
+
     bool decode();
 
+    //decoded for reference only, never output
+    bool m_decodeOnly;
+
 protected:
     VaapiDecPicture();
 
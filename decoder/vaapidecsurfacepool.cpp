@@ -74,7 +74,8 @@ bool VaapiDecSurfacePool::init(const DisplayPtr& display, VideoConfigBuffer* con
 
 VaapiDecSurfacePool::VaapiDecSurfacePool()
     :m_cond(m_lock),
-    m_flushing(false)
+    m_flushing(false),
+    m_starved(false)
 {
     memset(&m_allocParams, 0, sizeof(m_allocParams));
 }
@@ -109,6 +110,8 @@ SurfacePtr VaapiDecSurfacePool::acquireWithWait()
 {
     SurfacePtr surface;
     AutoLock lock(m_lock);
+    if (m_freed.empty())
+        m_starved = true;
     while (m_freed.empty() && !m_flushing) {
         DEBUG("wait because there is no available surface from pool");
         m_cond.wait();
@@ -142,6 +145,8 @@ bool VaapiDecSurfacePool::output(const SurfacePtr& surface, int64_t timeStamp)
     buffer->timeStamp = timeStamp;
     DEBUG("surface=0x%x is output-able with timeStamp=%ld", surface->getID(), timeStamp);
     m_output.push_back(buffer);
+    if (m_notifier)
+        m_notifier->notify();
     return true;
 }
 
@@ -172,13 +177,24 @@ private:
 
 void VaapiDecSurfacePool::setWaitable(bool waitable)
 {
+    AutoLock lock(m_lock);
     m_flushing = !waitable;
 
     if (!waitable) {
         m_cond.signal();
+        if (m_starved && m_notifier) {
+            m_starved = false;
+            m_notifier->notify();
+        }
     }
 }
 
+void VaapiDecSurfacePool::setNotifier(const SharedPtr<EventNotifier>& notifier)
+{
+    AutoLock lock(m_lock);
+    m_notifier = notifier;
+}
+
 void VaapiDecSurfacePool::flush()
 {
     AutoLock lock(m_lock);
@@ -206,6 +222,11 @@ void VaapiDecSurfacePool::recycleLocked(VASurfaceID id, SurfaceState flag)
         if (m_flushing && m_allocated.size() == 0)
             m_flushing = false;
         m_cond.signal();
+        //client stopped feeding us when we ran out, tell it to come back
+        if (m_starved && m_notifier) {
+            m_starved = false;
+            m_notifier->notify();
+        }
     }
 }
 
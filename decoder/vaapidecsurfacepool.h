@@ -20,6 +20,7 @@
 
 #include "common/condition.h"
 #include "common/common_def.h"
+#include "common/eventnotifier.h"
 #include "common/lock.h"
 #include "vaapi/vaapiptrs.h"
 #include "interface/VideoCommonDefs.h"
@@ -72,6 +73,8 @@ public:
     /// decode thread may be blocked at acquireWithWait, wake it up and escape if required. it doesn't release internal surfaces.
     /// it can be used for drain or unclear termination (in v4l2 wrapper, STREAMOFF can be used for either flush or drain).
     void setWaitable(bool waitable);
+    /// told about new output and about surfaces freed while we were out of them
+    void setNotifier(const SharedPtr<EventNotifier>&);
     ~VaapiDecSurfacePool();
 
 
@@ -112,6 +115,9 @@ private:
     Lock m_lock;
     Condition m_cond;
     bool m_flushing;
+    //acquireWithWait found no free surface
+    bool m_starved;
+    SharedPtr<EventNotifier> m_notifier;
 
     //for external allocator
     SharedPtr<SurfaceAllocator> m_allocator;
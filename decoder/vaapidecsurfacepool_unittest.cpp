@@ -0,0 +1,135 @@
+/*
+ * Copyright 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// library headers
+#include "common/unittest.h"
+
+// primary header
+#include "vaapidecsurfacepool.h"
+
+#include "common/eventnotifier.h"
+#include "vaapi/vaapidisplay.h"
+#include "vaapi/VaapiSurface.h"
+
+// system headers
+#include <poll.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace YamiMediaCodec {
+
+//hands out fake ids, the pool never touches the surfaces itself
+static YamiStatus fakeAlloc(SurfaceAllocator*, SurfaceAllocParams* params)
+{
+    params->surfaces = new intptr_t[params->size];
+    for (uint32_t i = 0; i < params->size; i++)
+        params->surfaces[i] = i + 1;
+    return YAMI_SUCCESS;
+}
+
+static YamiStatus fakeFree(SurfaceAllocator*, SurfaceAllocParams* params)
+{
+    delete[] params->surfaces;
+    params->surfaces = NULL;
+    return YAMI_SUCCESS;
+}
+
+static void fakeUnref(SurfaceAllocator* thiz)
+{
+    delete thiz;
+}
+
+class VaapiDecSurfacePoolTest : public ::testing::Test {
+protected:
+    DecSurfacePoolPtr createPool(uint32_t size)
+    {
+        NativeDisplay native = { 0, NATIVE_DISPLAY_DRM };
+        m_display = VaapiDisplay::create(native);
+        if (!m_display)
+            return DecSurfacePoolPtr();
+
+        SurfaceAllocator* p = new SurfaceAllocator;
+        p->alloc = fakeAlloc;
+        p->free = fakeFree;
+        p->unref = fakeUnref;
+        SharedPtr<SurfaceAllocator> allocator(p, fakeUnref);
+
+        VideoConfigBuffer config;
+        memset(&config, 0, sizeof(config));
+        config.surfaceWidth = 320;
+        config.surfaceHeight = 240;
+        config.surfaceNumber = size;
+        return VaapiDecSurfacePool::create(m_display, &config, allocator);
+    }
+
+    static bool readable(int fd)
+    {
+        struct pollfd p;
+        p.fd = fd;
+        p.events = POLLIN;
+        p.revents = 0;
+        return poll(&p, 1, 0) == 1 && (p.revents & POLLIN);
+    }
+
+    static void clear(int fd)
+    {
+        uint64_t count;
+        EXPECT_EQ((ssize_t)sizeof(count), read(fd, &count, sizeof(count)));
+    }
+
+    DisplayPtr m_display;
+};
+
+#define VAAPIDECSURFACEPOOL_TEST(name) \
+    TEST_F(VaapiDecSurfacePoolTest, name)
+
+VAAPIDECSURFACEPOOL_TEST(NotifyWhenStarvedClientGetsSurface)
+{
+    DecSurfacePoolPtr pool = createPool(1);
+    ASSERT_TRUE(bool(pool));
+
+    SharedPtr<EventNotifier> notifier(new EventNotifier);
+    pool->setNotifier(notifier);
+    int fd = notifier->fd();
+    ASSERT_LE(0, fd);
+
+    SurfacePtr surface = pool->acquireWithWait();
+    ASSERT_TRUE(bool(surface));
+
+    //run out of surfaces without blocking the test thread
+    pool->setWaitable(false);
+    EXPECT_FALSE(bool(pool->acquireWithWait()));
+    pool->setWaitable(true);
+    EXPECT_FALSE(readable(fd));
+
+    //the client waits on the fd, freeing a surface must wake it
+    surface.reset();
+    EXPECT_TRUE(readable(fd));
+    clear(fd);
+
+    //not starved any more, recycling is silent
+    surface = pool->acquireWithWait();
+    ASSERT_TRUE(bool(surface));
+    surface.reset();
+    EXPECT_FALSE(readable(fd));
+}
+
+}
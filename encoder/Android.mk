@@ -7,9 +7,11 @@ LOCAL_SRC_FILES := \
         vaapiencpicture.cpp \
         vaapiencoder_base.cpp \
         vaapiencoder_host.cpp \
+        vaapiencoder_lookahead.cpp \
 
 LOCAL_SRC_FILES += \
-        vaapiencoder_h264.cpp
+        vaapiencoder_h264.cpp \
+        vaapiencoder_chunked.cpp
 
 LOCAL_SRC_FILES += \
         vaapiencoder_jpeg.cpp
@@ -53,6 +53,15 @@ uint32_t VaapiCodedBuffer::size()
     return size;
 }
 
+void VaapiCodedBuffer::reset()
+{
+    if (m_segments) {
+        m_buf->unmap();
+        m_segments = NULL;
+    }
+    m_flags = 0;
+}
+
 bool VaapiCodedBuffer::copyInto(void* data)
 {
     if (!data)
@@ -34,6 +34,8 @@ public:
     bool setFlag(uint32_t flag) { m_flags |= flag; return true; }
     bool clearFlag(uint32_t flag) { m_flags &= ~flag; return true; }
     uint32_t getFlags() { return m_flags; }
+    //unmap and clear the flags, so the buffer can take another picture
+    void reset();
 
 private:
     VaapiCodedBuffer(const BufObjectPtr& buf):m_buf(buf), m_segments(NULL), m_flags(0) {}
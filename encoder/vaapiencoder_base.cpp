@@ -35,7 +35,8 @@ namespace YamiMediaCodec{
 VaapiEncoderBase::VaapiEncoderBase():
     m_entrypoint(VAEntrypointEncSlice),
     m_maxOutputBuffer(MaxOutputBuffer),
-    m_maxCodedbufSize(0)
+    m_maxCodedbufSize(0),
+    m_schedulePriority(1)
 {
     FUNC_ENTER();
     m_externalDisplay.handle = 0,
@@ -58,6 +59,12 @@ VaapiEncoderBase::VaapiEncoderBase():
     m_videoParamCommon.rcParams.disableBitsStuffing = 1;
     m_videoParamCommon.leastInputCount = 0;
 
+    memset(&m_videoParamLookahead, 0, sizeof(m_videoParamLookahead));
+    m_videoParamLookahead.size = sizeof(m_videoParamLookahead);
+    m_videoParamLookahead.enableSceneCut = true;
+    m_videoParamLookahead.enableAdaptiveB = true;
+    m_videoParamLookahead.enableAdaptiveQP = true;
+
     updateMaxOutputBufferCount();
 }
 
@@ -86,6 +93,8 @@ YamiStatus VaapiEncoderBase::start(void)
 
 void VaapiEncoderBase::flush(void)
 {
+    if (m_lookahead)
+        m_lookahead->flush();
     AutoLock l(m_lock);
     m_output.clear();
 }
@@ -110,9 +119,8 @@ YamiStatus VaapiEncoderBase::encode(VideoEncRawBuffer* inBuffer)
     if (!inBuffer)
         return YAMI_SUCCESS;
     if (!inBuffer->data && !inBuffer->size) {
-        // XXX handle EOS when there is B frames
         inBuffer->bufAvailable = true;
-        return YAMI_SUCCESS;
+        return endOfStream();
     }
     VideoFrameRawData frame;
     if (!fillFrameRawData(&frame, inBuffer->fourcc, width(), height(), inBuffer->data))
@@ -136,19 +144,67 @@ YamiStatus VaapiEncoderBase::encode(VideoFrameRawData* frame)
     SurfacePtr surface = createSurface(frame);
     if (!surface)
         return YAMI_OUT_MEMORY;
-    return doEncode(surface, frame->timeStamp, frame->flags & VIDEO_FRAME_FLAGS_KEY);
+    return encodeSurface(surface, frame->timeStamp, frame->flags & VIDEO_FRAME_FLAGS_KEY);
 }
 
 YamiStatus VaapiEncoderBase::encode(const SharedPtr<VideoFrame>& frame)
 {
     if (!frame)
-        return YAMI_INVALID_PARAM;
+        return endOfStream();
     if (isBusy())
         return YAMI_ENCODE_IS_BUSY;
     SurfacePtr surface = createSurface(frame);
     if (!surface)
         return YAMI_INVALID_PARAM;
-    return doEncode(surface, frame->timeStamp, frame->flags & VIDEO_FRAME_FLAGS_KEY);
+    return encodeSurface(surface, frame->timeStamp, frame->flags & VIDEO_FRAME_FLAGS_KEY);
+}
+
+YamiStatus VaapiEncoderBase::encodeSurface(const SurfacePtr& surface, uint64_t timeStamp, bool forceKeyFrame)
+{
+    if (!m_lookahead)
+        return doEncode(surface, timeStamp, forceKeyFrame);
+    m_lookahead->push(surface, timeStamp, forceKeyFrame);
+    return drainLookahead(false);
+}
+
+YamiStatus VaapiEncoderBase::drainLookahead(bool all)
+{
+    VaapiEncoderLookahead::Frame frame;
+    YamiStatus ret = YAMI_SUCCESS;
+    while (m_lookahead && m_lookahead->front(frame, all)) {
+        m_lookaheadStats = frame.stats;
+        ret = doEncode(frame.surface, frame.timeStamp, frame.forceKeyFrame);
+        m_lookaheadStats = LookaheadStats();
+        //a frame the encoder did not take stays first in line for the next call
+        if (ret != YAMI_SUCCESS) {
+            ERROR("encode lookahead frame failed, status = %d", ret);
+            break;
+        }
+        m_lookahead->pop();
+    }
+    return ret;
+}
+
+YamiStatus VaapiEncoderBase::endOfStream()
+{
+    //hand over the frames held by lookahead, then the ones held for reordering
+    YamiStatus ret = drainLookahead(true);
+    if (ret != YAMI_SUCCESS)
+        return ret;
+    return drainReorder();
+}
+
+bool VaapiEncoderBase::startLookahead()
+{
+    m_lookahead.reset();
+    if (!m_videoParamLookahead.depth)
+        return true;
+    m_lookahead.reset(new VaapiEncoderLookahead(m_display, width(), height(), m_videoParamLookahead));
+    if (!m_lookahead->start()) {
+        m_lookahead.reset();
+        return false;
+    }
+    return true;
 }
 
 YamiStatus VaapiEncoderBase::getParameters(VideoParamConfigType type, Yami_PTR videoEncParams)
@@ -168,6 +224,14 @@ YamiStatus VaapiEncoderBase::getParameters(VideoParamConfigType type, Yami_PTR v
         }
         break;
     }
+    case VideoParamsTypeLookahead: {
+        VideoParamsLookahead* lookahead = (VideoParamsLookahead*)videoEncParams;
+        if (lookahead->size == sizeof(VideoParamsLookahead)) {
+            PARAMETER_ASSIGN(*lookahead, m_videoParamLookahead);
+            ret = YAMI_SUCCESS;
+        }
+        break;
+    }
     default:
         ret = YAMI_SUCCESS;
         break;
@@ -214,6 +278,15 @@ YamiStatus VaapiEncoderBase::setParameters(VideoParamConfigType type, Yami_PTR v
             ret = YAMI_INVALID_PARAM;
         }
         break;
+    case VideoParamsTypeLookahead: {
+        VideoParamsLookahead* lookahead = (VideoParamsLookahead*)videoEncParams;
+        if (lookahead->size == sizeof(VideoParamsLookahead)) {
+            PARAMETER_ASSIGN(m_videoParamLookahead, *lookahead);
+        } else {
+            ret = YAMI_INVALID_PARAM;
+        }
+        break;
+    }
     default:
         ret = YAMI_INVALID_PARAM;
         break;
@@ -459,6 +532,7 @@ VideoProfile VaapiEncoderBase::profile() const
 
 void VaapiEncoderBase::cleanupVA()
 {
+    m_lookahead.reset();
     m_pool.reset();
     m_alloc.reset();
     m_context.reset();
@@ -494,7 +568,7 @@ bool VaapiEncoderBase::initVA()
         return false;
     }
 
-    m_alloc.reset(new VaapiSurfaceAllocator(m_display->getID()), unrefAllocator);
+    m_alloc.reset(new VaapiCachedSurfaceAllocator(m_display), unrefAllocator);
 
     int32_t surfaceWidth = ALIGN16(m_videoParamCommon.resolution.width);
     int32_t surfaceHeight = ALIGN16(m_videoParamCommon.resolution.height);
@@ -513,6 +587,8 @@ bool VaapiEncoderBase::initVA()
         ERROR("failed to create context");
         return false;
     }
+    VaapiScheduler::bindSession(m_session, m_display, m_schedulePriority);
+    m_context->setSession(m_session);
     return true;
 }
 
@@ -545,9 +621,14 @@ void VaapiEncoderBase::getPicture(PicturePtr &outPicture)
 
 YamiStatus VaapiEncoderBase::checkCodecData(VideoEncOutputBuffer* outBuffer)
 {
-    if (outBuffer->format != OUTPUT_CODEC_DATA) {
+    //a partial frame means the picture has more nals to hand out
+    if (outBuffer->format != OUTPUT_CODEC_DATA
+        && !(outBuffer->flag & ENCODE_BUFFERFLAG_PARTIALFRAME)) {
         AutoLock l(m_lock);
         m_output.pop_front();
+        //encode() said busy before this
+        if (m_output.size() + 1 == m_maxOutputBuffer)
+            m_notifier.notify();
     }
     return YAMI_SUCCESS;
 }
@@ -603,6 +684,31 @@ YamiStatus VaapiEncoderBase::getOutput(VideoEncOutputBuffer* outBuffer, VideoEnc
 
 #endif
 
+int VaapiEncoderBase::getEventFd()
+{
+    return m_notifier.fd();
+}
+
+YamiStatus VaapiEncoderBase::setSchedulePriority(uint32_t priority)
+{
+    if (!priority)
+        return YAMI_INVALID_PARAM;
+    m_schedulePriority = priority;
+    if (m_session)
+        m_session->setPriority(priority);
+    return YAMI_SUCCESS;
+}
+
+YamiStatus VaapiEncoderBase::getScheduleStats(VideoScheduleStats* stats)
+{
+    if (!stats)
+        return YAMI_INVALID_PARAM;
+    if (!m_session)
+        return YAMI_UNSUPPORTED;
+    m_session->getStats(stats);
+    return YAMI_SUCCESS;
+}
+
 YamiStatus VaapiEncoderBase::getCodecConfig(VideoEncOutputBuffer* outBuffer)
 {
     ASSERT(outBuffer && (outBuffer->format == OUTPUT_CODEC_DATA));
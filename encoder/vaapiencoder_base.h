@@ -19,12 +19,15 @@
 
 #include "interface/VideoEncoderDefs.h"
 #include "interface/VideoEncoderInterface.h"
+#include "common/eventnotifier.h"
 #include "common/lock.h"
 #include "common/log.h"
 #include "common/surfacepool.h"
 #include "vaapiencpicture.h"
+#include "vaapiencoder_lookahead.h"
 #include "vaapi/VaapiBuffer.h"
 #include "vaapi/vaapiptrs.h"
+#include "vaapi/vaapischeduler.h"
 #include "vaapi/VaapiSurface.h"
 
 #include <deque>
@@ -53,6 +56,10 @@ public:
     virtual YamiStatus encode(VideoEncRawBuffer* inBuffer);
     virtual YamiStatus encode(VideoFrameRawData* frame);
     virtual YamiStatus encode(const SharedPtr<VideoFrame>& frame);
+    virtual YamiStatus encodeBatch(const SharedPtr<VideoFrame>* frames, VideoEncOutputBuffer* outputs, uint32_t count)
+    {
+        return YAMI_UNSUPPORTED;
+    }
 
 /*
     * getOutput can be called several time for a frame (such as first time  codec data, and second time others)
@@ -71,6 +78,9 @@ public:
     virtual YamiStatus getConfig(VideoParamConfigType type, Yami_PTR);
 
     virtual YamiStatus getMaxOutSize(uint32_t* maxSize);
+    virtual int getEventFd();
+    virtual YamiStatus setSchedulePriority(uint32_t priority);
+    virtual YamiStatus getScheduleStats(VideoScheduleStats* stats);
 
 #ifdef __BUILD_GET_MV__
     /// get MV buffer size.
@@ -97,6 +107,11 @@ protected:
 
     //virtual functions
     virtual YamiStatus doEncode(const SurfacePtr&, uint64_t timeStamp, bool forceKeyFrame = false) = 0;
+    //end of stream, encode frames still held for reordering
+    virtual YamiStatus drainReorder() { return YAMI_SUCCESS; }
+
+    //lookahead, for encoders that decide frame types themselves
+    bool startLookahead();
 
     //rate control related things
     void fill(VAEncMiscParameterHRD*) const ;
@@ -169,17 +184,28 @@ protected:
     uint32_t m_maxOutputBuffer; // max count of frames are encoding in parallel, it hurts performance when m_maxOutputBuffer is too big.
     uint32_t m_maxCodedbufSize;
 
+    VideoParamsLookahead m_videoParamLookahead;
+    //stats of the frame currently passed to doEncode(), all clear without lookahead
+    LookaheadStats m_lookaheadStats;
+
 private:
     bool initVA();
+    YamiStatus encodeSurface(const SurfacePtr&, uint64_t timeStamp, bool forceKeyFrame);
+    YamiStatus drainLookahead(bool all);
+    YamiStatus endOfStream();
     void cleanupVA();
     NativeDisplay m_externalDisplay;
 
     SharedPtr<SurfacePool> m_pool;
     SharedPtr<SurfaceAllocator> m_alloc;
+    SharedPtr<VaapiEncoderLookahead> m_lookahead;
 
     Lock m_lock;
     typedef std::deque<PicturePtr> OutputQueue;
     OutputQueue m_output;
+    EventNotifier m_notifier;
+    ScheduleSessionPtr m_session;
+    uint32_t m_schedulePriority;
 
     bool updateMaxOutputBufferCount() {
         if (m_maxOutputBuffer < m_videoParamCommon.leastInputCount + 3)
@@ -197,6 +223,7 @@ bool VaapiEncoderBase::output(const SharedPtr<Pic>& pic)
     picture = DynamicPointerCast<VaapiEncPicture>(pic);
     if (picture) {
         m_output.push_back(picture);
+        m_notifier.notify();
         ret = true;
     } else {
         ERROR("output need a subclass of VaapiEncPicutre");
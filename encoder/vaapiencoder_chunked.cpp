@@ -0,0 +1,827 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "vaapiencoder_chunked.h"
+#include "codecparsers/bitReader.h"
+#include "codecparsers/bitWriter.h"
+#include "common/log.h"
+#include "common/nalreader.h"
+#include "interface/VideoEncoderHost.h"
+#include <algorithm>
+#include <string.h>
+
+namespace YamiMediaCodec{
+
+using namespace YamiParser::H264;
+using YamiParser::BitReader;
+using YamiParser::BitWriter;
+
+//chunks held at once, per session, counting the ones not read back yet
+const uint32_t CHUNKS_PER_SESSION = 2;
+
+VaapiEncStitcherH264::VaapiEncStitcherH264()
+{
+    reset();
+}
+
+void VaapiEncStitcherH264::reset()
+{
+    m_parser = Parser();
+    m_sps.clear();
+    m_pps.clear();
+    m_started = false;
+    m_prevIdr = false;
+    m_prevIdrPicId = 0;
+    m_prevRefFrameNum = 0;
+}
+
+bool VaapiEncStitcherH264::checkParameterSet(std::vector<Nal>& sets, uint32_t id, const uint8_t* nal, int32_t size)
+{
+    if (sets.size() <= id)
+        sets.resize(id + 1);
+    Nal& set = sets[id];
+    if (set.empty()) {
+        set.assign(nal, nal + size);
+        return true;
+    }
+    if (set.size() != (size_t)size || memcmp(&set[0], nal, size)) {
+        ERROR("parameter set %d differs from the first chunk", id);
+        return false;
+    }
+    return true;
+}
+
+bool VaapiEncStitcherH264::checkSlice(const SliceHeader& slice, const NalUnit& nalu, bool chunkStart)
+{
+    bool idr = nalu.m_idrPicFlag;
+    if ((chunkStart || !m_started) && !idr) {
+        ERROR("chunk does not start with an IDR");
+        return false;
+    }
+    const SharedPtr<SPS>& sps = slice.m_pps->m_sps;
+    if (idr) {
+        if (slice.frame_num || (!sps->pic_order_cnt_type && slice.pic_order_cnt_lsb)) {
+            ERROR("IDR with frame_num %d, poc lsb %d", slice.frame_num, slice.pic_order_cnt_lsb);
+            return false;
+        }
+        if (m_prevIdr && slice.idr_pic_id == m_prevIdrPicId) {
+            ERROR("back to back IDRs share idr_pic_id %d", slice.idr_pic_id);
+            return false;
+        }
+        m_prevIdrPicId = slice.idr_pic_id;
+        m_prevRefFrameNum = 0;
+    } else {
+        uint32_t next = (m_prevRefFrameNum + 1) % sps->m_maxFrameNum;
+        if (slice.frame_num != m_prevRefFrameNum && slice.frame_num != next) {
+            ERROR("frame_num jumps from %d to %d", m_prevRefFrameNum, slice.frame_num);
+            return false;
+        }
+        if (nalu.nal_ref_idc)
+            m_prevRefFrameNum = slice.frame_num;
+    }
+    m_prevIdr = idr;
+    m_started = true;
+    return true;
+}
+
+static void nalToRbsp(const uint8_t* nal, int32_t size, std::vector<uint8_t>& rbsp)
+{
+    uint32_t zeros = 0;
+    for (int32_t i = 0; i < size; i++) {
+        if (zeros >= 2 && nal[i] == 0x03) {
+            zeros = 0;
+            continue;
+        }
+        zeros = nal[i] ? 0 : zeros + 1;
+        rbsp.push_back(nal[i]);
+    }
+}
+
+static void rbspToNal(const uint8_t* rbsp, uint32_t size, std::vector<uint8_t>& nal)
+{
+    uint32_t zeros = 0;
+    for (uint32_t i = 0; i < size; i++) {
+        if (zeros >= 2 && rbsp[i] <= 0x03) {
+            nal.push_back(0x03);
+            zeros = 0;
+        }
+        zeros = rbsp[i] ? 0 : zeros + 1;
+        nal.push_back(rbsp[i]);
+    }
+    //cabac_zero_words end in an emulation prevention byte
+    if (zeros)
+        nal.push_back(0x03);
+}
+
+static bool readUe(BitReader& br, uint32_t& v)
+{
+    uint32_t zeros = 0;
+    uint32_t bit;
+    while (1) {
+        if (!br.read(bit, 1))
+            return false;
+        if (bit)
+            break;
+        if (++zeros > 31)
+            return false;
+    }
+    uint32_t rest = 0;
+    if (zeros && !br.read(rest, zeros))
+        return false;
+    v = (1u << zeros) - 1 + rest;
+    return true;
+}
+
+static void writeUe(BitWriter& bw, uint32_t v)
+{
+    uint32_t code = v + 1;
+    uint32_t bits = 0;
+    for (uint32_t c = code; c; c >>= 1)
+        bits++;
+    bw.writeBits(0, bits - 1);
+    bw.writeBits(code, bits);
+}
+
+static bool copyBits(BitReader& br, BitWriter& bw, uint64_t bits)
+{
+    while (bits) {
+        uint32_t n = bits > 32 ? 32 : bits;
+        uint32_t v;
+        if (!br.read(v, n))
+            return false;
+        bw.writeBits(v, n);
+        bits -= n;
+    }
+    return true;
+}
+
+//an idr_pic_id with the same ue(v) length when there is one, the slice data stays in place
+uint32_t VaapiEncStitcherH264::otherIdrPicId(uint32_t idrPicId)
+{
+    uint32_t bits = 0;
+    for (uint32_t code = idrPicId + 1; code > 1; code >>= 1)
+        bits++;
+    uint32_t first = (1u << bits) - 1;
+    uint32_t last = std::min((2u << bits) - 2, (uint32_t)MAX_IDR_PIC_ID);
+    if (idrPicId != first)
+        return first;
+    if (idrPicId != last)
+        return last;
+    return idrPicId < MAX_IDR_PIC_ID ? idrPicId + 1 : idrPicId - 1;
+}
+
+/* appends nal to out with idr_pic_id replaced; everything up to it is parsed
+ * again, the rest of the header is copied and the slice data follows at its
+ * new bit position, cabac data after cabac_alignment_one_bit */
+bool VaapiEncStitcherH264::rewriteIdrPicId(const uint8_t* nal, int32_t size, const NalUnit& nalu,
+    const SliceHeader& slice, uint32_t idrPicId, std::vector<uint8_t>& out)
+{
+    std::vector<uint8_t> rbsp;
+    nalToRbsp(nal, size, rbsp);
+    const SharedPtr<PPS>& pps = slice.m_pps;
+    const SharedPtr<SPS>& sps = pps->m_sps;
+
+    BitReader br(&rbsp[0], rbsp.size());
+    uint32_t v;
+    br.skip(nalu.m_nalUnitHeaderBytes * 8);
+    if (!readUe(br, v) || !readUe(br, v) || !readUe(br, v)) //first_mb_in_slice, slice_type, pps id
+        return false;
+    if (sps->separate_colour_plane_flag)
+        br.skip(2);
+    br.skip(sps->log2_max_frame_num_minus4 + 4);
+    if (!sps->frame_mbs_only_flag && br.read(1))
+        br.skip(1); //bottom_field_flag
+    uint64_t idStart = br.getPos();
+    if (!readUe(br, v))
+        return false;
+    uint64_t idEnd = br.getPos();
+    //same bit position the decoder hands to the driver
+    uint64_t headerEnd = slice.m_headerSize
+        + ((nalu.m_nalUnitHeaderBytes - slice.m_emulationPreventionBytes) << 3);
+    if (headerEnd < idEnd || headerEnd > rbsp.size() * 8)
+        return false;
+
+    BitWriter bw(rbsp.size() + 8);
+    BitReader in(&rbsp[0], rbsp.size());
+    if (!copyBits(in, bw, idStart))
+        return false;
+    in.skip(idEnd - idStart);
+    writeUe(bw, idrPicId);
+    if (!copyBits(in, bw, headerEnd - idEnd))
+        return false;
+
+    if (pps->entropy_coding_mode_flag) {
+        //cabac_alignment_one_bit, then the byte aligned slice data and cabac_zero_words
+        while (bw.getCodedBitsCount() % 8)
+            bw.writeBits(1, 1);
+        uint32_t dataStart = (headerEnd + 7) / 8;
+        if (dataStart < rbsp.size())
+            bw.writeBytes(&rbsp[dataStart], rbsp.size() - dataStart);
+    } else {
+        //the slice data up to rbsp_stop_one_bit, which moves with it
+        size_t last = rbsp.size();
+        while (last && !rbsp[last - 1])
+            last--;
+        if (!last)
+            return false;
+        uint32_t trailing = 0;
+        while (!(rbsp[last - 1] & (1 << trailing)))
+            trailing++;
+        uint64_t stopBit = (uint64_t)last * 8 - 1 - trailing;
+        if (stopBit < headerEnd || !copyBits(in, bw, stopBit - headerEnd))
+            return false;
+        bw.writeBits(1, 1);
+        bw.writeToBytesAligned();
+    }
+    rbspToNal(bw.getBitWriterData(), bw.getCodedBitsCount() / 8, out);
+    return true;
+}
+
+bool VaapiEncStitcherH264::append(std::vector<uint8_t>& au, bool chunkStart)
+{
+    const uint8_t* data = &au[0];
+    uint32_t size = au.size();
+    NalReader nr(data, size);
+    const uint8_t* nal;
+    int32_t nalSize;
+    bool hasSlice = false;
+    //replacement for a repeated idr_pic_id, -1 keeps the one coded
+    int32_t idrPicId = -1;
+    std::vector<uint8_t> rewritten;
+    const uint8_t* copied = data;
+    while (nr.read(nal, nalSize)) {
+        NalUnit nalu;
+        if (!nalu.parseNalUnit(nal, nalSize))
+            return false;
+        switch (nalu.nal_unit_type) {
+        case NAL_SPS: {
+            SharedPtr<SPS> sps(new SPS());
+            memset(sps.get(), 0, sizeof(SPS));
+            if (!m_parser.parseSps(sps, &nalu)
+                || !checkParameterSet(m_sps, sps->sps_id, nal, nalSize))
+                return false;
+            break;
+        }
+        case NAL_PPS: {
+            SharedPtr<PPS> pps(new PPS());
+            memset(static_cast<void*>(pps.get()), 0, sizeof(PPS));
+            if (!m_parser.parsePps(pps, &nalu)
+                || !checkParameterSet(m_pps, pps->pps_id, nal, nalSize))
+                return false;
+            break;
+        }
+        case NAL_SLICE_IDR:
+        case NAL_SLICE_NONIDR: {
+            //the first slice speaks for the whole picture, the others only follow a rewrite
+            if (hasSlice && idrPicId < 0)
+                break;
+            SliceHeader slice;
+            if (!slice.parseHeader(&m_parser, &nalu))
+                return false;
+            if (!hasSlice) {
+                if (nalu.m_idrPicFlag && m_prevIdr && slice.idr_pic_id == m_prevIdrPicId) {
+                    idrPicId = otherIdrPicId(slice.idr_pic_id);
+                    DEBUG("back to back IDRs share idr_pic_id %d, use %d", slice.idr_pic_id, idrPicId);
+                    slice.idr_pic_id = idrPicId;
+                }
+                if (!checkSlice(slice, nalu, chunkStart))
+                    return false;
+                hasSlice = true;
+            }
+            if (idrPicId >= 0 && nalu.m_idrPicFlag) {
+                rewritten.insert(rewritten.end(), copied, nal);
+                if (!rewriteIdrPicId(nal, nalSize, nalu, slice, idrPicId, rewritten)) {
+                    ERROR("failed to rewrite idr_pic_id");
+                    return false;
+                }
+                copied = nal + nalSize;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    if (!hasSlice) {
+        ERROR("access unit without slices");
+        return false;
+    }
+    if (idrPicId >= 0) {
+        rewritten.insert(rewritten.end(), copied, data + size);
+        au.swap(rewritten);
+    }
+    return true;
+}
+
+uint32_t VaapiEncStitcherH264::frameDataOffset(const uint8_t* data, uint32_t size)
+{
+    NalReader nr(data, size);
+    const uint8_t* nal;
+    int32_t nalSize;
+    while (nr.read(nal, nalSize)) {
+        uint8_t type = nal[0] & 0x1f;
+        if (type == NAL_SPS || type == NAL_PPS)
+            continue;
+        //back over the start code, zero_byte included
+        uint32_t offset = nal - data;
+        return (offset >= 4 && !data[offset - 4]) ? offset - 4 : offset - 3;
+    }
+    return size;
+}
+
+VaapiEncoderChunked::VaapiEncoderChunked(const char* mimeType, uint32_t sessions, uint32_t framesPerChunk)
+    : m_mimeType(mimeType ? mimeType : "")
+    , m_framesPerChunk(framesPerChunk)
+    , m_chunkFrames(0)
+    , m_maxOutSize(0)
+    , m_cond(m_lock)
+    , m_started(false)
+    , m_quit(false)
+{
+    m_sessions.resize(sessions);
+}
+
+VaapiEncoderChunked::~VaapiEncoderChunked()
+{
+    stop();
+}
+
+bool VaapiEncoderChunked::init()
+{
+    if (m_mimeType != YAMI_MIME_H264 && m_mimeType != YAMI_MIME_AVC) {
+        ERROR("chunked encode does not support %s", m_mimeType.c_str());
+        return false;
+    }
+    if (m_sessions.empty())
+        return false;
+    for (size_t i = 0; i < m_sessions.size(); i++) {
+        Session& session = m_sessions[i];
+        session.owner = this;
+        session.encoder.reset(createVideoEncoder(m_mimeType.c_str()), releaseVideoEncoder);
+        if (!session.encoder)
+            return false;
+    }
+    return true;
+}
+
+void VaapiEncoderChunked::setNativeDisplay(NativeDisplay* display)
+{
+    for (size_t i = 0; i < m_sessions.size(); i++)
+        m_sessions[i].encoder->setNativeDisplay(display);
+}
+
+YamiStatus VaapiEncoderChunked::start(void)
+{
+    if (m_started)
+        return YAMI_SUCCESS;
+
+    //chunks are cut at key periods, so the stream gets the IDRs one session would give it
+    VideoParamsCommon common;
+    common.size = sizeof(common);
+    VideoParamsAVC avc;
+    avc.size = sizeof(avc);
+    const EncoderPtr& first = m_sessions[0].encoder;
+    if (first->getParameters(VideoParamsTypeCommon, &common) != YAMI_SUCCESS
+        || first->getParameters(VideoParamsTypeAVC, &avc) != YAMI_SUCCESS)
+        return YAMI_FAIL;
+    uint32_t keyPeriod = (common.intraPeriod ? common.intraPeriod : 1) * (avc.idrInterval + 1);
+    m_chunkFrames = (m_framesPerChunk + keyPeriod - 1) / keyPeriod * keyPeriod;
+
+    for (size_t i = 0; i < m_sessions.size(); i++) {
+        YamiStatus status = m_sessions[i].encoder->start();
+        if (status != YAMI_SUCCESS)
+            return status;
+    }
+    if (first->getMaxOutSize(&m_maxOutSize) != YAMI_SUCCESS)
+        return YAMI_FAIL;
+    //every session has the same SPS/PPS, take them while the first one is idle
+    std::vector<uint8_t> buffer(m_maxOutSize);
+    VideoEncOutputBuffer out;
+    out.data = &buffer[0];
+    out.bufferSize = buffer.size();
+    out.format = OUTPUT_CODEC_DATA;
+    out.flag = 0;
+    out.dataSize = 0;
+#ifndef __BUILD_GET_MV__
+    YamiStatus status = first->getOutput(&out);
+#else
+    VideoEncMVBuffer mvBuffer;
+    mvBuffer.data = NULL;
+    mvBuffer.bufferSize = 0;
+    YamiStatus status = first->getOutput(&out, &mvBuffer);
+#endif
+    if (status == YAMI_SUCCESS)
+        m_codecData.assign(buffer.begin(), buffer.begin() + out.dataSize);
+    else
+        m_codecData.clear();
+
+    m_quit = false;
+    m_stitcher.reset();
+    for (size_t i = 0; i < m_sessions.size(); i++) {
+        if (pthread_create(&m_sessions[i].thread, NULL, sessionThread, &m_sessions[i]) != 0) {
+            ERROR("failed to create thread for session %d", (int)i);
+            {
+                AutoLock l(m_lock);
+                m_quit = true;
+                m_cond.broadcast();
+            }
+            for (size_t j = 0; j < i; j++)
+                pthread_join(m_sessions[j].thread, NULL);
+            for (size_t j = 0; j < m_sessions.size(); j++)
+                m_sessions[j].encoder->stop();
+            return YAMI_FAIL;
+        }
+    }
+    m_started = true;
+    INFO("chunked encode on %d sessions, %d frames per chunk", (int)m_sessions.size(), m_chunkFrames);
+    return YAMI_SUCCESS;
+}
+
+YamiStatus VaapiEncoderChunked::stop(void)
+{
+    if (!m_started)
+        return YAMI_SUCCESS;
+    {
+        AutoLock l(m_lock);
+        m_quit = true;
+        m_cond.broadcast();
+    }
+    for (size_t i = 0; i < m_sessions.size(); i++) {
+        pthread_join(m_sessions[i].thread, NULL);
+        m_sessions[i].encoder->stop();
+    }
+    m_started = false;
+
+    AutoLock l(m_lock);
+    m_chunks.clear();
+    m_todo.clear();
+    m_filling.reset();
+    return YAMI_SUCCESS;
+}
+
+void* VaapiEncoderChunked::sessionThread(void* arg)
+{
+    Session* session = static_cast<Session*>(arg);
+    session->owner->sessionLoop(*session);
+    return NULL;
+}
+
+bool VaapiEncoderChunked::quitting()
+{
+    AutoLock l(m_lock);
+    return m_quit;
+}
+
+void VaapiEncoderChunked::sessionLoop(Session& session)
+{
+    while (1) {
+        ChunkPtr chunk;
+        {
+            AutoLock l(m_lock);
+            while (!m_quit && m_todo.empty())
+                m_cond.wait();
+            if (m_quit)
+                return;
+            chunk = m_todo.front();
+            m_todo.pop_front();
+        }
+        YamiStatus status = encodeChunk(session.encoder, chunk);
+        {
+            AutoLock l(m_lock);
+            chunk->input.clear();
+            chunk->status = status;
+            chunk->done = true;
+            m_cond.broadcast();
+            m_notifier.notify();
+        }
+    }
+}
+
+YamiStatus VaapiEncoderChunked::collect(const EncoderPtr& encoder, const ChunkPtr& chunk, std::vector<uint8_t>& buffer)
+{
+    VideoEncOutputBuffer out;
+    out.data = &buffer[0];
+    out.bufferSize = buffer.size();
+    out.format = OUTPUT_EVERYTHING;
+#ifndef __BUILD_GET_MV__
+    YamiStatus status = encoder->getOutput(&out);
+#else
+    uint32_t mvSize;
+    encoder->getMVBufferSize(&mvSize);
+    std::vector<uint8_t> mv(mvSize + 1);
+    VideoEncMVBuffer mvBuffer;
+    mvBuffer.data = &mv[0];
+    mvBuffer.bufferSize = mvSize;
+    YamiStatus status = encoder->getOutput(&out, &mvBuffer);
+#endif
+    if (status != YAMI_SUCCESS)
+        return status;
+    chunk->output.push_back(Output());
+    Output& output = chunk->output.back();
+    output.data.assign(out.data, out.data + out.dataSize);
+    output.flag = out.flag;
+    output.timeStamp = out.timeStamp;
+    output.temporalId = out.temporalId;
+    output.stitched = false;
+    return YAMI_SUCCESS;
+}
+
+YamiStatus VaapiEncoderChunked::encodeChunk(const EncoderPtr& encoder, const ChunkPtr& chunk)
+{
+    //a fresh gop, the first frame becomes an IDR
+    encoder->flush();
+
+    std::vector<uint8_t> buffer(m_maxOutSize);
+    YamiStatus status;
+    for (size_t i = 0; i < chunk->input.size(); i++) {
+        if (quitting())
+            return YAMI_FAIL;
+        while ((status = encoder->encode(chunk->input[i])) == YAMI_ENCODE_IS_BUSY) {
+            status = collect(encoder, chunk, buffer);
+            if (status != YAMI_SUCCESS)
+                return status;
+        }
+        if (status != YAMI_SUCCESS)
+            return status;
+    }
+    //end of stream for this session, pending B frames get encoded too
+    status = encoder->encode(SharedPtr<VideoFrame>());
+    if (status != YAMI_SUCCESS)
+        return status;
+    while ((status = collect(encoder, chunk, buffer)) == YAMI_SUCCESS)
+        ;
+    return status == YAMI_ENCODE_BUFFER_NO_MORE ? YAMI_SUCCESS : status;
+}
+
+void VaapiEncoderChunked::closeChunk()
+{
+    if (!m_filling)
+        return;
+    m_todo.push_back(m_filling);
+    m_filling.reset();
+    m_cond.broadcast();
+}
+
+YamiStatus VaapiEncoderChunked::encode(VideoEncRawBuffer* inBuffer)
+{
+    if (!inBuffer)
+        return YAMI_SUCCESS;
+    if (!inBuffer->data && !inBuffer->size) {
+        inBuffer->bufAvailable = true;
+        return encode(SharedPtr<VideoFrame>());
+    }
+    ERROR("chunked encode takes VideoFrame input only");
+    return YAMI_UNSUPPORTED;
+}
+
+YamiStatus VaapiEncoderChunked::encode(VideoFrameRawData* frame)
+{
+    ERROR("chunked encode takes VideoFrame input only");
+    return YAMI_UNSUPPORTED;
+}
+
+YamiStatus VaapiEncoderChunked::encode(const SharedPtr<VideoFrame>& frame)
+{
+    if (!m_started)
+        return YAMI_FAIL;
+    AutoLock l(m_lock);
+    if (!frame) {
+        closeChunk();
+        return YAMI_SUCCESS;
+    }
+    //a forced key frame opens a new chunk
+    if (frame->flags & VIDEO_FRAME_FLAGS_KEY)
+        closeChunk();
+    if (!m_filling) {
+        if (m_chunks.size() >= m_sessions.size() * CHUNKS_PER_SESSION)
+            return YAMI_ENCODE_IS_BUSY;
+        m_filling.reset(new Chunk);
+        m_filling->status = YAMI_SUCCESS;
+        m_filling->done = false;
+        m_filling->first = true;
+        m_chunks.push_back(m_filling);
+    }
+    m_filling->input.push_back(frame);
+    if (m_filling->input.size() >= m_chunkFrames)
+        closeChunk();
+    return YAMI_SUCCESS;
+}
+
+#ifndef __BUILD_GET_MV__
+YamiStatus VaapiEncoderChunked::getOutput(VideoEncOutputBuffer* outBuffer, bool withWait)
+#else
+YamiStatus VaapiEncoderChunked::getOutput(VideoEncOutputBuffer* outBuffer, VideoEncMVBuffer* MVBuffer, bool withWait)
+#endif
+{
+    if (!outBuffer)
+        return YAMI_INVALID_PARAM;
+    if (outBuffer->format == OUTPUT_CODEC_DATA)
+        return getCodecData(outBuffer);
+    if (outBuffer->format != OUTPUT_EVERYTHING && outBuffer->format != OUTPUT_FRAME_DATA)
+        return YAMI_UNSUPPORTED;
+
+    AutoLock l(m_lock);
+    while (1) {
+        if (!m_chunks.empty() && m_chunks.front()->done) {
+            ChunkPtr chunk = m_chunks.front();
+            if (chunk->status != YAMI_SUCCESS) {
+                m_chunks.pop_front();
+                m_cond.broadcast();
+                return chunk->status;
+            }
+            if (!chunk->output.empty())
+                break;
+            m_chunks.pop_front();
+            m_cond.broadcast();
+            continue;
+        }
+        if (!withWait || m_quit)
+            return YAMI_ENCODE_BUFFER_NO_MORE;
+        m_cond.wait();
+    }
+
+    ChunkPtr chunk = m_chunks.front();
+    Output& output = chunk->output.front();
+    if (!output.stitched) {
+        if (!m_stitcher.append(output.data, chunk->first)) {
+            //the rest of the chunk can not join either, go on with the next IDR
+            ERROR("drop chunk, it does not join the stream");
+            m_stitcher.reset();
+            m_chunks.pop_front();
+            m_cond.broadcast();
+            m_notifier.notify();
+            return YAMI_FAIL;
+        }
+        output.stitched = true;
+        chunk->first = false;
+    }
+    uint32_t offset = 0;
+    if (outBuffer->format == OUTPUT_FRAME_DATA)
+        offset = VaapiEncStitcherH264::frameDataOffset(&output.data[0], output.data.size());
+    uint32_t size = output.data.size() - offset;
+    if (size > outBuffer->bufferSize)
+        return YAMI_ENCODE_BUFFER_TOO_SMALL;
+
+    memcpy(outBuffer->data, &output.data[0] + offset, size);
+    outBuffer->dataSize = size;
+    outBuffer->flag = output.flag;
+    outBuffer->timeStamp = output.timeStamp;
+    outBuffer->temporalId = output.temporalId;
+    chunk->output.pop_front();
+    if (chunk->output.empty()) {
+        m_chunks.pop_front();
+        m_cond.broadcast();
+        //room for a new chunk, encode() is no longer busy
+        m_notifier.notify();
+    }
+    return YAMI_SUCCESS;
+}
+
+YamiStatus VaapiEncoderChunked::getCodecData(VideoEncOutputBuffer* outBuffer)
+{
+    if (m_codecData.empty())
+        return YAMI_ENCODE_NO_REQUEST_DATA;
+    if (m_codecData.size() > outBuffer->bufferSize)
+        return YAMI_ENCODE_BUFFER_TOO_SMALL;
+    memcpy(outBuffer->data, &m_codecData[0], m_codecData.size());
+    outBuffer->dataSize = m_codecData.size();
+    outBuffer->flag = ENCODE_BUFFERFLAG_CODECCONFIG;
+    return YAMI_SUCCESS;
+}
+
+#ifdef __BUILD_GET_MV__
+YamiStatus VaapiEncoderChunked::getMVBufferSize(uint32_t* Size)
+{
+    *Size = 0;
+    return YAMI_SUCCESS;
+}
+#endif
+
+YamiStatus VaapiEncoderChunked::getParameters(VideoParamConfigType type, Yami_PTR videoEncParams)
+{
+    return m_sessions[0].encoder->getParameters(type, videoEncParams);
+}
+
+YamiStatus VaapiEncoderChunked::setParameters(VideoParamConfigType type, Yami_PTR videoEncParams)
+{
+    //every session shares the same targets, rate control included
+    YamiStatus status = YAMI_SUCCESS;
+    for (size_t i = 0; i < m_sessions.size() && status == YAMI_SUCCESS; i++)
+        status = m_sessions[i].encoder->setParameters(type, videoEncParams);
+    return status;
+}
+
+YamiStatus VaapiEncoderChunked::getMaxOutSize(uint32_t* maxSize)
+{
+    if (!m_started)
+        return m_sessions[0].encoder->getMaxOutSize(maxSize);
+    *maxSize = m_maxOutSize;
+    return YAMI_SUCCESS;
+}
+
+//the sessions keep no statistics and number their frames per chunk
+YamiStatus VaapiEncoderChunked::getStatistics(VideoStatistics* videoStat)
+{
+    return YAMI_UNSUPPORTED;
+}
+
+int VaapiEncoderChunked::getEventFd()
+{
+    return m_notifier.fd();
+}
+
+YamiStatus VaapiEncoderChunked::setSchedulePriority(uint32_t priority)
+{
+    for (size_t i = 0; i < m_sessions.size(); i++) {
+        YamiStatus status = m_sessions[i].encoder->setSchedulePriority(priority);
+        if (status != YAMI_SUCCESS)
+            return status;
+    }
+    return YAMI_SUCCESS;
+}
+
+//all sessions together
+YamiStatus VaapiEncoderChunked::getScheduleStats(VideoScheduleStats* stats)
+{
+    if (!stats)
+        return YAMI_INVALID_PARAM;
+    memset(stats, 0, sizeof(*stats));
+    for (size_t i = 0; i < m_sessions.size(); i++) {
+        VideoScheduleStats one;
+        YamiStatus status = m_sessions[i].encoder->getScheduleStats(&one);
+        if (status != YAMI_SUCCESS)
+            return status;
+        stats->jobs += one.jobs;
+        stats->totalQueueUs += one.totalQueueUs;
+        if (one.maxQueueUs > stats->maxQueueUs)
+            stats->maxQueueUs = one.maxQueueUs;
+    }
+    return YAMI_SUCCESS;
+}
+
+void VaapiEncoderChunked::flush(void)
+{
+    AutoLock l(m_lock);
+    //chunks already in a session finish there and are dropped
+    m_chunks.clear();
+    m_todo.clear();
+    m_filling.reset();
+    m_stitcher.reset();
+    m_cond.broadcast();
+}
+
+YamiStatus VaapiEncoderChunked::getConfig(VideoParamConfigType type, Yami_PTR videoEncConfig)
+{
+    return m_sessions[0].encoder->getConfig(type, videoEncConfig);
+}
+
+YamiStatus VaapiEncoderChunked::setConfig(VideoParamConfigType type, Yami_PTR videoEncConfig)
+{
+    if (type == VideoConfigTypeIDRRequest) {
+        //the next frame opens a new chunk, and so an IDR
+        AutoLock l(m_lock);
+        closeChunk();
+        return YAMI_SUCCESS;
+    }
+    YamiStatus status = YAMI_SUCCESS;
+    for (size_t i = 0; i < m_sessions.size() && status == YAMI_SUCCESS; i++)
+        status = m_sessions[i].encoder->setConfig(type, videoEncConfig);
+    return status;
+}
+}
+
+using namespace YamiMediaCodec;
+
+extern "C" {
+
+IVideoEncoder* createChunkedVideoEncoder(const char* mimeType, uint32_t sessions, uint32_t framesPerChunk)
+{
+    yamiTraceInit();
+
+    VaapiEncoderChunked* enc = new VaapiEncoderChunked(mimeType, sessions, framesPerChunk);
+    if (!enc->init()) {
+        ERROR("Failed to create chunked encoder for mimeType: '%s'", mimeType ? mimeType : "");
+        delete enc;
+        return NULL;
+    }
+    return enc;
+}
+
+} // extern "C"
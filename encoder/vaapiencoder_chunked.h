@@ -0,0 +1,165 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef vaapiencoder_chunked_h
+#define vaapiencoder_chunked_h
+
+#include "interface/VideoEncoderDefs.h"
+#include "interface/VideoEncoderInterface.h"
+#include "codecparsers/h264Parser.h"
+#include "common/condition.h"
+#include "common/eventnotifier.h"
+#include "common/lock.h"
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+namespace YamiMediaCodec{
+
+/*
+ * Checks that encoded H.264 access units, handed in stream order, join into
+ * one conformant stream: repeated SPS/PPS must match the first ones byte for
+ * byte, frame_num must not jump, and every chunk has to start with an IDR.
+ * Back to back IDRs need distinct idr_pic_id; sessions count them on their
+ * own, so an IDR repeating the one before gets its slice headers rewritten.
+ */
+class VaapiEncStitcherH264 {
+public:
+    VaapiEncStitcherH264();
+    /// au may be rewritten in place
+    bool append(std::vector<uint8_t>& au, bool chunkStart);
+    void reset();
+    /// where the access unit continues after the SPS/PPS sessions put in front of IDRs
+    static uint32_t frameDataOffset(const uint8_t* data, uint32_t size);
+
+private:
+    typedef std::vector<uint8_t> Nal;
+    bool checkParameterSet(std::vector<Nal>& sets, uint32_t id, const uint8_t* nal, int32_t size);
+    bool checkSlice(const YamiParser::H264::SliceHeader&, const YamiParser::H264::NalUnit&, bool chunkStart);
+    static uint32_t otherIdrPicId(uint32_t idrPicId);
+    static bool rewriteIdrPicId(const uint8_t* nal, int32_t size, const YamiParser::H264::NalUnit&,
+        const YamiParser::H264::SliceHeader&, uint32_t idrPicId, std::vector<uint8_t>& out);
+
+    YamiParser::H264::Parser m_parser;
+    std::vector<Nal> m_sps;
+    std::vector<Nal> m_pps;
+    bool m_started;
+    bool m_prevIdr;
+    uint32_t m_prevIdrPicId;
+    uint32_t m_prevRefFrameNum;
+};
+
+/*
+ * Encodes one stream on several encoder sessions at once. Input frames are
+ * cut into chunks of whole closed GOPs, each chunk goes to a free session
+ * which starts it with an IDR, and getOutput() hands the frames back in
+ * input order as a single elementary stream.
+ * Only SharedPtr<VideoFrame> input is taken, raw buffers are reused by the
+ * caller before a chunk gets encoded.
+ */
+class VaapiEncoderChunked : public IVideoEncoder {
+public:
+    VaapiEncoderChunked(const char* mimeType, uint32_t sessions, uint32_t framesPerChunk);
+    virtual ~VaapiEncoderChunked();
+
+    bool init();
+
+    virtual void setNativeDisplay(NativeDisplay* display = NULL);
+    virtual YamiStatus start(void);
+    virtual YamiStatus stop(void);
+    virtual YamiStatus encode(VideoEncRawBuffer* inBuffer);
+    virtual YamiStatus encode(VideoFrameRawData* frame);
+    virtual YamiStatus encode(const SharedPtr<VideoFrame>& frame);
+    virtual YamiStatus encodeBatch(const SharedPtr<VideoFrame>* frames, VideoEncOutputBuffer* outputs, uint32_t count)
+    {
+        return YAMI_UNSUPPORTED;
+    }
+#ifndef __BUILD_GET_MV__
+    virtual YamiStatus getOutput(VideoEncOutputBuffer* outBuffer, bool withWait = false);
+#else
+    virtual YamiStatus getOutput(VideoEncOutputBuffer* outBuffer, VideoEncMVBuffer* MVBuffer, bool withWait = false);
+    virtual YamiStatus getMVBufferSize(uint32_t* Size);
+#endif
+    virtual YamiStatus getParameters(VideoParamConfigType type, Yami_PTR videoEncParams);
+    virtual YamiStatus setParameters(VideoParamConfigType type, Yami_PTR videoEncParams);
+    virtual YamiStatus getMaxOutSize(uint32_t* maxSize);
+    virtual YamiStatus getStatistics(VideoStatistics* videoStat);
+    virtual int getEventFd();
+    virtual YamiStatus setSchedulePriority(uint32_t priority);
+    virtual YamiStatus getScheduleStats(VideoScheduleStats* stats);
+    virtual void flush(void);
+    virtual YamiStatus getConfig(VideoParamConfigType type, Yami_PTR videoEncConfig);
+    virtual YamiStatus setConfig(VideoParamConfigType type, Yami_PTR videoEncConfig);
+
+private:
+    struct Output {
+        std::vector<uint8_t> data;
+        uint32_t flag;
+        uint64_t timeStamp;
+        uint32_t temporalId;
+        //went through the stitcher already, a retry with a bigger buffer skips it
+        bool stitched;
+    };
+    struct Chunk {
+        std::vector<SharedPtr<VideoFrame> > input;
+        std::deque<Output> output;
+        YamiStatus status;
+        bool done;
+        //the first output has not been handed out yet
+        bool first;
+    };
+    typedef SharedPtr<Chunk> ChunkPtr;
+    typedef SharedPtr<IVideoEncoder> EncoderPtr;
+    struct Session {
+        VaapiEncoderChunked* owner;
+        EncoderPtr encoder;
+        pthread_t thread;
+    };
+
+    static void* sessionThread(void*);
+    void sessionLoop(Session&);
+    YamiStatus encodeChunk(const EncoderPtr&, const ChunkPtr&);
+    YamiStatus collect(const EncoderPtr&, const ChunkPtr&, std::vector<uint8_t>& buffer);
+    void closeChunk();
+    bool quitting();
+    YamiStatus getCodecData(VideoEncOutputBuffer* outBuffer);
+
+    std::string m_mimeType;
+    uint32_t m_framesPerChunk;
+    uint32_t m_chunkFrames;
+    uint32_t m_maxOutSize;
+    //SPS/PPS of the first session for OUTPUT_CODEC_DATA
+    std::vector<uint8_t> m_codecData;
+    std::vector<Session> m_sessions;
+    VaapiEncStitcherH264 m_stitcher;
+
+    Lock m_lock;
+    Condition m_cond;
+    EventNotifier m_notifier;
+    //every chunk not fully handed out yet, in stream order
+    std::deque<ChunkPtr> m_chunks;
+    //closed chunks waiting for a session
+    std::deque<ChunkPtr> m_todo;
+    ChunkPtr m_filling;
+    bool m_started;
+    bool m_quit;
+
+    DISALLOW_COPY_AND_ASSIGN(VaapiEncoderChunked);
+};
+}
+#endif /* vaapiencoder_chunked_h */
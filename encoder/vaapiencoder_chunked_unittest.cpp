@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// library headers
+#include "common/unittest.h"
+
+// primary header
+#include "vaapiencoder_chunked.h"
+
+#include "codecparsers/bitWriter.h"
+
+namespace YamiMediaCodec {
+
+using YamiParser::BitWriter;
+
+class VaapiEncStitcherH264Test
+    : public ::testing::Test {
+protected:
+    typedef std::vector<uint8_t> AccessUnit;
+
+    static void writeUe(BitWriter& bw, uint32_t value)
+    {
+        uint32_t code = value + 1;
+        uint32_t bits = 0;
+        for (uint32_t v = code; v; v >>= 1)
+            bits++;
+        bw.writeBits(0, bits - 1);
+        bw.writeBits(code, bits);
+    }
+
+    static void appendNal(AccessUnit& au, uint8_t header, BitWriter& bw)
+    {
+        //rbsp trailing bits
+        bw.writeBits(1, 1);
+        bw.writeToBytesAligned();
+        const uint8_t startCode[] = { 0, 0, 0, 1 };
+        au.insert(au.end(), startCode, startCode + sizeof(startCode));
+        au.push_back(header);
+        const uint8_t* data = bw.getBitWriterData();
+        uint32_t zeros = 0;
+        for (uint32_t i = 0; i < bw.getCodedBitsCount() / 8; i++) {
+            //emulation prevention
+            if (zeros == 2 && data[i] <= 3) {
+                au.push_back(3);
+                zeros = 0;
+            }
+            zeros = data[i] ? 0 : zeros + 1;
+            au.push_back(data[i]);
+        }
+    }
+
+    //a 16x16 baseline stream, MaxFrameNum and MaxPicOrderCntLsb are 16
+    static void appendParameterSets(AccessUnit& au, uint32_t level)
+    {
+        BitWriter sps;
+        sps.writeBits(66, 8); //profile_idc
+        sps.writeBits(0, 8); //constraint flags
+        sps.writeBits(level, 8);
+        writeUe(sps, 0); //seq_parameter_set_id
+        writeUe(sps, 0); //log2_max_frame_num_minus4
+        writeUe(sps, 0); //pic_order_cnt_type
+        writeUe(sps, 0); //log2_max_pic_order_cnt_lsb_minus4
+        writeUe(sps, 1); //max_num_ref_frames
+        sps.writeBits(0, 1); //gaps_in_frame_num_value_allowed_flag
+        writeUe(sps, 0); //pic_width_in_mbs_minus1
+        writeUe(sps, 0); //pic_height_in_map_units_minus1
+        sps.writeBits(1, 1); //frame_mbs_only_flag
+        sps.writeBits(1, 1); //direct_8x8_inference_flag
+        sps.writeBits(0, 1); //frame_cropping_flag
+        sps.writeBits(0, 1); //vui_parameters_present_flag
+        appendNal(au, 0x67, sps);
+
+        BitWriter pps;
+        writeUe(pps, 0); //pic_parameter_set_id
+        writeUe(pps, 0); //seq_parameter_set_id
+        pps.writeBits(0, 1); //entropy_coding_mode_flag
+        pps.writeBits(0, 1); //bottom_field_pic_order_in_frame_present_flag
+        writeUe(pps, 0); //num_slice_groups_minus1
+        writeUe(pps, 0); //num_ref_idx_l0_default_active_minus1
+        writeUe(pps, 0); //num_ref_idx_l1_default_active_minus1
+        pps.writeBits(0, 1); //weighted_pred_flag
+        pps.writeBits(0, 2); //weighted_bipred_idc
+        writeUe(pps, 0); //pic_init_qp_minus26
+        writeUe(pps, 0); //pic_init_qs_minus26
+        writeUe(pps, 0); //chroma_qp_index_offset
+        pps.writeBits(0, 1); //deblocking_filter_control_present_flag
+        pps.writeBits(0, 1); //constrained_intra_pred_flag
+        pps.writeBits(0, 1); //redundant_pic_cnt_present_flag
+        appendNal(au, 0x68, pps);
+    }
+
+    static AccessUnit idr(uint32_t idrPicId, uint32_t level = 30)
+    {
+        AccessUnit au;
+        appendParameterSets(au, level);
+        BitWriter slice;
+        writeUe(slice, 0); //first_mb_in_slice
+        writeUe(slice, 7); //slice_type, I
+        writeUe(slice, 0); //pic_parameter_set_id
+        slice.writeBits(0, 4); //frame_num
+        writeUe(slice, idrPicId);
+        slice.writeBits(0, 4); //pic_order_cnt_lsb
+        slice.writeBits(0, 1); //no_output_of_prior_pics_flag
+        slice.writeBits(0, 1); //long_term_reference_flag
+        writeUe(slice, 0); //slice_qp_delta
+        //slice data, needs emulation prevention wherever it lands
+        slice.writeBits(0x5, 3);
+        slice.writeBits(0, 24);
+        slice.writeBits(0x2d, 7);
+        appendNal(au, 0x65, slice);
+        return au;
+    }
+
+    static AccessUnit p(uint32_t frameNum)
+    {
+        AccessUnit au;
+        BitWriter slice;
+        writeUe(slice, 0); //first_mb_in_slice
+        writeUe(slice, 5); //slice_type, P
+        writeUe(slice, 0); //pic_parameter_set_id
+        slice.writeBits(frameNum, 4);
+        slice.writeBits(frameNum * 2, 4); //pic_order_cnt_lsb
+        slice.writeBits(0, 1); //num_ref_idx_active_override_flag
+        slice.writeBits(0, 1); //ref_pic_list_modification_flag_l0
+        slice.writeBits(0, 1); //adaptive_ref_pic_marking_mode_flag
+        writeUe(slice, 0); //slice_qp_delta
+        appendNal(au, 0x41, slice);
+        return au;
+    }
+
+    bool append(AccessUnit au, bool chunkStart = false)
+    {
+        return m_stitcher.append(au, chunkStart);
+    }
+
+    bool append(AccessUnit& au, const AccessUnit& expected, bool chunkStart)
+    {
+        return m_stitcher.append(au, chunkStart) && au == expected;
+    }
+
+    VaapiEncStitcherH264 m_stitcher;
+};
+
+#define VAAPIENC_STITCHER_H264_TEST(name) \
+    TEST_F(VaapiEncStitcherH264Test, name)
+
+VAAPIENC_STITCHER_H264_TEST(ContinuousChunks)
+{
+    EXPECT_TRUE(append(idr(1), true));
+    EXPECT_TRUE(append(p(1)));
+    EXPECT_TRUE(append(p(2)));
+    EXPECT_TRUE(append(idr(1), true));
+    EXPECT_TRUE(append(p(1)));
+}
+
+VAAPIENC_STITCHER_H264_TEST(ChunkWithoutIdr)
+{
+    EXPECT_FALSE(append(p(1), true));
+    EXPECT_TRUE(append(idr(1), true));
+    EXPECT_FALSE(append(p(1), true));
+}
+
+VAAPIENC_STITCHER_H264_TEST(ChangedSps)
+{
+    EXPECT_TRUE(append(idr(1), true));
+    EXPECT_TRUE(append(p(1)));
+    EXPECT_FALSE(append(idr(2, 31), true));
+}
+
+VAAPIENC_STITCHER_H264_TEST(ResetAfterFailure)
+{
+    EXPECT_TRUE(append(idr(1), true));
+    EXPECT_FALSE(append(idr(2, 31), true));
+    //the encoder drops the failed chunk and starts over at the next one
+    m_stitcher.reset();
+    EXPECT_TRUE(append(idr(2, 31), true));
+    EXPECT_TRUE(append(p(1)));
+}
+
+VAAPIENC_STITCHER_H264_TEST(FrameDataOffset)
+{
+    AccessUnit sets;
+    appendParameterSets(sets, 30);
+    AccessUnit key = idr(1);
+    ASSERT_EQ(sets.size(), VaapiEncStitcherH264::frameDataOffset(&key[0], key.size()));
+    EXPECT_EQ(0x65, key[sets.size() + 4]);
+
+    AccessUnit inter = p(1);
+    EXPECT_EQ(0u, VaapiEncStitcherH264::frameDataOffset(&inter[0], inter.size()));
+
+    //three byte start codes
+    AccessUnit shortCodes(sets.begin() + 1, sets.end());
+    shortCodes.insert(shortCodes.end(), inter.begin() + 1, inter.end());
+    EXPECT_EQ(sets.size() - 1, VaapiEncStitcherH264::frameDataOffset(&shortCodes[0], shortCodes.size()));
+
+    //nothing but parameter sets
+    EXPECT_EQ(sets.size(), VaapiEncStitcherH264::frameDataOffset(&sets[0], sets.size()));
+}
+
+VAAPIENC_STITCHER_H264_TEST(FrameNumGap)
+{
+    EXPECT_TRUE(append(idr(1), true));
+    EXPECT_TRUE(append(p(1)));
+    EXPECT_FALSE(append(p(3)));
+}
+
+VAAPIENC_STITCHER_H264_TEST(BackToBackIdr)
+{
+    EXPECT_TRUE(append(idr(1), true));
+    //the repeated id takes the other value of its length
+    AccessUnit au = idr(1);
+    EXPECT_TRUE(append(au, idr(2), true));
+    au = idr(1);
+    EXPECT_TRUE(append(au, idr(1), true));
+    EXPECT_TRUE(append(p(1)));
+}
+
+VAAPIENC_STITCHER_H264_TEST(BackToBackIdrLongerId)
+{
+    EXPECT_TRUE(append(idr(0), true));
+    //0 is the only one bit id, the slice data moves by two bits
+    AccessUnit au = idr(0);
+    EXPECT_TRUE(append(au, idr(1), true));
+    au = idr(0);
+    EXPECT_TRUE(append(au, idr(0), true));
+}
+
+VAAPIENC_STITCHER_H264_TEST(ForcedIdrs)
+{
+    //one frame chunks from forced key frames, every one of them is kept
+    EXPECT_TRUE(append(idr(1), true));
+    EXPECT_TRUE(append(p(1)));
+    AccessUnit au = idr(1);
+    EXPECT_TRUE(append(au, idr(1), true));
+    for (int i = 0; i < 4; i++) {
+        au = idr(1);
+        EXPECT_TRUE(append(au, idr(i % 2 ? 1 : 2), true));
+    }
+    EXPECT_TRUE(append(p(1)));
+    EXPECT_TRUE(append(p(2)));
+}
+
+}
@@ -48,6 +48,8 @@ using std::vector;
 #define H264_FRAME_FR 172
 #define H264_MIN_CR 2
 
+#define H264_MAX_TEMPORAL_LAYERS 4
+
 #define VAAPI_ENCODER_H264_NAL_REF_IDC_NONE        0
 #define VAAPI_ENCODER_H264_NAL_REF_IDC_LOW         1
 #define VAAPI_ENCODER_H264_NAL_REF_IDC_MEDIUM      2
@@ -59,7 +61,8 @@ typedef enum {
   VAAPI_ENCODER_H264_NAL_IDR         = 5,    /* ref_idc != 0 */
   VAAPI_ENCODER_H264_NAL_SEI         = 6,    /* ref_idc == 0 */
   VAAPI_ENCODER_H264_NAL_SPS         = 7,
-  VAAPI_ENCODER_H264_NAL_PPS         = 8
+  VAAPI_ENCODER_H264_NAL_PPS         = 8,
+  VAAPI_ENCODER_H264_NAL_PREFIX      = 14
 } GstVaapiEncoderH264NalType;
 
 /* Refer to H.264 spec Table A-1 l Level limits */
@@ -512,6 +515,17 @@ public:
             generateCodecConfigAnnexB();
     }
 
+    /* sps and pps with start codes, whatever the codec config format is */
+    void appendAnnexB(std::vector<uint8_t>& dest) const
+    {
+        const Header* headers[] = {&m_sps, &m_pps};
+        uint8_t sync[] = {0, 0, 0, 1};
+        for (size_t i = 0; i < N_ELEMENTS(headers); i++) {
+            dest.insert(dest.end(), sync, sync + N_ELEMENTS(sync));
+            appendHeaderWithEmulation(dest, *headers[i]);
+        }
+    }
+
     YamiStatus getCodecConfig(VideoEncOutputBuffer* outBuffer)
     {
         ASSERT(outBuffer && ((outBuffer->format == OUTPUT_CODEC_DATA) || (outBuffer->format == OUTPUT_EVERYTHING)));
@@ -537,15 +551,15 @@ private:
         param.insert(param.end(), codedData, codedData + codedBytes);
     }
 
-    void appendHeaderWithEmulation(Header& h)
+    static void appendHeaderWithEmulation(Header& dest, const Header& h)
     {
-        Header::iterator s = h.begin();
-        Header::iterator e;
+        Header::const_iterator s = h.begin();
+        Header::const_iterator e;
         uint8_t zeros[] = {0, 0};
         uint8_t emulation[] = {0, 0, 3};
         do {
             e = std::search(s, h.end(), zeros, zeros + N_ELEMENTS(zeros));
-            m_headers.insert(m_headers.end(), s, e);
+            dest.insert(dest.end(), s, e);
             if (e == h.end())
                 break;
 
@@ -554,22 +568,15 @@ private:
             /* only when bitstream contains 0x000000/0x000001/0x000002/0x000003
                need to insert emulation prevention byte 0x03 */
             if (*s <= 3)
-                m_headers.insert(m_headers.end(), emulation, emulation + N_ELEMENTS(emulation));
+                dest.insert(dest.end(), emulation, emulation + N_ELEMENTS(emulation));
             else
-                m_headers.insert(m_headers.end(), zeros, zeros + N_ELEMENTS(zeros));
+                dest.insert(dest.end(), zeros, zeros + N_ELEMENTS(zeros));
          } while (1);
     }
 
     void generateCodecConfigAnnexB()
     {
-        std::vector<Header*> headers;
-        headers.push_back(&m_sps);
-        headers.push_back(&m_pps);
-        uint8_t sync[] = {0, 0, 0, 1};
-        for (size_t i = 0; i < headers.size(); i++) {
-            m_headers.insert(m_headers.end(), sync, sync + N_ELEMENTS(sync));
-            appendHeaderWithEmulation(*headers[i]);
-        }
+        appendAnnexB(m_headers);
     }
 
     void generateCodecConfigAVCc()
@@ -629,6 +636,9 @@ public:
     {
         ASSERT(outBuffer);
         VideoOutputFormat format = outBuffer->format;
+        if (format == OUTPUT_ONE_NAL || format == OUTPUT_ONE_NAL_WITHOUT_STARTCODE)
+            return getOneNal(outBuffer, format == OUTPUT_ONE_NAL);
+
         //make a local copy of out Buffer;
         VideoEncOutputBuffer out = *outBuffer;
         out.flag = 0;
@@ -642,6 +652,7 @@ public:
         if (ret == YAMI_SUCCESS) {
             outBuffer->dataSize = out.data - outBuffer->data;
             outBuffer->flag = out.flag;
+            outBuffer->temporalId = m_temporalId;
         }
         return ret;
     }
@@ -650,7 +661,11 @@ private:
     VaapiEncPictureH264(const ContextPtr& context, const SurfacePtr& surface, int64_t timeStamp):
         VaapiEncPicture(context, surface, timeStamp),
         m_frameNum(0),
-        m_poc(0)
+        m_poc(0),
+        m_qpOffset(0),
+        m_refreshBand(-1),
+        m_nalsReady(false),
+        m_nalOffset(0)
     {
     }
 
@@ -658,6 +673,19 @@ private:
         return m_type == VAAPI_PICTURE_I && !m_frameNum;
     }
 
+    bool isReference() const {
+        return m_type != VAAPI_PICTURE_B && !m_temporalId;
+    }
+
+    /* same for every slice of the picture, the prefix NAL has to match it too */
+    uint32_t nalRefIdc() const {
+        if (m_type == VAAPI_PICTURE_I)
+            return VAAPI_ENCODER_H264_NAL_REF_IDC_HIGH;
+        if (isReference())
+            return VAAPI_ENCODER_H264_NAL_REF_IDC_MEDIUM;
+        return VAAPI_ENCODER_H264_NAL_REF_IDC_NONE;
+    }
+
     //getOutput is a virutal function, we need this to help bind
     static YamiStatus getOutputHelper(VaapiEncPictureH264* p, VideoEncOutputBuffer* out)
     {
@@ -681,9 +709,40 @@ private:
         return YAMI_SUCCESS;
     }
 
+    /* hands out one nal per call; every nal but the last is flagged
+       ENCODE_BUFFERFLAG_PARTIALFRAME, which keeps the picture queued */
+    YamiStatus getOneNal(VideoEncOutputBuffer* outBuffer, bool withStartCode)
+    {
+        if (!m_nalsReady) {
+            if (isIdr())
+                m_headers->appendAnnexB(m_nals);
+            uint32_t size = m_codedBuffer->size();
+            size_t offset = m_nals.size();
+            m_nals.resize(offset + size);
+            if (size && !m_codedBuffer->copyInto(&m_nals[offset]))
+                return YAMI_FAIL;
+            m_nalsReady = true;
+        }
+
+        uint32_t flags = m_codedBuffer->getFlags();
+        if (m_layerSync)
+            flags |= ENCODE_BUFFERFLAG_LAYERSYNC;
+        YamiStatus ret = VaapiEncoderH264::getOneNal(outBuffer, m_nals, m_nalOffset, flags, withStartCode);
+        if (ret == YAMI_SUCCESS)
+            outBuffer->temporalId = m_temporalId;
+        return ret;
+    }
+
     uint32_t m_frameNum;
     uint32_t m_poc;
+    int32_t m_qpOffset;
+    int32_t m_refreshBand; //intra refresh band of a P picture, -1 if none
     StreamHeaderPtr m_headers;
+
+    /* annexb picture data for OUTPUT_ONE_NAL */
+    std::vector<uint8_t> m_nals;
+    bool m_nalsReady;
+    size_t m_nalOffset;
 };
 
 class VaapiEncoderH264Ref
@@ -706,6 +765,10 @@ VaapiEncoderH264::VaapiEncoderH264():
     m_streamFormat(AVC_STREAM_FORMAT_ANNEXB),
     m_frameIndex(0),
     m_keyPeriod(30),
+    m_idrRequest(false),
+    m_refreshPeriod(0),
+    m_refreshBand(0),
+    m_temporalLayers(1),
     m_idrNum(0)
 {
     m_videoParamCommon.profile = VAProfileH264Main;
@@ -715,6 +778,8 @@ VaapiEncoderH264::VaapiEncoderH264():
 
     memset(&m_videoParamAVC, 0, sizeof(m_videoParamAVC));
     m_videoParamAVC.idrInterval = 0;
+    m_videoParamAVC.sliceNum.iSliceNum = 1;
+    m_videoParamAVC.sliceNum.pSliceNum = 1;
     m_videoParamAVC.enableCabac = true;
     m_videoParamAVC.enableDct8x8 = false;
     m_videoParamAVC.enableDeblockFilter = true;
@@ -743,12 +808,7 @@ bool VaapiEncoderH264::ensureCodedBufferSize()
 
     m_mbWidth = (width() + 15) / 16;
     m_mbHeight = (height() + 15)/ 16;
-    //FIXME:
-    m_numSlices = 1;
     mbSize = m_mbWidth * m_mbHeight;
-    if (m_numSlices > (mbSize + 1) / 2)
-        m_numSlices = (mbSize + 1) / 2;
-    ASSERT (m_numSlices);
 
     /* As spec A.3.1, max coded buffer size should be:
      * 384 *( Max( PicSizeInMbs, fR * MaxMBPS ) + MaxMBPS / fps ) ÷ MinCR
@@ -824,6 +884,26 @@ void VaapiEncoderH264::resetParams ()
     else
         m_numBFrames = ipPeriod() - 1;
 
+    m_temporalLayers = std::max(m_videoParamAVC.temporalLayers, 1U);
+    if (m_temporalLayers > H264_MAX_TEMPORAL_LAYERS) {
+        WARNING("at most %d temporal layers", H264_MAX_TEMPORAL_LAYERS);
+        m_temporalLayers = H264_MAX_TEMPORAL_LAYERS;
+    }
+    if (m_temporalLayers > 1) {
+        if (m_numBFrames) {
+            WARNING("temporal layers are hierarchical P, B frames disabled");
+            m_numBFrames = 0;
+            m_videoParamCommon.ipPeriod = 1;
+        }
+        /* periodic I frames stay in the base layer */
+        uint32_t period = 1 << (m_temporalLayers - 1);
+        if (intraPeriod() % period) {
+            WARNING("intra period %d is not a multiple of %d for %d temporal layers, round it up",
+                intraPeriod(), period, m_temporalLayers);
+            m_videoParamCommon.intraPeriod = (intraPeriod() + period - 1) / period * period;
+        }
+    }
+
     m_keyPeriod = intraPeriod() * (m_videoParamAVC.idrInterval + 1);
 
     if (m_keyPeriod > MAX_IDR_PERIOD)
@@ -836,6 +916,18 @@ void VaapiEncoderH264::resetParams ()
     if (m_numBFrames > (intraPeriod() + 1) / 2)
         m_numBFrames = (intraPeriod() + 1) / 2;
 
+    m_refreshPeriod = m_videoParamAVC.intraRefreshPeriod;
+    if (m_refreshPeriod) {
+        if (m_numBFrames) {
+            WARNING("intra refresh is for low delay, B frames disabled");
+            m_numBFrames = 0;
+            m_videoParamCommon.ipPeriod = 1;
+        }
+        if (m_refreshPeriod > m_mbHeight)
+            m_refreshPeriod = m_mbHeight;
+    }
+    m_refreshBand = 0;
+
     /* init m_maxFrameNum, max_poc */
     m_log2MaxFrameNum =
         h264_get_log2_max_frame_num (m_keyPeriod);
@@ -883,7 +975,10 @@ YamiStatus VaapiEncoderH264::start()
 {
     FUNC_ENTER();
     resetParams();
-    return VaapiEncoderBase::start();
+    YamiStatus status = VaapiEncoderBase::start();
+    if (status != YAMI_SUCCESS)
+        return status;
+    return startLookahead() ? YAMI_SUCCESS : YAMI_FAIL;
 }
 
 void VaapiEncoderH264::flush()
@@ -927,6 +1022,14 @@ YamiStatus VaapiEncoderH264::setParameters(VideoParamConfigType type, Yami_PTR v
             }
         }
         break;
+    case VideoConfigTypeSliceNum: {
+            VideoConfigSliceNum* sliceNum = (VideoConfigSliceNum*)videoEncParams;
+            if (sliceNum->size == sizeof(VideoConfigSliceNum)) {
+                m_videoParamAVC.sliceNum = sliceNum->sliceNum;
+                status = YAMI_SUCCESS;
+            }
+        }
+        break;
     default:
         status = VaapiEncoderBase::setParameters(type, videoEncParams);
         break;
@@ -934,6 +1037,17 @@ YamiStatus VaapiEncoderH264::setParameters(VideoParamConfigType type, Yami_PTR v
     return status;
 }
 
+YamiStatus VaapiEncoderH264::setConfig(VideoParamConfigType type, Yami_PTR videoEncConfig)
+{
+    FUNC_ENTER();
+    if (type == VideoConfigTypeIDRRequest) {
+        AutoLock locker(m_paramLock);
+        m_idrRequest = true;
+        return YAMI_SUCCESS;
+    }
+    return VaapiEncoderBase::setConfig(type, videoEncConfig);
+}
+
 YamiStatus VaapiEncoderH264::getParameters(VideoParamConfigType type, Yami_PTR videoEncParams)
 {
     YamiStatus status = YAMI_INVALID_PARAM;
@@ -977,7 +1091,19 @@ YamiStatus VaapiEncoderH264::reorder(const SurfacePtr& surface, uint64_t timeSta
 
     PicturePtr picture(new VaapiEncPictureH264(m_context, surface, timeStamp));
 
-    bool isIdr = (m_frameIndex == 0 ||m_frameIndex >= m_keyPeriod || forceKeyFrame);
+    bool idrRequest;
+    {
+        AutoLock locker(m_paramLock);
+        idrRequest = m_idrRequest;
+        m_idrRequest = false;
+    }
+
+    //intra refresh replaces the periodic key frames, requested ones stay
+    bool keyPeriodEnd = !m_refreshPeriod && m_frameIndex >= m_keyPeriod;
+    bool isIdr = (m_frameIndex == 0 || keyPeriodEnd || forceKeyFrame || idrRequest
+                  || m_lookaheadStats.sceneCut);
+    //a frame moving too much for a B frame ends the B run early
+    bool endBRun = m_videoParamLookahead.enableAdaptiveB && m_lookaheadStats.highMotion;
 
     if (isIdr) {
         // If the last frame before IDR is B frame, set it to P frame.
@@ -993,21 +1119,40 @@ YamiStatus VaapiEncoderH264::reorder(const SurfacePtr& surface, uint64_t timeSta
         m_reorderFrameList.push_back(picture);
         m_curFrameNum++;
         m_reorderState = VAAPI_ENC_REORD_DUMP_FRAMES;
-    } else if (m_frameIndex % intraPeriod() == 0) {
+    } else if (!m_refreshPeriod && m_frameIndex % intraPeriod() == 0) {
         setIFrame (picture);
         m_reorderFrameList.push_front(picture);
         m_curFrameNum++;
         m_reorderState = VAAPI_ENC_REORD_DUMP_FRAMES;
-    }else if (m_frameIndex % (m_numBFrames + 1) != 0) {
+    } else if (m_frameIndex % (m_numBFrames + 1) != 0 && !endBRun) {
         setBFrame (picture);
         m_reorderFrameList.push_back(picture);
     } else {
         setPFrame (picture);
         m_reorderFrameList.push_front(picture);
-        m_curFrameNum++;
+        picture->m_temporalId = temporalId(m_frameIndex, m_temporalLayers);
+        /* upper layers only reference the base layer, every frame is a switching point.
+           like B frames they do not bump frame_num */
+        if (picture->m_temporalId)
+            picture->m_layerSync = true;
+        else
+            m_curFrameNum++;
         m_reorderState = VAAPI_ENC_REORD_DUMP_FRAMES;
     }
 
+    if (picture->m_type != VAAPI_PICTURE_I)
+        picture->m_qpOffset = m_lookaheadStats.qpOffset;
+
+    /* the refresh band has to survive dropping the upper layers */
+    if (m_refreshPeriod && !picture->m_temporalId) {
+        if (isIdr) {
+            m_refreshBand = 0;
+        } else {
+            picture->m_refreshBand = m_refreshBand;
+            m_refreshBand = (m_refreshBand + 1) % m_refreshPeriod;
+        }
+    }
+
     picture->m_poc = m_frameIndex * 2;
     m_frameIndex++;
     return YAMI_SUCCESS;
@@ -1023,7 +1168,27 @@ YamiStatus VaapiEncoderH264::doEncode(const SurfacePtr& surface, uint64_t timeSt
     ret = reorder(surface, timeStamp, forceKeyFrame);
     if (ret != YAMI_SUCCESS)
         return ret;
+    return encodeReordered();
+}
 
+YamiStatus VaapiEncoderH264::drainReorder()
+{
+    if (m_reorderFrameList.empty())
+        return YAMI_SUCCESS;
+    // The trailing B frames lost their backward reference, the last one takes its place as P.
+    PicturePtr lastPic = m_reorderFrameList.back();
+    if (lastPic->m_type == VAAPI_PICTURE_B) {
+        lastPic->m_type = VAAPI_PICTURE_P;
+        m_reorderFrameList.pop_back();
+        m_reorderFrameList.push_front(lastPic);
+    }
+    m_reorderState = VAAPI_ENC_REORD_DUMP_FRAMES;
+    return encodeReordered();
+}
+
+YamiStatus VaapiEncoderH264::encodeReordered()
+{
+    YamiStatus ret;
     while (m_reorderState == VAAPI_ENC_REORD_DUMP_FRAMES) {
         if (!m_maxCodedbufSize)
             ensureCodedBufferSize();
@@ -1068,6 +1233,69 @@ YamiStatus VaapiEncoderH264::getCodecConfig(VideoEncOutputBuffer* outBuffer)
     return m_headers->getCodecConfig(outBuffer);
 }
 
+/* dyadic temporal id of the frame at @frameIndex since the IDR, with 3 layers 0 2 1 2 0 ... */
+uint32_t VaapiEncoderH264::temporalId(uint32_t frameIndex, uint32_t layers)
+{
+    uint32_t pos = frameIndex % (1 << (layers - 1));
+    if (!pos)
+        return 0;
+    uint32_t id = layers - 1;
+    for (; !(pos & 1); pos >>= 1)
+        id--;
+    return id;
+}
+
+/* position of the next 0x000001 at or after from, data.size() if none */
+size_t VaapiEncoderH264::findStartCode(const std::vector<uint8_t>& data, size_t from)
+{
+    for (size_t i = from; i + 2 < data.size(); i++) {
+        if (!data[i] && !data[i + 1] && data[i + 2] == 1)
+            return i;
+    }
+    return data.size();
+}
+
+/* copies the nal at offset out of annexb data and moves offset past it.
+ * a nal ends at its last non zero byte, trailing zero bytes are dropped;
+ * the zero_byte of a 4 bytes start code stays with its nal */
+YamiStatus VaapiEncoderH264::getOneNal(VideoEncOutputBuffer* outBuffer,
+    const std::vector<uint8_t>& data, size_t& offset, uint32_t flags, bool withStartCode)
+{
+    size_t start = findStartCode(data, offset);
+    size_t payload = offset;
+    size_t end = data.size();
+    if (start < end) {
+        payload = start + 3;
+        end = findStartCode(data, payload);
+        if (start > offset && !data[start - 1])
+            start--;
+    } else {
+        start = offset;
+    }
+    while (end > payload && !data[end - 1])
+        end--;
+    if (!withStartCode)
+        start = payload;
+
+    uint32_t size = end - start;
+    if (size > outBuffer->bufferSize) {
+        outBuffer->dataSize = 0;
+        return YAMI_ENCODE_BUFFER_TOO_SMALL;
+    }
+    if (size)
+        memcpy(outBuffer->data, &data[start], size);
+    outBuffer->dataSize = size;
+    if (findStartCode(data, end) < data.size()) {
+        flags &= ~ENCODE_BUFFERFLAG_ENDOFFRAME;
+        flags |= ENCODE_BUFFERFLAG_PARTIALFRAME;
+        offset = end;
+    } else {
+        offset = data.size();
+    }
+    outBuffer->flag = flags;
+    return YAMI_SUCCESS;
+}
+
 /* Handle new GOP starts */
 void VaapiEncoderH264::resetGopStart ()
 {
@@ -1109,7 +1337,7 @@ void VaapiEncoderH264::setIdrFrame (const PicturePtr& pic)
 bool VaapiEncoderH264::
 referenceListUpdate (const PicturePtr& picture, const SurfacePtr& surface)
 {
-    if (VAAPI_PICTURE_B == picture->m_type) {
+    if (!picture->isReference()) {
         return true;
     }
     if (picture->isIdr()) {
@@ -1263,7 +1491,7 @@ bool VaapiEncoderH264::fill(VAEncPictureParameterBufferH264* picParam, const Pic
 
     /* set picture fields */
     picParam->pic_fields.bits.idr_pic_flag = picture->isIdr();
-    picParam->pic_fields.bits.reference_pic_flag = (picture->m_type != VAAPI_PICTURE_B);
+    picParam->pic_fields.bits.reference_pic_flag = picture->isReference();
     picParam->pic_fields.bits.entropy_coding_mode_flag = m_videoParamAVC.enableCabac;
     picParam->pic_fields.bits.transform_8x8_mode_flag = m_videoParamAVC.enableDct8x8;
     picParam->pic_fields.bits.deblocking_filter_control_present_flag = true;
@@ -1309,13 +1537,120 @@ bool VaapiEncoderH264::fillReferenceList(VAEncSliceParameterBufferH264* slice) c
     return true;
 }
 
+/* Adds one slice of the given type to picture */
+bool VaapiEncoderH264::addSlice(const PicturePtr& picture, uint32_t firstMb, uint32_t numMbs,
+                                VaapiPictureType type) const
+{
+    VAEncSliceParameterBufferH264 *sliceParam;
+
+    if (!picture->newSlice(sliceParam))
+        return false;
+
+    sliceParam->macroblock_address = firstMb;
+    sliceParam->num_macroblocks = numMbs;
+    sliceParam->macroblock_info = VA_INVALID_ID;
+    sliceParam->slice_type = h264_get_slice_type (type);
+    assert (sliceParam->slice_type != -1);
+    sliceParam->idr_pic_id = m_idrNum;
+    sliceParam->pic_order_cnt_lsb = picture->m_poc % m_maxPicOrderCnt;
+
+    sliceParam->num_ref_idx_active_override_flag = 1;
+    if (type != VAAPI_PICTURE_I && m_refList0.size() > 0)
+        sliceParam->num_ref_idx_l0_active_minus1 = m_refList0.size() - 1;
+    if (type == VAAPI_PICTURE_B && m_refList1.size() > 0)
+        sliceParam->num_ref_idx_l1_active_minus1 = m_refList1.size() - 1;
+
+    fillReferenceList(sliceParam);
+
+    sliceParam->slice_qp_delta = initQP() - minQP();
+    if (sliceParam->slice_qp_delta > 4)
+        sliceParam->slice_qp_delta = 4;
+    if (rateControlMode() == RATE_CONTROL_CQP && picture->m_qpOffset) {
+        int32_t qp = (int32_t)initQP() + sliceParam->slice_qp_delta + picture->m_qpOffset;
+        qp = std::max(0, std::min(qp, (int32_t)maxQP()));
+        sliceParam->slice_qp_delta = qp - (int32_t)initQP();
+    }
+
+    sliceParam->disable_deblocking_filter_idc = !m_videoParamAVC.enableDeblockFilter;
+    sliceParam->slice_alpha_c0_offset_div2 = m_videoParamAVC.deblockAlphaOffsetDiv2;
+    sliceParam->slice_beta_offset_div2 = m_videoParamAVC.deblockBetaOffsetDiv2;
+
+    /* the driver derives nal_ref_idc from the slice type, which is wrong for
+       non reference P pictures and I refresh bands, write the header ourselves */
+    if (m_temporalLayers > 1) {
+        if (!addPrefixNal(picture) || !addPackedSliceHeader(picture, sliceParam))
+            return false;
+    }
+    return true;
+}
+
+/* Adds a packed slice header (7.3.3) for sliceParam, the driver puts each one
+ * in front of the slice with the same index */
+bool VaapiEncoderH264::addPackedSliceHeader(const PicturePtr& picture,
+    const VAEncSliceParameterBufferH264* const sliceParam) const
+{
+    BitWriter bs;
+    uint32_t nalRefIdc = picture->nalRefIdc();
+    uint32_t sliceType = sliceParam->slice_type % 5;
+
+    bs.writeBits(0x00000001, 32);
+    bit_writer_write_nal_header(&bs, nalRefIdc,
+        picture->isIdr() ? VAAPI_ENCODER_H264_NAL_IDR : VAAPI_ENCODER_H264_NAL_NON_IDR);
+    bit_writer_put_ue(&bs, sliceParam->macroblock_address); /* first_mb_in_slice */
+    bit_writer_put_ue(&bs, sliceParam->slice_type);
+    bit_writer_put_ue(&bs, 0); /* pic_parameter_set_id */
+    bs.writeBits(picture->m_frameNum, m_log2MaxFrameNum);
+    /* frame_mbs_only_flag is 1, no field_pic_flag */
+    if (picture->isIdr())
+        bit_writer_put_ue(&bs, sliceParam->idr_pic_id);
+    /* pic_order_cnt_type is 0 and pic_order_present_flag is 0 */
+    bs.writeBits(sliceParam->pic_order_cnt_lsb, m_log2MaxPicOrderCnt);
+    /* redundant_pic_cnt_present_flag is 0 */
+    if (sliceType == 1)
+        bs.writeBits(sliceParam->direct_spatial_mv_pred_flag, 1);
+    if (sliceType != 2) {
+        bs.writeBits(sliceParam->num_ref_idx_active_override_flag, 1);
+        if (sliceParam->num_ref_idx_active_override_flag) {
+            bit_writer_put_ue(&bs, sliceParam->num_ref_idx_l0_active_minus1);
+            if (sliceType == 1)
+                bit_writer_put_ue(&bs, sliceParam->num_ref_idx_l1_active_minus1);
+        }
+        /* ref_pic_list_modification, the lists are in default order */
+        bs.writeBits(0, 1);
+        if (sliceType == 1)
+            bs.writeBits(0, 1);
+    }
+    /* weighted_pred_flag and weighted_bipred_idc are 0 */
+    if (nalRefIdc) {
+        /* dec_ref_pic_marking, sliding window */
+        if (picture->isIdr()) {
+            bs.writeBits(0, 1); /* no_output_of_prior_pics_flag */
+            bs.writeBits(0, 1); /* long_term_reference_flag */
+        } else {
+            bs.writeBits(0, 1); /* adaptive_ref_pic_marking_mode_flag */
+        }
+    }
+    if (m_videoParamAVC.enableCabac && sliceType != 2)
+        bit_writer_put_ue(&bs, sliceParam->cabac_init_idc);
+    bit_writer_put_se(&bs, sliceParam->slice_qp_delta);
+    /* deblocking_filter_control_present_flag is 1 */
+    bit_writer_put_ue(&bs, sliceParam->disable_deblocking_filter_idc);
+    if (sliceParam->disable_deblocking_filter_idc != 1) {
+        bit_writer_put_se(&bs, sliceParam->slice_alpha_c0_offset_div2);
+        bit_writer_put_se(&bs, sliceParam->slice_beta_offset_div2);
+    }
+    bit_writer_write_trailing_bits(&bs);
+
+    return picture->addPackedHeader(VAEncPackedHeaderSlice, bs.getBitWriterData(), bs.getCodedBitsCount());
+}
+
 /* Adds slice headers to picture */
 bool VaapiEncoderH264::addSliceHeaders (const PicturePtr& picture) const
 {
-    VAEncSliceParameterBufferH264 *sliceParam;
     uint32_t sliceOfMbs, sliceModMbs, curSliceMbs;
     uint32_t mbSize;
     uint32_t lastMbIndex;
+    uint32_t numSlices;
 
     assert (picture);
 
@@ -1326,42 +1661,37 @@ bool VaapiEncoderH264::addSliceHeaders (const PicturePtr& picture) const
 
     mbSize = m_mbWidth * m_mbHeight;
 
-    assert (m_numSlices && m_numSlices < mbSize);
-    sliceOfMbs = mbSize / m_numSlices;
-    sliceModMbs = mbSize % m_numSlices;
+    if (picture->m_refreshBand >= 0) {
+        /* the refresh band is an I slice between the P slices above and below it */
+        uint32_t bandRows = (m_mbHeight + m_refreshPeriod - 1) / m_refreshPeriod;
+        uint32_t bandStart = std::min(picture->m_refreshBand * bandRows, m_mbHeight) * m_mbWidth;
+        uint32_t bandEnd = std::min((picture->m_refreshBand + 1) * bandRows, m_mbHeight) * m_mbWidth;
+        if (bandStart && !addSlice(picture, 0, bandStart, picture->m_type))
+            return false;
+        if (bandEnd > bandStart && !addSlice(picture, bandStart, bandEnd - bandStart, VAAPI_PICTURE_I))
+            return false;
+        if (bandEnd < mbSize && !addSlice(picture, bandEnd, mbSize - bandEnd, picture->m_type))
+            return false;
+        return true;
+    }
+
+    if (picture->m_type == VAAPI_PICTURE_I)
+        numSlices = m_videoParamAVC.sliceNum.iSliceNum;
+    else
+        numSlices = m_videoParamAVC.sliceNum.pSliceNum;
+    numSlices = std::min(std::max(numSlices, 1U), (mbSize + 1) / 2);
+
+    sliceOfMbs = mbSize / numSlices;
+    sliceModMbs = mbSize % numSlices;
     lastMbIndex = 0;
-    for (uint32_t i = 0; i < m_numSlices; ++i) {
+    for (uint32_t i = 0; i < numSlices; ++i) {
         curSliceMbs = sliceOfMbs;
         if (sliceModMbs) {
             ++curSliceMbs;
             --sliceModMbs;
         }
-        if (!picture->newSlice(sliceParam))
+        if (!addSlice(picture, lastMbIndex, curSliceMbs, picture->m_type))
             return false;
-
-        sliceParam->macroblock_address = lastMbIndex;
-        sliceParam->num_macroblocks = curSliceMbs;
-        sliceParam->macroblock_info = VA_INVALID_ID;
-        sliceParam->slice_type = h264_get_slice_type (picture->m_type);
-        assert (sliceParam->slice_type != -1);
-        sliceParam->idr_pic_id = m_idrNum;
-        sliceParam->pic_order_cnt_lsb = picture->m_poc % m_maxPicOrderCnt;
-
-        sliceParam->num_ref_idx_active_override_flag = 1;
-        if (picture->m_type != VAAPI_PICTURE_I && m_refList0.size() > 0)
-            sliceParam->num_ref_idx_l0_active_minus1 = m_refList0.size() - 1;
-        if (picture->m_type == VAAPI_PICTURE_B && m_refList1.size() > 0)
-            sliceParam->num_ref_idx_l1_active_minus1 = m_refList1.size() - 1;
-
-        fillReferenceList(sliceParam);
-
-        sliceParam->slice_qp_delta = initQP() - minQP();
-        if (sliceParam->slice_qp_delta > 4)
-            sliceParam->slice_qp_delta = 4;
-
-        sliceParam->disable_deblocking_filter_idc = !m_videoParamAVC.enableDeblockFilter;
-        sliceParam->slice_alpha_c0_offset_div2 = m_videoParamAVC.deblockAlphaOffsetDiv2;
-        sliceParam->slice_beta_offset_div2 = m_videoParamAVC.deblockBetaOffsetDiv2;
         /* set calculation for next slice */
         lastMbIndex += curSliceMbs;
     }
@@ -1369,6 +1699,70 @@ bool VaapiEncoderH264::addSliceHeaders (const PicturePtr& picture) const
     return true;
 }
 
+/* Adds a recovery point SEI (D.1.7) in front of the slices, marking the
+ * start of an intra refresh cycle as a random access point */
+bool VaapiEncoderH264::addRecoveryPointSEI(const PicturePtr& picture) const
+{
+    BitWriter bs;
+    uint32_t recoveryFrameCnt = m_refreshPeriod - 1;
+
+    /* recovery_frame_cnt ue(v), exact_match_flag, broken_link_flag, changing_slice_group_idc */
+    uint32_t payloadBits = 1 + 4;
+    for (uint32_t v = recoveryFrameCnt + 1; v > 1; v >>= 1)
+        payloadBits += 2;
+
+    bs.writeBits(0x00000001, 32);
+    bit_writer_write_nal_header(&bs, VAAPI_ENCODER_H264_NAL_REF_IDC_NONE, VAAPI_ENCODER_H264_NAL_SEI);
+    bs.writeBits(6, 8); /* payloadType, recovery point */
+    bs.writeBits((payloadBits + 7) / 8, 8); /* payloadSize */
+    bit_writer_put_ue(&bs, recoveryFrameCnt);
+    /* decoding from here is only approximately right, the driver's motion
+       search is free to reach into rows not yet refreshed */
+    bs.writeBits(0, 1); /* exact_match_flag */
+    bs.writeBits(0, 1); /* broken_link_flag */
+    bs.writeBits(0, 2); /* changing_slice_group_idc */
+    if (payloadBits % 8) {
+        /* bit_equal_to_one, then bit_equal_to_zero up to byte aligned */
+        bs.writeBits(1, 1);
+        bs.writeToBytesAligned();
+    }
+    bit_writer_write_trailing_bits(&bs);
+
+    return picture->addPackedHeader(VAEncPackedHeaderRawData, bs.getBitWriterData(), bs.getCodedBitsCount());
+}
+
+/* Adds a prefix NAL (G.7.3.1.1, G.7.3.2.12) with the temporal id right in front
+ * of a slice. AVC decoders skip it, a forwarding server can thin the stream
+ * by temporal_id without parsing slices */
+bool VaapiEncoderH264::addPrefixNal(const PicturePtr& picture) const
+{
+    BitWriter bs;
+    uint32_t nalRefIdc = picture->nalRefIdc();
+
+    bs.writeBits(0x00000001, 32);
+    bit_writer_write_nal_header(&bs, nalRefIdc, VAAPI_ENCODER_H264_NAL_PREFIX);
+    /* nal_unit_header_svc_extension */
+    bs.writeBits(1, 1); /* svc_extension_flag */
+    bs.writeBits(picture->isIdr(), 1); /* idr_flag */
+    bs.writeBits(0, 6); /* priority_id */
+    bs.writeBits(1, 1); /* no_inter_layer_pred_flag */
+    bs.writeBits(0, 3); /* dependency_id */
+    bs.writeBits(0, 4); /* quality_id */
+    bs.writeBits(picture->m_temporalId, 3); /* temporal_id */
+    bs.writeBits(0, 1); /* use_ref_base_pic_flag */
+    bs.writeBits(0, 1); /* discardable_flag */
+    bs.writeBits(1, 1); /* output_flag */
+    bs.writeBits(3, 2); /* reserved_three_2bits */
+    /* prefix_nal_unit_svc, empty for non reference pictures */
+    if (nalRefIdc) {
+        bs.writeBits(0, 1); /* store_ref_base_pic_flag */
+        bs.writeBits(0, 1); /* additional_prefix_nal_unit_extension_flag */
+        bit_writer_write_trailing_bits(&bs);
+    }
+
+    return picture->addPackedHeader(VAEncPackedHeaderRawData, bs.getBitWriterData(), bs.getCodedBitsCount());
+}
+
 bool VaapiEncoderH264::ensureSequence(const PicturePtr& picture)
 {
     VAEncSequenceParameterBufferH264* seqParam;
@@ -1410,6 +1804,8 @@ bool VaapiEncoderH264::ensureSlices(const PicturePtr& picture)
 {
     assert (picture);
 
+    if (picture->m_refreshBand == 0 && !addRecoveryPointSEI(picture))
+        return false;
     if (!addSliceHeaders (picture))
         return false;
     return true;
@@ -23,6 +23,7 @@
 #include <list>
 #include <queue>
 #include <deque>
+#include <vector>
 #include <pthread.h>
 #include <va/va_enc_h264.h>
 
@@ -47,6 +48,7 @@ public:
 
     virtual YamiStatus getParameters(VideoParamConfigType type, Yami_PTR);
     virtual YamiStatus setParameters(VideoParamConfigType type, Yami_PTR);
+    virtual YamiStatus setConfig(VideoParamConfigType type, Yami_PTR);
     virtual YamiStatus getMaxOutSize(uint32_t* maxSize);
 #ifdef __BUILD_GET_MV__
     // get MV buffer size.
@@ -55,11 +57,13 @@ public:
 
 protected:
     virtual YamiStatus doEncode(const SurfacePtr&, uint64_t timeStamp, bool forceKeyFrame);
+    virtual YamiStatus drainReorder();
     virtual YamiStatus getCodecConfig(VideoEncOutputBuffer* outBuffer);
 
 private:
     friend class FactoryTest<IVideoEncoder, VaapiEncoderH264>;
     friend class VaapiEncoderH264Test;
+    friend class VaapiEncPictureH264;
 
     //following code is a template for other encoder implementation
     YamiStatus encodePicture(const PicturePtr&);
@@ -68,6 +72,10 @@ private:
     bool ensureSequenceHeader(const PicturePtr&, const VAEncSequenceParameterBufferH264* const);
     bool ensurePictureHeader(const PicturePtr&, const VAEncPictureParameterBufferH264* const );
     bool addSliceHeaders (const PicturePtr&) const;
+    bool addSlice(const PicturePtr&, uint32_t firstMb, uint32_t numMbs, VaapiPictureType) const;
+    bool addPackedSliceHeader(const PicturePtr&, const VAEncSliceParameterBufferH264* const) const;
+    bool addRecoveryPointSEI(const PicturePtr&) const;
+    bool addPrefixNal(const PicturePtr&) const;
     bool ensureSequence(const PicturePtr&);
     bool ensurePicture (const PicturePtr&, const SurfacePtr&);
     bool ensureSlices(const PicturePtr&);
@@ -75,6 +83,7 @@ private:
 
     //reference list related
     YamiStatus reorder(const SurfacePtr& surface, uint64_t timeStamp, bool forceKeyFrame);
+    YamiStatus encodeReordered();
     bool fillReferenceList(VAEncSliceParameterBufferH264* slice) const;
     bool referenceListUpdate (const PicturePtr&, const SurfacePtr&);
     bool pictureReferenceListSet (const PicturePtr&);
@@ -90,11 +99,14 @@ private:
 
     void resetParams();
     void checkProfileLimitation();
+    static uint32_t temporalId(uint32_t frameIndex, uint32_t layers);
+    static size_t findStartCode(const std::vector<uint8_t>&, size_t from);
+    static YamiStatus getOneNal(VideoEncOutputBuffer*, const std::vector<uint8_t>& annexB,
+                                size_t& offset, uint32_t flags, bool withStartCode);
 
     VideoParamsAVC m_videoParamAVC;
 
     uint8_t m_levelIdc;
-    uint32_t m_numSlices;
     uint32_t m_numBFrames;
     uint32_t m_mbWidth;
     uint32_t m_mbHeight;
@@ -106,6 +118,14 @@ private:
     uint32_t m_frameIndex;
     uint32_t m_curFrameNum;
     uint32_t m_keyPeriod;
+    bool m_idrRequest;
+
+    /* gradual intra refresh, a band of intra mb rows moving down over P frames */
+    uint32_t m_refreshPeriod;
+    uint32_t m_refreshBand;
+
+    /* temporal scalability, layers above 0 are non reference P frames */
+    uint32_t m_temporalLayers;
 
     /* reference list */
     std::deque<ReferencePtr> m_refList;
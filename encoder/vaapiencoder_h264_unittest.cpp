@@ -49,6 +49,29 @@ protected:
     virtual void TearDown() {
         return;
     }
+
+    uint32_t temporalId(uint32_t frameIndex, uint32_t layers) const
+    {
+        return VaapiEncoderH264::temporalId(frameIndex, layers);
+    }
+
+    typedef std::vector<uint8_t> Bytes;
+
+    //next nal out of annexB, its bytes go to nal
+    YamiStatus getOneNal(const Bytes& annexB, size_t& offset, uint32_t flags,
+        bool withStartCode, Bytes& nal, uint32_t& outFlags) const
+    {
+        uint8_t data[64];
+        VideoEncOutputBuffer out;
+        out.data = data;
+        out.bufferSize = sizeof(data);
+        out.dataSize = 0;
+        out.flag = 0;
+        YamiStatus ret = VaapiEncoderH264::getOneNal(&out, annexB, offset, flags, withStartCode);
+        nal.assign(data, data + out.dataSize);
+        outFlags = out.flag;
+        return ret;
+    }
 };
 
 #define VAAPIENCODER_H264_TEST(name) \
@@ -61,4 +84,72 @@ VAAPIENCODER_H264_TEST(Factory) {
     doFactoryTest(mimeTypes);
 }
 
+VAAPIENCODER_H264_TEST(TemporalId) {
+    const uint32_t twoLayers[] = { 0, 1, 0, 1 };
+    const uint32_t threeLayers[] = { 0, 2, 1, 2, 0, 2, 1, 2 };
+    const uint32_t fourLayers[] = { 0, 3, 2, 3, 1, 3, 2, 3, 0 };
+    for (uint32_t i = 0; i < N_ELEMENTS(twoLayers); i++)
+        EXPECT_EQ(twoLayers[i], temporalId(i, 2));
+    for (uint32_t i = 0; i < N_ELEMENTS(threeLayers); i++)
+        EXPECT_EQ(threeLayers[i], temporalId(i, 3));
+    for (uint32_t i = 0; i < N_ELEMENTS(fourLayers); i++)
+        EXPECT_EQ(fourLayers[i], temporalId(i, 4));
+    EXPECT_EQ(0u, temporalId(5, 1));
+}
+
+VAAPIENCODER_H264_TEST(GetOneNal) {
+    //sps and pps after 4 bytes start codes, a slice with an emulation
+    //prevention byte, padding, a second slice and trailing zeros
+    const uint8_t stream[] = {
+        0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1e,
+        0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80,
+        0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x00, 0x03, 0x00, 0x80,
+        0x00, 0x00,
+        0x00, 0x00, 0x00, 0x01, 0x65, 0x11, 0x22, 0x80,
+        0x00, 0x00, 0x00
+    };
+    const uint8_t sps[] = { 0x00, 0x00, 0x00, 0x01, 0x67, 0x42, 0x00, 0x1e };
+    const uint8_t pps[] = { 0x00, 0x00, 0x00, 0x01, 0x68, 0xce, 0x3c, 0x80 };
+    const uint8_t slice0[] = { 0x00, 0x00, 0x01, 0x65, 0x88, 0x84, 0x00, 0x00, 0x03, 0x00, 0x80 };
+    const uint8_t slice1[] = { 0x00, 0x00, 0x00, 0x01, 0x65, 0x11, 0x22, 0x80 };
+    const uint8_t* nals[] = { sps, pps, slice0, slice1 };
+    const size_t sizes[] = { sizeof(sps), sizeof(pps), sizeof(slice0), sizeof(slice1) };
+    //start code lengths
+    const size_t prefixes[] = { 4, 4, 3, 4 };
+
+    Bytes annexB(stream, stream + sizeof(stream));
+    const uint32_t flags = ENCODE_BUFFERFLAG_ENDOFFRAME | ENCODE_BUFFERFLAG_SYNCFRAME;
+    for (int withStartCode = 1; withStartCode >= 0; withStartCode--) {
+        size_t offset = 0;
+        for (size_t i = 0; i < N_ELEMENTS(nals); i++) {
+            Bytes nal;
+            uint32_t outFlags;
+            ASSERT_EQ(YAMI_SUCCESS, getOneNal(annexB, offset, flags, withStartCode, nal, outFlags));
+            size_t skip = withStartCode ? 0 : prefixes[i];
+            EXPECT_EQ(Bytes(nals[i] + skip, nals[i] + sizes[i]), nal);
+            //the picture is done with the last nal, trailing zeros do not count
+            bool last = i == N_ELEMENTS(nals) - 1;
+            EXPECT_EQ(last, bool(outFlags & ENCODE_BUFFERFLAG_ENDOFFRAME));
+            EXPECT_EQ(!last, bool(outFlags & ENCODE_BUFFERFLAG_PARTIALFRAME));
+            EXPECT_TRUE(outFlags & ENCODE_BUFFERFLAG_SYNCFRAME);
+        }
+        EXPECT_EQ(annexB.size(), offset);
+    }
+}
+
+VAAPIENCODER_H264_TEST(GetOneNalBufferTooSmall) {
+    Bytes annexB(4096, 0x55);
+    annexB[2] = 0x01;
+    annexB[0] = annexB[1] = 0;
+
+    size_t offset = 0;
+    Bytes nal;
+    uint32_t outFlags;
+    EXPECT_EQ(YAMI_ENCODE_BUFFER_TOO_SMALL,
+        getOneNal(annexB, offset, ENCODE_BUFFERFLAG_ENDOFFRAME, true, nal, outFlags));
+    EXPECT_TRUE(nal.empty());
+    //nothing consumed, a bigger buffer gets the same nal
+    EXPECT_EQ(0u, offset);
+}
+
 }
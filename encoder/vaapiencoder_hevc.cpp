@@ -46,6 +46,12 @@ using std::deque;
 
 #define HEVC_NAL_START_CODE 0x000001
 
+#define HEVC_MAX_TILE_COLUMNS 20
+#define HEVC_MAX_TILE_ROWS 22
+/* main profiles want tiles 256 luma samples wide and 64 high at least */
+#define HEVC_MIN_TILE_WIDTH 256
+#define HEVC_MIN_TILE_HEIGHT 64
+
 #define HEVC_SLICE_TYPE_I            2
 #define HEVC_SLICE_TYPE_P           1
 #define HEVC_SLICE_TYPE_B           0
@@ -119,6 +125,22 @@ hevc_get_slice_type (VaapiPictureType type)
     return -1;
 }
 
+/* coding_type of the picture parameters, B1 and B2 are the pyramid levels below B */
+static uint8_t
+hevc_get_coding_type (VaapiPictureType type, uint32_t depth)
+{
+    switch (type) {
+    case VAAPI_PICTURE_I:
+        return 1;
+    case VAAPI_PICTURE_P:
+        return 2;
+    case VAAPI_PICTURE_B:
+        return 3 + std::min(depth > 0 ? depth - 1 : 0, 2U);
+    default:
+        return 0;
+    }
+}
+
 static uint32_t log2 (uint32_t num)
 {
     uint32_t ret = 0;
@@ -146,6 +168,50 @@ hevc_get_log2_max_frame_num (uint32_t num)
     return ret;
 }
 
+/* MaxTileCols and MaxTileRows of the level, table A.6 */
+static void hevc_get_max_tiles(uint8_t level, uint32_t& columns, uint32_t& rows)
+{
+    if (level < 30)
+        columns = rows = 1;
+    else if (level < 31)
+        columns = rows = 2;
+    else if (level < 40)
+        columns = rows = 3;
+    else if (level < 50)
+        columns = rows = 5;
+    else if (level < 60) {
+        columns = 10;
+        rows = 11;
+    } else {
+        columns = HEVC_MAX_TILE_COLUMNS;
+        rows = HEVC_MAX_TILE_ROWS;
+    }
+}
+
+/* CTU sizes of num tile columns or rows splitting total CTUs, the explicit
+ * ones if they leave minSize CTUs to every tile. return true if they did */
+static bool hevc_get_tile_sizes(vector<uint32_t>& sizes, uint32_t total, uint32_t num,
+                                const uint32_t* explicitSizes, uint32_t minSize)
+{
+    uint32_t i, used = 0;
+    sizes.clear();
+    if (num > 1 && explicitSizes[0]) {
+        for (i = 0; i < num - 1 && explicitSizes[i] >= minSize; i++) {
+            sizes.push_back(explicitSizes[i]);
+            used += explicitSizes[i];
+        }
+        if (sizes.size() == num - 1 && used + minSize <= total) {
+            sizes.push_back(total - used);
+            return true;
+        }
+        WARNING("explicit tile sizes do not fit %d CTUs, space %d tiles uniformly", total, num);
+        sizes.clear();
+    }
+    for (i = 0; i < num; i++)
+        sizes.push_back((i + 1) * total / num - i * total / num);
+    return false;
+}
+
 static uint8_t hevc_get_profile_idc(VideoProfile profile)
 {
     uint8_t idc;
@@ -390,10 +456,10 @@ private:
         bitwriter->writeBits(0, 1);
 
         /*vps_max_dec_pic_buffering_minus1*/
-        bit_writer_put_ue(bitwriter, 5);
+        bit_writer_put_ue(bitwriter, std::max(m_encoder->m_maxRefFrames, m_encoder->m_maxNumReorder));
 
         /*vps_max_num_reorder_pics*/
-        bit_writer_put_ue(bitwriter, 0);
+        bit_writer_put_ue(bitwriter, m_encoder->m_maxNumReorder);
 
         /*vps_max_latency_increase_plus1*/
         bit_writer_put_ue(bitwriter, 0);
@@ -473,9 +539,9 @@ private:
         bitwriter->writeBits(0, 1);
 
        /* sps_max_dec_pic_buffering_minus1 */
-       bit_writer_put_ue(bitwriter, 5);
+       bit_writer_put_ue(bitwriter, std::max(m_encoder->m_maxRefFrames, m_encoder->m_maxNumReorder));
        /* sps_max_num_reorder_pics */
-       bit_writer_put_ue(bitwriter, 0);
+       bit_writer_put_ue(bitwriter, m_encoder->m_maxNumReorder);
        /* sps_max_latency_increase_plus1 */
        bit_writer_put_ue(bitwriter, 0);
 
@@ -508,9 +574,9 @@ private:
             bitwriter->writeBits(seq->seq_fields.bits.pcm_loop_filter_disabled_flag, 1);
         }
 
-        bit_writer_put_ue(bitwriter, m_encoder->m_shortRFS.num_short_term_ref_pic_sets);
-        for (i = 0; i < m_encoder->m_shortRFS.num_short_term_ref_pic_sets; i++)
-            st_ref_pic_set(bitwriter, i, m_encoder->m_shortRFS);
+        bit_writer_put_ue(bitwriter, m_encoder->m_shortRfsSets.size());
+        for (i = 0; i < m_encoder->m_shortRfsSets.size(); i++)
+            st_ref_pic_set(bitwriter, i, m_encoder->m_shortRfsSets[i]);
 
         /* long_term_ref_pics_present_flag */
         bitwriter->writeBits(0, 1);
@@ -683,14 +749,24 @@ private:
         bitwriter->writeBits(pic->pic_fields.bits.entropy_coding_sync_enabled_flag, 1);
 
         if (pic->pic_fields.bits.tiles_enabled_flag) {
-            /*
-            * TBD: Add the tile division when tiles are enabled.
-            */
-            assert(!pic->pic_fields.bits.tiles_enabled_flag);
+            uint32_t i;
+            bool uniform_spacing_flag = m_encoder->m_uniformTiles;
+
+            bit_writer_put_ue(bitwriter, pic->num_tile_columns_minus1);
+            bit_writer_put_ue(bitwriter, pic->num_tile_rows_minus1);
+            bitwriter->writeBits(uniform_spacing_flag, 1);
+            if (!uniform_spacing_flag) {
+                for (i = 0; i < pic->num_tile_columns_minus1; i++)
+                    bit_writer_put_ue(bitwriter, pic->column_width_minus1[i]);
+                for (i = 0; i < pic->num_tile_rows_minus1; i++)
+                    bit_writer_put_ue(bitwriter, pic->row_height_minus1[i]);
+            }
+            /* loop_filter_across_tiles_enabled_flag */
+            bitwriter->writeBits(pic->pic_fields.bits.loop_filter_across_tiles_enabled_flag, 1);
         }
 
         /* pps_loop_filter_across_slices_enabled_flag */
-        bitwriter->writeBits(pic->pic_fields.bits.loop_filter_across_tiles_enabled_flag, 1);
+        bitwriter->writeBits(pic->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag, 1);
 
         /* deblocking_filter_control_present_flag. 1 */
         bitwriter->writeBits(deblocking_filter_control_present_flag, 1);
@@ -805,7 +881,12 @@ private:
     VaapiEncPictureHEVC(const ContextPtr& context, const SurfacePtr& surface, int64_t timeStamp):
         VaapiEncPicture(context, surface, timeStamp),
         m_frameNum(0),
-        m_poc(0)
+        m_poc(0),
+        m_qpOffset(0),
+        m_isReference(true),
+        m_depth(0),
+        m_rangeLow(0),
+        m_rangeHigh(0)
     {
     }
 
@@ -838,6 +919,13 @@ private:
 
     uint32_t m_frameNum;
     uint32_t m_poc;
+    int32_t m_qpOffset;
+    bool m_isReference;
+    //pyramid B frames: level below the anchors, and the poc range (low, high)
+    //of the frames which may reference it
+    uint32_t m_depth;
+    uint32_t m_rangeLow;
+    uint32_t m_rangeHigh;
     StreamHeaderPtr m_headers;
 };
 
@@ -847,22 +935,41 @@ public:
     VaapiEncoderHEVCRef(const PicturePtr& picture, const SurfacePtr& surface):
         m_frameNum(picture->m_frameNum),
         m_poc(picture->m_poc),
+        m_isAnchor(picture->m_type != VAAPI_PICTURE_B),
+        m_rangeLow(picture->m_rangeLow),
+        m_rangeHigh(picture->m_rangeHigh),
         m_pic(surface)
     {
     }
+    //a reference without picture, to plan the reference picture sets
+    VaapiEncoderHEVCRef(uint32_t poc, bool isAnchor, uint32_t rangeLow, uint32_t rangeHigh):
+        m_frameNum(0),
+        m_poc(poc),
+        m_isAnchor(isAnchor),
+        m_rangeLow(rangeLow),
+        m_rangeHigh(rangeHigh)
+    {
+    }
     uint32_t m_frameNum;
     uint32_t m_poc;
+    bool m_isAnchor;
+    uint32_t m_rangeLow;
+    uint32_t m_rangeHigh;
     SurfacePtr m_pic;
 };
 
 VaapiEncoderHEVC::VaapiEncoderHEVC():
     m_numBFrames(0),
+    m_bPyramid(false),
     m_ctbSize(8),
     m_cuSize(32),
     m_minTbSize(4),
     m_maxTbSize(16),
+    m_uniformTiles(true),
     m_reorderState(VAAPI_ENC_REORD_WAIT_FRAMES),
-    m_keyPeriod(30)
+    m_keyPeriod(30),
+    m_maxRefFrames(0),
+    m_maxNumReorder(0)
 {
     m_videoParamCommon.profile = VAProfileHEVCMain;
     m_videoParamCommon.level = 51;
@@ -870,7 +977,13 @@ VaapiEncoderHEVC::VaapiEncoderHEVC():
     m_videoParamCommon.rcParams.minQP = 1;
 
     memset(&m_videoParamAVC, 0, sizeof(m_videoParamAVC));
+    m_videoParamAVC.size = sizeof(m_videoParamAVC);
     m_videoParamAVC.idrInterval = 0;
+
+    memset(&m_videoParamHEVC, 0, sizeof(m_videoParamHEVC));
+    m_videoParamHEVC.size = sizeof(m_videoParamHEVC);
+    m_videoParamHEVC.tileColumns = 1;
+    m_videoParamHEVC.tileRows = 1;
 }
 
 VaapiEncoderHEVC::~VaapiEncoderHEVC()
@@ -911,6 +1024,9 @@ void VaapiEncoderHEVC::resetParams ()
     m_cuWidth = (width() + m_cuSize -1) / m_cuSize;
     m_cuHeight = (height() + m_cuSize-1) / m_cuSize;
 
+    setTiles();
+    setSliceSegments();
+
     m_confWinLeftOffset = m_confWinTopOffset = 0;
 
     if (m_AlignedWidth != width() || m_AlignedHeight !=height()) {
@@ -961,23 +1077,93 @@ void VaapiEncoderHEVC::resetParams ()
     m_log2MaxPicOrderCnt = m_log2MaxFrameNum + 1;
     m_maxPicOrderCnt = (1 << m_log2MaxPicOrderCnt);
 
+    //a pyramid needs two levels of B frames at least
+    m_bPyramid = m_videoParamHEVC.enableBPyramid && m_numBFrames > 2;
+
     m_maxRefList1Count = m_numBFrames > 0;//m_maxRefList1Count <=1, because of currenent order mechanism
     m_maxRefList0Count = numRefFrames();
     if (m_maxRefList0Count >= m_maxOutputBuffer -1)
         m_maxRefList0Count = m_maxOutputBuffer -1;
+    if (!m_maxRefList0Count)
+        m_maxRefList0Count = 1;
 
-    m_maxRefFrames =
-        m_maxRefList0Count + m_maxRefList1Count;
+    setShortRfs();
 
-    assert(m_maxRefFrames <= m_maxOutputBuffer);
+    //the reconstructed surfaces of the references come from the surface pool
+    if (m_maxOutputBuffer < m_maxRefFrames + 1)
+        m_maxOutputBuffer = m_maxRefFrames + 1;
 
     INFO("m_maxRefFrames: %d", m_maxRefFrames);
 
-    setShortRfs();
-
     resetGopStart();
 }
 
+void VaapiEncoderHEVC::setTiles()
+{
+    uint32_t maxColumns, maxRows;
+    uint32_t minWidth = HEVC_MIN_TILE_WIDTH / m_cuSize;
+    uint32_t minHeight = HEVC_MIN_TILE_HEIGHT / m_cuSize;
+    uint32_t columns = m_videoParamHEVC.tileColumns;
+    uint32_t rows = m_videoParamHEVC.tileRows;
+
+    hevc_get_max_tiles(m_levelIdc, maxColumns, maxRows);
+    maxColumns = std::max(1U, std::min(maxColumns, m_cuWidth / minWidth));
+    maxRows = std::max(1U, std::min(maxRows, m_cuHeight / minHeight));
+    if (columns > maxColumns || rows > maxRows) {
+        WARNING("%dx%d tiles do not fit level %d at %dx%d, use %dx%d", columns, rows, m_levelIdc,
+            width(), height(), std::min(columns, maxColumns), std::min(rows, maxRows));
+        columns = std::min(columns, maxColumns);
+        rows = std::min(rows, maxRows);
+    }
+
+    bool explicitColumns = hevc_get_tile_sizes(m_tileColumnWidths, m_cuWidth, columns,
+        m_videoParamHEVC.columnWidth, minWidth);
+    bool explicitRows = hevc_get_tile_sizes(m_tileRowHeights, m_cuHeight, rows,
+        m_videoParamHEVC.rowHeight, minHeight);
+    m_uniformTiles = !explicitColumns && !explicitRows;
+}
+
+void VaapiEncoderHEVC::setSliceSegments()
+{
+    SliceSegment segment;
+    bool wpp = m_videoParamHEVC.entropyCodingSync;
+    bool dependent = m_videoParamHEVC.dependentSliceSegments;
+
+    m_sliceSegments.clear();
+    if (!tilesEnabled() && !wpp && !dependent) {
+        uint32_t numCtus = m_cuWidth * m_cuHeight;
+        assert (m_numSlices && m_numSlices < numCtus);
+        segment.address = 0;
+        segment.dependent = false;
+        for (uint32_t i = 0; i < m_numSlices; i++) {
+            segment.numCtus = numCtus / m_numSlices + (i < numCtus % m_numSlices);
+            m_sliceSegments.push_back(segment);
+            segment.address += segment.numCtus;
+        }
+        return;
+    }
+
+    /* entry points are only known once the driver coded the slice data, so every
+     * tile, or every CTU row of a tile, gets a segment of its own and needs none */
+    bool perRow = wpp || !tilesEnabled();
+    uint32_t top = 0;
+    for (size_t row = 0; row < m_tileRowHeights.size(); row++) {
+        uint32_t left = 0;
+        for (size_t column = 0; column < m_tileColumnWidths.size(); column++) {
+            uint32_t tileWidth = m_tileColumnWidths[column];
+            uint32_t tileHeight = m_tileRowHeights[row];
+            for (uint32_t y = 0; y < tileHeight; y += (perRow ? 1 : tileHeight)) {
+                segment.address = (top + y) * m_cuWidth + left;
+                segment.numCtus = tileWidth * (perRow ? 1 : tileHeight);
+                segment.dependent = dependent && !m_sliceSegments.empty();
+                m_sliceSegments.push_back(segment);
+            }
+            left += tileWidth;
+        }
+        top += m_tileRowHeights[row];
+    }
+}
+
 YamiStatus VaapiEncoderHEVC::getMaxOutSize(uint32_t* maxSize)
 {
     FUNC_ENTER();
@@ -994,7 +1180,10 @@ YamiStatus VaapiEncoderHEVC::start()
 {
     FUNC_ENTER();
     resetParams();
-    return VaapiEncoderBase::start();
+    YamiStatus status = VaapiEncoderBase::start();
+    if (status != YAMI_SUCCESS)
+        return status;
+    return startLookahead() ? YAMI_SUCCESS : YAMI_FAIL;
 }
 
 void VaapiEncoderHEVC::flush()
@@ -1029,6 +1218,20 @@ YamiStatus VaapiEncoderHEVC::setParameters(VideoParamConfigType type, Yami_PTR v
             }
         }
         break;
+    case VideoParamsTypeHEVC: {
+            VideoParamsHEVC* hevc = (VideoParamsHEVC*)videoEncParams;
+            if (hevc->size != sizeof(VideoParamsHEVC))
+                break;
+            if (!hevc->tileColumns || hevc->tileColumns > HEVC_MAX_TILE_COLUMNS
+                || !hevc->tileRows || hevc->tileRows > HEVC_MAX_TILE_ROWS) {
+                ERROR("hevc supports 1 to %d tile columns and 1 to %d tile rows, not %dx%d",
+                    HEVC_MAX_TILE_COLUMNS, HEVC_MAX_TILE_ROWS, hevc->tileColumns, hevc->tileRows);
+                break;
+            }
+            PARAMETER_ASSIGN(m_videoParamHEVC, *hevc);
+            status = YAMI_SUCCESS;
+        }
+        break;
     default:
         status = VaapiEncoderBase::setParameters(type, videoEncParams);
         break;
@@ -1053,6 +1256,14 @@ YamiStatus VaapiEncoderHEVC::getParameters(VideoParamConfigType type, Yami_PTR v
             }
         }
         break;
+    case VideoParamsTypeHEVC: {
+            VideoParamsHEVC* hevc = (VideoParamsHEVC*)videoEncParams;
+            if (hevc->size == sizeof(VideoParamsHEVC)) {
+                PARAMETER_ASSIGN(*hevc, m_videoParamHEVC);
+                status = YAMI_SUCCESS;
+            }
+        }
+        break;
     default:
         status = VaapiEncoderBase::getParameters(type, videoEncParams);
         break;
@@ -1068,14 +1279,32 @@ YamiStatus VaapiEncoderHEVC::reorder(const SurfacePtr& surface, uint64_t timeSta
 
     PicturePtr picture(new VaapiEncPictureHEVC(m_context, surface, timeStamp));
 
-    bool isIdr = (m_frameIndex == 0 ||m_frameIndex >= m_keyPeriod || forceKeyFrame);
+    bool isIdr = (m_frameIndex == 0 ||m_frameIndex >= m_keyPeriod || forceKeyFrame
+                  || m_lookaheadStats.sceneCut);
+    //a frame moving too much for a B frame ends the B run early
+    bool endBRun = m_videoParamLookahead.enableAdaptiveB && m_lookaheadStats.highMotion;
+
+    // If the last frame before IDR is B frame, set it to P frame.
+    if (isIdr && m_reorderFrameList.size()) {
+        PicturePtr lastPic = m_reorderFrameList.back();
+        if (lastPic->m_type == VAAPI_PICTURE_B) {
+            lastPic->m_type = VAAPI_PICTURE_P;
+            lastPic->m_isReference = true;
+            m_reorderFrameList.pop_back();
+            m_reorderFrameList.push_front(lastPic);
+        }
+    }
 
     /* check key frames */
     if (isIdr || (m_frameIndex % intraPeriod() == 0)) {
         setIntraFrame (picture, isIdr);
-        m_reorderFrameList.push_back(picture);
+        // in a pyramid an I frame ends the B run as its backward reference
+        if (m_bPyramid && !isIdr)
+            m_reorderFrameList.push_front(picture);
+        else
+            m_reorderFrameList.push_back(picture);
         m_reorderState = VAAPI_ENC_REORD_DUMP_FRAMES;
-    } else if (m_frameIndex % (m_numBFrames + 1) != 0) {
+    } else if (m_frameIndex % (m_numBFrames + 1) != 0 && !endBRun) {
         setBFrame (picture);
         m_reorderFrameList.push_back(picture);
     } else {
@@ -1084,12 +1313,69 @@ YamiStatus VaapiEncoderHEVC::reorder(const SurfacePtr& surface, uint64_t timeSta
         m_reorderState = VAAPI_ENC_REORD_DUMP_FRAMES;
     }
 
+    if (picture->m_type != VAAPI_PICTURE_I)
+        picture->m_qpOffset = m_lookaheadStats.qpOffset;
+
     DEBUG("m_frameIndex is %d\n", m_frameIndex);
     picture->m_poc = m_frameIndex;
     m_frameIndex++;
+
+    if (m_bPyramid && m_reorderState == VAAPI_ENC_REORD_DUMP_FRAMES)
+        setPyramid();
     return YAMI_SUCCESS;
 }
 
+/* Splits the B run [begin, end) at its middle frame, which goes first, then
+ * does the same for both halves. A frame is referenced by the frames of its
+ * halves, so only frames which split nothing stay non-reference. */
+void VaapiEncoderHEVC::pyramidOrder(std::vector<PyramidFrame>& order,
+                                    uint32_t begin, uint32_t end, uint32_t depth)
+{
+    if (begin >= end)
+        return;
+    PyramidFrame frame;
+    frame.index = (begin + end) / 2;
+    frame.depth = depth;
+    frame.begin = begin;
+    frame.end = end;
+    order.push_back(frame);
+    pyramidOrder(order, begin, frame.index, depth + 1);
+    pyramidOrder(order, frame.index + 1, end, depth + 1);
+}
+
+/* Moves the B frames of m_reorderFrameList, queued in display order, into
+ * pyramid order right behind the anchor which ends their run */
+void VaapiEncoderHEVC::setPyramid()
+{
+    std::vector<PicturePtr> bFrames;
+    std::list<PicturePtr>::iterator it = m_reorderFrameList.begin();
+    while (it != m_reorderFrameList.end()) {
+        if ((*it)->m_type == VAAPI_PICTURE_B) {
+            bFrames.push_back(*it);
+            it = m_reorderFrameList.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (bFrames.empty() || m_reorderFrameList.empty())
+        return;
+
+    std::vector<PyramidFrame> order;
+    pyramidOrder(order, 0, bFrames.size());
+
+    it = m_reorderFrameList.begin();
+    ++it;
+    for (size_t i = 0; i < order.size(); i++) {
+        const PyramidFrame& frame = order[i];
+        PicturePtr& picture = bFrames[frame.index];
+        picture->m_depth = frame.depth;
+        picture->m_isReference = frame.end - frame.begin > 1;
+        picture->m_rangeLow = bFrames[frame.begin]->m_poc - 1;
+        picture->m_rangeHigh = bFrames[frame.end - 1]->m_poc + 1;
+        m_reorderFrameList.insert(it, picture);
+    }
+}
+
 // calls immediately after reorder,
 // it makes sure I frame are encoded immediately, so P frames can be pushed to the front of the m_reorderFrameList.
 // it also makes sure input thread and output thread runs in parallel
@@ -1100,7 +1386,30 @@ YamiStatus VaapiEncoderHEVC::doEncode(const SurfacePtr& surface, uint64_t timeSt
     ret = reorder(surface, timeStamp, forceKeyFrame);
     if (ret != YAMI_SUCCESS)
         return ret;
+    return encodeReordered();
+}
 
+YamiStatus VaapiEncoderHEVC::drainReorder()
+{
+    if (m_reorderFrameList.empty())
+        return YAMI_SUCCESS;
+    // The trailing B frames lost their backward reference, the last one takes its place as P.
+    PicturePtr lastPic = m_reorderFrameList.back();
+    if (lastPic->m_type == VAAPI_PICTURE_B) {
+        lastPic->m_type = VAAPI_PICTURE_P;
+        lastPic->m_isReference = true;
+        m_reorderFrameList.pop_back();
+        m_reorderFrameList.push_front(lastPic);
+    }
+    m_reorderState = VAAPI_ENC_REORD_DUMP_FRAMES;
+    if (m_bPyramid)
+        setPyramid();
+    return encodeReordered();
+}
+
+YamiStatus VaapiEncoderHEVC::encodeReordered()
+{
+    YamiStatus ret;
     while (m_reorderState == VAAPI_ENC_REORD_DUMP_FRAMES) {
         if (!m_maxCodedbufSize)
             ensureCodedBufferSize();
@@ -1153,6 +1462,8 @@ void VaapiEncoderHEVC::resetGopStart ()
 void VaapiEncoderHEVC::setBFrame (const PicturePtr& pic)
 {
     pic->m_type = VAAPI_PICTURE_B;
+    //setPyramid makes the B frames which split a run references
+    pic->m_isReference = false;
     pic->m_frameNum = (m_frameIndex % m_maxFrameNum);
 }
 
@@ -1188,24 +1499,86 @@ void VaapiEncoderHEVC::setIntraFrame (const PicturePtr& picture,bool idIdr)
         setIFrame(picture);
 }
 
+static bool pocLess(const VaapiEncoderHEVC::ReferencePtr& a, const VaapiEncoderHEVC::ReferencePtr& b)
+{
+    return a->m_poc < b->m_poc;
+}
+
+static bool pocGreater(const VaapiEncoderHEVC::ReferencePtr& a, const VaapiEncoderHEVC::ReferencePtr& b)
+{
+    return a->m_poc > b->m_poc;
+}
+
+static bool sameShortRfs(const ShortRFS& a, const ShortRFS& b)
+{
+    int i;
+    if (a.num_negative_pics != b.num_negative_pics || a.num_positive_pics != b.num_positive_pics)
+        return false;
+    for (i = 0; i < a.num_negative_pics; i++) {
+        if (a.delta_poc_s0_minus1[i] != b.delta_poc_s0_minus1[i]
+            || a.used_by_curr_pic_s0_flag[i] != b.used_by_curr_pic_s0_flag[i])
+            return false;
+    }
+    for (i = 0; i < a.num_positive_pics; i++) {
+        if (a.delta_poc_s1_minus1[i] != b.delta_poc_s1_minus1[i]
+            || a.used_by_curr_pic_s1_flag[i] != b.used_by_curr_pic_s1_flag[i])
+            return false;
+    }
+    return true;
+}
+
+static void addShortRfs(std::vector<ShortRFS>& sets, const ShortRFS& rps)
+{
+    /* num_short_term_ref_pic_sets is at most 64 */
+    if (sets.size() >= 64)
+        return;
+    for (size_t i = 0; i < sets.size(); i++) {
+        if (sameShortRfs(sets[i], rps))
+            return;
+    }
+    sets.push_back(rps);
+}
+
 bool VaapiEncoderHEVC::
 referenceListUpdate (const PicturePtr& picture, const SurfacePtr& surface)
 {
-    if (VAAPI_PICTURE_B == picture->m_type) {
+    /* all intra streams keep no references */
+    if (!picture->m_isReference || intraPeriod() <= 1) {
         return true;
     }
 
-    if (picture->isIdr()) {
+    if (picture->isIdr())
         m_refList.clear();
-    } else if (m_refList.size() >= m_maxRefFrames) {
-        m_refList.pop_back();
-    }
     ReferencePtr ref(new VaapiEncoderHEVCRef(picture, surface));
     m_refList.push_front(ref); // recent first
-    assert (m_refList.size() <= m_maxRefFrames);
+    assert (m_refList.size() <= m_maxRefFrames + 1);
     return true;
 }
 
+/* Drops the references which neither the picture at poc nor any picture
+ * coded after it uses. Anchors (I and P frames) stay while they are among
+ * the m_maxRefList0Count latest ones in front of poc, or behind poc.
+ * Pyramid B frames stay while poc is within the range they split. */
+void VaapiEncoderHEVC::referenceListPrune(std::deque<ReferencePtr>& refs, uint32_t poc) const
+{
+    uint32_t anchorsBefore = 0;
+    std::deque<ReferencePtr>::iterator it = refs.begin();
+    while (it != refs.end()) {
+        const ReferencePtr& ref = *it;
+        bool keep;
+        if (!ref->m_isAnchor)
+            keep = ref->m_rangeLow < poc && poc < ref->m_rangeHigh;
+        else if (ref->m_poc > poc)
+            keep = true;
+        else
+            keep = ++anchorsBefore <= m_maxRefList0Count;
+        if (keep)
+            ++it;
+        else
+            it = refs.erase(it);
+    }
+}
+
 bool  VaapiEncoderHEVC::pictureReferenceListSet (
     const PicturePtr& picture)
 {
@@ -1215,19 +1588,23 @@ bool  VaapiEncoderHEVC::pictureReferenceListSet (
     m_refList0.clear();
     m_refList1.clear();
 
-    for (i = 0; i < m_refList.size(); i++) {
-        assert(picture->m_poc != m_refList[i]->m_poc);
-        if (picture->m_poc > m_refList[i]->m_poc) {
-            /* set forward reflist */
-            m_refList0.push_front(m_refList[i]);
-            if (m_refList0.size() > m_maxRefList0Count)
-                m_refList0.pop_back();
-        } else {
-            /* set backward reflist */
-            m_refList1.push_front(m_refList[i]);
-            if (m_refList1.size() > m_maxRefList1Count)
-                m_refList1.pop_back();
+    referenceListPrune(m_refList, picture->m_poc);
+
+    if (picture->m_type != VAAPI_PICTURE_I) {
+        for (i = 0; i < m_refList.size(); i++) {
+            assert(picture->m_poc != m_refList[i]->m_poc);
+            if (picture->m_poc > m_refList[i]->m_poc)
+                m_refList0.push_back(m_refList[i]);
+            else if (picture->m_type == VAAPI_PICTURE_B)
+                m_refList1.push_back(m_refList[i]);
         }
+        /* closest first, the order of the reference picture set */
+        std::sort(m_refList0.begin(), m_refList0.end(), pocGreater);
+        std::sort(m_refList1.begin(), m_refList1.end(), pocLess);
+        if (m_refList0.size() > m_maxRefList0Count)
+            m_refList0.resize(m_maxRefList0Count);
+        if (m_refList1.size() > m_maxRefList1Count)
+            m_refList1.resize(m_maxRefList1Count);
     }
 
     shortRfsUpdate(picture);
@@ -1244,72 +1621,139 @@ void VaapiEncoderHEVC::referenceListFree()
     m_refList1.clear();
 }
 
-void VaapiEncoderHEVC::shortRfsUpdate(const PicturePtr& picture)
+/* The set holds every reference left in refs, the numUsedBefore and
+ * numUsedAfter ones closest to poc are used by the picture itself */
+void VaapiEncoderHEVC::fillShortRfs(ShortRFS& rps, uint32_t poc, const std::deque<ReferencePtr>& refs,
+                                    uint32_t numUsedBefore, uint32_t numUsedAfter)
 {
-    int i;
-
-    memset(&m_shortRFS, 0, sizeof(m_shortRFS));
-
-    m_shortRFS.num_short_term_ref_pic_sets = 0;
-    m_shortRFS.inter_ref_pic_set_prediction_flag = 0;
-
-    if (intraPeriod() > 1 && m_refList0.size()) {
-        m_shortRFS.num_negative_pics         = 1;
-        m_shortRFS.delta_poc_s0_minus1[0]  = picture->m_poc - m_refList0[0]->m_poc - 1;
-        m_shortRFS.used_by_curr_pic_s0_flag[0] = 1;
-        if (m_numBFrames && m_refList1.size()) {
-            m_shortRFS.num_positive_pics      = 1;
-            m_shortRFS.delta_poc_s1_minus1[0]  = m_refList1[0]->m_poc - picture->m_poc - 1;
-            m_shortRFS.used_by_curr_pic_s1_flag[0]            = 1;
-			
-            DEBUG("m_refList1_size is %zu\n", m_refList1.size());
-        }
+    std::deque<ReferencePtr> before, after;
+    uint32_t i, last;
+
+    for (i = 0; i < refs.size(); i++) {
+        if (refs[i]->m_poc < poc)
+            before.push_back(refs[i]);
+        else
+            after.push_back(refs[i]);
     }
-
-    for (i = 1; i < m_shortRFS.num_negative_pics; i++)
-    {
-        m_shortRFS.delta_poc_s0_minus1[i]                 = 0;
-        m_shortRFS.used_by_curr_pic_s0_flag[i]            = 1;
+    std::sort(before.begin(), before.end(), pocGreater);
+    std::sort(after.begin(), after.end(), pocLess);
+
+    memset(&rps, 0, sizeof(rps));
+    ASSERT(before.size() <= N_ELEMENTS(rps.delta_poc_s0_minus1)
+           && after.size() <= N_ELEMENTS(rps.delta_poc_s1_minus1));
+
+    rps.num_negative_pics = before.size();
+    last = poc;
+    for (i = 0; i < before.size(); i++) {
+        rps.delta_poc_s0_minus1[i] = last - before[i]->m_poc - 1;
+        rps.used_by_curr_pic_s0_flag[i] = i < numUsedBefore;
+        last = before[i]->m_poc;
     }
 
-    for (i = 1; i < m_shortRFS.num_positive_pics; i++) {
-        m_shortRFS.delta_poc_s1_minus1[i]                 = 0;
-        m_shortRFS.used_by_curr_pic_s1_flag[i]            = 1;
+    rps.num_positive_pics = after.size();
+    last = poc;
+    for (i = 0; i < after.size(); i++) {
+        rps.delta_poc_s1_minus1[i] = after[i]->m_poc - last - 1;
+        rps.used_by_curr_pic_s1_flag[i] = i < numUsedAfter;
+        last = after[i]->m_poc;
     }
-
 }
 
+void VaapiEncoderHEVC::shortRfsUpdate(const PicturePtr& picture)
+{
+    fillShortRfs(m_shortRFS, picture->m_poc, m_refList, m_refList0.size(), m_refList1.size());
+
+    /* refer to the SPS when it carries the set, else code it in the slice header */
+    m_shortRFS.num_short_term_ref_pic_sets = m_shortRfsSets.size();
+    for (size_t i = 0; i < m_shortRfsSets.size(); i++) {
+        if (sameShortRfs(m_shortRFS, m_shortRfsSets[i])) {
+            m_shortRFS.short_term_ref_pic_set_sps_flag = 1;
+            m_shortRFS.short_term_ref_pic_set_idx = i;
+            break;
+        }
+    }
+}
 
+/* Plans the SPS reference picture sets. Walks through mini GOPs the way
+ * reorder() and the reference list functions do until the DPB is full,
+ * and keeps the sets of the last one. Pictures with another set, like the
+ * first ones after an IDR, code theirs in the slice header. */
 void VaapiEncoderHEVC::setShortRfs()
 {
-    int i;
-
+    m_shortRfsSets.clear();
     memset(&m_shortRFS, 0, sizeof(m_shortRFS));
+    m_maxRefFrames = 0;
+    m_maxNumReorder = 0;
 
-    if (intraPeriod() > 1) {
-        m_shortRFS.num_negative_pics         = 1;
-        if (m_numBFrames )
-            m_shortRFS.num_positive_pics      = 1;
-    }
+    if (intraPeriod() <= 1)
+        return;
 
-    m_shortRFS.num_short_term_ref_pic_sets = 0;
-
-    m_shortRFS.inter_ref_pic_set_prediction_flag = 0;
+    std::vector<PyramidFrame> order;
+    if (m_bPyramid) {
+        pyramidOrder(order, 0, m_numBFrames);
+    } else {
+        for (uint32_t i = 0; i < m_numBFrames; i++) {
+            PyramidFrame frame = { i, 0, i, i + 1 };
+            order.push_back(frame);
+        }
+    }
 
-    m_shortRFS.delta_poc_s0_minus1[0]                 = 0;
-    m_shortRFS.used_by_curr_pic_s0_flag[0]            = 1;
+    const uint32_t gop = m_numBFrames + 1;
+    const uint32_t steady = m_maxRefList0Count + 1;
+    std::deque<ReferencePtr> refs;
+    refs.push_front(ReferencePtr(new VaapiEncoderHEVCRef(0, true, 0, 0)));
+    for (uint32_t n = 1; n <= steady; n++) {
+        const uint32_t anchor = n * gop;
+        const uint32_t first = anchor - m_numBFrames;
+        for (uint32_t i = 0; i <= order.size(); i++) {
+            //the anchor goes first, then its B run
+            bool isB = i > 0;
+            uint32_t poc = anchor;
+            uint32_t numReorder = 0;
+            ShortRFS rps;
+            if (isB) {
+                const PyramidFrame& frame = order[i - 1];
+                poc = first + frame.index;
+                //the anchor and the B frames before this one but behind it
+                numReorder = 1;
+                for (uint32_t j = 0; j < i - 1; j++)
+                    numReorder += order[j].index > frame.index;
+            }
 
-    for (i = 1; i < m_shortRFS.num_negative_pics; i++)
-    {
-        m_shortRFS.delta_poc_s0_minus1[i]                 = 0;
-        m_shortRFS.used_by_curr_pic_s0_flag[i]            = 1;
-    }
+            referenceListPrune(refs, poc);
+            uint32_t numBefore = 0, numAfter = 0;
+            for (uint32_t j = 0; j < refs.size(); j++) {
+                if (refs[j]->m_poc < poc)
+                    numBefore++;
+                else
+                    numAfter++;
+            }
+            numBefore = std::min(numBefore, m_maxRefList0Count);
+            numAfter = isB ? std::min(numAfter, m_maxRefList1Count) : 0;
+            m_maxRefFrames = std::max(m_maxRefFrames, (uint32_t)refs.size());
+            m_maxNumReorder = std::max(m_maxNumReorder, numReorder);
+
+            if (n == steady) {
+                fillShortRfs(rps, poc, refs, numBefore, numAfter);
+                addShortRfs(m_shortRfsSets, rps);
+                if (!isB) {
+                    //an I frame in place of the anchor uses none of them
+                    fillShortRfs(rps, poc, refs, 0, 0);
+                    addShortRfs(m_shortRfsSets, rps);
+                }
+            }
 
-    for (i = 1; i < m_shortRFS.num_positive_pics; i++) {
-        m_shortRFS.delta_poc_s1_minus1[i]                 = 0;
-        m_shortRFS.used_by_curr_pic_s1_flag[i]            = 1;
+            if (!isB) {
+                refs.push_front(ReferencePtr(new VaapiEncoderHEVCRef(poc, true, 0, 0)));
+            } else {
+                const PyramidFrame& frame = order[i - 1];
+                if (frame.end - frame.begin > 1)
+                    refs.push_front(ReferencePtr(new VaapiEncoderHEVCRef(poc, false,
+                        first + frame.begin - 1, first + frame.end)));
+            }
+        }
     }
-
+    INFO("%zu short term reference picture sets in SPS", m_shortRfsSets.size());
 }
 
 bool VaapiEncoderHEVC::fill(VAEncSequenceParameterBufferHEVC* seqParam) const
@@ -1411,12 +1855,16 @@ bool VaapiEncoderHEVC::fill(VAEncPictureParameterBufferHEVC* picParam, const Pic
     picParam->pps_cb_qp_offset = 0;
     picParam->pps_cr_qp_offset = 0;
 
-    /* currently multi-tile is disabled */
-    picParam->num_tile_columns_minus1 = 0;
-    picParam->num_tile_rows_minus1 = 0;
+    /* the driver wants the tile sizes even when they are spaced uniformly */
+    picParam->num_tile_columns_minus1 = m_tileColumnWidths.size() - 1;
+    picParam->num_tile_rows_minus1 = m_tileRowHeights.size() - 1;
 
     memset(picParam->column_width_minus1, 0, sizeof(picParam->column_width_minus1));
     memset(picParam->row_height_minus1, 0, sizeof(picParam->row_height_minus1));
+    for (i = 0; i < picParam->num_tile_columns_minus1; i++)
+        picParam->column_width_minus1[i] = m_tileColumnWidths[i] - 1;
+    for (i = 0; i < picParam->num_tile_rows_minus1; i++)
+        picParam->row_height_minus1[i] = m_tileRowHeights[i] - 1;
 
     picParam->log2_parallel_merge_level_minus2 = 0;
 
@@ -1431,10 +1879,9 @@ bool VaapiEncoderHEVC::fill(VAEncPictureParameterBufferHEVC* picParam, const Pic
 
     picParam->pic_fields.value = 0;
     picParam->pic_fields.bits.idr_pic_flag = picture->isIdr();
-    /*FIXME: can't support picture type B1 and B2 now */
-    picParam->pic_fields.bits.coding_type = picture->m_type;
-    picParam->pic_fields.bits.reference_pic_flag = (picture->m_type != VAAPI_PICTURE_B);
-    picParam->pic_fields.bits.dependent_slice_segments_enabled_flag = 0;
+    picParam->pic_fields.bits.coding_type = hevc_get_coding_type(picture->m_type, picture->m_depth);
+    picParam->pic_fields.bits.reference_pic_flag = picture->m_isReference;
+    picParam->pic_fields.bits.dependent_slice_segments_enabled_flag = m_videoParamHEVC.dependentSliceSegments;
     picParam->pic_fields.bits.sign_data_hiding_enabled_flag = 0;
     picParam->pic_fields.bits.constrained_intra_pred_flag = 0;
     picParam->pic_fields.bits.transform_skip_enabled_flag = 0;
@@ -1443,9 +1890,9 @@ bool VaapiEncoderHEVC::fill(VAEncPictureParameterBufferHEVC* picParam, const Pic
     picParam->pic_fields.bits.weighted_pred_flag = 0;
     picParam->pic_fields.bits.weighted_bipred_flag = 0;
     picParam->pic_fields.bits.transquant_bypass_enabled_flag = 0;
-    picParam->pic_fields.bits.tiles_enabled_flag = 0;
-    picParam->pic_fields.bits.entropy_coding_sync_enabled_flag = 0;
-    picParam->pic_fields.bits.loop_filter_across_tiles_enabled_flag = 0;
+    picParam->pic_fields.bits.tiles_enabled_flag = tilesEnabled();
+    picParam->pic_fields.bits.entropy_coding_sync_enabled_flag = m_videoParamHEVC.entropyCodingSync;
+    picParam->pic_fields.bits.loop_filter_across_tiles_enabled_flag = m_videoParamHEVC.loopFilterAcrossTiles;
     picParam->pic_fields.bits.pps_loop_filter_across_slices_enabled_flag = 0;
     /* scaling_list_data_present_flag: use default scaling list data*/
     picParam->pic_fields.bits.scaling_list_data_present_flag = 0;
@@ -1492,14 +1939,19 @@ bool VaapiEncoderHEVC:: fillReferenceList(VAEncSliceParameterBufferHEVC* slice)
     return true;
 }
 
+uint8_t VaapiEncoderHEVC::sliceNalUnitType(const PicturePtr& picture)
+{
+    return picture->isIdr() ? IDR_W_RADL : (picture->m_isReference ? TRAIL_R : TRAIL_N);
+}
+
 bool VaapiEncoderHEVC::addPackedSliceHeader(const PicturePtr& picture,
                                         const VAEncSliceParameterBufferHEVC* const sliceParam,
                                         uint32_t sliceIndex) const
 {
     bool ret = true;
     BitWriter bs;
-    BOOL short_term_ref_pic_set_sps_flag = !!m_shortRFS.num_short_term_ref_pic_sets;
-    HevcNalUnitType nalUnitType = (picture->isIdr() ? IDR_W_RADL : TRAIL_R );
+    BOOL short_term_ref_pic_set_sps_flag = m_shortRFS.short_term_ref_pic_set_sps_flag;
+    HevcNalUnitType nalUnitType = (HevcNalUnitType)sliceNalUnitType(picture);
     bs.writeBits(HEVC_NAL_START_CODE, 32);
     bit_writer_write_nal_header(&bs, nalUnitType);
 
@@ -1514,11 +1966,10 @@ bool VaapiEncoderHEVC::addPackedSliceHeader(const PicturePtr& picture,
     bit_writer_put_ue(&bs, 0);
 
     if (sliceIndex) {
-        /* don't support dependent_slice_segments_enabled_flag right now*/
-        ASSERT (!m_picParam->pic_fields.bits.dependent_slice_segments_enabled_flag &&
-                      !sliceParam->slice_fields.bits.dependent_slice_segment_flag);
-
-        bs.writeBits(sliceParam->slice_segment_address, log2(sliceParam->num_ctu_in_slice));
+        if (m_picParam->pic_fields.bits.dependent_slice_segments_enabled_flag)
+            bs.writeBits(sliceParam->slice_fields.bits.dependent_slice_segment_flag, 1);
+        /* Ceil(Log2(PicSizeInCtbsY)) bits */
+        bs.writeBits(sliceParam->slice_segment_address, log2(m_cuWidth * m_cuHeight));
     }
 
     if (!sliceParam->slice_fields.bits.dependent_slice_segment_flag) {
@@ -1557,7 +2008,7 @@ bool VaapiEncoderHEVC::addPackedSliceHeader(const PicturePtr& picture,
             }
         }
 
-        bit_writer_put_ue(&bs, sliceParam->slice_qp_delta);
+        bit_writer_put_se(&bs, sliceParam->slice_qp_delta);
         /* pps_slice_chroma_qp_offsets_present_flag is set to 1 */
         bit_writer_put_ue(&bs, sliceParam->slice_cb_qp_offset);
         bit_writer_put_ue(&bs, sliceParam->slice_cr_qp_offset);
@@ -1565,6 +2016,11 @@ bool VaapiEncoderHEVC::addPackedSliceHeader(const PicturePtr& picture,
           * pps_loop_filter_across_slices_enabled_flag are set to 0 */
     }
 
+    /* num_entry_point_offsets, every segment holds one tile or CTU row */
+    if (m_picParam->pic_fields.bits.tiles_enabled_flag
+        || m_picParam->pic_fields.bits.entropy_coding_sync_enabled_flag)
+        bit_writer_put_ue(&bs, 0);
+
     bit_writer_write_trailing_bits(&bs);
 
     uint8_t* codedData = bs.getBitWriterData();
@@ -1581,9 +2037,6 @@ bool VaapiEncoderHEVC::addPackedSliceHeader(const PicturePtr& picture,
 bool VaapiEncoderHEVC::addSliceHeaders (const PicturePtr& picture) const
 {
     VAEncSliceParameterBufferHEVC *sliceParam;
-    uint32_t sliceOfCtus, sliceModCtus, curSliceCtus;
-    uint32_t numCtus;
-    uint32_t lastCtuIndex;
 
     assert (picture);
 
@@ -1592,23 +2045,14 @@ bool VaapiEncoderHEVC::addSliceHeaders (const PicturePtr& picture) const
         assert(m_refList0.size() > 0);
     }
 
-    numCtus= m_cuWidth * m_cuHeight;
-
-    assert (m_numSlices && m_numSlices < numCtus);
-    sliceOfCtus = numCtus / m_numSlices;
-    sliceModCtus = numCtus % m_numSlices;
-    lastCtuIndex = 0;
-    for (uint32_t i = 0; i < m_numSlices; ++i) {
-        curSliceCtus = sliceOfCtus;
-        if (sliceModCtus) {
-            ++curSliceCtus;
-            --sliceModCtus;
-        }
+    for (uint32_t i = 0; i < m_sliceSegments.size(); ++i) {
+        const SliceSegment& segment = m_sliceSegments[i];
         if (!picture->newSlice(sliceParam))
             return false;
 
-        sliceParam->slice_segment_address = lastCtuIndex;
-        sliceParam->num_ctu_in_slice = curSliceCtus;
+        sliceParam->slice_segment_address = segment.address;
+        sliceParam->num_ctu_in_slice = segment.numCtus;
+        sliceParam->slice_fields.bits.dependent_slice_segment_flag = segment.dependent;
         sliceParam->slice_type = hevc_get_slice_type (picture->m_type);
         assert (sliceParam->slice_type != -1);
         sliceParam->slice_pic_parameter_set_id = 0;
@@ -1625,23 +2069,25 @@ bool VaapiEncoderHEVC::addSliceHeaders (const PicturePtr& picture) const
         /* max_num_merge_cand should be the range [1, 5 + NumExtraMergeCand] */
         sliceParam->max_num_merge_cand = 5;
 
-        /* let slice_qp equal to init_qp*/
+        /* let slice_qp equal to init_qp, unless lookahead adjusts it
+         * or the picture sits deeper in a pyramid */
         sliceParam->slice_qp_delta = 0;
+        if (rateControlMode() == RATE_CONTROL_CQP && (picture->m_qpOffset || picture->m_depth)) {
+            int32_t qp = (int32_t)initQP() + picture->m_qpOffset + (int32_t)picture->m_depth;
+            qp = std::max(0, std::min(qp, (int32_t)maxQP()));
+            sliceParam->slice_qp_delta = qp - (int32_t)initQP();
+        }
 
         /* slice_beta_offset_div2 and slice_tc_offset_div2  should be the range [-6, 6] */
         sliceParam->slice_beta_offset_div2 = 0;
         sliceParam->slice_tc_offset_div2 = 0;
 
-        /* set calculation for next slice */
-        lastCtuIndex += curSliceCtus;
-
         sliceParam->slice_fields.bits.slice_deblocking_filter_disabled_flag = 0;
 
-        sliceParam->slice_fields.bits.last_slice_of_pic_flag = (lastCtuIndex == numCtus);
+        sliceParam->slice_fields.bits.last_slice_of_pic_flag = (i + 1 == m_sliceSegments.size());
 
         addPackedSliceHeader(picture, sliceParam, i);
     }
-    assert (lastCtuIndex == numCtus);
 
     return true;
 }
@@ -1668,7 +2114,7 @@ bool VaapiEncoderHEVC::ensureSequence(const PicturePtr& picture)
 bool VaapiEncoderHEVC::ensurePicture (const PicturePtr& picture, const SurfacePtr& surface)
 {
 
-    if (picture->m_type != VAAPI_PICTURE_I &&
+    if (!picture->isIdr() &&
             !pictureReferenceListSet(picture)) {
         ERROR ("reference list reorder failed");
         return false;
@@ -24,6 +24,7 @@
 #include <list>
 #include <queue>
 #include <deque>
+#include <vector>
 #include <pthread.h>
 #include <va/va_enc_hevc.h>
 
@@ -36,11 +37,12 @@ typedef struct shortRFS
 {
     unsigned char    num_negative_pics;
     unsigned char    num_positive_pics;
-    unsigned char    delta_poc_s0_minus1[8];
-    unsigned char    used_by_curr_pic_s0_flag[8];
-    unsigned char    delta_poc_s1_minus1[8];
-    unsigned char    used_by_curr_pic_s1_flag[8];
+    unsigned char    delta_poc_s0_minus1[16];
+    unsigned char    used_by_curr_pic_s0_flag[16];
+    unsigned char    delta_poc_s1_minus1[16];
+    unsigned char    used_by_curr_pic_s1_flag[16];
     unsigned char    num_short_term_ref_pic_sets;
+    unsigned char    short_term_ref_pic_set_sps_flag;
     unsigned char    short_term_ref_pic_set_idx;
     unsigned int     inter_ref_pic_set_prediction_flag;
 }ShortRFS;
@@ -70,12 +72,30 @@ public:
 
 protected:
     virtual YamiStatus doEncode(const SurfacePtr&, uint64_t timeStamp, bool forceKeyFrame);
+    virtual YamiStatus drainReorder();
     virtual YamiStatus getCodecConfig(VideoEncOutputBuffer* outBuffer);
 
 private:
     friend class FactoryTest<IVideoEncoder, VaapiEncoderHEVC>;
     friend class VaapiEncoderHEVCTest;
 
+    //a B frame of a pyramid: its index in the B run, how many frames split
+    //the run above it and the range [begin, end) of the run it splits
+    struct PyramidFrame {
+        uint32_t index;
+        uint32_t depth;
+        uint32_t begin;
+        uint32_t end;
+    };
+
+    //a slice segment: raster address of its first CTU, how many CTUs it
+    //holds in tile scan and whether it continues the slice before it
+    struct SliceSegment {
+        uint32_t address;
+        uint32_t numCtus;
+        bool dependent;
+    };
+
     //following code is a template for other encoder implementation
     YamiStatus encodePicture(const PicturePtr&);
     bool fill(VAEncSequenceParameterBufferHEVC*) const;
@@ -84,6 +104,7 @@ private:
     bool ensureSequenceHeader(const PicturePtr&, const VAEncSequenceParameterBufferHEVC* const);
     bool ensurePictureHeader(const PicturePtr&, const VAEncPictureParameterBufferHEVC* const );
     bool addSliceHeaders (const PicturePtr&) const;
+    static uint8_t sliceNalUnitType(const PicturePtr&);
     bool addPackedSliceHeader (const PicturePtr&,
                           const VAEncSliceParameterBufferHEVC* const sliceParam,
                           uint32_t sliceIndex) const;
@@ -94,8 +115,12 @@ private:
 
     //reference list related
     YamiStatus reorder(const SurfacePtr& surface, uint64_t timeStamp, bool forceKeyFrame);
+    YamiStatus encodeReordered();
+    void setPyramid();
+    static void pyramidOrder(std::vector<PyramidFrame>& order, uint32_t begin, uint32_t end, uint32_t depth = 1);
     bool referenceListUpdate (const PicturePtr&, const SurfacePtr&);
     bool pictureReferenceListSet (const PicturePtr&);
+    void referenceListPrune(std::deque<ReferencePtr>& refs, uint32_t poc) const;
 
     void referenceListFree();
     //template end
@@ -108,14 +133,21 @@ private:
     void setIntraFrame(const PicturePtr&, bool idIdr);
     void resetParams();
     void setShortRfs();
+    void setTiles();
+    void setSliceSegments();
+    bool tilesEnabled() const { return m_tileColumnWidths.size() > 1 || m_tileRowHeights.size() > 1; }
     void shortRfsUpdate(const PicturePtr&);
+    static void fillShortRfs(ShortRFS& rps, uint32_t poc, const std::deque<ReferencePtr>& refs,
+                             uint32_t numUsedBefore, uint32_t numUsedAfter);
 
     VideoParamsAVC m_videoParamAVC;
+    VideoParamsHEVC m_videoParamHEVC;
 
     uint8_t m_profileIdc;
     uint8_t m_levelIdc;
     uint32_t m_numSlices;
     uint32_t m_numBFrames;
+    bool m_bPyramid;
     uint32_t m_ctbSize;
     uint32_t m_cuSize;
     uint32_t m_minTbSize;
@@ -126,6 +158,12 @@ private:
     uint32_t m_cuWidth;
     uint32_t m_cuHeight;
 
+    //CTU widths of the tile columns and heights of the tile rows
+    std::vector<uint32_t> m_tileColumnWidths;
+    std::vector<uint32_t> m_tileRowHeights;
+    bool m_uniformTiles;
+    std::vector<SliceSegment> m_sliceSegments;
+
     /* re-ordering */
     std::list<PicturePtr> m_reorderFrameList;
     VaapiEncReorderState m_reorderState;
@@ -137,7 +175,9 @@ private:
     std::deque<ReferencePtr> m_refList0;
     std::deque<ReferencePtr> m_refList1;
     
+    //most pictures the DPB holds for reference while one is coded
     uint32_t m_maxRefFrames;
+    uint32_t m_maxNumReorder;
     /* max reflist count */
     uint32_t m_maxRefList0Count;
     uint32_t m_maxRefList1Count;
@@ -158,6 +198,8 @@ private:
     VAEncPictureParameterBufferHEVC* m_picParam;
 
     ShortRFS m_shortRFS;
+    //sets carried in the SPS, pictures refer to them by short_term_ref_pic_set_idx
+    std::vector<ShortRFS> m_shortRfsSets;
     StreamHeaderPtr m_headers;
     Lock m_paramLock; // locker for parameters update, for example: m_sps/m_pps/m_maxCodedbufSize (width/height etc)
 
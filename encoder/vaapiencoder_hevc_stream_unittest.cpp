@@ -0,0 +1,231 @@
+/*
+ * Copyright 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+//
+// The unittest header must be included before va_x11.h (which might be included
+// indirectly).  The va_x11.h includes Xlib.h and X.h.  And the X headers
+// define 'Bool' and 'None' preprocessor types.  Gtest uses the same names
+// to define some struct placeholders.  Thus, this creates a compile conflict
+// if X defines them before gtest.  Hence, the include order requirement here
+// is the only fix for this right now.
+//
+// See bug filed on gtest at https://github.com/google/googletest/issues/371
+// for more details.
+//
+#include "common/unittest.h"
+
+// primary header
+#include "vaapiencoder_hevc.h"
+
+// library headers
+#include "codecparsers/h265Parser.h"
+#include "common/common_def.h"
+#include "common/nalreader.h"
+#include "common/utils.h"
+
+// system headers
+#include <vector>
+
+namespace YamiMediaCodec {
+
+using namespace YamiParser::H265;
+
+//reads back the parameter sets and slice segment headers the encoder wrote
+class VaapiEncoderHEVCStreamTest : public ::testing::Test {
+protected:
+    struct Segment {
+        uint32_t address;
+        bool dependent;
+    };
+
+    //encodes frames of 640x384, 20x12 CTUs, and keeps the output
+    void encode(const VideoParamsHEVC& hevc, uint32_t frames)
+    {
+        const uint32_t width = 640;
+        const uint32_t height = 384;
+
+        VaapiEncoderHEVC encoder;
+        VideoParamsCommon common;
+        common.size = sizeof(common);
+        ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeCommon, &common));
+        common.resolution.width = width;
+        common.resolution.height = height;
+        common.intraPeriod = frames;
+        common.ipPeriod = 1;
+        common.rcMode = RATE_CONTROL_CQP;
+        ASSERT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeCommon, &common));
+        ASSERT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeHEVC, (Yami_PTR)&hevc));
+
+        uint32_t size;
+        encoder.getMaxOutSize(&size);
+        std::vector<uint8_t> buffer(size);
+        std::vector<uint8_t> data(width * height * 3 / 2, 128);
+
+        m_stream.clear();
+        ASSERT_EQ(YAMI_SUCCESS, encoder.start());
+        for (uint32_t i = 0; i <= frames; i++) {
+            if (i < frames) {
+                for (uint32_t y = 0; y < height; y++) {
+                    for (uint32_t x = 0; x < width; x++)
+                        data[y * width + x] = (x * y + i * 5) & 0xff;
+                }
+                VideoFrameRawData frame = {};
+                EXPECT_TRUE(fillFrameRawData(&frame, YAMI_FOURCC_NV12, width, height, &data[0]));
+                frame.timeStamp = i;
+                EXPECT_EQ(YAMI_SUCCESS, encoder.encode(&frame));
+            } else {
+                EXPECT_EQ(YAMI_SUCCESS, encoder.encode(SharedPtr<VideoFrame>()));
+            }
+
+            VideoEncOutputBuffer output;
+            output.data = &buffer[0];
+            output.bufferSize = buffer.size();
+            output.format = OUTPUT_EVERYTHING;
+            while (encoder.getOutput(&output, false) == YAMI_SUCCESS)
+                m_stream.insert(m_stream.end(), output.data, output.data + output.dataSize);
+        }
+        encoder.stop();
+    }
+
+    //checks the pps of every slice and returns the segments of each picture
+    void parse(const VideoParamsHEVC& hevc, std::vector<std::vector<Segment> >& pictures)
+    {
+        Parser parser;
+        NalReader reader(&m_stream[0], m_stream.size());
+        const uint8_t* nal;
+        int32_t size;
+        bool tiles = hevc.tileColumns > 1 || hevc.tileRows > 1;
+
+        pictures.clear();
+        ASSERT_FALSE(m_stream.empty());
+        while (reader.read(nal, size)) {
+            NalUnit nalu;
+            ASSERT_TRUE(nalu.parseNaluHeader(nal, size));
+            if (nalu.nal_unit_type == NalUnit::VPS_NUT) {
+                ASSERT_TRUE(parser.parseVps(&nalu));
+            } else if (nalu.nal_unit_type == NalUnit::SPS_NUT) {
+                ASSERT_TRUE(parser.parseSps(&nalu));
+            } else if (nalu.nal_unit_type == NalUnit::PPS_NUT) {
+                ASSERT_TRUE(parser.parsePps(&nalu));
+            } else if (nalu.nal_unit_type <= NalUnit::CRA_NUT) {
+                SliceHeader slice;
+                ASSERT_TRUE(parser.parseSlice(&nalu, &slice));
+                const PPS* pps = slice.pps.get();
+                ASSERT_TRUE(pps);
+                EXPECT_EQ(tiles, pps->tiles_enabled_flag);
+                EXPECT_EQ(hevc.entropyCodingSync, pps->entropy_coding_sync_enabled_flag);
+                EXPECT_EQ(hevc.dependentSliceSegments, pps->dependent_slice_segments_enabled_flag);
+                if (tiles) {
+                    EXPECT_EQ(hevc.tileColumns - 1, pps->num_tile_columns_minus1);
+                    EXPECT_EQ(hevc.tileRows - 1, pps->num_tile_rows_minus1);
+                    EXPECT_EQ(!hevc.columnWidth[0], pps->uniform_spacing_flag);
+                    if (!pps->uniform_spacing_flag) {
+                        EXPECT_EQ(hevc.columnWidth[0] - 1, pps->column_width_minus1[0]);
+                    }
+                    EXPECT_EQ(hevc.loopFilterAcrossTiles, pps->loop_filter_across_tiles_enabled_flag);
+                }
+                EXPECT_EQ(0u, slice.num_entry_point_offsets);
+                if (slice.first_slice_segment_in_pic_flag)
+                    pictures.push_back(std::vector<Segment>());
+                ASSERT_FALSE(pictures.empty());
+                Segment segment = { slice.slice_segment_address, slice.dependent_slice_segment_flag };
+                pictures.back().push_back(segment);
+            }
+        }
+    }
+
+    std::vector<uint8_t> m_stream;
+};
+
+#define VAAPIENCODER_HEVC_STREAM_TEST(name) \
+    TEST_F(VaapiEncoderHEVCStreamTest, name)
+
+static VideoParamsHEVC tileParams(uint32_t columns, uint32_t rows, uint32_t firstColumnWidth,
+                                  bool wpp, bool dependent)
+{
+    VideoParamsHEVC hevc = {};
+    hevc.size = sizeof(hevc);
+    hevc.tileColumns = columns;
+    hevc.tileRows = rows;
+    hevc.columnWidth[0] = firstColumnWidth;
+    hevc.loopFilterAcrossTiles = true;
+    hevc.entropyCodingSync = wpp;
+    hevc.dependentSliceSegments = dependent;
+    return hevc;
+}
+
+VAAPIENCODER_HEVC_STREAM_TEST(Encode_UniformTiles)
+{
+    const uint32_t frames = 3;
+    VideoParamsHEVC hevc = tileParams(2, 2, 0, false, false);
+    std::vector<std::vector<Segment> > pictures;
+    encode(hevc, frames);
+    parse(hevc, pictures);
+
+    //10x6 CTU tiles in tile scan, each an independent slice
+    const uint32_t address[] = { 0, 10, 120, 130 };
+    ASSERT_EQ(frames, pictures.size());
+    for (size_t i = 0; i < pictures.size(); i++) {
+        ASSERT_EQ(N_ELEMENTS(address), pictures[i].size());
+        for (size_t j = 0; j < pictures[i].size(); j++) {
+            EXPECT_EQ(address[j], pictures[i][j].address);
+            EXPECT_FALSE(pictures[i][j].dependent);
+        }
+    }
+}
+
+VAAPIENCODER_HEVC_STREAM_TEST(Encode_WppDependentSegments)
+{
+    const uint32_t frames = 3;
+    VideoParamsHEVC hevc = tileParams(2, 1, 12, true, true);
+    std::vector<std::vector<Segment> > pictures;
+    encode(hevc, frames);
+    parse(hevc, pictures);
+
+    //a 12 and an 8 CTU wide column, one segment for each of their CTU rows
+    ASSERT_EQ(frames, pictures.size());
+    for (size_t i = 0; i < pictures.size(); i++) {
+        ASSERT_EQ(24u, pictures[i].size());
+        for (uint32_t j = 0; j < pictures[i].size(); j++) {
+            EXPECT_EQ((j % 12) * 20 + (j < 12 ? 0 : 12), pictures[i][j].address);
+            EXPECT_EQ(j > 0, pictures[i][j].dependent);
+        }
+    }
+}
+
+VAAPIENCODER_HEVC_STREAM_TEST(Encode_Wpp)
+{
+    const uint32_t frames = 2;
+    VideoParamsHEVC hevc = tileParams(1, 1, 0, true, false);
+    std::vector<std::vector<Segment> > pictures;
+    encode(hevc, frames);
+    parse(hevc, pictures);
+
+    ASSERT_EQ(frames, pictures.size());
+    for (size_t i = 0; i < pictures.size(); i++) {
+        ASSERT_EQ(12u, pictures[i].size());
+        for (uint32_t j = 0; j < pictures[i].size(); j++) {
+            EXPECT_EQ(j * 20, pictures[i][j].address);
+            EXPECT_FALSE(pictures[i][j].dependent);
+        }
+    }
+}
+
+}
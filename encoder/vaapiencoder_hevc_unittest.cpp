@@ -34,6 +34,15 @@
 // primary header
 #include "vaapiencoder_hevc.h"
 
+// library headers
+#include "common/common_def.h"
+#include "common/utils.h"
+#include "vaapi/VaapiSurface.h"
+
+// system headers
+#include <list>
+#include <vector>
+
 namespace YamiMediaCodec {
 
 class VaapiEncoderHEVCTest
@@ -49,6 +58,80 @@ protected:
     virtual void TearDown() {
         return;
     }
+
+    typedef VaapiEncoderHEVC::PyramidFrame PyramidFrame;
+    typedef VaapiEncoderHEVC::SliceSegment SliceSegment;
+
+    void pyramidOrder(std::vector<PyramidFrame>& order, uint32_t begin, uint32_t end) const
+    {
+        VaapiEncoderHEVC::pyramidOrder(order, begin, end);
+    }
+
+    void resetParams(VaapiEncoderHEVC& encoder) const
+    {
+        encoder.resetParams();
+    }
+
+    bool isPyramid(const VaapiEncoderHEVC& encoder) const
+    {
+        return encoder.m_bPyramid;
+    }
+
+    uint32_t maxNumReorder(const VaapiEncoderHEVC& encoder) const
+    {
+        return encoder.m_maxNumReorder;
+    }
+
+    uint32_t maxRefFrames(const VaapiEncoderHEVC& encoder) const
+    {
+        return encoder.m_maxRefFrames;
+    }
+
+    uint32_t maxOutputBuffer(const VaapiEncoderHEVC& encoder) const
+    {
+        return encoder.m_maxOutputBuffer;
+    }
+
+    const std::vector<ShortRFS>& shortRfsSets(const VaapiEncoderHEVC& encoder) const
+    {
+        return encoder.m_shortRfsSets;
+    }
+
+    const std::vector<uint32_t>& tileColumnWidths(const VaapiEncoderHEVC& encoder) const
+    {
+        return encoder.m_tileColumnWidths;
+    }
+
+    const std::vector<uint32_t>& tileRowHeights(const VaapiEncoderHEVC& encoder) const
+    {
+        return encoder.m_tileRowHeights;
+    }
+
+    bool uniformTiles(const VaapiEncoderHEVC& encoder) const
+    {
+        return encoder.m_uniformTiles;
+    }
+
+    const std::vector<SliceSegment>& sliceSegments(const VaapiEncoderHEVC& encoder) const
+    {
+        return encoder.m_sliceSegments;
+    }
+
+    YamiStatus reorder(VaapiEncoderHEVC& encoder, bool forceKeyFrame = false) const
+    {
+        SurfacePtr surface(new VaapiSurface(0, 352, 288));
+        return encoder.reorder(surface, 0, forceKeyFrame);
+    }
+
+    //nal_unit_type of the pictures waiting in coding order
+    std::vector<uint8_t> reorderedNalUnitTypes(const VaapiEncoderHEVC& encoder) const
+    {
+        std::vector<uint8_t> types;
+        std::list<VaapiEncoderHEVC::PicturePtr>::const_iterator it;
+        for (it = encoder.m_reorderFrameList.begin(); it != encoder.m_reorderFrameList.end(); ++it)
+            types.push_back(VaapiEncoderHEVC::sliceNalUnitType(*it));
+        return types;
+    }
 };
 
 #define VAAPIENCODER_HEVC_TEST(name) \
@@ -61,4 +144,265 @@ VAAPIENCODER_HEVC_TEST(Factory) {
     doFactoryTest(mimeTypes);
 }
 
+VAAPIENCODER_HEVC_TEST(PyramidOrder)
+{
+    std::vector<PyramidFrame> order;
+    pyramidOrder(order, 0, 7);
+
+    //the B run of a GOP 8 pyramid, coded as poc 4 2 1 3 6 5 7
+    const uint32_t index[] = { 3, 1, 0, 2, 5, 4, 6 };
+    const uint32_t depth[] = { 1, 2, 3, 3, 2, 3, 3 };
+    const bool reference[] = { true, true, false, false, true, false, false };
+    ASSERT_EQ(N_ELEMENTS(index), order.size());
+    for (size_t i = 0; i < order.size(); i++) {
+        EXPECT_EQ(index[i], order[i].index);
+        EXPECT_EQ(depth[i], order[i].depth);
+        EXPECT_EQ(reference[i], order[i].end - order[i].begin > 1);
+    }
+}
+
+static void setGop(VaapiEncoderHEVC& encoder, uint32_t width, uint32_t height,
+                   uint32_t intraPeriod, uint32_t ipPeriod, bool pyramid)
+{
+    VideoParamsCommon common;
+    common.size = sizeof(common);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeCommon, &common));
+    common.resolution.width = width;
+    common.resolution.height = height;
+    common.intraPeriod = intraPeriod;
+    common.ipPeriod = ipPeriod;
+    common.rcMode = RATE_CONTROL_CQP;
+    common.rcParams.initQP = 30;
+    ASSERT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeCommon, &common));
+
+    VideoParamsHEVC hevc;
+    hevc.size = sizeof(hevc);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeHEVC, &hevc));
+    hevc.enableBPyramid = pyramid;
+    ASSERT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeHEVC, &hevc));
+}
+
+VAAPIENCODER_HEVC_TEST(ShortRfsSets)
+{
+    VaapiEncoderHEVC encoder;
+
+    setGop(encoder, 352, 288, 32, 8, false);
+    resetParams(encoder);
+    EXPECT_FALSE(isPyramid(encoder));
+    EXPECT_EQ(1u, maxNumReorder(encoder));
+    EXPECT_EQ(2u, maxRefFrames(encoder));
+
+    setGop(encoder, 352, 288, 32, 8, true);
+    resetParams(encoder);
+    EXPECT_TRUE(isPyramid(encoder));
+    //poc 1 waits for 8, 4 and 2 and is coded with 0, 2, 4 and 8 in the DPB
+    EXPECT_EQ(3u, maxNumReorder(encoder));
+    EXPECT_EQ(4u, maxRefFrames(encoder));
+    EXPECT_LE(maxRefFrames(encoder) + 1, maxOutputBuffer(encoder));
+
+    //P, I and one set for each B frame
+    const std::vector<ShortRFS>& sets = shortRfsSets(encoder);
+    ASSERT_EQ(9u, sets.size());
+    const ShortRFS& p = sets[0];
+    EXPECT_EQ(1, p.num_negative_pics);
+    EXPECT_EQ(0, p.num_positive_pics);
+    EXPECT_EQ(7, p.delta_poc_s0_minus1[0]);
+    EXPECT_EQ(1, p.used_by_curr_pic_s0_flag[0]);
+
+    //poc 9 (1 in the run) references 8 and 10, and keeps 12 and 16
+    const ShortRFS& b = sets[4];
+    EXPECT_EQ(1, b.num_negative_pics);
+    EXPECT_EQ(0, b.delta_poc_s0_minus1[0]);
+    EXPECT_EQ(3, b.num_positive_pics);
+    EXPECT_EQ(0, b.delta_poc_s1_minus1[0]);
+    EXPECT_EQ(1, b.delta_poc_s1_minus1[1]);
+    EXPECT_EQ(3, b.delta_poc_s1_minus1[2]);
+    EXPECT_EQ(1, b.used_by_curr_pic_s1_flag[0]);
+    EXPECT_EQ(0, b.used_by_curr_pic_s1_flag[1]);
+    EXPECT_EQ(0, b.used_by_curr_pic_s1_flag[2]);
+}
+
+VAAPIENCODER_HEVC_TEST(FlatBFramesAreNotReferences)
+{
+    const uint8_t TRAIL_N = 0, TRAIL_R = 1, IDR_W_RADL = 19;
+    VaapiEncoderHEVC encoder;
+    setGop(encoder, 352, 288, 32, 4, false);
+    //pictures need the context
+    ASSERT_EQ(YAMI_SUCCESS, encoder.start());
+    EXPECT_FALSE(isPyramid(encoder));
+
+    for (int i = 0; i < 5; i++)
+        ASSERT_EQ(YAMI_SUCCESS, reorder(encoder));
+    const uint8_t gop[] = { TRAIL_R, IDR_W_RADL, TRAIL_N, TRAIL_N, TRAIL_N };
+    EXPECT_EQ(std::vector<uint8_t>(gop, gop + N_ELEMENTS(gop)), reorderedNalUnitTypes(encoder));
+
+    //a B frame turned into P in front of an IDR is referenced again
+    ASSERT_EQ(YAMI_SUCCESS, reorder(encoder));
+    ASSERT_EQ(YAMI_SUCCESS, reorder(encoder, true));
+    const uint8_t idr[] = { TRAIL_R, TRAIL_R, IDR_W_RADL, TRAIL_N, TRAIL_N, TRAIL_N, IDR_W_RADL };
+    EXPECT_EQ(std::vector<uint8_t>(idr, idr + N_ELEMENTS(idr)), reorderedNalUnitTypes(encoder));
+    encoder.stop();
+}
+
+static void setTiles(VaapiEncoderHEVC& encoder, uint32_t columns, uint32_t rows,
+                     uint32_t firstColumnWidth, bool wpp, bool dependent)
+{
+    VideoParamsHEVC hevc;
+    hevc.size = sizeof(hevc);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeHEVC, &hevc));
+    hevc.tileColumns = columns;
+    hevc.tileRows = rows;
+    hevc.columnWidth[0] = firstColumnWidth;
+    hevc.entropyCodingSync = wpp;
+    hevc.dependentSliceSegments = dependent;
+    ASSERT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeHEVC, &hevc));
+}
+
+VAAPIENCODER_HEVC_TEST(TileParams)
+{
+    VaapiEncoderHEVC encoder;
+    VideoParamsHEVC hevc;
+    hevc.size = sizeof(hevc);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeHEVC, &hevc));
+    EXPECT_EQ(1u, hevc.tileColumns);
+    EXPECT_EQ(1u, hevc.tileRows);
+
+    hevc.tileColumns = 0;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeHEVC, &hevc));
+    hevc.tileColumns = 21;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeHEVC, &hevc));
+    hevc.tileColumns = 20;
+    hevc.tileRows = 23;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeHEVC, &hevc));
+    hevc.tileRows = 22;
+    hevc.size = sizeof(hevc) - 1;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeHEVC, &hevc));
+    hevc.size = sizeof(hevc);
+    EXPECT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeHEVC, &hevc));
+}
+
+VAAPIENCODER_HEVC_TEST(TileLayout)
+{
+    VaapiEncoderHEVC encoder;
+
+    //60x34 CTUs, 4x3 uniform tiles, a slice for each
+    setGop(encoder, 1920, 1080, 30, 1, false);
+    setTiles(encoder, 4, 3, 0, false, false);
+    resetParams(encoder);
+    EXPECT_TRUE(uniformTiles(encoder));
+    const uint32_t widths[] = { 15, 15, 15, 15 };
+    const uint32_t heights[] = { 11, 11, 12 };
+    EXPECT_EQ(std::vector<uint32_t>(widths, widths + N_ELEMENTS(widths)), tileColumnWidths(encoder));
+    EXPECT_EQ(std::vector<uint32_t>(heights, heights + N_ELEMENTS(heights)), tileRowHeights(encoder));
+    const std::vector<SliceSegment>& tiles = sliceSegments(encoder);
+    ASSERT_EQ(12u, tiles.size());
+    EXPECT_EQ(15u, tiles[1].address);
+    EXPECT_EQ(15u * 11, tiles[1].numCtus);
+    EXPECT_EQ(11u * 60, tiles[4].address);
+    EXPECT_EQ(22u * 60 + 45, tiles[11].address);
+    EXPECT_EQ(15u * 12, tiles[11].numCtus);
+    for (size_t i = 0; i < tiles.size(); i++)
+        EXPECT_FALSE(tiles[i].dependent);
+
+    //columns narrower than 256 luma samples are not allowed
+    setTiles(encoder, 8, 1, 0, false, false);
+    resetParams(encoder);
+    EXPECT_EQ(7u, tileColumnWidths(encoder).size());
+    EXPECT_EQ(1u, tileRowHeights(encoder).size());
+
+    //20x12 CTUs, explicit columns with a dependent segment for each CTU row
+    setGop(encoder, 640, 384, 30, 1, false);
+    setTiles(encoder, 2, 1, 12, true, true);
+    resetParams(encoder);
+    EXPECT_FALSE(uniformTiles(encoder));
+    ASSERT_EQ(2u, tileColumnWidths(encoder).size());
+    EXPECT_EQ(12u, tileColumnWidths(encoder)[0]);
+    EXPECT_EQ(8u, tileColumnWidths(encoder)[1]);
+    const std::vector<SliceSegment>& rows = sliceSegments(encoder);
+    ASSERT_EQ(24u, rows.size());
+    EXPECT_FALSE(rows[0].dependent);
+    EXPECT_EQ(12u, rows[0].numCtus);
+    EXPECT_TRUE(rows[1].dependent);
+    EXPECT_EQ(20u, rows[1].address);
+    EXPECT_EQ(12u, rows[12].address);
+    EXPECT_EQ(8u, rows[12].numCtus);
+    EXPECT_TRUE(rows[12].dependent);
+
+    //an explicit column too narrow falls back to uniform spacing
+    setTiles(encoder, 2, 1, 4, false, false);
+    resetParams(encoder);
+    EXPECT_TRUE(uniformTiles(encoder));
+    EXPECT_EQ(10u, tileColumnWidths(encoder)[0]);
+    EXPECT_EQ(2u, sliceSegments(encoder).size());
+
+    //no tiles, wpp only, independent CTU rows
+    setTiles(encoder, 1, 1, 0, true, false);
+    resetParams(encoder);
+    const std::vector<SliceSegment>& wpp = sliceSegments(encoder);
+    ASSERT_EQ(12u, wpp.size());
+    EXPECT_EQ(20u, wpp[1].address);
+    EXPECT_EQ(20u, wpp[1].numCtus);
+    EXPECT_FALSE(wpp[1].dependent);
+}
+
+//coded bytes of a moving gradient, and the microseconds it took
+static uint64_t encodeGradient(uint32_t ipPeriod, bool pyramid, int64_t& encodeUs)
+{
+    const uint32_t width = 352;
+    const uint32_t height = 288;
+    const uint32_t frames = 64;
+
+    VaapiEncoderHEVC encoder;
+    setGop(encoder, width, height, frames, ipPeriod, pyramid);
+
+    uint32_t size;
+    encoder.getMaxOutSize(&size);
+    std::vector<uint8_t> buffer(size);
+    std::vector<uint8_t> data(width * height * 3 / 2, 128);
+    uint64_t bytes = 0;
+
+    uint64_t begin = getMonotonicTimeUs();
+    EXPECT_EQ(YAMI_SUCCESS, encoder.start());
+    for (uint32_t i = 0; i <= frames; i++) {
+        if (i < frames) {
+            for (uint32_t y = 0; y < height; y++) {
+                for (uint32_t x = 0; x < width; x++)
+                    data[y * width + x] = (x + y + i * 3) & 0xff;
+            }
+            VideoFrameRawData frame = {};
+            EXPECT_TRUE(fillFrameRawData(&frame, YAMI_FOURCC_NV12, width, height, &data[0]));
+            frame.timeStamp = i;
+            EXPECT_EQ(YAMI_SUCCESS, encoder.encode(&frame));
+        } else {
+            EXPECT_EQ(YAMI_SUCCESS, encoder.encode(SharedPtr<VideoFrame>()));
+        }
+
+        VideoEncOutputBuffer output;
+        output.data = &buffer[0];
+        output.bufferSize = buffer.size();
+        output.format = OUTPUT_EVERYTHING;
+        while (encoder.getOutput(&output, false) == YAMI_SUCCESS)
+            bytes += output.dataSize;
+    }
+    encoder.stop();
+    encodeUs = getMonotonicTimeUs() - begin;
+    return bytes;
+}
+
+VAAPIENCODER_HEVC_TEST(Encode_PyramidGain)
+{
+    int64_t flatUs, gop8Us, gop16Us;
+    uint64_t flat = encodeGradient(8, false, flatUs);
+    uint64_t gop8 = encodeGradient(8, true, gop8Us);
+    uint64_t gop16 = encodeGradient(16, true, gop16Us);
+
+    RecordProperty("FlatBytes", (int)flat);
+    RecordProperty("FlatUs", (int)flatUs);
+    RecordProperty("Gop8PyramidBytes", (int)gop8);
+    RecordProperty("Gop8PyramidUs", (int)gop8Us);
+    RecordProperty("Gop16PyramidBytes", (int)gop16);
+    RecordProperty("Gop16PyramidUs", (int)gop16Us);
+    EXPECT_LT(gop8, flat);
+}
+
 }
@@ -26,6 +26,7 @@
 #include "vaapiencpicture.h"
 #include "vaapiencoder_factory.h"
 #include "common/log.h"
+#include <algorithm>
 #include <stdio.h>
 #include <tr1/array>
 
@@ -34,6 +35,8 @@
 #define NUM_AC_CODE_WORDS_HUFFVAL 162
 #define NUM_DC_CODE_WORDS_HUFFVAL 12
 
+#define JPEG_DEFAULT_QUALITY 50
+
 using ::YamiParser::JPEG::FrameHeader;
 using ::YamiParser::JPEG::ScanHeader;
 using ::YamiParser::JPEG::QuantTable;
@@ -99,9 +102,13 @@ static const size_t JPEG_HEADER_SIZE = 83 + (YamiParser::JPEG::DCTSIZE2 * 2)
     + (NUM_DC_RUN_SIZE_BITS * 2) + (NUM_DC_CODE_WORDS_HUFFVAL * 2)
     + (NUM_AC_RUN_SIZE_BITS * 2) + (NUM_AC_CODE_WORDS_HUFFVAL * 2);
 
+//SOI, APP0 and two DQT segments come before the height in SOF0
+static const size_t JPEG_HEADER_HEIGHT_OFFSET = 2 + 18 + 2 * (5 + YamiParser::JPEG::DCTSIZE2) + 5;
+
 typedef std::tr1::array<uint8_t, JPEG_HEADER_SIZE> JPEGHeader;
 
-int buildJpegHeader(JPEGHeader& header, int picture_width, int picture_height)
+int buildJpegHeader(JPEGHeader& header, int picture_width, int picture_height,
+                    const uint8_t quantTables[][YamiParser::JPEG::DCTSIZE2])
 {
     using namespace ::YamiParser::JPEG;
 
@@ -132,23 +139,18 @@ int buildJpegHeader(JPEGHeader& header, int picture_width, int picture_height)
     header[++idx] = 0x00; // Thumbnail height
 
     // Quantization Tables
-    const QuantTables& quantTables = Defaults::instance().quantTables();
     for (size_t i(0); i < 2; ++i) {
-        const QuantTable::Shared& quantTable = quantTables[i];
         header[++idx] = 0xFF;
         header[++idx] = M_DQT;
         header[++idx] = 0x00;
         header[++idx] = 0x03 + DCTSIZE2; // Segment length:67 (2-byte)
 
         // Only 8-bit (1 byte) precision is supported
-        // 0:8-bit precision, 1:16-bit precision
-        assert(quantTable->precision == 0);
-
         // Precision (4-bit high) = 0, Index (4-bit low) = i
         header[++idx] = static_cast<uint8_t>(i);
 
         for (size_t j(0); j < DCTSIZE2; ++j)
-            header[++idx] = static_cast<uint8_t>(quantTable->values[j]);
+            header[++idx] = quantTables[i][j];
     }
 
     // Start of Frame - Baseline
@@ -159,6 +161,7 @@ int buildJpegHeader(JPEGHeader& header, int picture_width, int picture_height)
     header[++idx] = 0x00;
     header[++idx] = 0x11; // Segment length:17 (2-byte)
     header[++idx] = static_cast<uint8_t>(frameHdr->dataPrecision);
+    assert(idx + 1 == JPEG_HEADER_HEIGHT_OFFSET);
     header[++idx] = static_cast<uint8_t>((frameHdr->imageHeight >> 8) & 0xFF);
     header[++idx] = static_cast<uint8_t>(frameHdr->imageHeight & 0xFF);
     header[++idx] = static_cast<uint8_t>((frameHdr->imageWidth >> 8) & 0xFF);
@@ -229,6 +232,15 @@ int buildJpegHeader(JPEGHeader& header, int picture_width, int picture_height)
     return ++idx << 3;
 }
 
+void patchJpegHeaderSize(uint8_t* header, int picture_width, int picture_height)
+{
+    uint8_t* size = header + JPEG_HEADER_HEIGHT_OFFSET;
+    size[0] = static_cast<uint8_t>((picture_height >> 8) & 0xFF);
+    size[1] = static_cast<uint8_t>(picture_height & 0xFF);
+    size[2] = static_cast<uint8_t>((picture_width >> 8) & 0xFF);
+    size[3] = static_cast<uint8_t>(picture_width & 0xFF);
+}
+
 namespace YamiMediaCodec {
 
 typedef VaapiEncoderJpeg::PicturePtr PicturePtr;
@@ -237,9 +249,13 @@ class VaapiEncPictureJPEG:public VaapiEncPicture
 {
 public:
     VaapiEncPictureJPEG(const ContextPtr& context, const SurfacePtr& surface, int64_t timeStamp):
-        VaapiEncPicture(context, surface, timeStamp)
+        VaapiEncPicture(context, surface, timeStamp),
+        m_width(0),
+        m_height(0)
     {
     }
+     uint32_t m_width;
+     uint32_t m_height;
      VAEncPictureParameterBufferJPEG picParam;
      VAQMatrixBufferJPEG             qMatrix;
      VAEncSliceParameterBufferJPEG   sliceParam;
@@ -247,10 +263,29 @@ public:
 };
 
 VaapiEncoderJpeg::VaapiEncoderJpeg():
-    quality(50)
+    m_headerQuality(0),
+    m_headerWidth(0),
+    m_headerHeight(0)
 {
     m_videoParamCommon.profile = VAProfileJPEGBaseline;
     m_entrypoint = VAEntrypointEncPicture;
+
+    m_videoParamJPEG.size = sizeof(m_videoParamJPEG);
+    setQuality(JPEG_DEFAULT_QUALITY);
+}
+
+/* scales the default tables like jpeg_set_quality() of libjpeg with force_baseline */
+void VaapiEncoderJpeg::setQuality(uint32_t quality)
+{
+    uint32_t scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    const QuantTables& quantTables = Defaults::instance().quantTables();
+    for (size_t i = 0; i < N_ELEMENTS(m_quantTables); i++) {
+        for (size_t j = 0; j < ::YamiParser::JPEG::DCTSIZE2; j++) {
+            uint32_t value = (quantTables[i]->values[j] * scale + 50) / 100;
+            m_quantTables[i][j] = std::max(1U, std::min(value, 255U));
+        }
+    }
+    m_videoParamJPEG.quality = quality;
 }
 
 YamiStatus VaapiEncoderJpeg::getMaxOutSize(uint32_t* maxSize)
@@ -262,7 +297,7 @@ YamiStatus VaapiEncoderJpeg::getMaxOutSize(uint32_t* maxSize)
 
 void VaapiEncoderJpeg::resetParams()
 {
-    m_maxCodedbufSize = width()*height()*3/2;
+    m_maxCodedbufSize = width() * height() * 3 / 2 + JPEG_HEADER_SIZE;
 }
 
 YamiStatus VaapiEncoderJpeg::start()
@@ -281,6 +316,7 @@ void VaapiEncoderJpeg::flush()
 YamiStatus VaapiEncoderJpeg::stop()
 {
     flush();
+    m_batchCodedBuffers.clear();
     return VaapiEncoderBase::stop();
 }
 
@@ -292,6 +328,18 @@ YamiStatus VaapiEncoderJpeg::setParameters(VideoParamConfigType type, Yami_PTR v
         return YAMI_INVALID_PARAM;
 
     switch (type) {
+    case VideoParamsTypeJPEG: {
+        VideoParamsJPEG* jpeg = (VideoParamsJPEG*)videoEncParams;
+        if (jpeg->size != sizeof(VideoParamsJPEG))
+            return YAMI_INVALID_PARAM;
+        if (!jpeg->quality || jpeg->quality > 100) {
+            ERROR("jpeg quality should be 1 to 100, not %d", jpeg->quality);
+            return YAMI_INVALID_PARAM;
+        }
+        if (jpeg->quality != m_videoParamJPEG.quality)
+            setQuality(jpeg->quality);
+        break;
+    }
     default:
         status = VaapiEncoderBase::setParameters(type, videoEncParams);
         break;
@@ -305,6 +353,13 @@ YamiStatus VaapiEncoderJpeg::getParameters(VideoParamConfigType type, Yami_PTR v
     if (!videoEncParams)
         return YAMI_INVALID_PARAM;
 
+    if (type == VideoParamsTypeJPEG) {
+        VideoParamsJPEG* jpeg = (VideoParamsJPEG*)videoEncParams;
+        if (jpeg->size != sizeof(VideoParamsJPEG))
+            return YAMI_INVALID_PARAM;
+        PARAMETER_ASSIGN(*jpeg, m_videoParamJPEG);
+        return YAMI_SUCCESS;
+    }
     return VaapiEncoderBase::getParameters(type, videoEncParams);
 }
 
@@ -315,6 +370,8 @@ YamiStatus VaapiEncoderJpeg::doEncode(const SurfacePtr& surface, uint64_t timeSt
     CodedBufferPtr codedBuffer = VaapiCodedBuffer::create(m_context, m_maxCodedbufSize);
     PicturePtr picture(new VaapiEncPictureJPEG(m_context, surface, timeStamp));
     picture->m_codedBuffer = codedBuffer;
+    picture->m_width = width();
+    picture->m_height = height();
     ret = encodePicture(picture);
     if (ret != YAMI_SUCCESS)
         return ret;
@@ -324,12 +381,70 @@ YamiStatus VaapiEncoderJpeg::doEncode(const SurfacePtr& surface, uint64_t timeSt
     return YAMI_SUCCESS;
 }
 
+YamiStatus VaapiEncoderJpeg::encodeBatch(const SharedPtr<VideoFrame>* frames,
+                                         VideoEncOutputBuffer* outputs, uint32_t count)
+{
+    FUNC_ENTER();
+    if (!frames || !outputs || !count)
+        return YAMI_INVALID_PARAM;
+    if (!m_context)
+        return YAMI_FAIL;
+
+    while (m_batchCodedBuffers.size() < count) {
+        CodedBufferPtr codedBuffer = VaapiCodedBuffer::create(m_context, m_maxCodedbufSize);
+        if (!codedBuffer)
+            return YAMI_OUT_MEMORY;
+        m_batchCodedBuffers.push_back(codedBuffer);
+    }
+
+    std::vector<PicturePtr> pictures(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const SharedPtr<VideoFrame>& frame = frames[i];
+        if (!frame)
+            return YAMI_INVALID_PARAM;
+        uint32_t frameWidth = frame->crop.width ? frame->crop.width : width();
+        uint32_t frameHeight = frame->crop.height ? frame->crop.height : height();
+        if (frameWidth > width() || frameHeight > height()) {
+            ERROR("frame %d is %dx%d, larger than %dx%d", i, frameWidth, frameHeight, width(), height());
+            return YAMI_INVALID_PARAM;
+        }
+        SurfacePtr surface = createSurface(frame);
+        if (!surface)
+            return YAMI_INVALID_PARAM;
+
+        PicturePtr picture(new VaapiEncPictureJPEG(m_context, surface, frame->timeStamp));
+        picture->m_codedBuffer = m_batchCodedBuffers[i];
+        picture->m_codedBuffer->reset();
+        picture->m_width = frameWidth;
+        picture->m_height = frameHeight;
+        YamiStatus ret = encodePicture(picture);
+        if (ret != YAMI_SUCCESS)
+            return ret;
+        pictures[i] = picture;
+    }
+
+    //the context runs the pictures in order, the last one done means all are
+    if (!pictures.back()->sync())
+        return YAMI_FAIL;
+
+    YamiStatus status = YAMI_SUCCESS;
+    for (uint32_t i = 0; i < count; i++) {
+        outputs[i].flag = 0;
+        YamiStatus ret = pictures[i]->getOutput(&outputs[i]);
+        if (ret != YAMI_SUCCESS)
+            status = ret;
+        outputs[i].timeStamp = pictures[i]->m_timeStamp;
+        pictures[i]->m_codedBuffer->reset();
+    }
+    return status;
+}
+
 bool VaapiEncoderJpeg::fill(VAEncPictureParameterBufferJPEG * picParam, const PicturePtr &picture,
                             const SurfacePtr &surface) const
 {
     picParam->reconstructed_picture = surface->getID();
-    picParam->picture_height = height();
-    picParam->picture_width = width();
+    picParam->picture_height = picture->m_height;
+    picParam->picture_width = picture->m_width;
     picParam->coded_buf = picture->m_codedBuffer->getID();
     //Profile = Baseline
     picParam->pic_flags.bits.profile = 0;
@@ -346,23 +461,18 @@ bool VaapiEncoderJpeg::fill(VAEncPictureParameterBufferJPEG * picParam, const Pi
     picParam->num_scan = 1;
     // Supporting only upto 3 components maximum
     picParam->num_components = 3;
-    picParam->quality = quality;
+    //the tables are scaled already, drivers scaling them by quality must keep them
+    picParam->quality = JPEG_DEFAULT_QUALITY;
     return TRUE;
 }
 
 bool VaapiEncoderJpeg::fill(VAQMatrixBufferJPEG * qMatrix) const
 {
-    const QuantTable::Shared luminance = Defaults::instance().quantTables()[0];
     qMatrix->load_lum_quantiser_matrix = 1;
-    for (size_t i = 0; i < ::YamiParser::JPEG::DCTSIZE2; i++) {
-        qMatrix->lum_quantiser_matrix[i] = luminance->values[i];
-    }
+    memcpy(qMatrix->lum_quantiser_matrix, m_quantTables[0], sizeof(m_quantTables[0]));
 
-    const QuantTable::Shared chrominance = Defaults::instance().quantTables()[1];
     qMatrix->load_chroma_quantiser_matrix = 1;
-    for (size_t i = 0; i < ::YamiParser::JPEG::DCTSIZE2; i++) {
-        qMatrix->chroma_quantiser_matrix[i] = chrominance->values[i];
-    }
+    memcpy(qMatrix->chroma_quantiser_matrix, m_quantTables[1], sizeof(m_quantTables[1]));
 
     return true;
 }
@@ -474,13 +584,23 @@ bool VaapiEncoderJpeg::ensureHuffTable(const PicturePtr & picture)
     return true;
 }
 
-bool VaapiEncoderJpeg::addSliceHeaders (const PicturePtr& picture) const
+void VaapiEncoderJpeg::ensureHeader(uint32_t width, uint32_t height)
 {
-    unsigned int length_in_bits;
-    JPEGHeader header;
-    length_in_bits = buildJpegHeader(header, width(), height());
+    if (m_header.empty() || m_headerQuality != m_videoParamJPEG.quality) {
+        JPEGHeader header;
+        int length = buildJpegHeader(header, width, height, m_quantTables) >> 3;
+        m_header.assign(header.begin(), header.begin() + length);
+        m_headerQuality = m_videoParamJPEG.quality;
+    } else if (m_headerWidth != width || m_headerHeight != height) {
+        patchJpegHeaderSize(&m_header[0], width, height);
+    }
+    m_headerWidth = width;
+    m_headerHeight = height;
+}
 
-    if(!picture->addPackedHeader(VAEncPackedHeaderRawData, header.data(), length_in_bits))
+bool VaapiEncoderJpeg::addSliceHeaders (const PicturePtr& picture) const
+{
+    if(!picture->addPackedHeader(VAEncPackedHeaderRawData, &m_header[0], m_header.size() << 3))
         return false;
     return true;
 }
@@ -504,6 +624,7 @@ YamiStatus VaapiEncoderJpeg::encodePicture(const PicturePtr& picture)
     if (!ensureSlice (picture))
         return ret;
 
+    ensureHeader(picture->m_width, picture->m_height);
     if (!addSliceHeaders (picture))
         return ret;
     
@@ -20,6 +20,7 @@
 #include "vaapiencoder_base.h"
 #include "vaapi/vaapiptrs.h"
 #include <va/va_enc_jpeg.h>
+#include <vector>
 
 namespace YamiMediaCodec {
 class VaapiEncPictureJPEG;
@@ -37,6 +38,7 @@ public:
     virtual YamiStatus getParameters(VideoParamConfigType type, Yami_PTR videoEncParams);
     virtual YamiStatus setParameters(VideoParamConfigType type, Yami_PTR videoEncParams);
     virtual YamiStatus getMaxOutSize(uint32_t* maxSize);
+    virtual YamiStatus encodeBatch(const SharedPtr<VideoFrame>* frames, VideoEncOutputBuffer* outputs, uint32_t count);
 
 protected:
     virtual YamiStatus doEncode(const SurfacePtr&, uint64_t timeStamp, bool forceKeyFrame);
@@ -57,10 +59,24 @@ private:
     bool ensureQMatrix (const PicturePtr&);
     bool ensureSlice (const PicturePtr&);
     bool ensureHuffTable (const PicturePtr&);
+    void ensureHeader(uint32_t width, uint32_t height);
 
     void resetParams();
+    void setQuality(uint32_t quality);
 
-    unsigned char quality;
+    VideoParamsJPEG m_videoParamJPEG;
+
+    //luminance and chrominance tables scaled to m_videoParamJPEG.quality, in zigzag order
+    uint8_t m_quantTables[2][64];
+
+    //packed header for m_headerQuality, patched when only the size changes
+    std::vector<uint8_t> m_header;
+    uint32_t m_headerQuality;
+    uint32_t m_headerWidth;
+    uint32_t m_headerHeight;
+
+    //coded buffers of encodeBatch(), kept for the next batch
+    std::vector<CodedBufferPtr> m_batchCodedBuffers;
 
     static const bool s_registered; // VaapiEncoderFactory registration result
 };
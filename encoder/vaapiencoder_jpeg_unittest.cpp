@@ -35,7 +35,10 @@
 #include "vaapiencoder_jpeg.h"
 
 // library headers
+#include "codecparsers/jpegParser.h"
 #include "common/utils.h"
+#include "vaapi/vaapidisplay.h"
+#include "vaapi/VaapiUtils.h"
 
 // system headers
 #include <string>
@@ -206,6 +209,23 @@ const static std::tr1::array <uint8_t, 400> g_SimpleSmallRGBX = {
 
 namespace YamiMediaCodec {
 
+struct FrameDestroyer {
+    FrameDestroyer(DisplayPtr display)
+        : m_display(display)
+    {
+    }
+    void operator()(VideoFrame* frame)
+    {
+        VASurfaceID id = (VASurfaceID)frame->surface;
+        checkVaapiStatus(vaDestroySurfaces(m_display->getID(), &id, 1),
+            "vaDestroySurfaces");
+        delete frame;
+    }
+
+private:
+    DisplayPtr m_display;
+};
+
 class VaapiEncoderJpegTest
     : public FactoryTest<IVideoEncoder, VaapiEncoderJpeg>
 {
@@ -219,6 +239,37 @@ protected:
     virtual void TearDown() {
         return;
     }
+
+    const uint8_t* quantTable(const VaapiEncoderJpeg& encoder, size_t index) const
+    {
+        return encoder.m_quantTables[index];
+    }
+
+    const std::vector<uint8_t>& header(VaapiEncoderJpeg& encoder) const
+    {
+        encoder.ensureHeader(encoder.width(), encoder.height());
+        return encoder.m_header;
+    }
+
+    //a surface frame on the display of a started encoder, cropped to width x height
+    SharedPtr<VideoFrame> createFrame(const VaapiEncoderJpeg& encoder,
+        uint32_t width, uint32_t height) const
+    {
+        SharedPtr<VideoFrame> frame;
+        const DisplayPtr& display = encoder.m_display;
+        VASurfaceID id;
+        VAStatus status = vaCreateSurfaces(display->getID(), VA_RT_FORMAT_YUV420,
+            width, height, &id, 1, NULL, 0);
+        if (!checkVaapiStatus(status, "vaCreateSurfaces"))
+            return frame;
+        frame.reset(new VideoFrame, FrameDestroyer(display));
+        memset(frame.get(), 0, sizeof(VideoFrame));
+        frame->surface = (intptr_t)id;
+        frame->crop.width = width;
+        frame->crop.height = height;
+        frame->fourcc = YAMI_FOURCC_NV12;
+        return frame;
+    }
 };
 
 #define VAAPIENCODER_JPEG_TEST(name) \
@@ -230,6 +281,229 @@ VAAPIENCODER_JPEG_TEST(Factory) {
     doFactoryTest(mimeTypes);
 }
 
+static void setQuality(VaapiEncoderJpeg& encoder, uint32_t quality)
+{
+    VideoParamsJPEG jpeg;
+    jpeg.size = sizeof(jpeg);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeJPEG, &jpeg));
+    jpeg.quality = quality;
+    ASSERT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeJPEG, &jpeg));
+}
+
+static void setResolution(VaapiEncoderJpeg& encoder, uint32_t width, uint32_t height)
+{
+    VideoParamsCommon common;
+    common.size = sizeof(common);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeCommon, &common));
+    common.resolution.width = width;
+    common.resolution.height = height;
+    ASSERT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeCommon, &common));
+}
+
+VAAPIENCODER_JPEG_TEST(Quality)
+{
+    using ::YamiParser::JPEG::Defaults;
+    using ::YamiParser::JPEG::DCTSIZE2;
+
+    VaapiEncoderJpeg encoder;
+    VideoParamsJPEG jpeg;
+    jpeg.size = sizeof(jpeg);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeJPEG, &jpeg));
+    EXPECT_EQ(50u, jpeg.quality);
+
+    //50 keeps the default tables
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < DCTSIZE2; j++)
+            EXPECT_EQ(Defaults::instance().quantTables()[i]->values[j], quantTable(encoder, i)[j]);
+    }
+
+    //75 halves them, rounded like libjpeg
+    setQuality(encoder, 75);
+    EXPECT_EQ(8, quantTable(encoder, 0)[0]);
+    EXPECT_EQ(9, quantTable(encoder, 1)[0]);
+
+    //the extremes clamp to baseline values
+    setQuality(encoder, 100);
+    for (size_t j = 0; j < DCTSIZE2; j++)
+        EXPECT_EQ(1, quantTable(encoder, 0)[j]);
+    setQuality(encoder, 1);
+    for (size_t j = 0; j < DCTSIZE2; j++)
+        EXPECT_EQ(255, quantTable(encoder, 1)[j]);
+
+    jpeg.quality = 0;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeJPEG, &jpeg));
+    jpeg.quality = 101;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeJPEG, &jpeg));
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeJPEG, &jpeg));
+    EXPECT_EQ(1u, jpeg.quality);
+}
+
+VAAPIENCODER_JPEG_TEST(HeaderTemplate)
+{
+    using ::YamiParser::JPEG::DCTSIZE2;
+
+    VaapiEncoderJpeg encoder;
+    setResolution(encoder, 64, 48);
+    setQuality(encoder, 75);
+    std::vector<uint8_t> small(header(encoder));
+
+    //the first DQT carries the scaled luminance table
+    const size_t dqt = 2 + 18 + 5;
+    ASSERT_LT(dqt + DCTSIZE2, small.size());
+    for (size_t j = 0; j < DCTSIZE2; j++)
+        EXPECT_EQ(quantTable(encoder, 0)[j], small[dqt + j]);
+
+    //a new size patches the template into what a fresh build gives
+    setResolution(encoder, 1920, 1080);
+    VaapiEncoderJpeg fresh;
+    setResolution(fresh, 1920, 1080);
+    setQuality(fresh, 75);
+    const std::vector<uint8_t>& large = header(encoder);
+    EXPECT_EQ(header(fresh), large);
+    EXPECT_NE(small, large);
+
+    //a new quality rebuilds it
+    setQuality(encoder, 90);
+    const std::vector<uint8_t>& rebuilt = header(encoder);
+    const size_t chromaDqt = dqt + DCTSIZE2 + 5;
+    for (size_t j = 0; j < DCTSIZE2; j++) {
+        EXPECT_EQ(quantTable(encoder, 0)[j], rebuilt[dqt + j]);
+        EXPECT_EQ(quantTable(encoder, 1)[j], rebuilt[chromaDqt + j]);
+    }
+    EXPECT_NE(header(fresh), rebuilt);
+}
+
+//frames per second encoding a burst of small pictures
+VAAPIENCODER_JPEG_TEST(Encode_SmallBurst)
+{
+    const uint32_t width = 160;
+    const uint32_t height = 120;
+    const uint32_t frames = 200;
+
+    VaapiEncoderJpeg encoder;
+    setResolution(encoder, width, height);
+    setQuality(encoder, 75);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.start());
+
+    uint32_t size;
+    encoder.getMaxOutSize(&size);
+    std::vector<uint8_t> buffer(size);
+    std::vector<uint8_t> data(width * height * 3 / 2, 128);
+
+    uint64_t begin = getMonotonicTimeUs();
+    for (uint32_t i = 0; i < frames; i++) {
+        for (uint32_t y = 0; y < height; y++) {
+            for (uint32_t x = 0; x < width; x++)
+                data[y * width + x] = (x + y + i) & 0xff;
+        }
+        VideoFrameRawData frame = {};
+        ASSERT_TRUE(fillFrameRawData(&frame, YAMI_FOURCC_NV12, width, height, &data[0]));
+        ASSERT_EQ(YAMI_SUCCESS, encoder.encode(&frame));
+
+        VideoEncOutputBuffer output;
+        output.data = &buffer[0];
+        output.bufferSize = buffer.size();
+        output.format = OUTPUT_EVERYTHING;
+        ASSERT_EQ(YAMI_SUCCESS, encoder.getOutput(&output, false));
+        EXPECT_LT(0u, output.dataSize);
+    }
+    uint64_t us = getMonotonicTimeUs() - begin;
+    encoder.stop();
+
+    RecordProperty("Frames", (int)frames);
+    RecordProperty("Us", (int)us);
+    RecordProperty("FramesPerSecond", (int)(us ? frames * 1000000LL / us : 0));
+}
+
+//reads the frame size from the SOF0 of an encoded picture
+static bool jpegSize(const VideoEncOutputBuffer& output, uint32_t& width, uint32_t& height)
+{
+    const uint8_t* data = output.data;
+    if (output.dataSize < 2 || data[0] != 0xff || data[1] != 0xd8)
+        return false;
+    for (uint32_t i = 2; i + 9 <= output.dataSize; i++) {
+        if (data[i] == 0xff && data[i + 1] == 0xc0) {
+            height = (data[i + 5] << 8) | data[i + 6];
+            width = (data[i + 7] << 8) | data[i + 8];
+            return true;
+        }
+    }
+    return false;
+}
+
+//thumbnails of mixed sizes in one call, then the cost per thumbnail against encode()
+VAAPIENCODER_JPEG_TEST(Encode_Batch)
+{
+    const uint32_t width = 160;
+    const uint32_t height = 120;
+    const uint32_t count = 16;
+    const uint32_t rounds = 8;
+
+    VaapiEncoderJpeg encoder;
+    setResolution(encoder, width, height);
+    setQuality(encoder, 75);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.start());
+
+    uint32_t size;
+    encoder.getMaxOutSize(&size);
+    std::vector<uint8_t> buffer(size * count);
+    std::vector<VideoEncOutputBuffer> outputs(count);
+    std::vector<SharedPtr<VideoFrame> > frames(count);
+    for (uint32_t i = 0; i < count; i++) {
+        frames[i] = i & 1 ? createFrame(encoder, 96, 64) : createFrame(encoder, width, height);
+        ASSERT_TRUE(bool(frames[i]));
+        frames[i]->timeStamp = i;
+        outputs[i].data = &buffer[i * size];
+        outputs[i].bufferSize = size;
+        outputs[i].format = OUTPUT_EVERYTHING;
+    }
+
+    ASSERT_EQ(YAMI_SUCCESS, encoder.encodeBatch(&frames[0], &outputs[0], count));
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t w, h;
+        ASSERT_TRUE(jpegSize(outputs[i], w, h));
+        EXPECT_EQ(frames[i]->crop.width, w);
+        EXPECT_EQ(frames[i]->crop.height, h);
+        EXPECT_EQ(frames[i]->timeStamp, outputs[i].timeStamp);
+    }
+
+    //a frame larger than the configured size is refused
+    SharedPtr<VideoFrame> large = createFrame(encoder, width * 2, height);
+    ASSERT_TRUE(bool(large));
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.encodeBatch(&large, &outputs[0], 1));
+
+    for (uint32_t i = 0; i < count; i++) {
+        frames[i] = createFrame(encoder, width, height);
+        ASSERT_TRUE(bool(frames[i]));
+    }
+
+    uint64_t begin = getMonotonicTimeUs();
+    uint64_t cpuBegin = getProcessTimeUs();
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (uint32_t i = 0; i < count; i++) {
+            ASSERT_EQ(YAMI_SUCCESS, encoder.encode(frames[i]));
+            ASSERT_EQ(YAMI_SUCCESS, encoder.getOutput(&outputs[i], false));
+        }
+    }
+    uint64_t singleUs = getMonotonicTimeUs() - begin;
+    uint64_t singleCpuUs = getProcessTimeUs() - cpuBegin;
+
+    begin = getMonotonicTimeUs();
+    cpuBegin = getProcessTimeUs();
+    for (uint32_t r = 0; r < rounds; r++)
+        ASSERT_EQ(YAMI_SUCCESS, encoder.encodeBatch(&frames[0], &outputs[0], count));
+    uint64_t batchUs = getMonotonicTimeUs() - begin;
+    uint64_t batchCpuUs = getProcessTimeUs() - cpuBegin;
+    encoder.stop();
+
+    const uint32_t thumbnails = count * rounds;
+    RecordProperty("Thumbnails", (int)thumbnails);
+    RecordProperty("SingleUsPerThumbnail", (int)(singleUs / thumbnails));
+    RecordProperty("SingleCpuUsPerThumbnail", (int)(singleCpuUs / thumbnails));
+    RecordProperty("BatchUsPerThumbnail", (int)(batchUs / thumbnails));
+    RecordProperty("BatchCpuUsPerThumbnail", (int)(batchCpuUs / thumbnails));
+}
+
 class SimpleDataTest
     : public VaapiEncoderJpegTest
     , public ::testing::WithParamInterface<const char*>
@@ -0,0 +1,321 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "vaapiencoder_lookahead.h"
+#include "common/log.h"
+#include "vaapi/vaapidisplay.h"
+#include "vaapi/VaapiSurface.h"
+#include "vaapi/VaapiUtils.h"
+#include <math.h>
+#include <stdlib.h>
+
+namespace YamiMediaCodec{
+
+//the analysis runs on luma downscaled by this factor in each direction
+const uint32_t DOWNSCALE = 4;
+const uint32_t BLOCK_SIZE = 8;
+//motion search range in downscaled pixels, +-12 pixels at full size
+const int32_t SEARCH_RANGE = 3;
+
+//inter/intra cost ratio, in percent, above which a frame starts a new scene
+const uint64_t SCENE_CUT_PERCENT = 70;
+//inter/intra cost ratio, in percent, above which a frame should not be a B frame
+const uint64_t HIGH_MOTION_PERCENT = 40;
+//frames after a scene cut in which no new cut is reported, to ride out flashes
+const uint32_t MIN_SCENE_LENGTH = 4;
+//average intra cost per downscaled pixel below which frames are too flat to judge
+const uint64_t MIN_INTRA_COST = 1;
+const int32_t MAX_QP_OFFSET = 3;
+
+static uint32_t blockSad(const uint8_t* cur, const uint8_t* ref, uint32_t stride)
+{
+    uint32_t sad = 0;
+    for (uint32_t y = 0; y < BLOCK_SIZE; y++) {
+        for (uint32_t x = 0; x < BLOCK_SIZE; x++)
+            sad += abs(cur[x] - ref[x]);
+        cur += stride;
+        ref += stride;
+    }
+    return sad;
+}
+
+//sum of absolute deviations from the block mean, same scale as blockSad
+static uint32_t blockDeviation(const uint8_t* cur, uint32_t stride)
+{
+    uint32_t sum = 0;
+    const uint8_t* p = cur;
+    for (uint32_t y = 0; y < BLOCK_SIZE; y++) {
+        for (uint32_t x = 0; x < BLOCK_SIZE; x++)
+            sum += p[x];
+        p += stride;
+    }
+    int32_t mean = (sum + BLOCK_SIZE * BLOCK_SIZE / 2) / (BLOCK_SIZE * BLOCK_SIZE);
+    uint32_t dev = 0;
+    for (uint32_t y = 0; y < BLOCK_SIZE; y++) {
+        for (uint32_t x = 0; x < BLOCK_SIZE; x++)
+            dev += abs(cur[x] - mean);
+        cur += stride;
+    }
+    return dev;
+}
+
+static void downscaleLuma(uint8_t* dest, uint32_t width, uint32_t height,
+    const uint8_t* src, uint32_t pitch)
+{
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* row = src + y * DOWNSCALE * pitch;
+        for (uint32_t x = 0; x < width; x++) {
+            uint32_t sum = 0;
+            const uint8_t* p = row + x * DOWNSCALE;
+            for (uint32_t j = 0; j < DOWNSCALE; j++) {
+                for (uint32_t i = 0; i < DOWNSCALE; i++)
+                    sum += p[i];
+                p += pitch;
+            }
+            dest[x] = (sum + DOWNSCALE * DOWNSCALE / 2) / (DOWNSCALE * DOWNSCALE);
+        }
+        dest += width;
+    }
+}
+
+VaapiEncoderLookahead::VaapiEncoderLookahead(const DisplayPtr& display,
+    uint32_t width, uint32_t height, const VideoParamsLookahead& params)
+    : m_display(display)
+    , m_params(params)
+    , m_width(width / DOWNSCALE)
+    , m_height(height / DOWNSCALE)
+    , m_blocksX(m_width / BLOCK_SIZE)
+    , m_blocksY(m_height / BLOCK_SIZE)
+    , m_hasPrev(false)
+    , m_avgCost(0)
+    , m_sinceCut(0)
+    , m_cond(m_lock)
+    , m_busy(false)
+    , m_quit(false)
+    , m_started(false)
+{
+    m_luma.resize(m_width * m_height);
+    m_prevLuma.resize(m_width * m_height);
+}
+
+VaapiEncoderLookahead::~VaapiEncoderLookahead()
+{
+    if (!m_started)
+        return;
+    {
+        AutoLock l(m_lock);
+        m_quit = true;
+        m_cond.broadcast();
+    }
+    pthread_join(m_thread, NULL);
+}
+
+bool VaapiEncoderLookahead::start()
+{
+    if (pthread_create(&m_thread, NULL, analyseThread, this) != 0) {
+        ERROR("failed to create lookahead thread");
+        return false;
+    }
+    m_started = true;
+    return true;
+}
+
+void* VaapiEncoderLookahead::analyseThread(void* arg)
+{
+    VaapiEncoderLookahead* lookahead = static_cast<VaapiEncoderLookahead*>(arg);
+    lookahead->analyseLoop();
+    return NULL;
+}
+
+void VaapiEncoderLookahead::analyseLoop()
+{
+    while (1) {
+        ItemPtr item;
+        {
+            AutoLock l(m_lock);
+            while (!m_quit && m_todo.empty())
+                m_cond.wait();
+            if (m_quit)
+                return;
+            item = m_todo.front();
+            m_todo.pop_front();
+            m_busy = true;
+        }
+        analyse(item->frame);
+        {
+            AutoLock l(m_lock);
+            item->analysed = true;
+            m_busy = false;
+            m_cond.broadcast();
+        }
+    }
+}
+
+void VaapiEncoderLookahead::push(const SurfacePtr& surface, uint64_t timeStamp, bool forceKeyFrame)
+{
+    ItemPtr item(new Item);
+    item->frame.surface = surface;
+    item->frame.timeStamp = timeStamp;
+    item->frame.forceKeyFrame = forceKeyFrame;
+    item->analysed = false;
+
+    AutoLock l(m_lock);
+    m_queue.push_back(item);
+    m_todo.push_back(item);
+    m_cond.broadcast();
+}
+
+bool VaapiEncoderLookahead::front(Frame& frame, bool drain)
+{
+    AutoLock l(m_lock);
+    if (m_queue.empty() || (!drain && m_queue.size() <= m_params.depth))
+        return false;
+    ItemPtr item = m_queue.front();
+    while (!item->analysed)
+        m_cond.wait();
+    frame = item->frame;
+    return true;
+}
+
+void VaapiEncoderLookahead::pop()
+{
+    AutoLock l(m_lock);
+    if (!m_queue.empty())
+        m_queue.pop_front();
+}
+
+void VaapiEncoderLookahead::flush()
+{
+    AutoLock l(m_lock);
+    m_todo.clear();
+    m_queue.clear();
+    while (m_busy)
+        m_cond.wait();
+    //worker is idle with nothing to do, safe to touch its state
+    m_hasPrev = false;
+    m_avgCost = 0;
+    m_sinceCut = 0;
+}
+
+void VaapiEncoderLookahead::analyse(Frame& frame)
+{
+    VAImage image;
+    VADisplay display = m_display->getID();
+    uint8_t* p = mapSurfaceToImage(display, frame.surface->getID(), image);
+    if (!p) {
+        m_hasPrev = false;
+        return;
+    }
+    switch (image.format.fourcc) {
+    case VA_FOURCC_NV12:
+    case VA_FOURCC_I420:
+    case VA_FOURCC_YV12:
+        analyse(p + image.offsets[0], image.pitches[0], frame.forceKeyFrame, frame.stats);
+        break;
+    default:
+        DEBUG("lookahead skips fourcc %x", image.format.fourcc);
+        m_hasPrev = false;
+        break;
+    }
+    unmapImage(display, image);
+}
+
+uint32_t VaapiEncoderLookahead::searchBlock(uint32_t x, uint32_t y) const
+{
+    const uint8_t* cur = &m_luma[y * m_width + x];
+    uint32_t best = 0xffffffff;
+    for (int32_t dy = -SEARCH_RANGE; dy <= SEARCH_RANGE; dy++) {
+        int32_t refY = (int32_t)y + dy;
+        if (refY < 0 || refY + BLOCK_SIZE > m_height)
+            continue;
+        for (int32_t dx = -SEARCH_RANGE; dx <= SEARCH_RANGE; dx++) {
+            int32_t refX = (int32_t)x + dx;
+            if (refX < 0 || refX + BLOCK_SIZE > m_width)
+                continue;
+            uint32_t sad = blockSad(cur, &m_prevLuma[refY * m_width + refX], m_width);
+            if (sad < best)
+                best = sad;
+        }
+    }
+    return best;
+}
+
+void VaapiEncoderLookahead::analyse(const uint8_t* luma, uint32_t pitch,
+    bool forceKeyFrame, LookaheadStats& stats)
+{
+    if (!m_blocksX || !m_blocksY) {
+        m_hasPrev = false;
+        return;
+    }
+    downscaleLuma(&m_luma[0], m_width, m_height, luma, pitch);
+
+    uint64_t intraCost = 0;
+    uint64_t interCost = 0;
+    for (uint32_t by = 0; by < m_blocksY; by++) {
+        for (uint32_t bx = 0; bx < m_blocksX; bx++) {
+            uint32_t offset = by * BLOCK_SIZE * m_width + bx * BLOCK_SIZE;
+            uint32_t intra = blockDeviation(&m_luma[offset], m_width);
+            intraCost += intra;
+            if (m_hasPrev) {
+                uint32_t inter = searchBlock(bx * BLOCK_SIZE, by * BLOCK_SIZE);
+                //a block the encoder can not predict will be coded intra
+                interCost += inter < intra ? inter : intra;
+            }
+        }
+    }
+
+    uint64_t pixels = (uint64_t)m_blocksX * m_blocksY * BLOCK_SIZE * BLOCK_SIZE;
+    bool flat = intraCost < MIN_INTRA_COST * pixels;
+    if (m_hasPrev && !flat) {
+        m_sinceCut++;
+        if (m_params.enableSceneCut && !forceKeyFrame
+            && m_sinceCut >= MIN_SCENE_LENGTH
+            && interCost * 100 > intraCost * SCENE_CUT_PERCENT) {
+            stats.sceneCut = true;
+        }
+        stats.highMotion = interCost * 100 > intraCost * HIGH_MOTION_PERCENT;
+    }
+    if (stats.sceneCut || forceKeyFrame)
+        m_sinceCut = 0;
+
+    if (stats.sceneCut) {
+        //new scene, new baseline
+        m_avgCost = 0;
+    } else if (m_params.enableAdaptiveQP && m_hasPrev) {
+        if (m_avgCost && interCost) {
+            //qp follows complexity^0.4 as in a qcomp 0.6 rate control: 6 * 0.4 * log2(ratio)
+            double offset = 2.4 * log((double)interCost / m_avgCost) / log(2.0);
+            int32_t qpOffset = (int32_t)(offset < 0 ? offset - 0.5 : offset + 0.5);
+            if (qpOffset > MAX_QP_OFFSET)
+                qpOffset = MAX_QP_OFFSET;
+            if (qpOffset < -MAX_QP_OFFSET)
+                qpOffset = -MAX_QP_OFFSET;
+            stats.qpOffset = qpOffset;
+        }
+        if (!m_avgCost)
+            m_avgCost = interCost;
+        else
+            m_avgCost = (m_avgCost * 7 + interCost) / 8;
+    }
+
+    m_luma.swap(m_prevLuma);
+    m_hasPrev = true;
+}
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef vaapiencoder_lookahead_h
+#define vaapiencoder_lookahead_h
+
+#include "interface/VideoEncoderDefs.h"
+#include "common/condition.h"
+#include "common/lock.h"
+#include "vaapi/vaapiptrs.h"
+
+#include <deque>
+#include <vector>
+#include <pthread.h>
+
+namespace YamiMediaCodec{
+
+/* what the lookahead learned about one input frame */
+struct LookaheadStats {
+    bool sceneCut;     //frame starts a new scene
+    bool highMotion;   //inter cost is close to intra cost, a B frame will not pay off
+    int32_t qpOffset;  //complexity based qp offset, relative to the running average
+
+    LookaheadStats() : sceneCut(false), highMotion(false), qpOffset(0) {}
+};
+
+/*
+ * Analyses input surfaces on a worker thread before they reach doEncode().
+ * Luma is box-filtered to 1/4 size and split into 8x8 blocks; each block gets
+ * the best SAD of a small motion search in the previous frame (inter cost) and
+ * an absolute deviation from its own mean (intra cost). The frame totals drive
+ * scene cut, B run and qp decisions. Up to depth frames are held before pop()
+ * hands one back, so callers feeding VideoFrames need depth more of them in
+ * flight; an empty buffer or a null VideoFrame drains them at end of stream.
+ */
+class VaapiEncoderLookahead {
+public:
+    struct Frame {
+        SurfacePtr surface;
+        uint64_t timeStamp;
+        bool forceKeyFrame;
+        LookaheadStats stats;
+    };
+
+    VaapiEncoderLookahead(const DisplayPtr&, uint32_t width, uint32_t height,
+                          const VideoParamsLookahead&);
+    ~VaapiEncoderLookahead();
+
+    bool start();
+    void push(const SurfacePtr&, uint64_t timeStamp, bool forceKeyFrame);
+    //the oldest frame, false while no more than depth frames are queued unless drain is set
+    bool front(Frame&, bool drain = false);
+    //drops the frame front() returned, once the encoder took it
+    void pop();
+    //drops queued frames and analysis history
+    void flush();
+
+private:
+    struct Item {
+        Frame frame;
+        bool analysed;
+    };
+    typedef SharedPtr<Item> ItemPtr;
+
+    friend class VaapiEncoderLookaheadTest;
+
+    static void* analyseThread(void*);
+    void analyseLoop();
+    void analyse(Frame&);
+    //luma is the full size plane, the surface mapping stays out of the analysis
+    void analyse(const uint8_t* luma, uint32_t pitch, bool forceKeyFrame, LookaheadStats&);
+    uint32_t searchBlock(uint32_t x, uint32_t y) const;
+
+    DisplayPtr m_display;
+    VideoParamsLookahead m_params;
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_blocksX;
+    uint32_t m_blocksY;
+
+    /* owned by the worker thread */
+    std::vector<uint8_t> m_luma;
+    std::vector<uint8_t> m_prevLuma;
+    bool m_hasPrev;
+    uint64_t m_avgCost;
+    uint32_t m_sinceCut;
+
+    Lock m_lock;
+    Condition m_cond;
+    std::deque<ItemPtr> m_queue;
+    std::deque<ItemPtr> m_todo;
+    bool m_busy;
+    bool m_quit;
+    bool m_started;
+    pthread_t m_thread;
+
+    DISALLOW_COPY_AND_ASSIGN(VaapiEncoderLookahead);
+};
+}
+#endif /* vaapiencoder_lookahead_h */
@@ -0,0 +1,257 @@
+/*
+ * Copyright 2016 Intel Corporation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// library headers
+#include "common/unittest.h"
+
+// primary header
+#include "vaapiencoder_lookahead.h"
+
+// system headers
+#include <string.h>
+#include <vector>
+
+namespace YamiMediaCodec {
+
+//full size frames, 64x64 after the downscale, 8x8 blocks of 8x8
+const uint32_t WIDTH = 256;
+const uint32_t HEIGHT = 256;
+//one block row at full size
+const uint32_t BLOCK_ROW = 32;
+
+class VaapiEncoderLookaheadTest : public ::testing::Test {
+protected:
+    typedef std::vector<uint8_t> Luma;
+
+    static VideoParamsLookahead params(bool adaptiveQP)
+    {
+        VideoParamsLookahead p;
+        memset(&p, 0, sizeof(p));
+        p.size = sizeof(p);
+        p.depth = 4;
+        p.enableSceneCut = true;
+        p.enableAdaptiveB = true;
+        p.enableAdaptiveQP = adaptiveQP;
+        return p;
+    }
+
+    //noise, constant over each 4x4 so the downscale keeps all of it
+    static uint8_t texel(uint32_t x, uint32_t y, uint32_t seed)
+    {
+        uint32_t h = (x / 4) * 374761393u + (y / 4) * 668265263u + seed * 2246822519u;
+        h = (h ^ (h >> 13)) * 1274126177u;
+        return (h ^ (h >> 16)) & 0xff;
+    }
+
+    //rows from movingFrom down are shifted left by shift pixels, the rest are still
+    static void fill(Luma& luma, uint32_t seed, uint32_t movingFrom = HEIGHT, uint32_t shift = 0)
+    {
+        luma.resize(WIDTH * HEIGHT);
+        for (uint32_t y = 0; y < HEIGHT; y++) {
+            uint32_t dx = y < movingFrom ? 0 : shift;
+            for (uint32_t x = 0; x < WIDTH; x++)
+                luma[y * WIDTH + x] = texel(x + dx, y, seed);
+        }
+    }
+
+    static void flat(Luma& luma)
+    {
+        luma.assign(WIDTH * HEIGHT, 128);
+    }
+
+    static LookaheadStats analyse(VaapiEncoderLookahead& lookahead, const Luma& luma,
+        bool forceKeyFrame = false)
+    {
+        LookaheadStats stats;
+        lookahead.analyse(&luma[0], WIDTH, forceKeyFrame, stats);
+        return stats;
+    }
+
+    //what the worker thread does, without mapping any surface
+    static void push(VaapiEncoderLookahead& lookahead, uint64_t timeStamp)
+    {
+        lookahead.push(SurfacePtr(), timeStamp, false);
+        AutoLock l(lookahead.m_lock);
+        lookahead.m_todo.clear();
+        lookahead.m_queue.back()->analysed = true;
+    }
+};
+
+#define VAAPIENCODER_LOOKAHEAD_TEST(name) \
+    TEST_F(VaapiEncoderLookaheadTest, name)
+
+VAAPIENCODER_LOOKAHEAD_TEST(Static)
+{
+    VaapiEncoderLookahead lookahead(DisplayPtr(), WIDTH, HEIGHT, params(true));
+    Luma luma;
+    fill(luma, 1);
+    for (int i = 0; i < 8; i++) {
+        LookaheadStats stats = analyse(lookahead, luma);
+        EXPECT_FALSE(stats.sceneCut);
+        EXPECT_FALSE(stats.highMotion);
+        EXPECT_EQ(0, stats.qpOffset);
+    }
+}
+
+VAAPIENCODER_LOOKAHEAD_TEST(Panning)
+{
+    VaapiEncoderLookahead lookahead(DisplayPtr(), WIDTH, HEIGHT, params(true));
+    Luma luma;
+    for (uint32_t i = 0; i < 8; i++) {
+        //4 full size pixels a frame, inside the search range
+        fill(luma, 1, 0, i * 4);
+        LookaheadStats stats = analyse(lookahead, luma);
+        EXPECT_FALSE(stats.sceneCut);
+        EXPECT_FALSE(stats.highMotion);
+        EXPECT_EQ(0, stats.qpOffset);
+    }
+}
+
+VAAPIENCODER_LOOKAHEAD_TEST(HighMotion)
+{
+    VaapiEncoderLookahead lookahead(DisplayPtr(), WIDTH, HEIGHT, params(false));
+    Luma luma;
+    for (uint32_t i = 0; i < 8; i++) {
+        //the lower half jumps beyond the search range every frame
+        fill(luma, 1, HEIGHT / 2, i * 40);
+        LookaheadStats stats = analyse(lookahead, luma);
+        EXPECT_FALSE(stats.sceneCut);
+        EXPECT_EQ(i > 0, stats.highMotion);
+    }
+}
+
+VAAPIENCODER_LOOKAHEAD_TEST(HardCut)
+{
+    VaapiEncoderLookahead lookahead(DisplayPtr(), WIDTH, HEIGHT, params(false));
+    Luma luma;
+    fill(luma, 1);
+    for (int i = 0; i < 5; i++)
+        EXPECT_FALSE(analyse(lookahead, luma).sceneCut);
+
+    fill(luma, 2);
+    LookaheadStats stats = analyse(lookahead, luma);
+    EXPECT_TRUE(stats.sceneCut);
+    EXPECT_TRUE(stats.highMotion);
+
+    //too soon after the last cut, a flash back is not a new scene
+    fill(luma, 1);
+    stats = analyse(lookahead, luma);
+    EXPECT_FALSE(stats.sceneCut);
+    EXPECT_TRUE(stats.highMotion);
+}
+
+VAAPIENCODER_LOOKAHEAD_TEST(ForcedKeyFrameIsNoCut)
+{
+    VaapiEncoderLookahead lookahead(DisplayPtr(), WIDTH, HEIGHT, params(false));
+    Luma luma;
+    fill(luma, 1);
+    for (int i = 0; i < 5; i++)
+        analyse(lookahead, luma);
+
+    fill(luma, 2);
+    EXPECT_FALSE(analyse(lookahead, luma, true).sceneCut);
+}
+
+VAAPIENCODER_LOOKAHEAD_TEST(Flat)
+{
+    VaapiEncoderLookahead lookahead(DisplayPtr(), WIDTH, HEIGHT, params(true));
+    Luma luma;
+    fill(luma, 1);
+    for (int i = 0; i < 5; i++)
+        analyse(lookahead, luma);
+
+    //a fade to black is all change but nothing to judge by
+    flat(luma);
+    for (int i = 0; i < 3; i++) {
+        LookaheadStats stats = analyse(lookahead, luma);
+        EXPECT_FALSE(stats.sceneCut);
+        EXPECT_FALSE(stats.highMotion);
+        EXPECT_EQ(0, stats.qpOffset);
+    }
+}
+
+VAAPIENCODER_LOOKAHEAD_TEST(QpOffset)
+{
+    VaapiEncoderLookahead lookahead(DisplayPtr(), WIDTH, HEIGHT, params(true));
+    Luma luma;
+    uint32_t frame = 0;
+    fill(luma, 1);
+    analyse(lookahead, luma);
+
+    //one block row out of reach sets the average
+    for (int i = 0; i < 4; i++) {
+        fill(luma, 1, HEIGHT - BLOCK_ROW, ++frame * 40);
+        EXPECT_EQ(0, analyse(lookahead, luma).qpOffset);
+    }
+
+    //four times the cost is 4.8 qp up, capped
+    fill(luma, 1, HEIGHT - 4 * BLOCK_ROW, ++frame * 40);
+    LookaheadStats stats = analyse(lookahead, luma);
+    EXPECT_FALSE(stats.sceneCut);
+    EXPECT_EQ(3, stats.qpOffset);
+
+    //the average only moved an eighth of the way, a frame with just
+    //the bottom 8 rows changing goes down
+    Luma quiet;
+    fill(quiet, 1, HEIGHT - 8, ++frame * 40);
+    memcpy(&luma[(HEIGHT - 8) * WIDTH], &quiet[(HEIGHT - 8) * WIDTH], 8 * WIDTH);
+    EXPECT_GT(0, analyse(lookahead, luma).qpOffset);
+}
+
+VAAPIENCODER_LOOKAHEAD_TEST(Flush)
+{
+    VaapiEncoderLookahead lookahead(DisplayPtr(), WIDTH, HEIGHT, params(false));
+    Luma luma;
+    fill(luma, 1);
+    for (int i = 0; i < 5; i++)
+        analyse(lookahead, luma);
+    lookahead.flush();
+
+    //no history, the next frame is nothing to compare with
+    fill(luma, 2);
+    LookaheadStats stats = analyse(lookahead, luma);
+    EXPECT_FALSE(stats.sceneCut);
+    EXPECT_FALSE(stats.highMotion);
+}
+
+VAAPIENCODER_LOOKAHEAD_TEST(FrontKeepsFrameUntilPop)
+{
+    VideoParamsLookahead p = params(false);
+    p.depth = 1;
+    VaapiEncoderLookahead lookahead(DisplayPtr(), WIDTH, HEIGHT, p);
+    VaapiEncoderLookahead::Frame frame;
+    push(lookahead, 0);
+    EXPECT_FALSE(lookahead.front(frame));
+    push(lookahead, 1);
+
+    //a frame the encoder failed on comes back on the next call
+    ASSERT_TRUE(lookahead.front(frame));
+    EXPECT_EQ(0u, frame.timeStamp);
+    ASSERT_TRUE(lookahead.front(frame));
+    EXPECT_EQ(0u, frame.timeStamp);
+
+    lookahead.pop();
+    EXPECT_FALSE(lookahead.front(frame));
+    ASSERT_TRUE(lookahead.front(frame, true));
+    EXPECT_EQ(1u, frame.timeStamp);
+    lookahead.pop();
+    EXPECT_FALSE(lookahead.front(frame, true));
+}
+}
@@ -30,9 +30,61 @@
 
 namespace YamiMediaCodec{
 
-//golden, alter, last
-#define MAX_REFERECNE_FRAME 3
 #define VP8_DEFAULT_QP     40
+#define VP8_DEFAULT_GOLDEN_REFRESH_PERIOD 16
+#define VP8_MAX_LOOP_FILTER_LEVEL 63
+#define VP8_MAX_TEMPORAL_LAYERS 3
+
+//temporal layer of each frame in the pattern, the pattern has 1 << (layers - 1) frames.
+//layer 0 uses last, 1 golden, 2 altref
+static const uint8_t s_layerPattern[VP8_MAX_TEMPORAL_LAYERS][4] = {
+    { 0 },
+    { 0, 1 },
+    { 0, 2, 1, 2 }
+};
+//percent of bitRate() for each layer and those below it
+static const uint32_t s_layerShare[VP8_MAX_TEMPORAL_LAYERS][VP8_MAX_TEMPORAL_LAYERS] = {
+    { 100 },
+    { 60, 100 },
+    { 40, 60, 100 }
+};
+
+//bits per second of @layer and the layers below it, zeros take their share of @bitRate
+static uint32_t effectiveLayerBitRate(const VideoParamsVP8& vp8, uint32_t bitRate, uint32_t layer)
+{
+    if (vp8.layerBitRate[layer])
+        return vp8.layerBitRate[layer];
+    return (uint64_t)bitRate * s_layerShare[vp8.temporalLayers - 1][layer] / 100;
+}
+
+//every layer has to add bits to those below it, shares of a bitRate
+//not set yet are left for a later check
+static bool checkLayerBitRates(const VideoParamsVP8& vp8, uint32_t bitRate)
+{
+    uint32_t below = 0;
+    for (uint32_t i = 0; i < vp8.temporalLayers; i++) {
+        uint32_t rate = effectiveLayerBitRate(vp8, bitRate, i);
+        if (!rate)
+            continue;
+        if (rate <= below) {
+            ERROR("temporal layer %d gets %d bps, not more than the %d of the layers below",
+                i, rate, below);
+            return false;
+        }
+        below = rate;
+    }
+    return true;
+}
+
+static uint64_t gcd(uint64_t a, uint64_t b)
+{
+    while (b) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
 
 class VaapiEncPictureVP8 : public VaapiEncPicture
 {
@@ -40,6 +92,12 @@ public:
     VaapiEncPictureVP8(const ContextPtr& context, const SurfacePtr& surface,
                        int64_t timeStamp)
         : VaapiEncPicture(context, surface, timeStamp)
+        , m_refreshLast(false)
+        , m_refreshGolden(false)
+        , m_refreshAlt(false)
+        , m_copyGoldenToAlt(false)
+        , m_noRefGolden(false)
+        , m_noRefAlt(false)
     {
         return;
     }
@@ -48,16 +106,33 @@ public:
     {
         return m_codedBuffer->getID();
     }
+
+    bool m_refreshLast;
+    bool m_refreshGolden;
+    bool m_refreshAlt;
+    //done before the refresh, so altref gets the old golden
+    bool m_copyGoldenToAlt;
+    bool m_noRefGolden;
+    bool m_noRefAlt;
 };
 
 VaapiEncoderVP8::VaapiEncoderVP8():
 	m_frameCount(0),
-	m_qIndex(VP8_DEFAULT_QP)
+	m_qIndex(VP8_DEFAULT_QP),
+	m_layerRestart(0),
+	m_layerFresh(0)
 {
     m_videoParamCommon.profile = VAProfileVP8Version0_3;
     m_videoParamCommon.rcParams.minQP = 9;
     m_videoParamCommon.rcParams.maxQP = 127;
     m_videoParamCommon.rcParams.initQP = VP8_DEFAULT_QP;
+
+    memset(&m_videoParamVP8, 0, sizeof(m_videoParamVP8));
+    m_videoParamVP8.size = sizeof(m_videoParamVP8);
+    m_videoParamVP8.tokenPartitions = 1;
+    m_videoParamVP8.goldenRefreshPeriod = VP8_DEFAULT_GOLDEN_REFRESH_PERIOD;
+    m_videoParamVP8.loopFilterLevel = -1;
+    m_videoParamVP8.temporalLayers = 1;
 }
 
 VaapiEncoderVP8::~VaapiEncoderVP8()
@@ -85,6 +160,9 @@ void VaapiEncoderVP8::resetParams()
 YamiStatus VaapiEncoderVP8::start()
 {
     FUNC_ENTER();
+    //the common bitRate may have come after the vp8 parameters
+    if (!checkLayerBitRates(m_videoParamVP8, bitRate()))
+        return YAMI_INVALID_PARAM;
     resetParams();
     return VaapiEncoderBase::start();
 }
@@ -93,7 +171,9 @@ void VaapiEncoderVP8::flush()
 {
     FUNC_ENTER();
     m_frameCount = 0;
-    m_reference.clear();
+    m_last.reset();
+    m_golden.reset();
+    m_alt.reset();
     VaapiEncoderBase::flush();
 }
 
@@ -111,6 +191,26 @@ YamiStatus VaapiEncoderVP8::setParameters(VideoParamConfigType type, Yami_PTR vi
         return YAMI_INVALID_PARAM;
 
     switch (type) {
+    case VideoParamsTypeVP8: {
+        VideoParamsVP8* vp8 = (VideoParamsVP8*)videoEncParams;
+        if (vp8->size != sizeof(VideoParamsVP8))
+            return YAMI_INVALID_PARAM;
+        uint32_t partitions = vp8->tokenPartitions;
+        if (partitions != 1 && partitions != 2 && partitions != 4 && partitions != 8) {
+            ERROR("vp8 supports 1, 2, 4 or 8 token partitions, not %d", partitions);
+            return YAMI_INVALID_PARAM;
+        }
+        if (vp8->loopFilterLevel < -1 || vp8->loopFilterLevel > VP8_MAX_LOOP_FILTER_LEVEL)
+            return YAMI_INVALID_PARAM;
+        if (!vp8->temporalLayers || vp8->temporalLayers > VP8_MAX_TEMPORAL_LAYERS) {
+            ERROR("vp8 supports 1 to %d temporal layers, not %d", VP8_MAX_TEMPORAL_LAYERS, vp8->temporalLayers);
+            return YAMI_INVALID_PARAM;
+        }
+        if (!checkLayerBitRates(*vp8, bitRate()))
+            return YAMI_INVALID_PARAM;
+        PARAMETER_ASSIGN(m_videoParamVP8, *vp8);
+        break;
+    }
     default:
         status = VaapiEncoderBase::setParameters(type, videoEncParams);
         break;
@@ -124,6 +224,13 @@ YamiStatus VaapiEncoderVP8::getParameters(VideoParamConfigType type, Yami_PTR vi
     if (!videoEncParams)
         return YAMI_INVALID_PARAM;
 
+    if (type == VideoParamsTypeVP8) {
+        VideoParamsVP8* vp8 = (VideoParamsVP8*)videoEncParams;
+        if (vp8->size != sizeof(VideoParamsVP8))
+            return YAMI_INVALID_PARAM;
+        PARAMETER_ASSIGN(*vp8, m_videoParamVP8);
+        return YAMI_SUCCESS;
+    }
     // TODO, update video resolution basing on hw requirement
     return VaapiEncoderBase::getParameters(type, videoEncParams);
 }
@@ -138,6 +245,7 @@ YamiStatus VaapiEncoderVP8::doEncode(const SurfacePtr& surface, uint64_t timeSta
 
     m_frameCount %= keyFramePeriod();
     picture->m_type = (m_frameCount ? VAAPI_PICTURE_P : VAAPI_PICTURE_I);
+    planReferences(picture);
     m_frameCount++;
 
     m_qIndex = (initQP() > minQP() && initQP() < maxQP()) ? initQP() : VP8_DEFAULT_QP;
@@ -176,31 +284,38 @@ bool VaapiEncoderVP8::fill(VAEncPictureParameterBufferVP8* picParam, const Pictu
     picParam->reconstructed_frame = surface->getID();
     if (picture->m_type == VAAPI_PICTURE_P) {
         picParam->pic_flags.bits.frame_type = 1;
-        ReferenceQueue::const_iterator it = m_reference.begin();
-        picParam->ref_arf_frame = (*it++)->getID();
-        picParam->ref_gf_frame = (*it++)->getID();
-        picParam->ref_last_frame = (*it)->getID();
-        picParam->pic_flags.bits.refresh_last = 1;
-        picParam->pic_flags.bits.refresh_golden_frame = 0;
-        picParam->pic_flags.bits.copy_buffer_to_golden = 1;
-        picParam->pic_flags.bits.refresh_alternate_frame = 0;
-        picParam->pic_flags.bits.copy_buffer_to_alternate = 2;
+        picParam->ref_arf_frame = m_alt->getID();
+        picParam->ref_gf_frame = m_golden->getID();
+        picParam->ref_last_frame = m_last->getID();
+        //also do not search the same surface twice
+        picParam->ref_flags.bits.no_ref_gf = picture->m_noRefGolden || m_golden == m_last;
+        picParam->ref_flags.bits.no_ref_arf = picture->m_noRefAlt || m_alt == m_golden || m_alt == m_last;
+        picParam->pic_flags.bits.refresh_last = picture->m_refreshLast;
+        picParam->pic_flags.bits.refresh_golden_frame = picture->m_refreshGolden;
+        picParam->pic_flags.bits.copy_buffer_to_golden = 0;
+        picParam->pic_flags.bits.refresh_alternate_frame = picture->m_refreshAlt;
+        picParam->pic_flags.bits.copy_buffer_to_alternate = picture->m_copyGoldenToAlt ? 2 : 0;
     } else {
         picParam->ref_last_frame = VA_INVALID_SURFACE;
         picParam->ref_gf_frame = VA_INVALID_SURFACE;
         picParam->ref_arf_frame = VA_INVALID_SURFACE;
     }
 
+    picParam->ref_flags.bits.temporal_id = picture->m_temporalId;
     picParam->coded_buf = picture->getCodedBufferID();
 
     picParam->pic_flags.bits.show_frame = 1;
-    /*TODO: multi partition*/
-    picParam->pic_flags.bits.num_token_partitions = 0;
+    //log2 of the partition count
+    uint32_t partitions = 0;
+    while ((1u << partitions) < m_videoParamVP8.tokenPartitions)
+        partitions++;
+    picParam->pic_flags.bits.num_token_partitions = partitions;
     //REMOVE THIS
     picParam->pic_flags.bits.refresh_entropy_probs = 0;
     /*pic_flags end */
+    uint8_t level = loopFilterLevel();
     for (int i = 0; i < 4; i++) {
-        picParam->loop_filter_level[i] = 19;
+        picParam->loop_filter_level[i] = level;
     }
 
     picParam->clamp_qindex_low = minQP();
@@ -208,6 +323,49 @@ bool VaapiEncoderVP8::fill(VAEncPictureParameterBufferVP8* picParam, const Pictu
     return TRUE;
 }
 
+//close to what libvpx picks for real time, about 17 at the default q index
+uint8_t VaapiEncoderVP8::loopFilterLevel() const
+{
+    if (m_videoParamVP8.loopFilterLevel >= 0)
+        return m_videoParamVP8.loopFilterLevel;
+    if (m_qIndex < 8)
+        return 0;
+    return std::min(m_qIndex * 3 / 8 + 2, VP8_MAX_LOOP_FILTER_LEVEL);
+}
+
+uint32_t VaapiEncoderVP8::layerBitRate(uint32_t layer) const
+{
+    return effectiveLayerBitRate(m_videoParamVP8, bitRate(), layer);
+}
+
+//layer @layer and below have 1 << layer frames of each pattern. the driver takes
+//the denominator in the high and the numerator in the low 16 bits
+uint32_t VaapiEncoderVP8::layerFrameRate(uint32_t layer) const
+{
+    uint64_t num = (uint64_t)frameRateNum() << layer;
+    uint64_t denom = (uint64_t)frameRateDenom() << (m_videoParamVP8.temporalLayers - 1);
+    uint64_t divisor = gcd(num, denom);
+    if (divisor) {
+        num /= divisor;
+        denom /= divisor;
+    }
+    //still too wide, give the larger half all 16 bits and round the other
+    if (num > 0xffff || denom > 0xffff) {
+        if (num >= denom) {
+            uint64_t d = std::max<uint64_t>(1, 0xffff * denom / num);
+            num = std::min<uint64_t>(0xffff, (num * d + denom / 2) / denom);
+            denom = d;
+        } else {
+            uint64_t n = std::max<uint64_t>(1, 0xffff * num / denom);
+            denom = std::min<uint64_t>(0xffff, (denom * n + num / 2) / num);
+            num = n;
+        }
+    }
+    if (!num || !denom)
+        num = denom = 1;
+    return (uint32_t)(denom << 16 | num);
+}
+
 bool VaapiEncoderVP8::fill(VAQMatrixBufferVP8* qMatrix) const
 {
     size_t i;
@@ -260,20 +418,141 @@ bool VaapiEncoderVP8::ensureQMatrix (const PicturePtr& picture)
     return true;
 }
 
+//picks the temporal layer, references and refreshes of @picture.
+//without layers last is always refreshed and golden every goldenRefreshPeriod frames.
+//with layers each layer refreshes only its own buffer and references those of the
+//layers below, so dropping the upper layers leaves a decodable stream
+void VaapiEncoderVP8::planReferences(bool keyFrame, ReferencePlan& plan)
+{
+    memset(&plan, 0, sizeof(plan));
+    uint32_t layers = m_videoParamVP8.temporalLayers;
+    uint32_t upperLayers = ((1 << layers) - 1) & ~1;
+    uint32_t goldenPeriod = m_videoParamVP8.goldenRefreshPeriod;
+    bool restart = m_frameCount && goldenPeriod && !(m_frameCount % goldenPeriod);
+
+    if (keyFrame) {
+        m_layerRestart = 0;
+        m_layerFresh = upperLayers;
+        return;
+    }
+    if (layers == 1) {
+        plan.refreshLast = true;
+        plan.refreshGolden = restart;
+        plan.copyGoldenToAlt = restart;
+        return;
+    }
+
+    if (restart)
+        m_layerRestart = upperLayers;
+    uint32_t id = s_layerPattern[layers - 1][m_frameCount % (1 << (layers - 1))];
+    plan.temporalId = id;
+    plan.noRefGolden = id < 1;
+    plan.noRefAlt = id < 2;
+    if (!id) {
+        plan.refreshLast = true;
+        return;
+    }
+
+    uint32_t bit = 1 << id;
+    if (m_layerRestart & bit) {
+        if (id == 1)
+            plan.noRefGolden = true;
+        else
+            plan.noRefAlt = true;
+        plan.layerSync = true;
+    }
+    if (m_layerFresh & bit)
+        plan.layerSync = true;
+    m_layerRestart &= ~bit;
+    m_layerFresh &= ~bit;
+    if (id == 1)
+        plan.refreshGolden = true;
+    else
+        plan.refreshAlt = true;
+}
+
+void VaapiEncoderVP8::planReferences(const PicturePtr& picture)
+{
+    ReferencePlan plan;
+    planReferences(picture->m_type == VAAPI_PICTURE_I, plan);
+    picture->m_temporalId = plan.temporalId;
+    picture->m_layerSync = plan.layerSync;
+    picture->m_refreshLast = plan.refreshLast;
+    picture->m_refreshGolden = plan.refreshGolden;
+    picture->m_refreshAlt = plan.refreshAlt;
+    picture->m_copyGoldenToAlt = plan.copyGoldenToAlt;
+    picture->m_noRefGolden = plan.noRefGolden;
+    picture->m_noRefAlt = plan.noRefAlt;
+}
+
 bool VaapiEncoderVP8::referenceListUpdate (const PicturePtr& pic, const SurfacePtr& recon)
 {
 
     if (pic->m_type == VAAPI_PICTURE_I) {
-        m_reference.clear();
-        m_reference.insert(m_reference.end(), MAX_REFERECNE_FRAME, recon);
+        m_last = m_golden = m_alt = recon;
     } else {
-        m_reference.pop_front();
-        m_reference.push_back(recon);
+        if (pic->m_copyGoldenToAlt)
+            m_alt = m_golden;
+        if (pic->m_refreshGolden)
+            m_golden = recon;
+        if (pic->m_refreshAlt)
+            m_alt = recon;
+        if (pic->m_refreshLast)
+            m_last = recon;
     }
 
     return true;
 }
 
+//per layer rate control, the driver gets one rate control and frame rate
+//buffer for each layer, each covering the layers below it
+bool VaapiEncoderVP8::ensureLayerMiscParams(const PicturePtr& picture)
+{
+#if VA_CHECK_VERSION(0, 39, 0)
+    VAEncMiscParameterHRD* hrd = NULL;
+    if (!picture->newMisc(VAEncMiscParameterTypeHRD, hrd))
+        return false;
+    if (hrd)
+        fill(hrd);
+    VideoRateControl mode = rateControlMode();
+    if (mode != RATE_CONTROL_CBR && mode != RATE_CONTROL_VBR)
+        return true;
+
+    uint32_t layers = m_videoParamVP8.temporalLayers;
+    uint32_t period = 1 << (layers - 1);
+    VAEncMiscParameterTemporalLayerStructure* structure = NULL;
+    if (!picture->newMisc(VAEncMiscParameterTypeTemporalLayerStructure, structure))
+        return false;
+    if (structure) {
+        structure->number_of_layers = layers;
+        structure->periodicity = period;
+        for (uint32_t i = 0; i < period; i++)
+            structure->layer_id[i] = s_layerPattern[layers - 1][i];
+    }
+    for (uint32_t i = 0; i < layers; i++) {
+        VAEncMiscParameterRateControl* rateControl = NULL;
+        if (!picture->newMisc(VAEncMiscParameterTypeRateControl, rateControl))
+            return false;
+        if (rateControl) {
+            fill(rateControl);
+            rateControl->bits_per_second = layerBitRate(i);
+            rateControl->rc_flags.bits.temporal_id = i;
+        }
+        VAEncMiscParameterFrameRate* frameRate = NULL;
+        if (!picture->newMisc(VAEncMiscParameterTypeFrameRate, frameRate))
+            return false;
+        if (frameRate) {
+            frameRate->framerate = layerFrameRate(i);
+            frameRate->framerate_flags.bits.temporal_id = i;
+        }
+    }
+    return true;
+#else
+    //no per layer rate control in this libva, the layers share one budget
+    return ensureMiscParams(picture.get());
+#endif
+}
+
 YamiStatus VaapiEncoderVP8::encodePicture(const PicturePtr& picture)
 {
     YamiStatus ret = YAMI_FAIL;
@@ -284,7 +563,10 @@ YamiStatus VaapiEncoderVP8::encodePicture(const PicturePtr& picture)
     if (!ensureSequence (picture))
         return ret;
 
-    if (!ensureMiscParams (picture.get()))
+    if (m_videoParamVP8.temporalLayers > 1) {
+        if (!ensureLayerMiscParams(picture))
+            return ret;
+    } else if (!ensureMiscParams (picture.get()))
         return ret;
 
     if (!ensurePicture(picture, reconstruct))
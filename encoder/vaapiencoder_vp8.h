@@ -20,7 +20,6 @@
 #include "vaapiencoder_base.h"
 #include "vaapi/vaapiptrs.h"
 #include <va/va_enc_vp8.h>
-#include <deque>
 
 
 namespace YamiMediaCodec{
@@ -57,7 +56,25 @@ private:
     bool ensureSequence(const PicturePtr&);
     bool ensurePicture (const PicturePtr&, const SurfacePtr&);
     bool ensureQMatrix (const PicturePtr&);
+    bool ensureLayerMiscParams(const PicturePtr&);
     bool referenceListUpdate (const PicturePtr&, const SurfacePtr&);
+    //temporal layer, references and refreshes of one frame
+    struct ReferencePlan {
+        uint32_t temporalId;
+        bool layerSync;
+        bool refreshLast;
+        bool refreshGolden;
+        bool refreshAlt;
+        //done before the refresh, so altref gets the old golden
+        bool copyGoldenToAlt;
+        bool noRefGolden;
+        bool noRefAlt;
+    };
+    void planReferences(bool keyFrame, ReferencePlan&);
+    void planReferences(const PicturePtr&);
+    uint8_t loopFilterLevel() const;
+    uint32_t layerBitRate(uint32_t layer) const;
+    uint32_t layerFrameRate(uint32_t layer) const;
 
     void resetParams();
 
@@ -69,8 +86,15 @@ private:
 
     int m_qIndex;
 
-    typedef std::deque<SurfacePtr> ReferenceQueue;
-    std::deque<SurfacePtr> m_reference;
+    VideoParamsVP8 m_videoParamVP8;
+
+    SurfacePtr m_last;
+    SurfacePtr m_golden;
+    SurfacePtr m_alt;
+    //bit n set: the next frame of temporal layer n may not use its own buffer
+    uint32_t m_layerRestart;
+    //bit n set: the buffer of temporal layer n still holds a key frame
+    uint32_t m_layerFresh;
 
     static const bool s_registered; // VaapiEncoderFactory registration result
 };
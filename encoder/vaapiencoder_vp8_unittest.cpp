@@ -49,6 +49,58 @@ protected:
     virtual void TearDown() {
         return;
     }
+
+    uint8_t loopFilterLevel(const VaapiEncoderVP8& encoder) const
+    {
+        return encoder.loopFilterLevel();
+    }
+
+    void setQIndex(VaapiEncoderVP8& encoder, int qIndex) const
+    {
+        encoder.m_qIndex = qIndex;
+    }
+
+    uint32_t layerBitRate(const VaapiEncoderVP8& encoder, uint32_t layer) const
+    {
+        return encoder.layerBitRate(layer);
+    }
+
+    uint32_t layerFrameRate(const VaapiEncoderVP8& encoder, uint32_t layer) const
+    {
+        return encoder.layerFrameRate(layer);
+    }
+
+    typedef VaapiEncoderVP8::ReferencePlan ReferencePlan;
+
+    //what doEncode plans for the next frame
+    void planNext(VaapiEncoderVP8& encoder, ReferencePlan& plan) const
+    {
+        encoder.m_frameCount %= encoder.keyFramePeriod();
+        encoder.planReferences(!encoder.m_frameCount, plan);
+        encoder.m_frameCount++;
+    }
+
+    void setCommon(VaapiEncoderVP8& encoder, uint32_t bitRate, uint32_t num, uint32_t denom) const
+    {
+        VideoParamsCommon common;
+        common.size = sizeof(common);
+        ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeCommon, &common));
+        common.intraPeriod = 30;
+        common.rcParams.bitRate = bitRate;
+        common.frameRate.frameRateNum = num;
+        common.frameRate.frameRateDenom = denom;
+        ASSERT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeCommon, &common));
+    }
+
+    void setLayers(VaapiEncoderVP8& encoder, uint32_t layers, uint32_t goldenRefreshPeriod) const
+    {
+        VideoParamsVP8 vp8;
+        vp8.size = sizeof(vp8);
+        ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeVP8, &vp8));
+        vp8.temporalLayers = layers;
+        vp8.goldenRefreshPeriod = goldenRefreshPeriod;
+        ASSERT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeVP8, &vp8));
+    }
 };
 
 #define VAAPIENCODER_VP8_TEST(name) \
@@ -60,4 +112,194 @@ VAAPIENCODER_VP8_TEST(Factory) {
     doFactoryTest(mimeTypes);
 }
 
+VAAPIENCODER_VP8_TEST(Params)
+{
+    VaapiEncoderVP8 encoder;
+    VideoParamsVP8 vp8;
+    vp8.size = sizeof(vp8);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeVP8, &vp8));
+    EXPECT_EQ(1u, vp8.tokenPartitions);
+    EXPECT_EQ(-1, vp8.loopFilterLevel);
+
+    vp8.tokenPartitions = 3;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeVP8, &vp8));
+    vp8.tokenPartitions = 8;
+    vp8.loopFilterLevel = 64;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeVP8, &vp8));
+    vp8.loopFilterLevel = 20;
+    vp8.goldenRefreshPeriod = 0;
+    EXPECT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeVP8, &vp8));
+
+    VideoParamsVP8 out;
+    out.size = sizeof(out);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeVP8, &out));
+    EXPECT_EQ(8u, out.tokenPartitions);
+    EXPECT_EQ(0u, out.goldenRefreshPeriod);
+    EXPECT_EQ(20, out.loopFilterLevel);
+    EXPECT_EQ(20, loopFilterLevel(encoder));
+}
+
+VAAPIENCODER_VP8_TEST(LoopFilterFromQuantizer)
+{
+    VaapiEncoderVP8 encoder;
+    setQIndex(encoder, 4);
+    EXPECT_EQ(0, loopFilterLevel(encoder));
+    setQIndex(encoder, 40);
+    EXPECT_EQ(17, loopFilterLevel(encoder));
+    setQIndex(encoder, 127);
+    EXPECT_EQ(49, loopFilterLevel(encoder));
+}
+
+VAAPIENCODER_VP8_TEST(TemporalLayers)
+{
+    VaapiEncoderVP8 encoder;
+    VideoParamsVP8 vp8;
+    vp8.size = sizeof(vp8);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeVP8, &vp8));
+    EXPECT_EQ(1u, vp8.temporalLayers);
+
+    vp8.temporalLayers = 4;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeVP8, &vp8));
+    vp8.temporalLayers = 3;
+    vp8.layerBitRate[0] = 300000;
+    vp8.layerBitRate[1] = 200000;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeVP8, &vp8));
+    vp8.layerBitRate[1] = 0;
+    EXPECT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeVP8, &vp8));
+
+    VideoParamsCommon common;
+    common.size = sizeof(common);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeCommon, &common));
+    common.rcParams.bitRate = 1000000;
+    ASSERT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeCommon, &common));
+    EXPECT_EQ(300000u, layerBitRate(encoder, 0));
+    EXPECT_EQ(600000u, layerBitRate(encoder, 1));
+    EXPECT_EQ(1000000u, layerBitRate(encoder, 2));
+}
+
+VAAPIENCODER_VP8_TEST(MixedLayerBitRates)
+{
+    VaapiEncoderVP8 encoder;
+    setCommon(encoder, 1000000, 30, 1);
+    VideoParamsVP8 vp8;
+    vp8.size = sizeof(vp8);
+    ASSERT_EQ(YAMI_SUCCESS, encoder.getParameters(VideoParamsTypeVP8, &vp8));
+    vp8.temporalLayers = 2;
+    //the derived 60 percent of layer 1 is below the explicit layer 0
+    vp8.layerBitRate[0] = 700000;
+    vp8.layerBitRate[1] = 0;
+    EXPECT_EQ(YAMI_INVALID_PARAM, encoder.setParameters(VideoParamsTypeVP8, &vp8));
+    vp8.layerBitRate[0] = 500000;
+    EXPECT_EQ(YAMI_SUCCESS, encoder.setParameters(VideoParamsTypeVP8, &vp8));
+
+    //a bitRate coming after the layers is checked by start()
+    VaapiEncoderVP8 late;
+    setCommon(late, 0, 30, 1);
+    vp8.layerBitRate[0] = 700000;
+    ASSERT_EQ(YAMI_SUCCESS, late.setParameters(VideoParamsTypeVP8, &vp8));
+    setCommon(late, 1000000, 30, 1);
+    EXPECT_EQ(YAMI_INVALID_PARAM, late.start());
+}
+
+VAAPIENCODER_VP8_TEST(LayerFrameRate)
+{
+    VaapiEncoderVP8 encoder;
+    setLayers(encoder, 3, 8);
+
+    setCommon(encoder, 0, 30000, 1001);
+    EXPECT_EQ(1001u << 16 | 7500, layerFrameRate(encoder, 0));
+    EXPECT_EQ(1001u << 16 | 15000, layerFrameRate(encoder, 1));
+    EXPECT_EQ(1001u << 16 | 30000, layerFrameRate(encoder, 2));
+
+    //240000/4004 does not fit in 16 bits before it is reduced
+    setCommon(encoder, 0, 60000, 1001);
+    EXPECT_EQ(1001u << 16 | 60000, layerFrameRate(encoder, 2));
+
+    //nothing to reduce, both halves get clamped but keep the ratio
+    setCommon(encoder, 0, 100003, 3);
+    uint32_t rate = layerFrameRate(encoder, 2);
+    uint32_t num = rate & 0xffff;
+    uint32_t denom = rate >> 16;
+    ASSERT_NE(0u, denom);
+    EXPECT_NEAR(100003.0 / 3, (double)num / denom, 100003.0 / 3 / 1000);
+}
+
+VAAPIENCODER_VP8_TEST(PlanReferencesOneLayer)
+{
+    VaapiEncoderVP8 encoder;
+    setCommon(encoder, 0, 30, 1);
+    setLayers(encoder, 1, 4);
+
+    ReferencePlan plan;
+    planNext(encoder, plan);
+    EXPECT_FALSE(plan.refreshLast);
+    for (int i = 1; i < 4; i++) {
+        planNext(encoder, plan);
+        EXPECT_TRUE(plan.refreshLast);
+        EXPECT_FALSE(plan.refreshGolden);
+        EXPECT_FALSE(plan.copyGoldenToAlt);
+    }
+    planNext(encoder, plan);
+    EXPECT_TRUE(plan.refreshLast);
+    EXPECT_TRUE(plan.refreshGolden);
+    EXPECT_TRUE(plan.copyGoldenToAlt);
+    EXPECT_EQ(0u, plan.temporalId);
+}
+
+VAAPIENCODER_VP8_TEST(PlanReferencesThreeLayers)
+{
+    VaapiEncoderVP8 encoder;
+    setCommon(encoder, 0, 30, 1);
+    setLayers(encoder, 3, 8);
+
+    ReferencePlan plan;
+    //key frame, every buffer holds it
+    planNext(encoder, plan);
+
+    //the first frame of each upper layer starts it from the key frame
+    planNext(encoder, plan);
+    EXPECT_EQ(2u, plan.temporalId);
+    EXPECT_TRUE(plan.refreshAlt);
+    EXPECT_TRUE(plan.layerSync);
+    EXPECT_FALSE(plan.noRefAlt);
+
+    planNext(encoder, plan);
+    EXPECT_EQ(1u, plan.temporalId);
+    EXPECT_TRUE(plan.refreshGolden);
+    EXPECT_TRUE(plan.layerSync);
+    EXPECT_FALSE(plan.noRefGolden);
+    EXPECT_TRUE(plan.noRefAlt);
+
+    planNext(encoder, plan);
+    EXPECT_EQ(2u, plan.temporalId);
+    EXPECT_FALSE(plan.layerSync);
+
+    //the base layer only ever sees last
+    planNext(encoder, plan);
+    EXPECT_EQ(0u, plan.temporalId);
+    EXPECT_TRUE(plan.refreshLast);
+    EXPECT_TRUE(plan.noRefGolden);
+    EXPECT_TRUE(plan.noRefAlt);
+
+    for (int i = 5; i < 8; i++)
+        planNext(encoder, plan);
+
+    //golden refresh period, the upper layers restart from the base layer
+    planNext(encoder, plan);
+    EXPECT_EQ(0u, plan.temporalId);
+    planNext(encoder, plan);
+    EXPECT_EQ(2u, plan.temporalId);
+    EXPECT_TRUE(plan.layerSync);
+    EXPECT_TRUE(plan.noRefAlt);
+    planNext(encoder, plan);
+    EXPECT_EQ(1u, plan.temporalId);
+    EXPECT_TRUE(plan.layerSync);
+    EXPECT_TRUE(plan.noRefGolden);
+    EXPECT_TRUE(plan.noRefAlt);
+    planNext(encoder, plan);
+    EXPECT_EQ(2u, plan.temporalId);
+    EXPECT_FALSE(plan.layerSync);
+    EXPECT_FALSE(plan.noRefAlt);
+}
+
 }
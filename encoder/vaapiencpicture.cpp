@@ -31,6 +31,8 @@ VaapiEncPicture::VaapiEncPicture(const ContextPtr& context,
                                  const SurfacePtr & surface,
                                  int64_t timeStamp)
 :VaapiPicture(context, surface, timeStamp)
+, m_temporalId(0)
+, m_layerSync(false)
 {
 }
 
@@ -86,8 +88,11 @@ YamiStatus VaapiEncPicture::getOutput(VideoEncOutputBuffer* outBuffer)
     if (size > 0) {
         m_codedBuffer->copyInto(outBuffer->data);
         outBuffer->flag |= m_codedBuffer->getFlags();
+        if (m_layerSync)
+            outBuffer->flag |= ENCODE_BUFFERFLAG_LAYERSYNC;
     }
     outBuffer->dataSize = size;
+    outBuffer->temporalId = m_temporalId;
     return YAMI_SUCCESS;
 }
 
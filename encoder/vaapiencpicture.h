@@ -27,7 +27,8 @@ class VaapiEncPicture:public VaapiPicture {
   public:
     VaapiEncPicture(const ContextPtr& context,
                     const SurfacePtr & surface, int64_t timeStamp);
-    virtual ~VaapiEncPicture() { }
+    //the render job may still read our buffers
+    virtual ~VaapiEncPicture() { wait(); }
 
     template < class T >
     bool editSequence(T * &seqParam);
@@ -63,6 +64,9 @@ class VaapiEncPicture:public VaapiPicture {
 #endif
 
     CodedBufferPtr m_codedBuffer;
+    //copied to VideoEncOutputBuffer
+    uint32_t m_temporalId;
+    bool m_layerSync;
 
   private:
     bool doRender();
@@ -246,6 +246,17 @@ typedef struct VideoFrame {
 #endif
 } VideoFrame;
 
+/**
+ * numbers of one decoder or encoder on the display scheduler,
+ * the scheduler runs when LIBYAMI_SCHEDULER_WORKERS is set to the worker count
+ */
+typedef struct VideoScheduleStats {
+    uint64_t    jobs;
+    /* time from submit until a worker took the job, in microseconds */
+    uint64_t    totalQueueUs;
+    uint64_t    maxQueueUs;
+} VideoScheduleStats;
+
 #define YAMI_MIME_MPEG2 "video/mpeg2"
 #define YAMI_MIME_H264 "video/h264"
 #define YAMI_MIME_AVC  "video/avc"
@@ -88,6 +88,16 @@ typedef struct {
     uint32_t flag;
 }VideoDecodeBuffer;
 
+// which pictures the decoder spends surfaces and hardware on, see IVideoDecoder::setDecodePolicy
+typedef enum {
+    // decode every picture
+    DECODE_POLICY_ALL,
+    // drop pictures no later picture predicts from
+    DECODE_POLICY_SKIP_NON_REFERENCE,
+    // decode key frames only: IDR/IRAP, I pictures, VP8/VP9 key frames
+    DECODE_POLICY_KEY_FRAMES_ONLY
+} VideoDecodePolicy;
+
 typedef struct {
     uint8_t *data;
     int32_t size;
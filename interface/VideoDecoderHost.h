@@ -37,6 +37,19 @@ void releaseVideoDecoder(YamiMediaCodec::IVideoDecoder * p);
 */
 std::vector<std::string> getVideoDecoderMimeTypes();
 
+/** \fn void setVideoResourceCacheTtl(uint32_t ttlMs)
+ * \brief keep VA configs and surfaces of stopped decoders and encoders for @ttlMs,
+ * a stream of the same profile and size started within that time skips their creation.
+ * 0 (the default) disables the cache and releases what it holds.
+*/
+void setVideoResourceCacheTtl(uint32_t ttlMs);
+/** \fn YamiStatus prewarmVideoDecoder(const NativeDisplay* display, const VideoConfigBuffer* config)
+ * \brief create the config and surfaces a decoder started with @config on @display will ask for
+ * and put them in the resource cache. uses profile, surfaceWidth, surfaceHeight and surfaceNumber.
+ * return YAMI_UNSUPPORTED if the cache is disabled.
+*/
+YamiStatus prewarmVideoDecoder(const NativeDisplay* display, const VideoConfigBuffer* config);
+
 typedef YamiMediaCodec::IVideoDecoder *(*YamiCreateVideoDecoderFuncPtr) (const char *mimeType);
 typedef void (*YamiReleaseVideoDecoderFuncPtr)(YamiMediaCodec::IVideoDecoder * p);
 }
@@ -51,6 +51,36 @@ public:
     ///get decoded frame from decoder.
     virtual SharedPtr<VideoFrame> getOutput() = 0;
 
+    /** \brief choose which pictures get decoded, to keep up under overload.
+    * it takes effect from the next picture and can be changed at any time, also from
+    * another thread. dropped pictures take no surface and no hardware and give no output.
+    * once a reference picture was dropped, everything up to the next key frame is dropped,
+    * so going back to #DECODE_POLICY_ALL needs no flush.
+    */
+    virtual YamiStatus setDecodePolicy(VideoDecodePolicy policy) = 0;
+
+    /** \brief time stamp of the first frame queued for output since start or flush.
+    * a stream may be entered at a recovery point or CRA, pictures which can not be
+    * reconstructed are dropped and this tells where display really starts.
+    * return YAMI_MORE_DATA until such a frame is decoded.
+    */
+    virtual YamiStatus getFirstDisplayTimeStamp(int64_t* timeStamp) = 0;
+
+    /** \brief an eventfd for event loops, readable when getOutput() has a frame or
+    * a surface was freed after decode() ran out of them. read it to clear it, then
+    * call getOutput() until it returns nothing. it stays the same over start/stop.
+    * return -1 if eventfd is not supported.
+    */
+    virtual int getEventFd() = 0;
+
+    /** \brief share of the display scheduler, a decoder with priority n gets up to n
+    * submissions per round robin round. default is 1, 0 is invalid.
+    * it only matters when LIBYAMI_SCHEDULER_WORKERS is set, see #VideoScheduleStats.
+    */
+    virtual YamiStatus setSchedulePriority(uint32_t priority) = 0;
+    /// queueing delay on the display scheduler, YAMI_UNSUPPORTED when it is not running
+    virtual YamiStatus getScheduleStats(VideoScheduleStats* stats) = 0;
+
     /** \brief retrieve updated stream information after decoder has parsed the video stream.
     * client usually calls it when libyami return YAMI_DECODE_FORMAT_CHANGE in decode().
     */
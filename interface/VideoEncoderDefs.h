@@ -87,6 +87,9 @@ typedef enum {
 #define ENCODE_BUFFERFLAG_DATACORRUPT      0x00000010
 #define ENCODE_BUFFERFLAG_DATAINVALID      0x00000020
 #define ENCODE_BUFFERFLAG_SLICEOVERFOLOW   0x00000040
+//first frame of its temporal layer which references only lower layers,
+//a receiver can start taking this layer here
+#define ENCODE_BUFFERFLAG_LAYERSYNC        0x00000080
 
 typedef struct VideoEncOutputBuffer {
     uint8_t *data;
@@ -96,9 +99,10 @@ typedef struct VideoEncOutputBuffer {
     uint32_t flag;                   //Key frame, Codec Data etc
     VideoOutputFormat format;   //output format
     uint64_t timeStamp;         //reserved
+    uint32_t temporalId;        //temporal layer of the frame, 0 is the base layer
 #ifndef __ENABLE_CAPI__
      VideoEncOutputBuffer():data(0), bufferSize(0), dataSize(0)
-    , remainingSize(0), flag(0), format(OUTPUT_BUFFER_LAST), timeStamp(0) {
+    , remainingSize(0), flag(0), format(OUTPUT_BUFFER_LAST), timeStamp(0), temporalId(0) {
     };
 #endif
 }VideoEncOutputBuffer;
@@ -234,6 +238,11 @@ typedef enum {
     //format related
     VideoConfigTypeAVCStreamFormat,
 
+    VideoParamsTypeLookahead,
+    VideoParamsTypeVP8,
+    VideoParamsTypeHEVC,
+    VideoParamsTypeJPEG,
+
     VideoParamsConfigExtension
 }VideoParamConfigType;
 
@@ -268,8 +277,59 @@ typedef struct VideoParamsAVC {
     bool  enableDeblockFilter;
     int8_t deblockAlphaOffsetDiv2; //same as slice_alpha_c0_offset_div2 defined in h264 spec 7.4.3
     int8_t deblockBetaOffsetDiv2; //same as slice_beta_offset_div2 defined in h264 spec 7.4.3
+    uint32_t intraRefreshPeriod; //frames per gradual intra refresh cycle, replaces periodic I/IDR frames; 0 disables it
+    uint32_t temporalLayers; //up to 4, frames get dyadic temporal ids and only layer 0 is referenced; 0 or 1 disables it
 }VideoParamsAVC;
 
+typedef struct VideoParamsLookahead {
+    uint32_t size;
+    uint32_t depth;         //frames analysed ahead of encoding, 0 disables the lookahead
+    bool enableSceneCut;    //start a new IDR at detected scene changes
+    bool enableAdaptiveB;   //end a B run early when motion is too high for B frames
+    bool enableAdaptiveQP;  //offset the CQP slice qp by frame complexity
+}VideoParamsLookahead;
+
+typedef struct VideoParamsVP8 {
+    uint32_t size;
+    uint32_t tokenPartitions;     //1, 2, 4 or 8, lets the receiver decode macroblock rows in parallel
+    uint32_t goldenRefreshPeriod; //frames between golden frame refreshes, the old golden moves to altref; 0 keeps the key frame
+    int32_t loopFilterLevel;      //0 to 63, -1 derives it from the quantizer of each frame
+    //1 to 3. with 2 layers frames go 0 1 0 1, with 3 layers 0 2 1 2.
+    //golden and altref then carry layer 1 and 2, goldenRefreshPeriod sets how often
+    //they restart from the base layer with a ENCODE_BUFFERFLAG_LAYERSYNC frame
+    uint32_t temporalLayers;
+    //CBR/VBR bits per second of each layer together with the layers below it,
+    //zeros split bitRate() like 60/100 or 40/60/100 percent
+    uint32_t layerBitRate[3];
+}VideoParamsVP8;
+
+typedef struct VideoParamsHEVC {
+    uint32_t size;
+    //tiles split the picture on a grid of CTU columns and rows, 1 by 1 disables them.
+    //up to 20 columns and 22 rows, the level and picture size may allow fewer
+    uint32_t tileColumns;
+    uint32_t tileRows;
+    //CTU widths of all columns but the last and CTU heights of all rows but the last,
+    //all zeros space the tiles uniformly
+    uint32_t columnWidth[19];
+    uint32_t rowHeight[21];
+    bool loopFilterAcrossTiles;
+    //wavefront parallel processing, each CTU row starts from the CABAC state
+    //of the second CTU in the row above
+    bool entropyCodingSync;
+    //tiles or CTU rows after the first go into dependent slice segments,
+    //they keep the slice header and CABAC state of the segment before them
+    bool dependentSliceSegments;
+    //the B frames of each ipPeriod run reference each other in a hierarchy (ipPeriod 8 or 16)
+    bool enableBPyramid;
+}VideoParamsHEVC;
+
+typedef struct VideoParamsJPEG {
+    uint32_t size;
+    //1 to 100, scales the quantization tables the way libjpeg does, 50 keeps them
+    uint32_t quality;
+}VideoParamsJPEG;
+
 typedef struct VideoParamsHRD {
     uint32_t size;
     uint32_t bufferSize;
@@ -30,6 +30,12 @@ extern "C" { // for dlsym usage
  * \brief create encoder basing on given mimetype
 */
 YamiMediaCodec::IVideoEncoder *createVideoEncoder(const char *mimeType);
+/** \fn IVideoEncoder *createChunkedVideoEncoder(const char *mimeType, uint32_t sessions, uint32_t framesPerChunk)
+ * encodes closed gop chunks of about framesPerChunk frames on several sessions at once,
+ * the output is still one stream. only h264 is supported, and only VideoFrame input;
+ * it is there when libyami is built with the h264 encoder.
+*/
+YamiMediaCodec::IVideoEncoder *createChunkedVideoEncoder(const char *mimeType, uint32_t sessions, uint32_t framesPerChunk);
 ///brief destroy encoder
 void releaseVideoEncoder(YamiMediaCodec::IVideoEncoder * p);
 /** \fn void getVideoEncoderMimeTypes()
@@ -48,6 +48,15 @@ class IVideoEncoder {
     /// we will hold a reference of @param[in]frame, until encode is done
     virtual YamiStatus encode(const SharedPtr<VideoFrame>& frame) = 0;
 
+    /**
+     * \brief encode @param[in] count frames back to back and wait once for all of them,
+     * the coded data of frames[i] goes to outputs[i], like getOutput() with OUTPUT_EVERYTHING.
+     * frames may be smaller than the configured resolution, their crop gives the size.
+     * the frames bypass getOutput(), give each output getMaxOutSize() bytes.
+     * YAMI_UNSUPPORTED for codecs that need the frames in a sequence, only jpeg supports it now.
+     */
+    virtual YamiStatus encodeBatch(const SharedPtr<VideoFrame>* frames, VideoEncOutputBuffer* outputs, uint32_t count) = 0;
+
 #ifndef __BUILD_GET_MV__
     /**
      * \brief return one frame encoded data to client;
@@ -89,6 +98,16 @@ class IVideoEncoder {
     virtual YamiStatus getMVBufferSize(uint32_t* Size) = 0;
 #endif
 
+    /// an eventfd for event loops, readable when getOutput() has data or encode() is no
+    /// longer busy. read it to clear it, then call getOutput() until it has nothing.
+    /// return -1 if eventfd is not supported.
+    virtual int getEventFd() = 0;
+
+    /// share of the display scheduler, same as IVideoDecoder::setSchedulePriority
+    virtual YamiStatus setSchedulePriority(uint32_t priority) = 0;
+    /// queueing delay on the display scheduler, YAMI_UNSUPPORTED when it is not running
+    virtual YamiStatus getScheduleStats(VideoScheduleStats* stats) = 0;
+
     /// get encode statistics information, for debug use
     virtual YamiStatus getStatistics(VideoStatistics* videoStat) = 0;
 
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VIDEO_LADDER_INTERFACE_H_
+#define VIDEO_LADDER_INTERFACE_H_
+
+#include "VideoEncoderInterface.h"
+
+namespace YamiMediaCodec{
+/**
+ * \class IVideoLadder
+ * \brief one decoded frame in, N renditions out, for adaptive bitrate streaming.
+ * every input frame is scaled once per distinct rendition format by a single
+ * scaler and handed to each rendition's encoder. renditions of one format share
+ * the scaled frame, renditions matching the input share the input frame.
+ * key frames are placed on the same input frame in every rendition, so
+ * segments can be cut at the same point.
+ */
+class IVideoLadder {
+  public:
+    virtual ~IVideoLadder() {}
+    /// add a rendition before start(). @param encoder is set up by the caller but not started,
+    /// its frames are fourcc/width/height. @param[out] index identifies the rendition in getOutput()
+    virtual YamiStatus addRendition(IVideoEncoder* encoder, uint32_t fourcc,
+                                    uint32_t width, uint32_t height, uint32_t* index) = 0;
+    /**
+     * \brief align gop settings of all renditions to the first one and start the encoders.
+     * every keyInterval input frames all renditions get a key frame, 0 leaves it to the
+     * encoders' gop, which then still matches since every rendition sees the same frames.
+     */
+    virtual YamiStatus start(uint32_t keyInterval) = 0;
+    virtual void stop() = 0;
+    /**
+     * \brief scale @param frame for every rendition and encode it.
+     * YAMI_ENCODE_IS_BUSY means the frame was not taken, drain getOutput() and try again.
+     * a null frame ends the stream.
+     */
+    virtual YamiStatus encode(const SharedPtr<VideoFrame>& frame) = 0;
+    /// the next encoded frame of rendition @param index
+    virtual YamiStatus getOutput(uint32_t index, VideoEncOutputBuffer* outBuffer) = 0;
+};
+}
+#endif                          /* VIDEO_LADDER_INTERFACE_H_ */
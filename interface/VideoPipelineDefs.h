@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __VIDEO_PIPELINE_DEFS_H__
+#define __VIDEO_PIPELINE_DEFS_H__
+
+#include "VideoCommonDefs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* decoder, post process stages and encoder */
+#define VIDEO_PIPELINE_MAX_STAGES 8
+
+typedef struct VideoPipelineStageStats {
+    uint32_t frames;        //frames the stage handed to the next one
+    uint32_t queued;        //frames waiting in front of the stage right now
+    uint32_t maxQueued;     //most frames ever waiting in front of the stage
+    uint32_t queueSize;     //capacity of the queue in front of the stage
+    uint64_t busyUs;        //time spent in decode()/process()/encode()
+    uint64_t maxBusyUs;     //longest single call
+    uint64_t queueUs;       //time frames spent waiting in front of the stage
+    uint64_t blockedUs;     //time stalled on the next stage or on the stage's surface pool
+} VideoPipelineStageStats;
+
+typedef struct VideoPipelineStats {
+    size_t size;
+    uint32_t numStages;
+    VideoPipelineStageStats stages[VIDEO_PIPELINE_MAX_STAGES];
+} VideoPipelineStats;
+
+#ifdef __cplusplus
+}
+#endif
+#endif /*  __VIDEO_PIPELINE_DEFS_H__ */
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VIDEO_PIPELINE_HOST_H_
+#define VIDEO_PIPELINE_HOST_H_
+
+#include "VideoPipelineInterface.h"
+#include "VideoLadderInterface.h"
+
+extern "C" { // for dlsym usage
+
+/** \file VideoPipelineHost.h
+*/
+
+/** \fn IVideoPipeline *createVideoPipeline(IVideoDecoder* decoder, IVideoEncoder* encoder, const NativeDisplay* display, uint32_t queueSize)
+ * \brief wire @param decoder to @param encoder, queueSize frames may wait in front of each stage
+*/
+YamiMediaCodec::IVideoPipeline *createVideoPipeline(YamiMediaCodec::IVideoDecoder* decoder,
+    YamiMediaCodec::IVideoEncoder* encoder, const NativeDisplay* display, uint32_t queueSize);
+/** \fn void releaseVideoPipeline(IVideoPipeline *p)
+*/
+void releaseVideoPipeline(YamiMediaCodec::IVideoPipeline * p);
+
+typedef YamiMediaCodec::IVideoPipeline *(*YamiCreateVideoPipelineFuncPtr) (YamiMediaCodec::IVideoDecoder* decoder,
+    YamiMediaCodec::IVideoEncoder* encoder, const NativeDisplay* display, uint32_t queueSize);
+typedef void (*YamiReleaseVideoPipelineFuncPtr)(YamiMediaCodec::IVideoPipeline * p);
+
+/** \fn IVideoLadder *createVideoLadder(const NativeDisplay* display)
+ * \brief an abr ladder, renditions are added before it starts
+*/
+YamiMediaCodec::IVideoLadder *createVideoLadder(const NativeDisplay* display);
+/** \fn void releaseVideoLadder(IVideoLadder *p)
+*/
+void releaseVideoLadder(YamiMediaCodec::IVideoLadder * p);
+
+typedef YamiMediaCodec::IVideoLadder *(*YamiCreateVideoLadderFuncPtr) (const NativeDisplay* display);
+typedef void (*YamiReleaseVideoLadderFuncPtr)(YamiMediaCodec::IVideoLadder * p);
+}
+#endif                          /* VIDEO_PIPELINE_HOST_H_ */
@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef VIDEO_PIPELINE_INTERFACE_H_
+#define VIDEO_PIPELINE_INTERFACE_H_
+
+#include "VideoPipelineDefs.h"
+#include "VideoDecoderInterface.h"
+#include "VideoEncoderInterface.h"
+#include "VideoPostProcessInterface.h"
+
+namespace YamiMediaCodec{
+/**
+ * \class IVideoPipeline
+ * \brief decoder -> post process stages -> encoder, each stage on its own thread
+ * frames travel between stages as surfaces, bounded queues and the surface pools
+ * hold back the stages in front of a slow one. stages are owned by the caller,
+ * are set up before start() and must not be started by the caller.
+ * decode() and getOutput() can be called from different threads.
+ */
+class IVideoPipeline {
+  public:
+    virtual ~IVideoPipeline() {}
+    /// stages added after the decoder, in order. output is fourcc/width/height surfaces.
+    virtual YamiStatus addPostProcess(IVideoPostProcess* vpp, uint32_t fourcc, uint32_t width, uint32_t height) = 0;
+    /// start decoder with @param[in] config, then encoder. all stages share the pipeline's display
+    virtual YamiStatus start(VideoConfigBuffer* config) = 0;
+    /// stop the threads, drop queued frames and stop decoder and encoder. a stopped pipeline can't be restarted
+    virtual void stop() = 0;
+    /// queue one bitstream buffer, blocks while the input queue is full.
+    /// a NULL buffer or a buffer without data ends the stream.
+    virtual YamiStatus decode(VideoDecodeBuffer* buffer) = 0;
+    /**
+     * \brief the next encoded frame.
+     * when withWait is true, it blocks until a frame is encoded or the stream ended.
+     * YAMI_ENCODE_BUFFER_NO_MORE after the end of stream means the pipeline is drained.
+     */
+    virtual YamiStatus getOutput(VideoEncOutputBuffer* outBuffer, bool withWait = false) = 0;
+    /// per stage counters, stage 0 is the decoder and the last one is the encoder
+    virtual YamiStatus getStatistics(VideoPipelineStats* stats) = 0;
+};
+}
+#endif                          /* VIDEO_PIPELINE_INTERFACE_H_ */
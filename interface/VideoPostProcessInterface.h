@@ -19,6 +19,7 @@
 
 #include "VideoCommonDefs.h"
 #include "VideoPostProcessDefs.h"
+#include <vector>
 
 namespace YamiMediaCodec{
 /**
@@ -36,6 +37,18 @@ class IVideoPostProcess {
     // for some type of vpp such as deinterlace, we will hold a referece of src.
     virtual YamiStatus process(const SharedPtr<VideoFrame>& src,
                                const SharedPtr<VideoFrame>& dest) = 0;
+    // process one src into each of dests, for an abr ladder.
+    // implementations may set the source up once and share it across dests.
+    virtual YamiStatus processMulti(const SharedPtr<VideoFrame>& src,
+                                    const std::vector<SharedPtr<VideoFrame> >& dests)
+    {
+        for (size_t i = 0; i < dests.size(); i++) {
+            YamiStatus status = process(src, dests[i]);
+            if (status != YAMI_SUCCESS)
+                return status;
+        }
+        return YAMI_SUCCESS;
+    }
     virtual YamiStatus setParameters(VppParamType type, void* vppParam) = 0;
     virtual ~IVideoPostProcess() {}
 };
@@ -0,0 +1,353 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "videoladder.h"
+#include "common/log.h"
+#include "common/surfacepool.h"
+#include "interface/VideoPostProcessHost.h"
+#include "vaapi/vaapidisplay.h"
+#include "vaapi/VaapiSurface.h"
+#include "vaapi/vaapisurfaceallocator.h"
+#include <string.h>
+
+namespace YamiMediaCodec{
+
+//frames an encoder keeps in its output queue before it reports busy, see VaapiEncoderBase
+const uint32_t ENCODER_OUTPUT_FRAMES = 5;
+
+static void unrefAllocator(SurfaceAllocator* allocator)
+{
+    allocator->unref(allocator);
+}
+
+static void releaseScaler(IVideoPostProcess* scaler)
+{
+    releaseVideoPostProcess(scaler);
+}
+
+//keeps what the frame points to alive, a pool surface or the shared source frame
+template <class T>
+struct FrameHolder {
+    FrameHolder(const T& held)
+        : m_held(held)
+    {
+    }
+    void operator()(VideoFrame* frame)
+    {
+        delete frame;
+    }
+
+private:
+    T m_held;
+};
+
+VideoLadder::VideoLadder()
+    : m_keyInterval(0)
+    , m_frames(0)
+    , m_started(false)
+    , m_eos(false)
+{
+    memset(&m_nativeDisplay, 0, sizeof(m_nativeDisplay));
+}
+
+VideoLadder::~VideoLadder()
+{
+    stop();
+}
+
+bool VideoLadder::init(const NativeDisplay* display)
+{
+    NativeDisplay nativeDisplay;
+    memset(&nativeDisplay, 0, sizeof(nativeDisplay));
+    if (display)
+        nativeDisplay = *display;
+    m_display = VaapiDisplay::create(nativeDisplay);
+    if (!m_display) {
+        ERROR("failed to create display for the ladder");
+        return false;
+    }
+    m_nativeDisplay.handle = (intptr_t)m_display->getID();
+    m_nativeDisplay.type = NATIVE_DISPLAY_VA;
+
+    m_scaler.reset(createVideoPostProcess(YAMI_VPP_SCALER), releaseScaler);
+    if (!m_scaler || m_scaler->setNativeDisplay(m_nativeDisplay) != YAMI_SUCCESS) {
+        ERROR("failed to create scaler for the ladder");
+        return false;
+    }
+    //one allocator for every rendition format
+    m_alloc.reset(new VaapiSurfaceAllocator(m_display->getID()), unrefAllocator);
+    return true;
+}
+
+YamiStatus VideoLadder::addRendition(IVideoEncoder* encoder, uint32_t fourcc,
+    uint32_t width, uint32_t height, uint32_t* index)
+{
+    if (!encoder || !fourcc || !width || !height || !index)
+        return YAMI_INVALID_PARAM;
+    if (m_started) {
+        ERROR("can't add rendition to a started ladder");
+        return YAMI_FAIL;
+    }
+    Rendition rendition;
+    rendition.encoder = encoder;
+    rendition.output = m_outputs.size();
+    for (size_t i = 0; i < m_outputs.size(); i++) {
+        const Output& output = m_outputs[i];
+        if (output.fourcc == fourcc && output.width == width && output.height == height) {
+            rendition.output = i;
+            break;
+        }
+    }
+    if (rendition.output == m_outputs.size()) {
+        Output output;
+        output.fourcc = fourcc;
+        output.width = width;
+        output.height = height;
+        output.poolSize = 0;
+        m_outputs.push_back(output);
+    }
+    *index = m_renditions.size();
+    m_renditions.push_back(rendition);
+    return YAMI_SUCCESS;
+}
+
+uint32_t VideoLadder::framesHeld(IVideoEncoder* encoder)
+{
+    uint32_t held = ENCODER_OUTPUT_FRAMES;
+    VideoParamsCommon common;
+    common.size = sizeof(common);
+    if (encoder->getParameters(VideoParamsTypeCommon, &common) == YAMI_SUCCESS) {
+        if (held < common.leastInputCount + 3)
+            held = common.leastInputCount + 3;
+        held += common.ipPeriod;
+    }
+    VideoParamsLookahead lookahead;
+    lookahead.size = sizeof(lookahead);
+    if (encoder->getParameters(VideoParamsTypeLookahead, &lookahead) == YAMI_SUCCESS)
+        held += lookahead.depth;
+    return held;
+}
+
+void VideoLadder::alignGop()
+{
+    VideoParamsCommon first;
+    first.size = sizeof(first);
+    if (m_renditions[0].encoder->getParameters(VideoParamsTypeCommon, &first) != YAMI_SUCCESS)
+        return;
+    for (size_t i = 0; i < m_renditions.size(); i++) {
+        IVideoEncoder* encoder = m_renditions[i].encoder;
+        VideoParamsCommon common;
+        common.size = sizeof(common);
+        if (i && encoder->getParameters(VideoParamsTypeCommon, &common) == YAMI_SUCCESS
+            && (common.intraPeriod != first.intraPeriod || common.ipPeriod != first.ipPeriod)) {
+            INFO("rendition %d takes intra period %d, ip period %d from rendition 0",
+                (int)i, first.intraPeriod, first.ipPeriod);
+            common.intraPeriod = first.intraPeriod;
+            common.ipPeriod = first.ipPeriod;
+            encoder->setParameters(VideoParamsTypeCommon, &common);
+        }
+        //scene cuts and B runs decided on each rendition's own pixels may land on different frames
+        VideoParamsLookahead lookahead;
+        lookahead.size = sizeof(lookahead);
+        if (encoder->getParameters(VideoParamsTypeLookahead, &lookahead) == YAMI_SUCCESS
+            && (lookahead.enableSceneCut || lookahead.enableAdaptiveB)) {
+            INFO("rendition %d: scene cut and adaptive B are off in a ladder", (int)i);
+            lookahead.enableSceneCut = false;
+            lookahead.enableAdaptiveB = false;
+            encoder->setParameters(VideoParamsTypeLookahead, &lookahead);
+        }
+    }
+}
+
+YamiStatus VideoLadder::start(uint32_t keyInterval)
+{
+    if (m_started)
+        return YAMI_FAIL;
+    if (m_renditions.empty()) {
+        ERROR("ladder has no rendition");
+        return YAMI_FAIL;
+    }
+    alignGop();
+    for (size_t i = 0; i < m_outputs.size(); i++)
+        m_outputs[i].poolSize = 0;
+    for (size_t i = 0; i < m_renditions.size(); i++) {
+        Rendition& rendition = m_renditions[i];
+        //renditions of one format hold the same frames, the pool covers the greediest
+        Output& output = m_outputs[rendition.output];
+        uint32_t held = framesHeld(rendition.encoder) + 1;
+        if (output.poolSize < held)
+            output.poolSize = held;
+
+        rendition.encoder->setNativeDisplay(&m_nativeDisplay);
+        YamiStatus status = rendition.encoder->start();
+        if (status != YAMI_SUCCESS) {
+            ERROR("failed to start encoder of rendition %d", (int)i);
+            while (i--)
+                m_renditions[i].encoder->stop();
+            return status;
+        }
+    }
+    m_keyInterval = keyInterval;
+    m_frames = 0;
+    m_eos = false;
+    m_started = true;
+    return YAMI_SUCCESS;
+}
+
+void VideoLadder::stop()
+{
+    if (!m_started)
+        return;
+    for (size_t i = 0; i < m_renditions.size(); i++) {
+        Rendition& rendition = m_renditions[i];
+        rendition.pending.reset();
+        rendition.encoder->stop();
+    }
+    for (size_t i = 0; i < m_outputs.size(); i++)
+        m_outputs[i].pool.reset();
+    m_started = false;
+}
+
+bool VideoLadder::isSource(const Output& output, const SharedPtr<VideoFrame>& frame)
+{
+    const VideoRect& crop = frame->crop;
+    return output.fourcc == frame->fourcc && !crop.x && !crop.y
+        && output.width == crop.width && output.height == crop.height;
+}
+
+SharedPtr<VideoFrame> VideoLadder::allocFrame(Output& output)
+{
+    SharedPtr<VideoFrame> frame;
+    if (!output.pool) {
+        output.pool = SurfacePool::create(m_alloc, output.fourcc, output.width, output.height, output.poolSize);
+        if (!output.pool) {
+            ERROR("failed to create surface pool for %dx%d", output.width, output.height);
+            return frame;
+        }
+    }
+    SurfacePtr surface = output.pool->alloc();
+    if (!surface)
+        return frame;
+    frame.reset(new VideoFrame, FrameHolder<SurfacePtr>(surface));
+    memset(frame.get(), 0, sizeof(VideoFrame));
+    frame->surface = (intptr_t)surface->getID();
+    frame->crop.width = output.width;
+    frame->crop.height = output.height;
+    frame->fourcc = output.fourcc;
+    return frame;
+}
+
+YamiStatus VideoLadder::encodePending()
+{
+    YamiStatus ret = YAMI_SUCCESS;
+    bool busy = false;
+    for (size_t i = 0; i < m_renditions.size(); i++) {
+        Rendition& rendition = m_renditions[i];
+        if (!rendition.pending)
+            continue;
+        YamiStatus status = rendition.encoder->encode(rendition.pending);
+        if (status == YAMI_ENCODE_IS_BUSY) {
+            busy = true;
+            continue;
+        }
+        rendition.pending.reset();
+        if (status != YAMI_SUCCESS) {
+            ERROR("rendition %d failed to encode, status = %d", (int)i, status);
+            ret = status;
+        }
+    }
+    return busy ? YAMI_ENCODE_IS_BUSY : ret;
+}
+
+YamiStatus VideoLadder::encode(const SharedPtr<VideoFrame>& frame)
+{
+    if (!m_started)
+        return YAMI_FAIL;
+    //the last frame has to reach every encoder before the next one is taken
+    YamiStatus status = encodePending();
+    if (status != YAMI_SUCCESS)
+        return status;
+    if (m_eos)
+        return frame ? YAMI_FAIL : YAMI_SUCCESS;
+    if (!frame) {
+        for (size_t i = 0; i < m_renditions.size(); i++)
+            m_renditions[i].encoder->encode(frame);
+        m_eos = true;
+        return YAMI_SUCCESS;
+    }
+
+    std::vector<SharedPtr<VideoFrame> > frames(m_outputs.size());
+    std::vector<SharedPtr<VideoFrame> > dests;
+    for (size_t i = 0; i < m_outputs.size(); i++) {
+        Output& output = m_outputs[i];
+        if (isSource(output, frame)) {
+            //a copy of the frame description, so key flags stay ours
+            frames[i].reset(new VideoFrame(*frame), FrameHolder<SharedPtr<VideoFrame> >(frame));
+            continue;
+        }
+        frames[i] = allocFrame(output);
+        //every surface is still in an encoder, output has to be drained first
+        if (!frames[i])
+            return YAMI_ENCODE_IS_BUSY;
+        dests.push_back(frames[i]);
+    }
+    if (!dests.empty()) {
+        status = m_scaler->processMulti(frame, dests);
+        if (status != YAMI_SUCCESS) {
+            ERROR("ladder failed to scale, status = %d", status);
+            return status;
+        }
+    }
+
+    bool key = (frame->flags & VIDEO_FRAME_FLAGS_KEY)
+        || (m_keyInterval && !(m_frames % m_keyInterval));
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (key)
+            frames[i]->flags |= VIDEO_FRAME_FLAGS_KEY;
+    }
+    for (size_t i = 0; i < m_renditions.size(); i++) {
+        Rendition& rendition = m_renditions[i];
+        rendition.pending = frames[rendition.output];
+    }
+    m_frames++;
+
+    //the frame is taken, a busy encoder gets it on the next call
+    status = encodePending();
+    return status == YAMI_ENCODE_IS_BUSY ? YAMI_SUCCESS : status;
+}
+
+YamiStatus VideoLadder::getOutput(uint32_t index, VideoEncOutputBuffer* outBuffer)
+{
+    if (index >= m_renditions.size() || !outBuffer)
+        return YAMI_INVALID_PARAM;
+    IVideoEncoder* encoder = m_renditions[index].encoder;
+#ifndef __BUILD_GET_MV__
+    return encoder->getOutput(outBuffer);
+#else
+    uint32_t mvSize = 0;
+    encoder->getMVBufferSize(&mvSize);
+    std::vector<uint8_t> mv(mvSize + 1);
+    VideoEncMVBuffer mvBuffer;
+    mvBuffer.data = &mv[0];
+    mvBuffer.bufferSize = mvSize;
+    return encoder->getOutput(outBuffer, &mvBuffer);
+#endif
+}
+}
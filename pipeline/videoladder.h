@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef videoladder_h
+#define videoladder_h
+
+#include "interface/VideoLadderInterface.h"
+#include "interface/VideoPostProcessInterface.h"
+#include "common/NonCopyable.h"
+#include "vaapi/vaapiptrs.h"
+
+#include <vector>
+
+namespace YamiMediaCodec{
+
+class SurfacePool;
+
+/*
+ * Fans one input frame out to several encoders. Not thread safe, except that
+ * getOutput() may run on other threads than encode(), as with IVideoEncoder.
+ */
+class VideoLadder : public IVideoLadder {
+public:
+    VideoLadder();
+    virtual ~VideoLadder();
+
+    bool init(const NativeDisplay* display);
+
+    virtual YamiStatus addRendition(IVideoEncoder* encoder, uint32_t fourcc,
+                                    uint32_t width, uint32_t height, uint32_t* index);
+    virtual YamiStatus start(uint32_t keyInterval);
+    virtual void stop();
+    virtual YamiStatus encode(const SharedPtr<VideoFrame>& frame);
+    virtual YamiStatus getOutput(uint32_t index, VideoEncOutputBuffer* outBuffer);
+
+private:
+    //one scaler destination, shared by every rendition of this format
+    struct Output {
+        uint32_t fourcc;
+        uint32_t width;
+        uint32_t height;
+        //most frames a rendition of this format can hold
+        uint32_t poolSize;
+        SharedPtr<SurfacePool> pool;
+    };
+    struct Rendition {
+        IVideoEncoder* encoder;
+        uint32_t output;
+        //taken by the ladder, not yet by the busy encoder
+        SharedPtr<VideoFrame> pending;
+    };
+
+    void alignGop();
+    uint32_t framesHeld(IVideoEncoder*);
+    bool isSource(const Output&, const SharedPtr<VideoFrame>&);
+    SharedPtr<VideoFrame> allocFrame(Output&);
+    YamiStatus encodePending();
+
+    DisplayPtr m_display;
+    NativeDisplay m_nativeDisplay;
+    SharedPtr<IVideoPostProcess> m_scaler;
+    SharedPtr<SurfaceAllocator> m_alloc;
+    std::vector<Output> m_outputs;
+    std::vector<Rendition> m_renditions;
+    uint32_t m_keyInterval;
+    uint64_t m_frames;
+    bool m_started;
+    bool m_eos;
+
+    DISALLOW_COPY_AND_ASSIGN(VideoLadder);
+};
+}
+#endif /* videoladder_h */
@@ -0,0 +1,694 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "videopipeline.h"
+#include "common/log.h"
+#include "common/surfacepool.h"
+#include "common/utils.h"
+#include "vaapi/vaapidisplay.h"
+#include "vaapi/VaapiSurface.h"
+#include "vaapi/vaapisurfaceallocator.h"
+#include <string.h>
+
+namespace YamiMediaCodec{
+
+static void unrefAllocator(SurfaceAllocator* allocator)
+{
+    allocator->unref(allocator);
+}
+
+//counts released frames, outlives the pipeline if a stage keeps a frame
+class VideoPipeline::FrameReleases {
+public:
+    FrameReleases()
+        : m_cond(m_lock)
+        , m_count(0)
+        , m_closed(false)
+    {
+    }
+
+    uint32_t count()
+    {
+        AutoLock l(m_lock);
+        return m_count;
+    }
+
+    void release()
+    {
+        AutoLock l(m_lock);
+        m_count++;
+        m_cond.broadcast();
+    }
+
+    /// wait for a release after @count was read, false once closed
+    bool wait(uint32_t count)
+    {
+        AutoLock l(m_lock);
+        while (!m_closed && count == m_count)
+            m_cond.wait();
+        return !m_closed;
+    }
+
+    void close()
+    {
+        AutoLock l(m_lock);
+        m_closed = true;
+        m_cond.broadcast();
+    }
+
+private:
+    Lock m_lock;
+    Condition m_cond;
+    uint32_t m_count;
+    bool m_closed;
+};
+
+//keeps the pool surface or the decoder frame until the frame is gone,
+//then wakes up a stage waiting for a surface
+struct VideoPipeline::FrameHolder {
+    FrameHolder(const SharedPtr<FrameReleases>& releases, const SurfacePtr& surface)
+        : m_releases(releases)
+        , m_surface(surface)
+    {
+    }
+    FrameHolder(const SharedPtr<FrameReleases>& releases, const SharedPtr<VideoFrame>& frame)
+        : m_releases(releases)
+        , m_frame(frame)
+    {
+    }
+    void operator()(VideoFrame* frame)
+    {
+        //a decoder frame is deleted by the decoder's own deleter
+        if (!m_frame)
+            delete frame;
+        m_frame.reset();
+        m_surface.reset();
+        m_releases->release();
+    }
+
+private:
+    SharedPtr<FrameReleases> m_releases;
+    SurfacePtr m_surface;
+    SharedPtr<VideoFrame> m_frame;
+};
+
+VideoPipeline::VideoPipeline(IVideoDecoder* decoder, IVideoEncoder* encoder, uint32_t queueSize)
+    : m_decoder(decoder)
+    , m_encoder(encoder)
+    , m_queueSize(queueSize ? queueSize : 1)
+    , m_input(m_queueSize)
+    , m_decodeStarted(false)
+    , m_started(false)
+    , m_cond(m_lock)
+    , m_encodeCount(0)
+    , m_outputCount(0)
+    , m_draining(false)
+    , m_drained(false)
+    , m_eos(false)
+    , m_done(false)
+    , m_quit(false)
+{
+    memset(&m_nativeDisplay, 0, sizeof(m_nativeDisplay));
+}
+
+VideoPipeline::~VideoPipeline()
+{
+    stop();
+}
+
+bool VideoPipeline::init(const NativeDisplay* display)
+{
+    if (!m_decoder || !m_encoder) {
+        ERROR("pipeline needs a decoder and an encoder");
+        return false;
+    }
+    NativeDisplay nativeDisplay;
+    memset(&nativeDisplay, 0, sizeof(nativeDisplay));
+    if (display)
+        nativeDisplay = *display;
+    m_display = VaapiDisplay::create(nativeDisplay);
+    if (!m_display) {
+        ERROR("failed to create display for the pipeline");
+        return false;
+    }
+    //every stage works on surfaces of the same VADisplay
+    m_nativeDisplay.handle = (intptr_t)m_display->getID();
+    m_nativeDisplay.type = NATIVE_DISPLAY_VA;
+    return true;
+}
+
+YamiStatus VideoPipeline::addPostProcess(IVideoPostProcess* vpp, uint32_t fourcc, uint32_t width, uint32_t height)
+{
+    if (!vpp || !fourcc || !width || !height)
+        return YAMI_INVALID_PARAM;
+    if (m_started) {
+        ERROR("can't add post process to a started pipeline");
+        return YAMI_FAIL;
+    }
+    //decoder and encoder take two of the stages
+    if (m_vpps.size() + 2 >= VIDEO_PIPELINE_MAX_STAGES) {
+        ERROR("too many post process stages");
+        return YAMI_UNSUPPORTED;
+    }
+    YamiStatus status = vpp->setNativeDisplay(m_nativeDisplay);
+    if (status != YAMI_SUCCESS)
+        return status;
+
+    SharedPtr<SurfaceAllocator> alloc(new VaapiSurfaceAllocator(m_display->getID()), unrefAllocator);
+    //one frame in each queue slot, one in process() and one held by the next stage
+    SharedPtr<SurfacePool> pool = SurfacePool::create(alloc, fourcc, width, height, m_queueSize + 2);
+    if (!pool) {
+        ERROR("failed to create surface pool for post process");
+        return YAMI_OUT_MEMORY;
+    }
+    StagePtr stage(new Stage);
+    stage->owner = this;
+    stage->index = m_vpps.size() + 1;
+    stage->vpp = vpp;
+    stage->fourcc = fourcc;
+    stage->width = width;
+    stage->height = height;
+    stage->pool = pool;
+    stage->started = false;
+    m_vpps.push_back(stage);
+    return YAMI_SUCCESS;
+}
+
+bool VideoPipeline::startThread(pthread_t& thread, void* (*func)(void*), void* arg)
+{
+    if (pthread_create(&thread, NULL, func, arg) != 0) {
+        ERROR("failed to create pipeline thread");
+        return false;
+    }
+    return true;
+}
+
+YamiStatus VideoPipeline::start(VideoConfigBuffer* config)
+{
+    if (m_started)
+        return YAMI_FAIL;
+    m_decoder->setNativeDisplay(&m_nativeDisplay);
+    YamiStatus status = m_decoder->start(config);
+    if (status != YAMI_SUCCESS) {
+        ERROR("failed to start decoder");
+        return status;
+    }
+    m_encoder->setNativeDisplay(&m_nativeDisplay);
+    status = m_encoder->start();
+    if (status != YAMI_SUCCESS) {
+        ERROR("failed to start encoder");
+        m_decoder->stop();
+        return status;
+    }
+
+    {
+        AutoLock l(m_lock);
+        m_queues.clear();
+        for (size_t i = 0; i <= m_vpps.size(); i++)
+            m_queues.push_back(FrameQueuePtr(new FrameQueue(m_queueSize)));
+        m_releases.reset(new FrameReleases);
+        VideoPipelineStageStats zero;
+        memset(&zero, 0, sizeof(zero));
+        m_stats.assign(m_vpps.size() + 2, zero);
+        m_draining = false;
+        m_drained = false;
+        m_eos = false;
+        m_done = false;
+        m_quit = false;
+    }
+
+    //from the encoder back, so no stage pushes into a queue nobody pops
+    m_started = true;
+    if (!startThread(m_encodeThread, encodeThread, this)) {
+        m_started = false;
+        m_encoder->stop();
+        m_decoder->stop();
+        return YAMI_FAIL;
+    }
+    for (size_t i = m_vpps.size(); i > 0; i--) {
+        Stage& stage = *m_vpps[i - 1];
+        stage.started = startThread(stage.thread, processThread, &stage);
+        if (!stage.started) {
+            stop();
+            return YAMI_FAIL;
+        }
+    }
+    m_decodeStarted = startThread(m_decodeThread, decodeThread, this);
+    if (!m_decodeStarted) {
+        stop();
+        return YAMI_FAIL;
+    }
+    return YAMI_SUCCESS;
+}
+
+void VideoPipeline::stop()
+{
+    if (!m_started)
+        return;
+    {
+        AutoLock l(m_lock);
+        m_quit = true;
+        m_cond.broadcast();
+    }
+    m_input.close();
+    for (size_t i = 0; i < m_queues.size(); i++)
+        m_queues[i]->close();
+    m_releases->close();
+
+    if (m_decodeStarted)
+        pthread_join(m_decodeThread, NULL);
+    m_decodeStarted = false;
+    for (size_t i = 0; i < m_vpps.size(); i++) {
+        Stage& stage = *m_vpps[i];
+        if (stage.started)
+            pthread_join(stage.thread, NULL);
+        stage.started = false;
+    }
+    pthread_join(m_encodeThread, NULL);
+
+    //queued frames hold decoder and pool surfaces
+    m_input.clear();
+    {
+        AutoLock l(m_lock);
+        m_queues.clear();
+    }
+    m_encoder->stop();
+    m_decoder->stop();
+    m_started = false;
+}
+
+YamiStatus VideoPipeline::decode(VideoDecodeBuffer* buffer)
+{
+    if (!m_started)
+        return YAMI_FAIL;
+    PacketPtr packet(new Packet);
+    packet->eos = !buffer || !buffer->data || !buffer->size;
+    if (!packet->eos) {
+        packet->data.assign(buffer->data, buffer->data + buffer->size);
+        packet->timeStamp = buffer->timeStamp;
+        packet->flag = buffer->flag;
+    }
+    {
+        AutoLock l(m_lock);
+        if (m_eos) {
+            ERROR("decode after end of stream");
+            return YAMI_FAIL;
+        }
+        m_eos = packet->eos;
+    }
+    packet->queuedUs = getMonotonicTimeUs();
+    if (!m_input.push(packet))
+        return YAMI_FAIL;
+    return YAMI_SUCCESS;
+}
+
+YamiStatus VideoPipeline::getOutput(VideoEncOutputBuffer* outBuffer, bool withWait)
+{
+    if (!outBuffer)
+        return YAMI_INVALID_PARAM;
+    while (1) {
+        uint32_t count;
+        bool done;
+        {
+            AutoLock l(m_lock);
+            count = m_encodeCount;
+            done = m_done;
+        }
+        YamiStatus status;
+        {
+            AutoLock l(m_encoderLock);
+#ifndef __BUILD_GET_MV__
+            status = m_encoder->getOutput(outBuffer, false);
+#else
+            uint32_t mvSize = 0;
+            m_encoder->getMVBufferSize(&mvSize);
+            std::vector<uint8_t> mv(mvSize + 1);
+            VideoEncMVBuffer mvBuffer;
+            mvBuffer.data = &mv[0];
+            mvBuffer.bufferSize = mvSize;
+            status = m_encoder->getOutput(outBuffer, &mvBuffer, false);
+#endif
+        }
+        if (status == YAMI_SUCCESS) {
+            AutoLock l(m_lock);
+            m_outputCount++;
+            m_cond.broadcast();
+            return status;
+        }
+        if (status == YAMI_ENCODE_BUFFER_NO_MORE) {
+            AutoLock l(m_lock);
+            //everything coded at the old size is out, the encoder may restart
+            if (m_draining && count == m_encodeCount) {
+                m_drained = true;
+                m_cond.broadcast();
+            }
+        }
+        //the encoder got every frame before done was set
+        if (status != YAMI_ENCODE_BUFFER_NO_MORE || done || !withWait)
+            return status;
+
+        AutoLock l(m_lock);
+        while (!m_quit && !m_done && count == m_encodeCount)
+            m_cond.wait();
+        if (m_quit)
+            return YAMI_ENCODE_BUFFER_NO_MORE;
+    }
+}
+
+YamiStatus VideoPipeline::getStatistics(VideoPipelineStats* stats)
+{
+    if (!stats || stats->size < sizeof(VideoPipelineStats))
+        return YAMI_INVALID_PARAM;
+    uint32_t numStages = m_vpps.size() + 2;
+    stats->numStages = numStages;
+    //stop() may tear the queues down under us
+    AutoLock l(m_lock);
+    if (m_stats.size() != numStages)
+        return YAMI_FAIL;
+    for (uint32_t i = 0; i < numStages; i++)
+        stats->stages[i] = m_stats[i];
+    VideoPipelineStageStats& decoder = stats->stages[0];
+    decoder.queued = m_input.size();
+    decoder.maxQueued = m_input.maxSize();
+    decoder.queueSize = m_input.capacity();
+    for (uint32_t i = 1; i < numStages && i <= m_queues.size(); i++) {
+        VideoPipelineStageStats& stage = stats->stages[i];
+        FrameQueue& queue = *m_queues[i - 1];
+        stage.queued = queue.size();
+        stage.maxQueued = queue.maxSize();
+        stage.queueSize = queue.capacity();
+    }
+    return YAMI_SUCCESS;
+}
+
+void VideoPipeline::account(uint32_t stage, uint64_t busyUs, uint64_t queueUs)
+{
+    AutoLock l(m_lock);
+    VideoPipelineStageStats& stats = m_stats[stage];
+    stats.busyUs += busyUs;
+    if (busyUs > stats.maxBusyUs)
+        stats.maxBusyUs = busyUs;
+    stats.queueUs += queueUs;
+}
+
+void VideoPipeline::addBlocked(uint32_t stage, uint64_t us)
+{
+    AutoLock l(m_lock);
+    m_stats[stage].blockedUs += us;
+}
+
+void VideoPipeline::setDone()
+{
+    AutoLock l(m_lock);
+    m_done = true;
+    m_cond.broadcast();
+}
+
+bool VideoPipeline::pushFrame(uint32_t stage, const SharedPtr<VideoFrame>& frame)
+{
+    Item item;
+    item.frame = frame;
+    return pushItem(stage, item);
+}
+
+bool VideoPipeline::pushFormat(uint32_t stage, const VideoFormatInfo& format)
+{
+    Item item;
+    item.format.reset(new VideoFormatInfo(format));
+    return pushItem(stage, item);
+}
+
+bool VideoPipeline::pushItem(uint32_t stage, Item& item)
+{
+    item.queuedUs = getMonotonicTimeUs();
+    bool ret = m_queues[stage]->push(item);
+    uint64_t blocked = getMonotonicTimeUs() - item.queuedUs;
+
+    AutoLock l(m_lock);
+    VideoPipelineStageStats& stats = m_stats[stage];
+    stats.blockedUs += blocked;
+    if (ret && item.frame)
+        stats.frames++;
+    return ret;
+}
+
+void* VideoPipeline::decodeThread(void* arg)
+{
+    VideoPipeline* pipeline = static_cast<VideoPipeline*>(arg);
+    pipeline->decodeLoop();
+    return NULL;
+}
+
+bool VideoPipeline::drainDecoder()
+{
+    SharedPtr<VideoFrame> frame;
+    while ((frame = m_decoder->getOutput())) {
+        //the surface goes back to the decoder when the wrapper is released
+        SharedPtr<VideoFrame> wrapped(frame.get(), FrameHolder(m_releases, frame));
+        if (!pushFrame(0, wrapped))
+            return false;
+    }
+    return true;
+}
+
+YamiStatus VideoPipeline::decodeOne(VideoDecodeBuffer* buffer)
+{
+    YamiStatus status;
+    uint64_t busy = 0;
+    while (1) {
+        uint32_t released = m_releases->count();
+        uint64_t start = getMonotonicTimeUs();
+        status = m_decoder->decode(buffer);
+        uint64_t end = getMonotonicTimeUs();
+        busy += end - start;
+        if (status == YAMI_DECODE_FORMAT_CHANGE) {
+            //the frames of the old format go first, then the new size
+            const VideoFormatInfo* format = m_decoder->getFormatInfo();
+            INFO("pipeline decoder format changed");
+            if (!drainDecoder() || (format && !pushFormat(0, *format)))
+                break;
+            //surfaces are reallocated by the decoder, the same buffer goes in again
+            continue;
+        }
+        if (status != YAMI_DECODE_NO_SURFACE)
+            break;
+        //every surface is somewhere downstream
+        if (!drainDecoder())
+            break;
+        bool running = m_releases->wait(released);
+        addBlocked(0, getMonotonicTimeUs() - end);
+        if (!running)
+            break;
+    }
+    account(0, busy, 0);
+    return status;
+}
+
+void VideoPipeline::decodeLoop()
+{
+    PacketPtr packet;
+    while (m_input.pop(packet)) {
+        account(0, 0, getMonotonicTimeUs() - packet->queuedUs);
+        VideoDecodeBuffer buffer;
+        memset(&buffer, 0, sizeof(buffer));
+        if (!packet->eos) {
+            buffer.data = &packet->data[0];
+            buffer.size = packet->data.size();
+            buffer.timeStamp = packet->timeStamp;
+            buffer.flag = packet->flag;
+        }
+        YamiStatus status = decodeOne(&buffer);
+        if (status < YAMI_SUCCESS)
+            ERROR("pipeline decode failed, status = %d", status);
+        if (!drainDecoder())
+            return;
+        if (packet->eos) {
+            pushFrame(0, SharedPtr<VideoFrame>());
+            return;
+        }
+    }
+}
+
+void* VideoPipeline::processThread(void* arg)
+{
+    Stage* stage = static_cast<Stage*>(arg);
+    stage->owner->processLoop(*stage);
+    return NULL;
+}
+
+SharedPtr<VideoFrame> VideoPipeline::allocFrame(Stage& stage)
+{
+    SharedPtr<VideoFrame> frame;
+    SurfacePtr surface;
+    uint64_t start = getMonotonicTimeUs();
+    while (1) {
+        uint32_t released = m_releases->count();
+        if ((surface = stage.pool->alloc()))
+            break;
+        if (!m_releases->wait(released))
+            return frame;
+    }
+    addBlocked(stage.index, getMonotonicTimeUs() - start);
+
+    frame.reset(new VideoFrame, FrameHolder(m_releases, surface));
+    memset(frame.get(), 0, sizeof(VideoFrame));
+    frame->surface = (intptr_t)surface->getID();
+    frame->crop.x = 0;
+    frame->crop.y = 0;
+    frame->crop.width = stage.width;
+    frame->crop.height = stage.height;
+    frame->fourcc = stage.fourcc;
+    return frame;
+}
+
+void VideoPipeline::processLoop(Stage& stage)
+{
+    FrameQueue& input = *m_queues[stage.index - 1];
+    Item item;
+    while (input.pop(item)) {
+        uint64_t queueUs = getMonotonicTimeUs() - item.queuedUs;
+        //the output size is ours, a new decoder size only changes the source crop
+        if (item.format) {
+            INFO("pipeline post process %d gets %dx%d input", stage.index,
+                item.format->width, item.format->height);
+            continue;
+        }
+        if (!item.frame) {
+            pushFrame(stage.index, item.frame);
+            return;
+        }
+        SharedPtr<VideoFrame> dest = allocFrame(stage);
+        if (!dest)
+            return;
+        dest->timeStamp = item.frame->timeStamp;
+        dest->flags = item.frame->flags;
+
+        uint64_t start = getMonotonicTimeUs();
+        YamiStatus status = stage.vpp->process(item.frame, dest);
+        account(stage.index, getMonotonicTimeUs() - start, queueUs);
+        //the stage keeps the frame, nothing to pass on yet
+        if (status == YAMI_MORE_DATA)
+            continue;
+        if (status != YAMI_SUCCESS) {
+            ERROR("pipeline post process %d failed, status = %d", stage.index, status);
+            continue;
+        }
+        if (!pushFrame(stage.index, dest))
+            return;
+    }
+}
+
+bool VideoPipeline::resizeEncoder(const VideoFormatInfo& format)
+{
+    VideoParamsCommon common;
+    common.size = sizeof(common);
+    if (m_encoder->getParameters(VideoParamsTypeCommon, &common) != YAMI_SUCCESS)
+        return false;
+    if (common.resolution.width == format.width && common.resolution.height == format.height)
+        return true;
+    INFO("pipeline encoder restarts at %dx%d", format.width, format.height);
+
+    //getOutput() hands out what was coded at the old size first, a call
+    //that saw the old m_encodeCount may have missed the flushed frames
+    YamiStatus status = m_encoder->encode(SharedPtr<VideoFrame>());
+    {
+        AutoLock l(m_lock);
+        m_draining = true;
+        m_drained = false;
+        m_encodeCount++;
+        m_cond.broadcast();
+        while (!m_quit && status == YAMI_SUCCESS && !m_drained)
+            m_cond.wait();
+        m_draining = false;
+        if (m_quit || status != YAMI_SUCCESS)
+            return false;
+    }
+
+    AutoLock l(m_encoderLock);
+    m_encoder->stop();
+    common.resolution.width = format.width;
+    common.resolution.height = format.height;
+    status = m_encoder->setParameters(VideoParamsTypeCommon, &common);
+    if (status == YAMI_SUCCESS)
+        status = m_encoder->start();
+    return status == YAMI_SUCCESS;
+}
+
+void* VideoPipeline::encodeThread(void* arg)
+{
+    VideoPipeline* pipeline = static_cast<VideoPipeline*>(arg);
+    pipeline->encodeLoop();
+    return NULL;
+}
+
+void VideoPipeline::encodeLoop()
+{
+    uint32_t index = m_vpps.size() + 1;
+    FrameQueue& input = *m_queues.back();
+    Item item;
+    while (input.pop(item)) {
+        uint64_t queueUs = getMonotonicTimeUs() - item.queuedUs;
+        if (item.format) {
+            if (!resizeEncoder(*item.format)) {
+                ERROR("pipeline failed to restart the encoder at %dx%d",
+                    item.format->width, item.format->height);
+                //the stages in front stop at their next push
+                input.close();
+                break;
+            }
+            continue;
+        }
+        uint64_t busy = 0;
+        YamiStatus status;
+        while (1) {
+            uint32_t count;
+            {
+                AutoLock l(m_lock);
+                count = m_outputCount;
+            }
+            uint64_t start = getMonotonicTimeUs();
+            status = m_encoder->encode(item.frame);
+            uint64_t end = getMonotonicTimeUs();
+            busy += end - start;
+            if (status != YAMI_ENCODE_IS_BUSY)
+                break;
+            //output queue is full, wait for getOutput()
+            AutoLock l(m_lock);
+            while (!m_quit && count == m_outputCount)
+                m_cond.wait();
+            m_stats[index].blockedUs += getMonotonicTimeUs() - end;
+            if (m_quit)
+                return;
+        }
+        account(index, busy, queueUs);
+        if (status != YAMI_SUCCESS)
+            ERROR("pipeline encode failed, status = %d", status);
+
+        AutoLock l(m_lock);
+        if (item.frame && status == YAMI_SUCCESS)
+            m_stats[index].frames++;
+        m_encodeCount++;
+        m_cond.broadcast();
+        if (!item.frame)
+            break;
+    }
+    setDone();
+}
+}
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef videopipeline_h
+#define videopipeline_h
+
+#include "interface/VideoPipelineInterface.h"
+#include "common/boundedqueue.h"
+#include "common/condition.h"
+#include "common/lock.h"
+#include "vaapi/vaapiptrs.h"
+
+#include <vector>
+#include <pthread.h>
+
+namespace YamiMediaCodec{
+
+class SurfacePool;
+
+/*
+ * Runs decoder, post process stages and encoder on one thread each. Decoded
+ * surfaces are handed on as VideoFrames without copies; a stage that can not
+ * push to the next queue, or gets no surface from its pool, waits and counts
+ * the time as blocked, so the statistics show which stage limits throughput.
+ * A stage out of surfaces sleeps until a frame it handed on is released.
+ * When the decoder changes format, the frames behind it carry the new size;
+ * post process stages scale each frame from its own crop, and an encoder
+ * right behind the decoder is drained and restarted at the new size.
+ */
+class VideoPipeline : public IVideoPipeline {
+public:
+    VideoPipeline(IVideoDecoder* decoder, IVideoEncoder* encoder, uint32_t queueSize);
+    virtual ~VideoPipeline();
+
+    bool init(const NativeDisplay* display);
+
+    virtual YamiStatus addPostProcess(IVideoPostProcess* vpp, uint32_t fourcc, uint32_t width, uint32_t height);
+    virtual YamiStatus start(VideoConfigBuffer* config);
+    virtual void stop();
+    virtual YamiStatus decode(VideoDecodeBuffer* buffer);
+    virtual YamiStatus getOutput(VideoEncOutputBuffer* outBuffer, bool withWait = false);
+    virtual YamiStatus getStatistics(VideoPipelineStats* stats);
+
+private:
+    struct Packet {
+        std::vector<uint8_t> data;
+        int64_t timeStamp;
+        uint32_t flag;
+        //no more input after this one
+        bool eos;
+        uint64_t queuedUs;
+    };
+    typedef SharedPtr<Packet> PacketPtr;
+
+    //a null frame announces a new decoder format when it has one,
+    //else it marks the end of stream
+    struct Item {
+        SharedPtr<VideoFrame> frame;
+        SharedPtr<VideoFormatInfo> format;
+        uint64_t queuedUs;
+    };
+    typedef BoundedQueue<Item> FrameQueue;
+    typedef SharedPtr<FrameQueue> FrameQueuePtr;
+
+    struct Stage {
+        VideoPipeline* owner;
+        uint32_t index;
+        IVideoPostProcess* vpp;
+        uint32_t fourcc;
+        uint32_t width;
+        uint32_t height;
+        SharedPtr<SurfacePool> pool;
+        pthread_t thread;
+        bool started;
+    };
+    typedef SharedPtr<Stage> StagePtr;
+
+    class FrameReleases;
+    struct FrameHolder;
+
+    static void* decodeThread(void*);
+    static void* processThread(void*);
+    static void* encodeThread(void*);
+    void decodeLoop();
+    void processLoop(Stage&);
+    void encodeLoop();
+
+    YamiStatus decodeOne(VideoDecodeBuffer*);
+    bool drainDecoder();
+    bool pushFrame(uint32_t stage, const SharedPtr<VideoFrame>&);
+    bool pushFormat(uint32_t stage, const VideoFormatInfo&);
+    bool pushItem(uint32_t stage, Item&);
+    SharedPtr<VideoFrame> allocFrame(Stage&);
+    bool resizeEncoder(const VideoFormatInfo&);
+    void account(uint32_t stage, uint64_t busyUs, uint64_t queueUs);
+    void addBlocked(uint32_t stage, uint64_t us);
+    void setDone();
+    bool startThread(pthread_t&, void* (*)(void*), void*);
+
+    IVideoDecoder* m_decoder;
+    IVideoEncoder* m_encoder;
+    uint32_t m_queueSize;
+    DisplayPtr m_display;
+    NativeDisplay m_nativeDisplay;
+    std::vector<StagePtr> m_vpps;
+
+    BoundedQueue<PacketPtr> m_input;
+    //m_queues[i] is in front of stage i + 1, the last one feeds the encoder,
+    //set up by start() and torn down by stop() under m_lock
+    std::vector<FrameQueuePtr> m_queues;
+    //frames handed to the next stage report here when they are released
+    SharedPtr<FrameReleases> m_releases;
+
+    pthread_t m_decodeThread;
+    pthread_t m_encodeThread;
+    bool m_decodeStarted;
+    bool m_started;
+
+    Lock m_lock;
+    Condition m_cond;
+    std::vector<VideoPipelineStageStats> m_stats;
+    //bumped after every encode(), getOutput() waits on it
+    uint32_t m_encodeCount;
+    //bumped after every output handed out, a busy encoder waits on it
+    uint32_t m_outputCount;
+    //the encoder got the end of stream for a resize, getOutput() sets
+    //m_drained once it handed out the rest
+    bool m_draining;
+    bool m_drained;
+    //getOutput() against the encoder restart of a resize
+    Lock m_encoderLock;
+    bool m_eos;
+    bool m_done;
+    bool m_quit;
+
+    DISALLOW_COPY_AND_ASSIGN(VideoPipeline);
+};
+}
+#endif /* videopipeline_h */
@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "common/log.h"
+#include "interface/VideoPipelineHost.h"
+#include "videoladder.h"
+#include "videopipeline.h"
+
+using namespace YamiMediaCodec;
+
+extern "C" {
+
+IVideoPipeline* createVideoPipeline(IVideoDecoder* decoder, IVideoEncoder* encoder,
+    const NativeDisplay* display, uint32_t queueSize)
+{
+    yamiTraceInit();
+
+    VideoPipeline* pipeline = new VideoPipeline(decoder, encoder, queueSize);
+    if (!pipeline->init(display)) {
+        ERROR("Failed to create video pipeline");
+        delete pipeline;
+        return NULL;
+    }
+    INFO("Created video pipeline, queue size %d", queueSize);
+    return pipeline;
+}
+
+void releaseVideoPipeline(IVideoPipeline* p)
+{
+    delete p;
+}
+
+IVideoLadder* createVideoLadder(const NativeDisplay* display)
+{
+    yamiTraceInit();
+
+    VideoLadder* ladder = new VideoLadder();
+    if (!ladder->init(display)) {
+        ERROR("Failed to create video ladder");
+        delete ladder;
+        return NULL;
+    }
+    INFO("Created video ladder");
+    return ladder;
+}
+
+void releaseVideoLadder(IVideoLadder* p)
+{
+    delete p;
+}
+
+} // extern "C"
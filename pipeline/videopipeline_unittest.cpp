@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// library headers
+#include "common/unittest.h"
+
+// primary header
+#include "videopipeline.h"
+
+// system headers
+#include <deque>
+#include <pthread.h>
+#include <string.h>
+#include <vector>
+
+namespace YamiMediaCodec {
+
+//a packet starting with this byte makes the decoder switch to the large size
+const uint8_t FORMAT_CHANGE = 'F';
+const uint32_t SMALL_WIDTH = 176;
+const uint32_t SMALL_HEIGHT = 144;
+const uint32_t LARGE_WIDTH = 352;
+const uint32_t LARGE_HEIGHT = 288;
+
+//a decoder with a few surfaces, a frame gives its surface back when released
+class FakeDecoder : public IVideoDecoder {
+public:
+    explicit FakeDecoder(uint32_t surfaces)
+        : m_free(surfaces)
+    {
+        memset(&m_format, 0, sizeof(m_format));
+        m_format.width = SMALL_WIDTH;
+        m_format.height = SMALL_HEIGHT;
+    }
+
+    YamiStatus start(VideoConfigBuffer*) { return YAMI_SUCCESS; }
+    YamiStatus reset(VideoConfigBuffer*) { return YAMI_SUCCESS; }
+    void stop() {}
+    void flush() {}
+    YamiStatus decode(VideoDecodeBuffer* buffer)
+    {
+        if (!buffer->data || !buffer->size)
+            return YAMI_SUCCESS;
+        if (buffer->data[0] == FORMAT_CHANGE && m_format.width != LARGE_WIDTH) {
+            m_format.width = LARGE_WIDTH;
+            m_format.height = LARGE_HEIGHT;
+            return YAMI_DECODE_FORMAT_CHANGE;
+        }
+        {
+            AutoLock l(m_lock);
+            if (!m_free)
+                return YAMI_DECODE_NO_SURFACE;
+            m_free--;
+        }
+        SharedPtr<VideoFrame> frame(new VideoFrame, Release(this));
+        memset(frame.get(), 0, sizeof(VideoFrame));
+        frame->timeStamp = buffer->timeStamp;
+        frame->crop.width = m_format.width;
+        frame->crop.height = m_format.height;
+        m_output.push_back(frame);
+        return YAMI_SUCCESS;
+    }
+    SharedPtr<VideoFrame> getOutput()
+    {
+        SharedPtr<VideoFrame> frame;
+        if (!m_output.empty()) {
+            frame = m_output.front();
+            m_output.pop_front();
+        }
+        return frame;
+    }
+    YamiStatus setDecodePolicy(VideoDecodePolicy) { return YAMI_SUCCESS; }
+    YamiStatus getFirstDisplayTimeStamp(int64_t*) { return YAMI_UNSUPPORTED; }
+    int getEventFd() { return -1; }
+    YamiStatus setSchedulePriority(uint32_t) { return YAMI_UNSUPPORTED; }
+    YamiStatus getScheduleStats(VideoScheduleStats*) { return YAMI_UNSUPPORTED; }
+    const VideoFormatInfo* getFormatInfo() { return &m_format; }
+    void setNativeDisplay(NativeDisplay*) {}
+    void setAllocator(SurfaceAllocator*) {}
+    void releaseLock(bool) {}
+    VADisplay getDisplayID() { return NULL; }
+
+    uint32_t freeSurfaces()
+    {
+        AutoLock l(m_lock);
+        return m_free;
+    }
+
+private:
+    struct Release {
+        explicit Release(FakeDecoder* decoder)
+            : m_decoder(decoder)
+        {
+        }
+        void operator()(VideoFrame* frame)
+        {
+            delete frame;
+            AutoLock l(m_decoder->m_lock);
+            m_decoder->m_free++;
+        }
+        FakeDecoder* m_decoder;
+    };
+
+    VideoFormatInfo m_format;
+    std::deque<SharedPtr<VideoFrame> > m_output;
+    uint32_t m_free;
+    Lock m_lock;
+};
+
+//codes every frame at once and keeps it until its output is taken
+class FakeEncoder : public IVideoEncoder {
+public:
+    struct Coded {
+        int64_t timeStamp;
+        uint32_t frameWidth;
+        uint32_t encoderWidth;
+    };
+
+    FakeEncoder()
+        : m_starts(0)
+        , m_lost(0)
+    {
+        m_common.size = sizeof(m_common);
+        m_common.resolution.width = SMALL_WIDTH;
+        m_common.resolution.height = SMALL_HEIGHT;
+    }
+
+    void setNativeDisplay(NativeDisplay*) {}
+    YamiStatus start()
+    {
+        AutoLock l(m_lock);
+        m_starts++;
+        return YAMI_SUCCESS;
+    }
+    YamiStatus stop()
+    {
+        AutoLock l(m_lock);
+        m_lost += m_output.size();
+        m_output.clear();
+        return YAMI_SUCCESS;
+    }
+    YamiStatus encode(VideoEncRawBuffer*) { return YAMI_UNSUPPORTED; }
+    YamiStatus encode(VideoFrameRawData*) { return YAMI_UNSUPPORTED; }
+    YamiStatus encode(const SharedPtr<VideoFrame>& frame)
+    {
+        if (!frame)
+            return YAMI_SUCCESS;
+        AutoLock l(m_lock);
+        Coded coded;
+        coded.timeStamp = frame->timeStamp;
+        coded.frameWidth = frame->crop.width;
+        coded.encoderWidth = m_common.resolution.width;
+        m_output.push_back(std::make_pair(coded, frame));
+        return YAMI_SUCCESS;
+    }
+    YamiStatus encodeBatch(const SharedPtr<VideoFrame>*, VideoEncOutputBuffer*, uint32_t)
+    {
+        return YAMI_UNSUPPORTED;
+    }
+#ifndef __BUILD_GET_MV__
+    YamiStatus getOutput(VideoEncOutputBuffer* outBuffer, bool)
+#else
+    YamiStatus getOutput(VideoEncOutputBuffer* outBuffer, VideoEncMVBuffer*, bool)
+#endif
+    {
+        AutoLock l(m_lock);
+        if (m_output.empty())
+            return YAMI_ENCODE_BUFFER_NO_MORE;
+        outBuffer->timeStamp = m_output.front().first.timeStamp;
+        m_coded.push_back(m_output.front().first);
+        m_output.pop_front();
+        return YAMI_SUCCESS;
+    }
+    YamiStatus getParameters(VideoParamConfigType type, Yami_PTR params)
+    {
+        if (type != VideoParamsTypeCommon)
+            return YAMI_UNSUPPORTED;
+        AutoLock l(m_lock);
+        *(VideoParamsCommon*)params = m_common;
+        return YAMI_SUCCESS;
+    }
+    YamiStatus setParameters(VideoParamConfigType type, Yami_PTR params)
+    {
+        if (type != VideoParamsTypeCommon)
+            return YAMI_UNSUPPORTED;
+        AutoLock l(m_lock);
+        m_common = *(VideoParamsCommon*)params;
+        return YAMI_SUCCESS;
+    }
+    YamiStatus getMaxOutSize(uint32_t* maxSize)
+    {
+        *maxSize = 0;
+        return YAMI_SUCCESS;
+    }
+#ifdef __BUILD_GET_MV__
+    YamiStatus getMVBufferSize(uint32_t* size)
+    {
+        *size = 0;
+        return YAMI_SUCCESS;
+    }
+#endif
+    int getEventFd() { return -1; }
+    YamiStatus setSchedulePriority(uint32_t) { return YAMI_UNSUPPORTED; }
+    YamiStatus getScheduleStats(VideoScheduleStats*) { return YAMI_UNSUPPORTED; }
+    YamiStatus getStatistics(VideoStatistics*) { return YAMI_UNSUPPORTED; }
+    void flush() {}
+    YamiStatus getConfig(VideoParamConfigType, Yami_PTR) { return YAMI_UNSUPPORTED; }
+    YamiStatus setConfig(VideoParamConfigType, Yami_PTR) { return YAMI_UNSUPPORTED; }
+
+    //following members are read after the pipeline stopped
+    std::vector<Coded> m_coded;
+    uint32_t m_starts;
+    //outputs nobody took before a stop()
+    uint32_t m_lost;
+
+private:
+    Lock m_lock;
+    VideoParamsCommon m_common;
+    std::deque<std::pair<Coded, SharedPtr<VideoFrame> > > m_output;
+};
+
+class VideoPipelineTest : public ::testing::Test {
+protected:
+    struct Feed {
+        VideoPipeline* pipeline;
+        uint32_t packets;
+        //index of the packet that changes the format, or packets for none
+        uint32_t formatChange;
+    };
+
+    //decode() blocks while the input queue is full, so it gets its own thread
+    static void* feed(void* arg)
+    {
+        Feed* feed = static_cast<Feed*>(arg);
+        for (uint32_t i = 0; i < feed->packets; i++) {
+            uint8_t data = i == feed->formatChange ? FORMAT_CHANGE : 0;
+            VideoDecodeBuffer buffer;
+            memset(&buffer, 0, sizeof(buffer));
+            buffer.data = &data;
+            buffer.size = 1;
+            buffer.timeStamp = i;
+            if (feed->pipeline->decode(&buffer) != YAMI_SUCCESS)
+                return NULL;
+        }
+        feed->pipeline->decode(NULL);
+        return NULL;
+    }
+
+    static std::vector<int64_t> transcode(VideoPipeline& pipeline, uint32_t packets,
+        uint32_t formatChange)
+    {
+        std::vector<int64_t> timeStamps;
+        Feed arg = { &pipeline, packets, formatChange };
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, feed, &arg))
+            return timeStamps;
+        VideoEncOutputBuffer output;
+        while (pipeline.getOutput(&output, true) == YAMI_SUCCESS)
+            timeStamps.push_back(output.timeStamp);
+        pthread_join(thread, NULL);
+        return timeStamps;
+    }
+
+    static VideoPipelineStats statistics(VideoPipeline& pipeline)
+    {
+        VideoPipelineStats stats;
+        memset(&stats, 0, sizeof(stats));
+        stats.size = sizeof(stats);
+        EXPECT_EQ(YAMI_SUCCESS, pipeline.getStatistics(&stats));
+        return stats;
+    }
+};
+
+#define VIDEOPIPELINE_TEST(name) \
+    TEST_F(VideoPipelineTest, name)
+
+VIDEOPIPELINE_TEST(Transcode)
+{
+    //the encoder keeps each frame until its output is taken, so the
+    //decoder runs out of surfaces all the time and has to be woken up
+    FakeDecoder decoder(2);
+    FakeEncoder encoder;
+    VideoPipeline pipeline(&decoder, &encoder, 1);
+    ASSERT_EQ(YAMI_SUCCESS, pipeline.start(NULL));
+
+    const uint32_t PACKETS = 50;
+    std::vector<int64_t> timeStamps = transcode(pipeline, PACKETS, PACKETS);
+    ASSERT_EQ(PACKETS, timeStamps.size());
+    for (uint32_t i = 0; i < PACKETS; i++)
+        EXPECT_EQ(i, timeStamps[i]);
+
+    VideoPipelineStats stats = statistics(pipeline);
+    ASSERT_EQ(2u, stats.numStages);
+    EXPECT_EQ(PACKETS, stats.stages[0].frames);
+    EXPECT_EQ(PACKETS, stats.stages[1].frames);
+    EXPECT_EQ(1u, stats.stages[1].queueSize);
+
+    pipeline.stop();
+    EXPECT_EQ(2u, decoder.freeSurfaces());
+    EXPECT_EQ(1u, encoder.m_starts);
+}
+
+VIDEOPIPELINE_TEST(FormatChange)
+{
+    FakeDecoder decoder(2);
+    FakeEncoder encoder;
+    VideoPipeline pipeline(&decoder, &encoder, 2);
+    ASSERT_EQ(YAMI_SUCCESS, pipeline.start(NULL));
+
+    const uint32_t PACKETS = 20;
+    const uint32_t CHANGE = 8;
+    std::vector<int64_t> timeStamps = transcode(pipeline, PACKETS, CHANGE);
+    pipeline.stop();
+    ASSERT_EQ(PACKETS, timeStamps.size());
+
+    //the encoder restarted once, after every small frame was taken
+    EXPECT_EQ(2u, encoder.m_starts);
+    EXPECT_EQ(0u, encoder.m_lost);
+    ASSERT_EQ(PACKETS, encoder.m_coded.size());
+    for (uint32_t i = 0; i < PACKETS; i++) {
+        const FakeEncoder::Coded& coded = encoder.m_coded[i];
+        EXPECT_EQ(i, coded.timeStamp);
+        EXPECT_EQ(i < CHANGE ? SMALL_WIDTH : LARGE_WIDTH, coded.frameWidth);
+        EXPECT_EQ(coded.frameWidth, coded.encoderWidth);
+    }
+}
+
+VIDEOPIPELINE_TEST(StopWhileOutOfSurfaces)
+{
+    FakeDecoder decoder(2);
+    FakeEncoder encoder;
+    VideoPipeline pipeline(&decoder, &encoder, 1);
+    ASSERT_EQ(YAMI_SUCCESS, pipeline.start(NULL));
+
+    //nobody takes outputs, the decoder waits for a surface after two frames
+    uint8_t data = 0;
+    VideoDecodeBuffer buffer;
+    memset(&buffer, 0, sizeof(buffer));
+    buffer.data = &data;
+    buffer.size = 1;
+    for (int i = 0; i < 3; i++)
+        EXPECT_EQ(YAMI_SUCCESS, pipeline.decode(&buffer));
+    pipeline.stop();
+    EXPECT_EQ(2u, decoder.freeSurfaces());
+}
+
+VIDEOPIPELINE_TEST(Statistics)
+{
+    FakeDecoder decoder(2);
+    FakeEncoder encoder;
+    VideoPipeline pipeline(&decoder, &encoder, 4);
+
+    VideoPipelineStats stats;
+    memset(&stats, 0, sizeof(stats));
+    EXPECT_EQ(YAMI_INVALID_PARAM, pipeline.getStatistics(NULL));
+    EXPECT_EQ(YAMI_INVALID_PARAM, pipeline.getStatistics(&stats));
+
+    ASSERT_EQ(YAMI_SUCCESS, pipeline.start(NULL));
+    stats = statistics(pipeline);
+    EXPECT_EQ(2u, stats.numStages);
+    EXPECT_EQ(4u, stats.stages[0].queueSize);
+    EXPECT_EQ(4u, stats.stages[1].queueSize);
+
+    //the counters stay, the queues are gone
+    pipeline.stop();
+    stats = statistics(pipeline);
+    EXPECT_EQ(0u, stats.stages[1].queued);
+    EXPECT_EQ(0u, stats.stages[1].queueSize);
+}
+}
@@ -23,6 +23,7 @@
 #include "common/log.h"
 #include "common/common_def.h"
 #include "vaapi/vaapidisplay.h"
+#include "vaapi/vaapiresourcecache.h"
 #include "vaapi/VaapiUtils.h"
 #include <algorithm>
 #include <vector>
@@ -89,6 +90,11 @@ ConfigPtr VaapiConfig::create(const DisplayPtr& display,
     VAStatus vaStatus;
     VAConfigID config;
 
+    SharedPtr<VaapiResourceCache> cache = VaapiResourceCache::getInstance();
+    ret = cache->findConfig(display, profile, entry, attribList, numAttribs);
+    if (ret)
+        return ret;
+
     if (!checkProfileCompatible(display, profile)){
         ERROR("Unsupport profile");
         return ret;
@@ -99,7 +105,7 @@ ConfigPtr VaapiConfig::create(const DisplayPtr& display,
     if (!checkVaapiStatus(vaStatus, "vaCreateConfig "))
         return ret;
     ret.reset(new VaapiConfig(display, config));
-    return ret;
+    return cache->addConfig(display, profile, entry, attribList, numAttribs, ret);
 }
 
 VaapiConfig::VaapiConfig(const DisplayPtr& display, VAConfigID config)
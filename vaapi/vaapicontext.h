@@ -20,6 +20,7 @@
 #include "common/NonCopyable.h"
 #include "interface/VideoCommonDefs.h"
 #include "vaapi/vaapiptrs.h"
+#include "vaapi/vaapischeduler.h"
 #include <va/va.h>
 
 namespace YamiMediaCodec{
@@ -46,12 +47,16 @@ public:
                       int num_render_targets);
     VAContextID getID() const { return m_context; }
     DisplayPtr getDisplay() const { return m_config->m_display; }
+    /// pictures of this context submit through @session when it is set
+    void setSession(const ScheduleSessionPtr& session) { m_session = session; }
+    const ScheduleSessionPtr& getSession() const { return m_session; }
 
     ~VaapiContext();
 private:
     VaapiContext(const ConfigPtr&,  VAContextID);
     ConfigPtr m_config;
     VAContextID m_context;
+    ScheduleSessionPtr m_session;
     DISALLOW_COPY_AND_ASSIGN(VaapiContext);
 };
 }
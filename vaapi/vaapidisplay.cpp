@@ -20,6 +20,7 @@
 
 #include "vaapi/vaapidisplay.h"
 #include <stdint.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <list>
@@ -232,6 +233,18 @@ VaapiDisplay::getVaFormat(uint32_t fourcc)
     return NULL;
 }
 
+SharedPtr<VaapiScheduler> VaapiDisplay::getScheduler()
+{
+    AutoLock locker(m_lock);
+    if (!m_schedulerChecked) {
+        m_schedulerChecked = true;
+        const char* workers = getenv("LIBYAMI_SCHEDULER_WORKERS");
+        if (workers && atoi(workers) > 0)
+            m_scheduler = VaapiScheduler::create(atoi(workers));
+    }
+    return m_scheduler;
+}
+
 //display cache
 class DisplayCache
 {
@@ -18,6 +18,7 @@
 #define vaapidisplay_h
 
 #include "vaapi/vaapiptrs.h"
+#include "vaapi/vaapischeduler.h"
 #include <va/va.h>
 #include <va/va_tpi.h>
 #ifdef HAVE_VA_X11
@@ -49,6 +50,8 @@ public:
     virtual bool setRotation(int degree);
     VADisplay getID() const { return m_vaDisplay; }
     const VAImageFormat* getVaFormat(uint32_t fourcc);
+    /// shared by all sessions on this display, NULL unless LIBYAMI_SCHEDULER_WORKERS is set
+    SharedPtr<VaapiScheduler> getScheduler();
 
 protected:
     /// for display cache management.
@@ -56,12 +59,14 @@ protected:
 
 private:
     VaapiDisplay(const NativeDisplayPtr& nativeDisplay, VADisplay vaDisplay)
-    :m_vaDisplay(vaDisplay), m_nativeDisplay(nativeDisplay) { };
+    :m_vaDisplay(vaDisplay), m_nativeDisplay(nativeDisplay), m_schedulerChecked(false) { };
 
     Lock m_lock;
     VADisplay   m_vaDisplay;
     NativeDisplayPtr m_nativeDisplay;
     std::vector<VAImageFormat> m_vaImageFormats;
+    bool m_schedulerChecked;
+    SharedPtr<VaapiScheduler> m_scheduler;
 
 DISALLOW_COPY_AND_ASSIGN(VaapiDisplay);
 };
@@ -26,6 +26,7 @@
 #include "vaapicontext.h"
 #include "VaapiSurface.h"
 #include "VaapiUtils.h"
+#include "vaapischeduler.h"
 
 namespace YamiMediaCodec{
 VaapiPicture::VaapiPicture(const ContextPtr& context,
@@ -43,6 +44,19 @@ VaapiPicture::VaapiPicture()
 {
 }
 
+struct VaapiPicture::RenderJob : public VaapiScheduler::Job {
+    RenderJob(VaapiPicture* picture, const ScheduleSessionPtr& session)
+        : m_picture(picture)
+        , m_owner(session)
+    {
+    }
+    bool run() { return m_picture->doSubmit(); }
+
+    VaapiPicture* m_picture;
+    //keeps the session alive while the job is queued
+    ScheduleSessionPtr m_owner;
+};
+
 bool VaapiPicture::render()
 {
     if (m_surface->getID() == VA_INVALID_SURFACE) {
@@ -50,6 +64,28 @@ bool VaapiPicture::render()
         return false;
     }
 
+    const ScheduleSessionPtr& session = m_context->getSession();
+    if (session) {
+        if (!m_job || m_job->m_owner != session) {
+            wait();
+            m_job.reset(new RenderJob(this, session));
+        }
+        //errors show up in wait()
+        session->submit(*m_job);
+        return true;
+    }
+    return doSubmit();
+}
+
+bool VaapiPicture::wait()
+{
+    if (!m_job)
+        return true;
+    return m_job->m_owner->wait(*m_job);
+}
+
+bool VaapiPicture::doSubmit()
+{
     VAStatus status;
     status = vaBeginPicture(m_display->getID(), m_context->getID(), m_surface->getID());
     if (!checkVaapiStatus(status, "vaBeginPicture()"))
@@ -109,8 +145,10 @@ bool VaapiPicture::addObject(std::vector < BufObjectPtr >& objects,
     return true;
 }
 
+//only submissions go through the scheduler, a worker blocked in
+//vaSyncSurface would hold up the jobs of every other session
 bool VaapiPicture::sync()
 {
-    return vaSyncSurface(m_display->getID(), getSurfaceID()) == VA_STATUS_SUCCESS;
+    return wait() && vaSyncSurface(m_display->getID(), getSurfaceID()) == VA_STATUS_SUCCESS;
 }
 }
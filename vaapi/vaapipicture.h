@@ -53,6 +53,8 @@ public:
     inline VASurfaceID getSurfaceID() const;
     inline SurfacePtr getSurface() const;
     inline void setSurface(const SurfacePtr&);
+    /// wait until the picture went to the driver, false if that failed
+    bool wait();
     bool sync();
 
     int64_t                 m_timeStamp;
@@ -79,6 +81,12 @@ protected:
     inline BufObjectPtr createBufferObject(VABufferType bufType,
         uint32_t size, const void* data, void** mapped);
     VaapiPicture();
+
+private:
+    struct RenderJob;
+    bool doSubmit();
+    //set once render() went through a scheduler
+    SharedPtr<RenderJob> m_job;
 };
 
 template<class T>
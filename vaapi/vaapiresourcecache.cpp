@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "vaapiresourcecache.h"
+
+#include "common/log.h"
+#include "common/utils.h"
+#include "vaapi/vaapicontext.h"
+#include "vaapi/vaapidisplay.h"
+#include "vaapi/VaapiUtils.h"
+
+namespace YamiMediaCodec{
+
+//keeps the cached config alive and tells the cache when the user is done
+struct VaapiResourceCache::ConfigReleaser
+{
+    ConfigReleaser(const SharedPtr<VaapiResourceCache>& cache, ConfigEntry* entry)
+        : m_cache(cache), m_entry(entry), m_config(entry->config) {}
+    void operator()(VaapiConfig*) { m_cache->release(m_entry); }
+private:
+    SharedPtr<VaapiResourceCache> m_cache;
+    ConfigEntry* m_entry;
+    ConfigPtr m_config;
+};
+
+SharedPtr<VaapiResourceCache> VaapiResourceCache::getInstance()
+{
+    static SharedPtr<VaapiResourceCache> cache(new VaapiResourceCache);
+    return cache;
+}
+
+VaapiResourceCache::VaapiResourceCache()
+    : m_ttlUs(0)
+{
+}
+
+VaapiResourceCache::~VaapiResourceCache()
+{
+    destroy(m_surfaces);
+}
+
+void VaapiResourceCache::destroy(SurfaceList& list)
+{
+    for (SurfaceList::iterator it = list.begin(); it != list.end(); ++it) {
+        std::vector<VASurfaceID>& surfaces = it->surfaces;
+        checkVaapiStatus(vaDestroySurfaces(it->display->getID(), &surfaces[0], surfaces.size()),
+            "vaDestroySurfaces");
+    }
+    list.clear();
+}
+
+void VaapiResourceCache::purgeLocked(SurfaceList& expired)
+{
+    uint64_t now = getMonotonicTimeUs();
+    for (ConfigList::iterator it = m_configs.begin(); it != m_configs.end();) {
+        if (!it->users && now - it->releasedUs >= m_ttlUs)
+            it = m_configs.erase(it);
+        else
+            ++it;
+    }
+    for (SurfaceList::iterator it = m_surfaces.begin(); it != m_surfaces.end();) {
+        if (now - it->releasedUs >= m_ttlUs)
+            expired.splice(expired.end(), m_surfaces, it++);
+        else
+            ++it;
+    }
+}
+
+void VaapiResourceCache::purge()
+{
+    SurfaceList expired;
+    {
+        AutoLock lock(m_lock);
+        purgeLocked(expired);
+    }
+    destroy(expired);
+}
+
+void VaapiResourceCache::setTtl(uint32_t ms)
+{
+    {
+        AutoLock lock(m_lock);
+        m_ttlUs = (uint64_t)ms * 1000;
+    }
+    INFO("resource cache ttl %d ms", ms);
+    purge();
+}
+
+bool VaapiResourceCache::enabled()
+{
+    AutoLock lock(m_lock);
+    return m_ttlUs;
+}
+
+static bool sameAttribs(const std::vector<std::pair<int, uint32_t> >& attribs,
+    const VAConfigAttrib* attribList, int numAttribs)
+{
+    if (attribs.size() != (size_t)numAttribs)
+        return false;
+    for (int i = 0; i < numAttribs; i++) {
+        if (attribs[i].first != attribList[i].type || attribs[i].second != attribList[i].value)
+            return false;
+    }
+    return true;
+}
+
+ConfigPtr VaapiResourceCache::handOut(ConfigEntry& entry)
+{
+    entry.users++;
+    return ConfigPtr(entry.config.get(), ConfigReleaser(getInstance(), &entry));
+}
+
+void VaapiResourceCache::release(ConfigEntry* entry)
+{
+    AutoLock lock(m_lock);
+    entry->users--;
+    entry->releasedUs = getMonotonicTimeUs();
+}
+
+ConfigPtr VaapiResourceCache::findConfig(const DisplayPtr& display, VAProfile profile,
+    VAEntrypoint entrypoint, const VAConfigAttrib* attribList, int numAttribs)
+{
+    ConfigPtr config;
+    SurfaceList expired;
+    {
+        AutoLock lock(m_lock);
+        purgeLocked(expired);
+        for (ConfigList::iterator it = m_configs.begin(); it != m_configs.end(); ++it) {
+            if (it->display == display->getID() && it->profile == profile
+                && it->entrypoint == entrypoint
+                && sameAttribs(it->attribs, attribList, numAttribs)) {
+                config = handOut(*it);
+                break;
+            }
+        }
+    }
+    destroy(expired);
+    return config;
+}
+
+ConfigPtr VaapiResourceCache::addConfig(const DisplayPtr& display, VAProfile profile,
+    VAEntrypoint entrypoint, const VAConfigAttrib* attribList, int numAttribs,
+    const ConfigPtr& config)
+{
+    AutoLock lock(m_lock);
+    if (!m_ttlUs)
+        return config;
+    m_configs.push_back(ConfigEntry());
+    ConfigEntry& entry = m_configs.back();
+    entry.display = display->getID();
+    entry.profile = profile;
+    entry.entrypoint = entrypoint;
+    for (int i = 0; i < numAttribs; i++)
+        entry.attribs.push_back(std::make_pair((int)attribList[i].type, attribList[i].value));
+    entry.config = config;
+    entry.users = 0;
+    entry.releasedUs = 0;
+    return handOut(entry);
+}
+
+bool VaapiResourceCache::takeSurfaces(const DisplayPtr& display, uint32_t fourcc,
+    uint32_t width, uint32_t height, uint32_t size, std::vector<VASurfaceID>& surfaces)
+{
+    if (!size)
+        return false;
+    SurfaceList expired;
+    bool found = false;
+    {
+        AutoLock lock(m_lock);
+        purgeLocked(expired);
+        SurfaceList::iterator best = m_surfaces.end();
+        for (SurfaceList::iterator it = m_surfaces.begin(); it != m_surfaces.end(); ++it) {
+            if (it->display->getID() != display->getID() || it->fourcc != fourcc
+                || it->width != width || it->height != height || it->surfaces.size() < size)
+                continue;
+            if (best == m_surfaces.end() || it->surfaces.size() < best->surfaces.size())
+                best = it;
+        }
+        if (best != m_surfaces.end()) {
+            //a stream asking for a few must not walk off with a big set
+            std::vector<VASurfaceID>& cached = best->surfaces;
+            surfaces.assign(cached.begin(), cached.begin() + size);
+            cached.erase(cached.begin(), cached.begin() + size);
+            if (cached.empty())
+                m_surfaces.erase(best);
+            found = true;
+        }
+    }
+    destroy(expired);
+    if (found) {
+        DEBUG("reuse %d cached surfaces of %dx%d", (int)surfaces.size(), width, height);
+    }
+    return found;
+}
+
+bool VaapiResourceCache::putSurfaces(const DisplayPtr& display, uint32_t fourcc,
+    uint32_t width, uint32_t height, const std::vector<VASurfaceID>& surfaces)
+{
+    SurfaceList expired;
+    {
+        AutoLock lock(m_lock);
+        if (!m_ttlUs || surfaces.empty())
+            return false;
+        purgeLocked(expired);
+        m_surfaces.push_back(SurfaceEntry());
+        SurfaceEntry& entry = m_surfaces.back();
+        entry.display = display;
+        entry.fourcc = fourcc;
+        entry.width = width;
+        entry.height = height;
+        entry.surfaces = surfaces;
+        entry.releasedUs = getMonotonicTimeUs();
+    }
+    destroy(expired);
+    return true;
+}
+}
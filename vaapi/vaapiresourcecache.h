@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef vaapiresourcecache_h
+#define vaapiresourcecache_h
+
+#include "common/lock.h"
+#include "vaapi/vaapiptrs.h"
+#include <va/va.h>
+#include <list>
+#include <utility>
+#include <vector>
+
+namespace YamiMediaCodec{
+
+/*
+ * Keeps VA configs and surface sets of stopped decoders and encoders alive
+ * for a while, a stream of the same shape started within the TTL gets them
+ * without asking the driver. The TTL is 0 by default, which disables it.
+ * Expired entries are released on the next access, like the display cache.
+ */
+class VaapiResourceCache
+{
+public:
+    static SharedPtr<VaapiResourceCache> getInstance();
+    ~VaapiResourceCache();
+
+    /// 0 releases everything unused and stops caching
+    void setTtl(uint32_t ms);
+    bool enabled();
+
+    /// a config created with the same arguments before, or a null pointer
+    ConfigPtr findConfig(const DisplayPtr&, VAProfile, VAEntrypoint,
+        const VAConfigAttrib* attribList, int numAttribs);
+    /// start caching @config, returns what the caller should hand out
+    ConfigPtr addConfig(const DisplayPtr&, VAProfile, VAEntrypoint,
+        const VAConfigAttrib* attribList, int numAttribs, const ConfigPtr& config);
+
+    /// @size surfaces out of the smallest cached set with enough of them in this
+    /// format and size, the rest of the set stays cached
+    bool takeSurfaces(const DisplayPtr&, uint32_t fourcc, uint32_t width, uint32_t height,
+        uint32_t size, std::vector<VASurfaceID>& surfaces);
+    /// false if caching is off, the caller destroys @surfaces then
+    bool putSurfaces(const DisplayPtr&, uint32_t fourcc, uint32_t width, uint32_t height,
+        const std::vector<VASurfaceID>& surfaces);
+
+private:
+    friend class VaapiResourceCacheTest;
+    typedef std::vector<std::pair<int, uint32_t> > Attribs;
+    struct ConfigEntry {
+        VADisplay display;
+        VAProfile profile;
+        VAEntrypoint entrypoint;
+        Attribs attribs;
+        ConfigPtr config;
+        //configs handed out and not released yet
+        uint32_t users;
+        uint64_t releasedUs;
+    };
+    struct SurfaceEntry {
+        DisplayPtr display;
+        uint32_t fourcc;
+        uint32_t width;
+        uint32_t height;
+        std::vector<VASurfaceID> surfaces;
+        uint64_t releasedUs;
+    };
+    struct ConfigReleaser;
+    typedef std::list<ConfigEntry> ConfigList;
+    typedef std::list<SurfaceEntry> SurfaceList;
+
+    VaapiResourceCache();
+    //caller holds m_lock, expired surfaces are moved to @expired
+    void purgeLocked(SurfaceList& expired);
+    void purge();
+    void release(ConfigEntry*);
+    ConfigPtr handOut(ConfigEntry&);
+    static void destroy(SurfaceList&);
+
+    Lock m_lock;
+    uint64_t m_ttlUs;
+    ConfigList m_configs;
+    SurfaceList m_surfaces;
+
+    DISALLOW_COPY_AND_ASSIGN(VaapiResourceCache);
+};
+}
+#endif
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// the unittest header must be included before va_x11.h, see vaapidisplay_unittest.cpp
+#include "common/unittest.h"
+
+// primary header
+#include "vaapiresourcecache.h"
+
+#include "vaapi/vaapidisplay.h"
+
+// system headers
+#include <unistd.h>
+
+namespace YamiMediaCodec {
+
+const uint32_t WIDTH = 320;
+const uint32_t HEIGHT = 240;
+const uint32_t TTL_MS = 10;
+
+class VaapiResourceCacheTest : public ::testing::Test {
+protected:
+    VaapiResourceCacheTest()
+        : m_cache(VaapiResourceCache::getInstance())
+        , m_released(0)
+    {
+    }
+
+    virtual void SetUp()
+    {
+        NativeDisplay native = { 0, NATIVE_DISPLAY_DRM };
+        m_display = VaapiDisplay::create(native);
+        m_cache->setTtl(1000);
+    }
+
+    virtual void TearDown()
+    {
+        //drops everything the test left unused
+        m_cache->setTtl(0);
+    }
+
+    //the cache never looks into a config, any distinct pointer will do
+    struct CountRelease {
+        explicit CountRelease(int* released)
+            : m_released(released)
+        {
+        }
+        void operator()(VaapiConfig*) { (*m_released)++; }
+        int* m_released;
+    };
+
+    ConfigPtr fakeConfig(uintptr_t tag)
+    {
+        return ConfigPtr(reinterpret_cast<VaapiConfig*>(tag), CountRelease(&m_released));
+    }
+
+    ConfigPtr addConfig(const ConfigPtr& config, VAEntrypoint entrypoint,
+        const VAConfigAttrib* attribs = NULL, int numAttribs = 0)
+    {
+        return m_cache->addConfig(m_display, VAProfileNone, entrypoint, attribs, numAttribs, config);
+    }
+
+    ConfigPtr findConfig(VAEntrypoint entrypoint, const VAConfigAttrib* attribs = NULL,
+        int numAttribs = 0)
+    {
+        return m_cache->findConfig(m_display, VAProfileNone, entrypoint, attribs, numAttribs);
+    }
+
+    std::vector<VASurfaceID> createSurfaces(uint32_t size)
+    {
+        std::vector<VASurfaceID> surfaces(size, VA_INVALID_SURFACE);
+        EXPECT_EQ(VA_STATUS_SUCCESS, vaCreateSurfaces(m_display->getID(), VA_RT_FORMAT_YUV420,
+                                         WIDTH, HEIGHT, &surfaces[0], size, NULL, 0));
+        return surfaces;
+    }
+
+    void destroySurfaces(std::vector<VASurfaceID>& surfaces)
+    {
+        if (!surfaces.empty())
+            vaDestroySurfaces(m_display->getID(), &surfaces[0], surfaces.size());
+        surfaces.clear();
+    }
+
+    bool putSurfaces(const std::vector<VASurfaceID>& surfaces)
+    {
+        return m_cache->putSurfaces(m_display, VA_FOURCC_NV12, WIDTH, HEIGHT, surfaces);
+    }
+
+    bool takeSurfaces(uint32_t size, std::vector<VASurfaceID>& surfaces)
+    {
+        return m_cache->takeSurfaces(m_display, VA_FOURCC_NV12, WIDTH, HEIGHT, size, surfaces);
+    }
+
+    size_t cachedSets()
+    {
+        AutoLock lock(m_cache->m_lock);
+        return m_cache->m_surfaces.size();
+    }
+
+    static void expire()
+    {
+        usleep(TTL_MS * 2 * 1000);
+    }
+
+    SharedPtr<VaapiResourceCache> m_cache;
+    DisplayPtr m_display;
+    //fake configs the cache let go of
+    int m_released;
+};
+
+#define VAAPIRESOURCECACHE_TEST(name) \
+    TEST_F(VaapiResourceCacheTest, name)
+
+VAAPIRESOURCECACHE_TEST(ConfigHitAndMiss)
+{
+    ASSERT_TRUE(bool(m_display));
+    VAConfigAttrib attrib;
+    attrib.type = VAConfigAttribRTFormat;
+    attrib.value = VA_RT_FORMAT_YUV420;
+
+    EXPECT_FALSE(bool(findConfig(VAEntrypointVLD, &attrib, 1)));
+    ConfigPtr config = addConfig(fakeConfig(1), VAEntrypointVLD, &attrib, 1);
+    ASSERT_TRUE(bool(config));
+
+    ConfigPtr hit = findConfig(VAEntrypointVLD, &attrib, 1);
+    EXPECT_EQ(config.get(), hit.get());
+
+    //every argument is part of the key
+    EXPECT_FALSE(bool(findConfig(VAEntrypointVLD)));
+    EXPECT_FALSE(bool(findConfig(VAEntrypointEncSlice, &attrib, 1)));
+    attrib.value = VA_RT_FORMAT_YUV420 << 1;
+    EXPECT_FALSE(bool(findConfig(VAEntrypointVLD, &attrib, 1)));
+}
+
+VAAPIRESOURCECACHE_TEST(ConfigNotCachedWithoutTtl)
+{
+    ASSERT_TRUE(bool(m_display));
+    m_cache->setTtl(0);
+
+    ConfigPtr original = fakeConfig(1);
+    ConfigPtr config = addConfig(original, VAEntrypointVLD);
+    EXPECT_EQ(original.get(), config.get());
+    EXPECT_FALSE(bool(findConfig(VAEntrypointVLD)));
+}
+
+VAAPIRESOURCECACHE_TEST(ConfigRefcount)
+{
+    ASSERT_TRUE(bool(m_display));
+    m_cache->setTtl(TTL_MS);
+
+    ConfigPtr first = addConfig(fakeConfig(1), VAEntrypointVLD);
+    ConfigPtr second = findConfig(VAEntrypointVLD);
+    ASSERT_TRUE(bool(second));
+
+    //in use, the ttl does not count yet
+    first.reset();
+    expire();
+    ConfigPtr third = findConfig(VAEntrypointVLD);
+    ASSERT_TRUE(bool(third));
+    EXPECT_EQ(second.get(), third.get());
+
+    //the last user is gone, the ttl starts then
+    second.reset();
+    third.reset();
+    EXPECT_EQ(0, m_released);
+    expire();
+    EXPECT_FALSE(bool(findConfig(VAEntrypointVLD)));
+    EXPECT_EQ(1, m_released);
+}
+
+VAAPIRESOURCECACHE_TEST(SurfacesBestFit)
+{
+    ASSERT_TRUE(bool(m_display));
+    std::vector<VASurfaceID> four = createSurfaces(4);
+    std::vector<VASurfaceID> eight = createSurfaces(8);
+    std::vector<VASurfaceID> six = createSurfaces(6);
+    ASSERT_TRUE(putSurfaces(four));
+    ASSERT_TRUE(putSurfaces(eight));
+    ASSERT_TRUE(putSurfaces(six));
+
+    //the smallest set that is large enough
+    std::vector<VASurfaceID> surfaces;
+    ASSERT_TRUE(takeSurfaces(5, surfaces));
+    EXPECT_EQ(std::vector<VASurfaceID>(six.begin(), six.begin() + 5), surfaces);
+    destroySurfaces(surfaces);
+
+    ASSERT_TRUE(takeSurfaces(4, surfaces));
+    EXPECT_EQ(four, surfaces);
+    destroySurfaces(surfaces);
+
+    EXPECT_FALSE(takeSurfaces(9, surfaces));
+    EXPECT_TRUE(surfaces.empty());
+}
+
+VAAPIRESOURCECACHE_TEST(SurfacesOtherFormat)
+{
+    ASSERT_TRUE(bool(m_display));
+    ASSERT_TRUE(putSurfaces(createSurfaces(4)));
+
+    std::vector<VASurfaceID> surfaces;
+    EXPECT_FALSE(m_cache->takeSurfaces(m_display, VA_FOURCC_YV12, WIDTH, HEIGHT, 4, surfaces));
+    EXPECT_FALSE(m_cache->takeSurfaces(m_display, VA_FOURCC_NV12, WIDTH * 2, HEIGHT, 4, surfaces));
+    EXPECT_FALSE(m_cache->takeSurfaces(m_display, VA_FOURCC_NV12, WIDTH, HEIGHT * 2, 4, surfaces));
+    EXPECT_EQ(1u, cachedSets());
+}
+
+VAAPIRESOURCECACHE_TEST(SurfacesCapped)
+{
+    ASSERT_TRUE(bool(m_display));
+    std::vector<VASurfaceID> big = createSurfaces(16);
+    ASSERT_TRUE(putSurfaces(big));
+
+    //a small stream gets what it asked for, the rest stays for the next one
+    std::vector<VASurfaceID> small;
+    ASSERT_TRUE(takeSurfaces(4, small));
+    EXPECT_EQ(4u, small.size());
+    EXPECT_EQ(1u, cachedSets());
+
+    std::vector<VASurfaceID> rest;
+    ASSERT_TRUE(takeSurfaces(12, rest));
+    EXPECT_EQ(std::vector<VASurfaceID>(big.begin() + 4, big.end()), rest);
+    EXPECT_EQ(0u, cachedSets());
+    destroySurfaces(small);
+    destroySurfaces(rest);
+}
+
+VAAPIRESOURCECACHE_TEST(SurfacesExpire)
+{
+    ASSERT_TRUE(bool(m_display));
+    m_cache->setTtl(TTL_MS);
+    ASSERT_TRUE(putSurfaces(createSurfaces(4)));
+    EXPECT_EQ(1u, cachedSets());
+
+    expire();
+    std::vector<VASurfaceID> surfaces;
+    EXPECT_FALSE(takeSurfaces(4, surfaces));
+    EXPECT_EQ(0u, cachedSets());
+}
+
+VAAPIRESOURCECACHE_TEST(SurfacesNotCachedWithoutTtl)
+{
+    ASSERT_TRUE(bool(m_display));
+    m_cache->setTtl(0);
+    std::vector<VASurfaceID> surfaces = createSurfaces(4);
+    EXPECT_FALSE(putSurfaces(surfaces));
+    destroySurfaces(surfaces);
+    EXPECT_EQ(0u, cachedSets());
+}
+}
@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "vaapischeduler.h"
+
+#include "common/log.h"
+#include "common/utils.h"
+#include "vaapi/vaapidisplay.h"
+#include <string.h>
+
+namespace YamiMediaCodec{
+
+//jobs a worker runs back to back before it looks at the queues again
+const size_t BATCH_SIZE = 8;
+
+SharedPtr<VaapiScheduler> VaapiScheduler::create(uint32_t workers)
+{
+    SharedPtr<VaapiScheduler> scheduler(new VaapiScheduler);
+    if (!scheduler->start(workers))
+        scheduler.reset();
+    return scheduler;
+}
+
+VaapiScheduler::VaapiScheduler()
+    : m_cond(m_lock)
+    , m_done(m_lock)
+    , m_quit(false)
+{
+    m_next = m_sessions.end();
+}
+
+VaapiScheduler::~VaapiScheduler()
+{
+    {
+        AutoLock lock(m_lock);
+        m_quit = true;
+        m_cond.broadcast();
+    }
+    for (size_t i = 0; i < m_threads.size(); i++)
+        pthread_join(m_threads[i], NULL);
+}
+
+bool VaapiScheduler::start(uint32_t workers)
+{
+    if (!workers)
+        return false;
+    for (uint32_t i = 0; i < workers; i++) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, workerThread, this)) {
+            ERROR("create scheduler worker failed");
+            break;
+        }
+        m_threads.push_back(thread);
+    }
+    INFO("scheduler started with %d workers", (int)m_threads.size());
+    return !m_threads.empty();
+}
+
+ScheduleSessionPtr VaapiScheduler::createSession()
+{
+    ScheduleSessionPtr session(new VaapiScheduleSession(shared_from_this()));
+    AutoLock lock(m_lock);
+    m_sessions.push_back(session.get());
+    return session;
+}
+
+void VaapiScheduler::removeSession(VaapiScheduleSession* session)
+{
+    AutoLock lock(m_lock);
+    if (m_next != m_sessions.end() && *m_next == session)
+        ++m_next;
+    m_sessions.remove(session);
+}
+
+void VaapiScheduler::bindSession(ScheduleSessionPtr& session, const DisplayPtr& display, uint32_t priority)
+{
+    SharedPtr<VaapiScheduler> scheduler = display->getScheduler();
+    if (!scheduler) {
+        session.reset();
+        return;
+    }
+    if (session && session->m_scheduler == scheduler)
+        return;
+    session = scheduler->createSession();
+    session->setPriority(priority);
+}
+
+void* VaapiScheduler::workerThread(void* arg)
+{
+    static_cast<VaapiScheduler*>(arg)->workerLoop();
+    return NULL;
+}
+
+bool VaapiScheduler::takeBatch(std::vector<Job*>& batch, std::vector<VaapiScheduleSession*>& sessions)
+{
+    batch.clear();
+    sessions.clear();
+    //the second pass starts a new round if every waiting session used its credits
+    for (int pass = 0; pass < 2; pass++) {
+        bool waiting = false;
+        for (size_t i = 0; i < m_sessions.size() && batch.size() < BATCH_SIZE; i++) {
+            if (m_next == m_sessions.end())
+                m_next = m_sessions.begin();
+            VaapiScheduleSession* session = *m_next++;
+            //another worker has its earlier jobs
+            if (session->m_jobs.empty() || session->m_busy)
+                continue;
+            if (!session->m_credits) {
+                waiting = true;
+                continue;
+            }
+            session->m_busy = true;
+            sessions.push_back(session);
+            while (session->m_credits && !session->m_jobs.empty() && batch.size() < BATCH_SIZE) {
+                session->m_credits--;
+                Job* job = session->m_jobs.front();
+                session->m_jobs.pop_front();
+                uint64_t queued = getMonotonicTimeUs() - job->m_queuedUs;
+                VideoScheduleStats& stats = session->m_stats;
+                stats.jobs++;
+                stats.totalQueueUs += queued;
+                if (queued > stats.maxQueueUs)
+                    stats.maxQueueUs = queued;
+                batch.push_back(job);
+            }
+        }
+        if (!batch.empty() || !waiting)
+            break;
+        for (Sessions::iterator it = m_sessions.begin(); it != m_sessions.end(); ++it)
+            (*it)->m_credits = (*it)->m_priority;
+    }
+    return !batch.empty();
+}
+
+void VaapiScheduler::finishBatch(const std::vector<VaapiScheduleSession*>& sessions)
+{
+    for (size_t i = 0; i < sessions.size(); i++)
+        sessions[i]->m_busy = false;
+    //their next jobs may go to any worker now
+    m_cond.broadcast();
+    m_done.broadcast();
+}
+
+void VaapiScheduler::workerLoop()
+{
+    std::vector<Job*> batch;
+    std::vector<VaapiScheduleSession*> sessions;
+    while (1) {
+        {
+            AutoLock lock(m_lock);
+            while (!m_quit && !takeBatch(batch, sessions))
+                m_cond.wait();
+            if (m_quit)
+                return;
+        }
+        for (size_t i = 0; i < batch.size(); i++) {
+            Job* job = batch[i];
+            bool result = job->run();
+            //the owner may free the job once it is no longer pending
+            AutoLock lock(m_lock);
+            job->m_result = result;
+            job->m_pending = false;
+            m_done.broadcast();
+        }
+        AutoLock lock(m_lock);
+        finishBatch(sessions);
+    }
+}
+
+void VaapiScheduler::submit(VaapiScheduleSession* session, Job& job)
+{
+    AutoLock lock(m_lock);
+    while (job.m_pending)
+        m_done.wait();
+    job.m_session = session;
+    job.m_pending = true;
+    job.m_queuedUs = getMonotonicTimeUs();
+    session->m_jobs.push_back(&job);
+    m_cond.signal();
+}
+
+bool VaapiScheduler::wait(Job& job)
+{
+    AutoLock lock(m_lock);
+    while (job.m_pending)
+        m_done.wait();
+    return job.m_result;
+}
+
+VaapiScheduleSession::VaapiScheduleSession(const SharedPtr<VaapiScheduler>& scheduler)
+    : m_scheduler(scheduler)
+    , m_busy(false)
+    , m_priority(1)
+    , m_credits(1)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+VaapiScheduleSession::~VaapiScheduleSession()
+{
+    //pictures wait for their jobs before they go, this is only a safety net
+    {
+        AutoLock lock(m_scheduler->m_lock);
+        while (!m_jobs.empty() || m_busy)
+            m_scheduler->m_done.wait();
+    }
+    m_scheduler->removeSession(this);
+}
+
+void VaapiScheduleSession::setPriority(uint32_t priority)
+{
+    AutoLock lock(m_scheduler->m_lock);
+    m_priority = priority ? priority : 1;
+}
+
+void VaapiScheduleSession::submit(VaapiScheduler::Job& job)
+{
+    m_scheduler->submit(this, job);
+}
+
+bool VaapiScheduleSession::wait(VaapiScheduler::Job& job)
+{
+    return m_scheduler->wait(job);
+}
+
+void VaapiScheduleSession::getStats(VideoScheduleStats* stats)
+{
+    AutoLock lock(m_scheduler->m_lock);
+    *stats = m_stats;
+}
+}
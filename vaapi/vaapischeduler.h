@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef vaapischeduler_h
+#define vaapischeduler_h
+
+#include "common/condition.h"
+#include "common/lock.h"
+#include "interface/VideoCommonDefs.h"
+#include "vaapi/vaapiptrs.h"
+
+#include <deque>
+#include <list>
+#include <vector>
+#include <pthread.h>
+
+namespace YamiMediaCodec{
+
+class VaapiScheduleSession;
+typedef SharedPtr<VaapiScheduleSession> ScheduleSessionPtr;
+
+/*
+ * Runs the driver submissions of all sessions sharing a display on
+ * a few worker threads, so hundreds of streams in one process do not mean
+ * hundreds of threads fighting over the driver lock. Submitting only queues
+ * a job, the session waits for it when it needs the result. A worker takes
+ * a batch of jobs round robin over the sessions, a session with priority n
+ * gets up to n jobs per round. The jobs of one session run in order and
+ * never on two workers at once.
+ */
+class VaapiScheduler : public EnableSharedFromThis<VaapiScheduler>
+{
+public:
+    class Job {
+    public:
+        Job()
+            : m_session(NULL)
+            , m_pending(false)
+            , m_result(true)
+            , m_queuedUs(0)
+        {
+        }
+        virtual ~Job() {}
+        virtual bool run() = 0;
+
+    private:
+        friend class VaapiScheduler;
+        friend class VaapiScheduleSession;
+        friend class VaapiSchedulerTest;
+        //following members are guarded by the scheduler lock
+        VaapiScheduleSession* m_session;
+        //queued or running
+        bool m_pending;
+        bool m_result;
+        uint64_t m_queuedUs;
+    };
+
+    static SharedPtr<VaapiScheduler> create(uint32_t workers);
+    ~VaapiScheduler();
+
+    ScheduleSessionPtr createSession();
+
+    /// keep @session on the scheduler of @display, reset it if the display has none
+    static void bindSession(ScheduleSessionPtr& session, const DisplayPtr& display, uint32_t priority);
+
+private:
+    friend class VaapiScheduleSession;
+    friend class VaapiSchedulerTest;
+
+    VaapiScheduler();
+    bool start(uint32_t workers);
+    static void* workerThread(void*);
+    void workerLoop();
+    bool takeBatch(std::vector<Job*>& batch, std::vector<VaapiScheduleSession*>& sessions);
+    void finishBatch(const std::vector<VaapiScheduleSession*>& sessions);
+    void submit(VaapiScheduleSession*, Job&);
+    bool wait(Job&);
+    void removeSession(VaapiScheduleSession*);
+
+    Lock m_lock;
+    //workers wait for jobs
+    Condition m_cond;
+    //submitters wait for their jobs
+    Condition m_done;
+    typedef std::list<VaapiScheduleSession*> Sessions;
+    Sessions m_sessions;
+    //where the next round robin pass starts
+    Sessions::iterator m_next;
+    std::vector<pthread_t> m_threads;
+    bool m_quit;
+
+    DISALLOW_COPY_AND_ASSIGN(VaapiScheduler);
+};
+
+/// one decoder or encoder on a scheduler
+class VaapiScheduleSession
+{
+public:
+    ~VaapiScheduleSession();
+
+    /// jobs per round robin round, at least 1
+    void setPriority(uint32_t priority);
+    /// queue @job for a worker and return, @job has to live until wait() returns
+    void submit(VaapiScheduler::Job& job);
+    /// wait for @job to run, returns its result
+    bool wait(VaapiScheduler::Job& job);
+    void getStats(VideoScheduleStats* stats);
+
+private:
+    friend class VaapiScheduler;
+    friend class VaapiSchedulerTest;
+    explicit VaapiScheduleSession(const SharedPtr<VaapiScheduler>&);
+
+    SharedPtr<VaapiScheduler> m_scheduler;
+    //following members are guarded by the scheduler lock
+    std::deque<VaapiScheduler::Job*> m_jobs;
+    //a worker runs jobs of this session
+    bool m_busy;
+    uint32_t m_priority;
+    uint32_t m_credits;
+    VideoScheduleStats m_stats;
+
+    DISALLOW_COPY_AND_ASSIGN(VaapiScheduleSession);
+};
+}
+#endif
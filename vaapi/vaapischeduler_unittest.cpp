@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+// the unittest header must be included before va_x11.h, see vaapidisplay_unittest.cpp
+#include "common/unittest.h"
+
+// primary header
+#include "vaapischeduler.h"
+
+// system headers
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+
+namespace YamiMediaCodec {
+
+class VaapiSchedulerTest : public ::testing::Test {
+protected:
+    typedef VaapiScheduler::Job Job;
+    typedef std::vector<VaapiScheduleSession*> Sessions;
+
+    //a scheduler without workers, batches are taken by the test
+    SharedPtr<VaapiScheduler> createIdle()
+    {
+        return SharedPtr<VaapiScheduler>(new VaapiScheduler);
+    }
+
+    void queue(const ScheduleSessionPtr& session, Job& job)
+    {
+        job.m_session = session.get();
+        job.m_pending = true;
+        session->m_jobs.push_back(&job);
+    }
+
+    bool takeBatch(const SharedPtr<VaapiScheduler>& scheduler, std::vector<Job*>& batch)
+    {
+        //what a worker does after running the previous batch
+        scheduler->finishBatch(m_taken);
+        return scheduler->takeBatch(batch, m_taken);
+    }
+
+    //take and finish batches like two workers would
+    bool takeBatch(const SharedPtr<VaapiScheduler>& scheduler, std::vector<Job*>& batch,
+        Sessions& sessions)
+    {
+        return scheduler->takeBatch(batch, sessions);
+    }
+
+    void finishBatch(const SharedPtr<VaapiScheduler>& scheduler, const Sessions& sessions)
+    {
+        scheduler->finishBatch(sessions);
+    }
+
+    Sessions m_taken;
+};
+
+#define VAAPISCHEDULER_TEST(name) \
+    TEST_F(VaapiSchedulerTest, name)
+
+class CountJob : public VaapiScheduler::Job {
+public:
+    CountJob()
+        : m_runs(0)
+    {
+    }
+    bool run()
+    {
+        m_runs++;
+        return true;
+    }
+    int m_runs;
+};
+
+//runs once the test opens the gate
+class GateJob : public VaapiScheduler::Job {
+public:
+    GateJob()
+        : m_cond(m_lock)
+        , m_open(false)
+        , m_ran(false)
+    {
+    }
+    bool run()
+    {
+        AutoLock lock(m_lock);
+        while (!m_open)
+            m_cond.wait();
+        m_ran = true;
+        return false;
+    }
+    void open()
+    {
+        AutoLock lock(m_lock);
+        m_open = true;
+        m_cond.signal();
+    }
+    bool ran()
+    {
+        AutoLock lock(m_lock);
+        return m_ran;
+    }
+
+private:
+    Lock m_lock;
+    Condition m_cond;
+    bool m_open;
+    bool m_ran;
+};
+
+//records the order its jobs ran in and whether two ever overlapped
+class OrderJob : public VaapiScheduler::Job {
+public:
+    OrderJob(int index, std::vector<int>& order, int& running, bool& overlapped)
+        : m_index(index)
+        , m_order(order)
+        , m_running(running)
+        , m_overlapped(overlapped)
+    {
+    }
+    bool run()
+    {
+        //only one worker may be in here for a session, so no lock
+        if (m_running++)
+            m_overlapped = true;
+        m_order.push_back(m_index);
+        usleep(100);
+        m_running--;
+        return true;
+    }
+
+private:
+    int m_index;
+    std::vector<int>& m_order;
+    int& m_running;
+    bool& m_overlapped;
+};
+
+static void* submitFrom(void* arg)
+{
+    ScheduleSessionPtr& session = *static_cast<ScheduleSessionPtr*>(arg);
+    CountJob job;
+    for (int i = 0; i < 100; i++) {
+        session->submit(job);
+        if (!session->wait(job))
+            break;
+    }
+    return reinterpret_cast<void*>(job.m_runs);
+}
+
+VAAPISCHEDULER_TEST(RunJobs)
+{
+    SharedPtr<VaapiScheduler> scheduler = VaapiScheduler::create(2);
+    ASSERT_TRUE(bool(scheduler));
+
+    const int SESSIONS = 8;
+    ScheduleSessionPtr sessions[SESSIONS];
+    pthread_t threads[SESSIONS];
+    for (int i = 0; i < SESSIONS; i++) {
+        sessions[i] = scheduler->createSession();
+        sessions[i]->setPriority(i % 3 + 1);
+        ASSERT_EQ(0, pthread_create(&threads[i], NULL, submitFrom, &sessions[i]));
+    }
+    for (int i = 0; i < SESSIONS; i++) {
+        void* runs;
+        pthread_join(threads[i], &runs);
+        EXPECT_EQ(100, reinterpret_cast<intptr_t>(runs));
+
+        VideoScheduleStats stats;
+        sessions[i]->getStats(&stats);
+        EXPECT_EQ(100u, stats.jobs);
+        EXPECT_LE(stats.maxQueueUs, stats.totalQueueUs);
+    }
+}
+
+VAAPISCHEDULER_TEST(SubmitDoesNotWait)
+{
+    SharedPtr<VaapiScheduler> scheduler = VaapiScheduler::create(1);
+    ASSERT_TRUE(bool(scheduler));
+    ScheduleSessionPtr session = scheduler->createSession();
+
+    GateJob job;
+    session->submit(job);
+    EXPECT_FALSE(job.ran());
+    job.open();
+    EXPECT_FALSE(session->wait(job));
+    EXPECT_TRUE(job.ran());
+}
+
+VAAPISCHEDULER_TEST(SessionOrder)
+{
+    SharedPtr<VaapiScheduler> scheduler = VaapiScheduler::create(4);
+    ASSERT_TRUE(bool(scheduler));
+    ScheduleSessionPtr session = scheduler->createSession();
+
+    const int JOBS = 64;
+    std::vector<int> order;
+    int running = 0;
+    bool overlapped = false;
+    std::vector<SharedPtr<OrderJob> > jobs;
+    for (int i = 0; i < JOBS; i++) {
+        jobs.push_back(SharedPtr<OrderJob>(new OrderJob(i, order, running, overlapped)));
+        session->submit(*jobs.back());
+    }
+    for (int i = 0; i < JOBS; i++)
+        EXPECT_TRUE(session->wait(*jobs[i]));
+
+    EXPECT_FALSE(overlapped);
+    ASSERT_EQ(JOBS, (int)order.size());
+    for (int i = 0; i < JOBS; i++)
+        EXPECT_EQ(i, order[i]);
+}
+
+VAAPISCHEDULER_TEST(Priority)
+{
+    SharedPtr<VaapiScheduler> scheduler = createIdle();
+    ScheduleSessionPtr high = scheduler->createSession();
+    ScheduleSessionPtr low = scheduler->createSession();
+    high->setPriority(3);
+
+    CountJob highJobs[6], lowJobs[6];
+    for (int i = 0; i < 6; i++) {
+        queue(high, highJobs[i]);
+        queue(low, lowJobs[i]);
+    }
+
+    //one job each from the initial credits, then rounds of 3 to 1
+    std::vector<Job*> batch;
+    ASSERT_TRUE(takeBatch(scheduler, batch));
+    ASSERT_EQ(2u, batch.size());
+    EXPECT_EQ(&highJobs[0], batch[0]);
+    EXPECT_EQ(&lowJobs[0], batch[1]);
+
+    ASSERT_TRUE(takeBatch(scheduler, batch));
+    ASSERT_EQ(4u, batch.size());
+    EXPECT_EQ(&highJobs[1], batch[0]);
+    EXPECT_EQ(&highJobs[3], batch[2]);
+    EXPECT_EQ(&lowJobs[1], batch[3]);
+
+    ASSERT_TRUE(takeBatch(scheduler, batch));
+    ASSERT_EQ(3u, batch.size());
+    EXPECT_EQ(&highJobs[4], batch[0]);
+    EXPECT_EQ(&highJobs[5], batch[1]);
+    EXPECT_EQ(&lowJobs[2], batch[2]);
+
+    for (int i = 3; i < 6; i++) {
+        ASSERT_TRUE(takeBatch(scheduler, batch));
+        ASSERT_EQ(1u, batch.size());
+        EXPECT_EQ(&lowJobs[i], batch[0]);
+    }
+    EXPECT_FALSE(takeBatch(scheduler, batch));
+
+    VideoScheduleStats stats;
+    high->getStats(&stats);
+    EXPECT_EQ(6u, stats.jobs);
+}
+
+VAAPISCHEDULER_TEST(BusySessionIsSkipped)
+{
+    SharedPtr<VaapiScheduler> scheduler = createIdle();
+    ScheduleSessionPtr first = scheduler->createSession();
+    ScheduleSessionPtr second = scheduler->createSession();
+    first->setPriority(2);
+
+    CountJob firstJobs[3], secondJob;
+    for (int i = 0; i < 3; i++)
+        queue(first, firstJobs[i]);
+    queue(second, secondJob);
+
+    std::vector<Job*> batch;
+    Sessions taken;
+    ASSERT_TRUE(takeBatch(scheduler, batch, taken));
+    ASSERT_EQ(2u, batch.size());
+    EXPECT_EQ(&firstJobs[0], batch[0]);
+    EXPECT_EQ(&secondJob, batch[1]);
+
+    //a second worker must not run the later jobs of a session in flight
+    Sessions other;
+    EXPECT_FALSE(takeBatch(scheduler, batch, other));
+
+    finishBatch(scheduler, taken);
+    ASSERT_TRUE(takeBatch(scheduler, batch, other));
+    EXPECT_EQ(&firstJobs[1], batch[0]);
+    finishBatch(scheduler, other);
+}
+}
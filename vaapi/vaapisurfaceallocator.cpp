@@ -20,6 +20,8 @@
 
 #include "common/log.h"
 #include "vaapi/vaapisurfaceallocator.h"
+#include "vaapi/vaapidisplay.h"
+#include "vaapi/vaapiresourcecache.h"
 #include "vaapi/VaapiUtils.h"
 #include <vector>
 
@@ -80,4 +82,40 @@ void VaapiSurfaceAllocator::doUnref()
     delete this;
 }
 
+VaapiCachedSurfaceAllocator::VaapiCachedSurfaceAllocator(const DisplayPtr& display, uint32_t extraSize)
+    : VaapiSurfaceAllocator(display->getID(), extraSize)
+    , m_cacheDisplay(display)
+    , m_cacheExtraSize(extraSize)
+{
+}
+
+YamiStatus VaapiCachedSurfaceAllocator::doAlloc(SurfaceAllocParams* params)
+{
+    if (!params || !params->width || !params->height || !params->size)
+        return YAMI_INVALID_PARAM;
+    std::vector<VASurfaceID> v;
+    if (!VaapiResourceCache::getInstance()->takeSurfaces(m_cacheDisplay, params->fourcc,
+            params->width, params->height, params->size + m_cacheExtraSize, v))
+        return VaapiSurfaceAllocator::doAlloc(params);
+    uint32_t size = v.size();
+    params->surfaces = new intptr_t[size];
+    for (uint32_t i = 0; i < size; i++) {
+        params->surfaces[i] = (intptr_t)v[i];
+    }
+    params->size = size;
+    return YAMI_SUCCESS;
+}
+
+YamiStatus VaapiCachedSurfaceAllocator::doFree(SurfaceAllocParams* params)
+{
+    if (!params || !params->size || !params->surfaces)
+        return YAMI_INVALID_PARAM;
+    std::vector<VASurfaceID> v(params->surfaces, params->surfaces + params->size);
+    if (!VaapiResourceCache::getInstance()->putSurfaces(m_cacheDisplay, params->fourcc,
+            params->width, params->height, v))
+        return VaapiSurfaceAllocator::doFree(params);
+    delete[] params->surfaces;
+    return YAMI_SUCCESS;
+}
+
 } //YamiMediaCodec
@@ -18,12 +18,14 @@
 #define vaapisurfaceallocator_h
 #include "common/basesurfaceallocator.h"
 #include "common/NonCopyable.h"
+#include "vaapi/vaapiptrs.h"
 #include <va/va.h>
 
 namespace YamiMediaCodec{
 
 class VaapiSurfaceAllocator : public BaseSurfaceAllocator
 {
+protected:
     //extra buffer size for performance
     static const uint32_t EXTRA_BUFFER_SIZE = 5;
 public:
@@ -40,5 +42,20 @@ private:
     DISALLOW_COPY_AND_ASSIGN(VaapiSurfaceAllocator);
 };
 
+//takes surface sets from VaapiResourceCache and gives them back on free,
+//behaves like VaapiSurfaceAllocator while the cache is disabled
+class VaapiCachedSurfaceAllocator : public VaapiSurfaceAllocator
+{
+public:
+    VaapiCachedSurfaceAllocator(const DisplayPtr& display, uint32_t extraSize = EXTRA_BUFFER_SIZE);
+protected:
+    virtual YamiStatus doAlloc(SurfaceAllocParams* params);
+    virtual YamiStatus doFree(SurfaceAllocParams* params);
+private:
+    DisplayPtr m_cacheDisplay;
+    uint32_t  m_cacheExtraSize;
+    DISALLOW_COPY_AND_ASSIGN(VaapiCachedSurfaceAllocator);
+};
+
 }
 #endif //vaapisurfaceallocator_h
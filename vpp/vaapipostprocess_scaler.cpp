@@ -25,6 +25,7 @@
 #include "vaapipostprocess_factory.h"
 #include "common/log.h"
 #include <va/va_vpp.h>
+#include <string.h>
 
 namespace YamiMediaCodec {
 
@@ -82,40 +83,85 @@ bool VaapiPostProcessScaler::getFilters(std::vector<VABufferID>& filters)
     return !filters.empty();
 }
 
-YamiStatus
-VaapiPostProcessScaler::process(const SharedPtr<VideoFrame>& src,
-    const SharedPtr<VideoFrame>& dest)
+void VaapiPostProcessScaler::fillSource(VAProcPipelineParameterBuffer& param,
+    VARectangle& srcCrop, std::vector<VABufferID>& filters,
+    const SharedPtr<VideoFrame>& src)
 {
-    if (!m_context) {
-        ERROR("NO context for scaler");
-        return YAMI_FAIL;
-    }
-    if (!src || !dest) {
-        return YAMI_INVALID_PARAM;
+    memset(&param, 0, sizeof(param));
+    if (fillRect(srcCrop, src->crop))
+        param.surface_region = &srcCrop;
+    param.surface = (VASurfaceID)src->surface;
+    param.surface_color_standard = fourccToColorStandard(src->fourcc);
+
+    if (getFilters(filters)) {
+        param.filters = &filters[0];
+        param.num_filters = (unsigned int)filters.size();
     }
+}
+
+YamiStatus VaapiPostProcessScaler::processDest(const VAProcPipelineParameterBuffer& source,
+    const SharedPtr<VideoFrame>& src, const SharedPtr<VideoFrame>& dest)
+{
     copyVideoFrameMeta(src, dest);
     SurfacePtr surface(new VaapiSurface(dest));
     VaapiVppPicture picture(m_context, surface);
     VAProcPipelineParameterBuffer* vppParam;
     if (!picture.editVppParam(vppParam))
         return YAMI_OUT_MEMORY;
-    VARectangle srcCrop, destCrop;
-    if (fillRect(srcCrop, src->crop))
-        vppParam->surface_region = &srcCrop;
-    vppParam->surface = (VASurfaceID)src->surface;
-    vppParam->surface_color_standard = fourccToColorStandard(src->fourcc);
+    *vppParam = source;
 
+    VARectangle destCrop;
     if (fillRect(destCrop, dest->crop))
         vppParam->output_region = &destCrop;
     vppParam->output_color_standard = fourccToColorStandard(dest->fourcc);
 
-    std::vector<VABufferID> filters;
-    if (getFilters(filters)) {
-        vppParam->filters = &filters[0];
-        vppParam->num_filters = (unsigned int)filters.size();
+    return picture.process() ? YAMI_SUCCESS : YAMI_FAIL;
+}
+
+YamiStatus
+VaapiPostProcessScaler::process(const SharedPtr<VideoFrame>& src,
+    const SharedPtr<VideoFrame>& dest)
+{
+    if (!m_context) {
+        ERROR("NO context for scaler");
+        return YAMI_FAIL;
+    }
+    if (!src || !dest) {
+        return YAMI_INVALID_PARAM;
     }
+    VAProcPipelineParameterBuffer source;
+    VARectangle srcCrop;
+    std::vector<VABufferID> filters;
+    fillSource(source, srcCrop, filters, src);
+    return processDest(source, src, dest);
+}
 
-    return picture.process() ? YAMI_SUCCESS : YAMI_FAIL;
+YamiStatus
+VaapiPostProcessScaler::processMulti(const SharedPtr<VideoFrame>& src,
+    const std::vector<SharedPtr<VideoFrame> >& dests)
+{
+    if (!m_context) {
+        ERROR("NO context for scaler");
+        return YAMI_FAIL;
+    }
+    if (!src)
+        return YAMI_INVALID_PARAM;
+    for (size_t i = 0; i < dests.size(); i++) {
+        if (!dests[i])
+            return YAMI_INVALID_PARAM;
+    }
+    //source region, color standard and filters are the same for every destination,
+    //each destination still needs its own vaBeginPicture on the output surface
+    VAProcPipelineParameterBuffer source;
+    VARectangle srcCrop;
+    std::vector<VABufferID> filters;
+    fillSource(source, srcCrop, filters, src);
+    for (size_t i = 0; i < dests.size(); i++) {
+        YamiStatus status = processDest(source, src, dests[i]);
+        if (status != YAMI_SUCCESS)
+            return status;
+    }
+    return YAMI_SUCCESS;
 }
 
 bool VaapiPostProcessScaler::mapToRange(
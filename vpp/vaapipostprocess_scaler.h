@@ -29,6 +29,8 @@ public:
     VaapiPostProcessScaler();
     virtual YamiStatus process(const SharedPtr<VideoFrame>& src,
                                const SharedPtr<VideoFrame>& dest);
+    virtual YamiStatus processMulti(const SharedPtr<VideoFrame>& src,
+                                    const std::vector<SharedPtr<VideoFrame> >& dests);
 
     virtual YamiStatus setParameters(VppParamType type, void* vppParam);
 
@@ -58,6 +60,10 @@ private:
     YamiStatus setParamToNone(ProcParams& params, int32_t none);
 
     bool getFilters(std::vector<VABufferID>& filters);
+    void fillSource(VAProcPipelineParameterBuffer& param, VARectangle& srcCrop,
+        std::vector<VABufferID>& filters, const SharedPtr<VideoFrame>& src);
+    YamiStatus processDest(const VAProcPipelineParameterBuffer& source,
+        const SharedPtr<VideoFrame>& src, const SharedPtr<VideoFrame>& dest);
     YamiStatus createFilter(BufObjectPtr& filter, VAProcFilterType, float value);
 
     YamiStatus setProcParams(ProcParams& params, int32_t level,
@@ -33,7 +33,8 @@ bool VaapiVppPicture::editVppParam(VAProcPipelineParameterBuffer*& vppParm)
 
 bool VaapiVppPicture::process()
 {
-    return render();
+    //the caller hands the output surface on right away
+    return render() && wait();
 }
 
 bool VaapiVppPicture::doRender()
@@ -26,7 +26,8 @@ class VaapiVppPicture:public VaapiPicture {
 public:
     VaapiVppPicture(const ContextPtr& context,
                     const SurfacePtr & surface);
-    virtual ~VaapiVppPicture() { }
+    //the render job may still read our buffers
+    virtual ~VaapiVppPicture() { wait(); }
 
     bool editVppParam(VAProcPipelineParameterBuffer*&);
 